@@ -1,21 +1,65 @@
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "platform.h"
 #include "core/bios.h"
+#include "core/bus.h"
 #include "core/cartridge.h"
+#include "core/cpu.h"
+#include "core/defines.h"
 #include "core/ewram.h"
 #include "core/io.h"
 #include "core/iwram.h"
 #include "core/ppu.h"
+#include "core/scheduler.h"
 
+uint8_t gba_bus_cycles[GBA_BUS_ACCESS_COUNT][16];
+bool gba_bus_sequential;
+bool gba_bus_writeHashing;
+uint32_t gba_bus_writeHash;
+
+void gba_bus_reset();
 uint8_t gba_bus_read8(uint32_t address);
 uint16_t gba_bus_read16(uint32_t address);
 uint32_t gba_bus_read32(uint32_t address);
 void gba_bus_write8(uint32_t address, uint8_t value);
 void gba_bus_write16(uint32_t address, uint16_t value);
 void gba_bus_write32(uint32_t address, uint32_t value);
+uint8_t gba_bus_peek8(uint32_t address);
+uint16_t gba_bus_peek16(uint32_t address);
+uint32_t gba_bus_peek32(uint32_t address);
+uint32_t *gba_bus_getBurst32(uint32_t address, uint32_t count, bool write);
+void gba_bus_writeCallback_waitcnt(uint32_t address, uint16_t value);
+static inline void gba_bus_updateCycles(uint16_t waitcnt);
+static inline void gba_bus_addCycles(uint32_t address, gba_bus_access_t access);
+static inline void gba_bus_hashWrite(uint32_t address, uint32_t value);
+
+void gba_bus_reset() {
+    gba_bus_sequential = false;
+    gba_bus_updateCycles(gba_io_getRegister(0x04000204)->value);
+}
 
 uint8_t gba_bus_read8(uint32_t address) {
+    gba_bus_addCycles(address, GBA_BUS_ACCESS_N16);
+
+    return gba_bus_peek8(address);
+}
+
+uint16_t gba_bus_read16(uint32_t address) {
+    gba_bus_addCycles(address, GBA_BUS_ACCESS_N16);
+
+    return gba_bus_peek16(address);
+}
+
+uint32_t gba_bus_read32(uint32_t address) {
+    gba_bus_addCycles(address, GBA_BUS_ACCESS_N32);
+
+    return gba_bus_peek32(address);
+}
+
+// Peeking reads memory without taking any cycles, for the code that looks
+// at memory without emulating an access.
+uint8_t gba_bus_peek8(uint32_t address) {
     switch((address & 0x0f000000) >> 24) {
         case 0x0: // BIOS
         case 0x1:
@@ -59,7 +103,7 @@ uint8_t gba_bus_read8(uint32_t address) {
     return 0x00;
 }
 
-uint16_t gba_bus_read16(uint32_t address) {
+uint16_t gba_bus_peek16(uint32_t address) {
     switch((address & 0x0f000000) >> 24) {
         case 0x0: // BIOS
         case 0x1:
@@ -103,7 +147,7 @@ uint16_t gba_bus_read16(uint32_t address) {
     return 0x0000;
 }
 
-uint32_t gba_bus_read32(uint32_t address) {
+uint32_t gba_bus_peek32(uint32_t address) {
     switch((address & 0x0f000000) >> 24) {
         case 0x0: // BIOS
         case 0x1:
@@ -148,13 +192,21 @@ uint32_t gba_bus_read32(uint32_t address) {
 }
 
 void gba_bus_write8(uint32_t address, uint8_t value) {
+    gba_bus_addCycles(address, GBA_BUS_ACCESS_N16);
+
+    if(gba_bus_writeHashing) {
+        gba_bus_hashWrite(address, value);
+    }
+
     switch((address & 0x0f000000) >> 24) {
         case 0x02: // EWRAM
         gba_ewram_write8(address, value);
+        gba_cpu_invalidateCode(address);
         break;
 
         case 0x03: // IWRAM
         gba_iwram_write8(address, value);
+        gba_cpu_invalidateCode(address);
         break;
 
         case 0x04: // IO
@@ -181,13 +233,21 @@ void gba_bus_write8(uint32_t address, uint8_t value) {
 }
 
 void gba_bus_write16(uint32_t address, uint16_t value) {
+    gba_bus_addCycles(address, GBA_BUS_ACCESS_N16);
+
+    if(gba_bus_writeHashing) {
+        gba_bus_hashWrite(address, value);
+    }
+
     switch((address & 0x0f000000) >> 24) {
         case 0x02: // EWRAM
         gba_ewram_write16(address, value);
+        gba_cpu_invalidateCode(address);
         break;
 
         case 0x03: // IWRAM
         gba_iwram_write16(address, value);
+        gba_cpu_invalidateCode(address);
         break;
 
         case 0x04: // IO
@@ -214,13 +274,21 @@ void gba_bus_write16(uint32_t address, uint16_t value) {
 }
 
 void gba_bus_write32(uint32_t address, uint32_t value) {
+    gba_bus_addCycles(address, GBA_BUS_ACCESS_N32);
+
+    if(gba_bus_writeHashing) {
+        gba_bus_hashWrite(address, value);
+    }
+
     switch((address & 0x0f000000) >> 24) {
         case 0x02: // EWRAM
         gba_ewram_write32(address, value);
+        gba_cpu_invalidateCode(address);
         break;
 
         case 0x03: // IWRAM
         gba_iwram_write32(address, value);
+        gba_cpu_invalidateCode(address);
         break;
 
         case 0x04: // IO
@@ -245,3 +313,115 @@ void gba_bus_write32(uint32_t address, uint32_t value) {
         break;
     }
 }
+
+// Hashed writes go through gba_bus_write32() so that they are folded in
+// order. A burst is shorter than a code page, so invalidating the pages of
+// its first and last words covers it.
+uint32_t *gba_bus_getBurst32(uint32_t address, uint32_t count, bool write) {
+    uint8_t *buffer;
+    uint32_t offset;
+    uint32_t region = (address & 0x0f000000) >> 24;
+
+    if(count == 0 || (write && gba_bus_writeHashing)) {
+        return NULL;
+    }
+
+    switch(region) {
+        case 0x02: // EWRAM
+        buffer = gba_ewram_buffer;
+        offset = address & (GBA_EWRAM_SIZE - 4);
+
+        if(offset + count * 4 > GBA_EWRAM_SIZE) {
+            return NULL;
+        }
+
+        break;
+
+        case 0x03: // IWRAM
+        buffer = gba_iwram_buffer;
+        offset = address & (GBA_IWRAM_SIZE - 4);
+
+        if(offset + count * 4 > GBA_IWRAM_SIZE) {
+            return NULL;
+        }
+
+        break;
+
+        default:
+        return NULL;
+    }
+
+    gba_scheduler_cycleCounter += gba_bus_cycles[GBA_BUS_ACCESS_N32 + gba_bus_sequential][region];
+    gba_scheduler_cycleCounter += (count - 1) * gba_bus_cycles[GBA_BUS_ACCESS_S32][region];
+
+    if(write) {
+        gba_cpu_invalidateCode(address);
+        gba_cpu_invalidateCode(address + (count - 1) * 4);
+    }
+
+    return (uint32_t *)(buffer + offset);
+}
+
+void gba_bus_writeCallback_waitcnt(uint32_t address, uint16_t value) {
+    UNUSED(address);
+
+    gba_bus_updateCycles(value);
+    gba_cpu_invalidateCycles();
+}
+
+// Builds the cost of each kind of access to each region, including the
+// first cycle. The game pak bus is 16 bits wide, so 32-bit accesses to it
+// take a non-sequential and a sequential access.
+static inline void gba_bus_updateCycles(uint16_t waitcnt) {
+    static const uint8_t firstAccess[4] = {4, 3, 2, 8};
+
+    static const uint8_t fixedCycles[8][2] = {
+        {1, 1}, // BIOS
+        {1, 1},
+        {3, 6}, // EWRAM
+        {1, 1}, // IWRAM
+        {1, 1}, // IO
+        {1, 2}, // Palette
+        {1, 2}, // VRAM
+        {1, 1}  // OAM
+    };
+
+    for(int i = 0; i < 8; i++) {
+        gba_bus_cycles[GBA_BUS_ACCESS_N16][i] = fixedCycles[i][0];
+        gba_bus_cycles[GBA_BUS_ACCESS_S16][i] = fixedCycles[i][0];
+        gba_bus_cycles[GBA_BUS_ACCESS_N32][i] = fixedCycles[i][1];
+        gba_bus_cycles[GBA_BUS_ACCESS_S32][i] = fixedCycles[i][1];
+    }
+
+    uint8_t romCycles[3][2] = {
+        {1 + firstAccess[(waitcnt >> 2) & 3], (waitcnt & (1 << 4)) ? 2 : 3},
+        {1 + firstAccess[(waitcnt >> 5) & 3], (waitcnt & (1 << 7)) ? 2 : 5},
+        {1 + firstAccess[(waitcnt >> 8) & 3], (waitcnt & (1 << 10)) ? 2 : 9}
+    };
+
+    for(int i = 0; i < 3; i++) {
+        for(int j = 0x08 + i * 2; j < 0x0a + i * 2; j++) {
+            gba_bus_cycles[GBA_BUS_ACCESS_N16][j] = romCycles[i][0];
+            gba_bus_cycles[GBA_BUS_ACCESS_S16][j] = romCycles[i][1];
+            gba_bus_cycles[GBA_BUS_ACCESS_N32][j] = romCycles[i][0] + romCycles[i][1];
+            gba_bus_cycles[GBA_BUS_ACCESS_S32][j] = romCycles[i][1] * 2;
+        }
+    }
+
+    uint8_t sramCycles = 1 + firstAccess[waitcnt & 3];
+
+    for(int i = 0; i < GBA_BUS_ACCESS_COUNT; i++) {
+        gba_bus_cycles[i][0x0e] = sramCycles;
+        gba_bus_cycles[i][0x0f] = sramCycles;
+    }
+}
+
+static inline void gba_bus_addCycles(uint32_t address, gba_bus_access_t access) {
+    gba_scheduler_cycleCounter += gba_bus_cycles[access + gba_bus_sequential][(address >> 24) & 0x0f];
+}
+
+// FNV-1a over the address and the value of every write.
+static inline void gba_bus_hashWrite(uint32_t address, uint32_t value) {
+    gba_bus_writeHash = (gba_bus_writeHash ^ address) * 16777619;
+    gba_bus_writeHash = (gba_bus_writeHash ^ value) * 16777619;
+}
@@ -1,13 +1,45 @@
 #ifndef __CORE_BUS_H__
 #define __CORE_BUS_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// The sequential kinds immediately follow their non-sequential ones.
+typedef enum {
+    GBA_BUS_ACCESS_N16,
+    GBA_BUS_ACCESS_S16,
+    GBA_BUS_ACCESS_N32,
+    GBA_BUS_ACCESS_S32,
+    GBA_BUS_ACCESS_COUNT
+} gba_bus_access_t;
+
+// Cycles taken by each kind of access to each 16 MiB region, rebuilt when
+// WAITCNT is written. Reads and writes add them to the cycle counter.
+extern uint8_t gba_bus_cycles[GBA_BUS_ACCESS_COUNT][16];
+
+// Set by the callers performing a burst of consecutive accesses, such as
+// LDM/STM and DMA, after the first one.
+extern bool gba_bus_sequential;
+
+// When enabled, every write is folded into the hash, so that tools can tell
+// whether two runs wrote the same values to the same addresses.
+extern bool gba_bus_writeHashing;
+extern uint32_t gba_bus_writeHash;
+
+extern void gba_bus_reset();
 extern uint8_t gba_bus_read8(uint32_t address);
 extern uint16_t gba_bus_read16(uint32_t address);
 extern uint32_t gba_bus_read32(uint32_t address);
 extern void gba_bus_write8(uint32_t address, uint8_t value);
 extern void gba_bus_write16(uint32_t address, uint16_t value);
 extern void gba_bus_write32(uint32_t address, uint32_t value);
+extern uint8_t gba_bus_peek8(uint32_t address);
+extern uint16_t gba_bus_peek16(uint32_t address);
+extern uint32_t gba_bus_peek32(uint32_t address);
+// Returns the memory backing a burst of at most 16 consecutive words when it
+// sits in EWRAM or IWRAM, taking the cycles of the whole burst, and NULL
+// otherwise, in which case the caller performs the accesses one at a time.
+extern uint32_t *gba_bus_getBurst32(uint32_t address, uint32_t count, bool write);
+extern void gba_bus_writeCallback_waitcnt(uint32_t address, uint16_t value);
 
 #endif
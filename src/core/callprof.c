@@ -0,0 +1,175 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "core/callprof.h"
+#include "core/scheduler.h"
+
+// Every call path gets a node of the call tree, the root being the code
+// that was not entered through a tracked call.
+typedef struct {
+    uint32_t address;
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint64_t samples;
+} gba_callprof_node_t;
+
+bool gba_callprof_enabled;
+gba_callprof_node_t *gba_callprof_nodes;
+uint32_t gba_callprof_nodeCapacity;
+uint32_t gba_callprof_nodeCount;
+uint32_t gba_callprof_node;
+uint32_t gba_callprof_interval;
+uint64_t gba_callprof_nextSample;
+
+// Shadow call stack, holding for each call the address it returns to and
+// the node that was current before it.
+uint32_t gba_callprof_returnAddresses[GBA_CALLPROF_MAX_DEPTH];
+uint32_t gba_callprof_callerNodes[GBA_CALLPROF_MAX_DEPTH];
+int gba_callprof_depth;
+
+void gba_callprof_start(void *buffer, size_t size, uint32_t interval);
+void gba_callprof_stop();
+void gba_callprof_call(uint32_t address, uint32_t returnAddress);
+void gba_callprof_return(uint32_t address);
+int gba_callprof_getDepth();
+void gba_callprof_write(FILE *file, gba_callprof_formatter_t *formatter);
+static inline void gba_callprof_sample();
+static inline uint32_t gba_callprof_getChild(uint32_t parent, uint32_t address);
+
+// Builds the call tree in the given buffer and samples the current call
+// path every interval cycles from now on.
+void gba_callprof_start(void *buffer, size_t size, uint32_t interval) {
+    gba_callprof_nodes = buffer;
+    gba_callprof_nodeCapacity = size / sizeof(gba_callprof_node_t);
+    gba_callprof_interval = interval ? interval : 1;
+    gba_callprof_nextSample = gba_scheduler_cycleCounter + gba_callprof_interval;
+    gba_callprof_depth = 0;
+    gba_callprof_node = 0;
+    gba_callprof_nodeCount = 0;
+    gba_callprof_enabled = gba_callprof_nodeCapacity != 0;
+
+    if(gba_callprof_enabled) {
+        gba_callprof_nodes[0] = (gba_callprof_node_t){0, 0, 0, 0, 0};
+        gba_callprof_nodeCount = 1;
+    }
+}
+
+void gba_callprof_stop() {
+    if(gba_callprof_enabled) {
+        gba_callprof_sample();
+        gba_callprof_enabled = false;
+    }
+}
+
+// Once the tree is full, the new call paths are merged into their caller.
+void gba_callprof_call(uint32_t address, uint32_t returnAddress) {
+    gba_callprof_sample();
+
+    if(gba_callprof_depth == GBA_CALLPROF_MAX_DEPTH) {
+        return;
+    }
+
+    gba_callprof_returnAddresses[gba_callprof_depth] = returnAddress & 0xfffffffe;
+    gba_callprof_callerNodes[gba_callprof_depth] = gba_callprof_node;
+    gba_callprof_depth++;
+    gba_callprof_node = gba_callprof_getChild(gba_callprof_node, address & 0xfffffffe);
+}
+
+// Jumps to an address that no call returns to are ignored, which also skips
+// the frames of functions left without returning.
+void gba_callprof_return(uint32_t address) {
+    address &= 0xfffffffe;
+
+    for(int i = gba_callprof_depth - 1; i >= 0; i--) {
+        if(gba_callprof_returnAddresses[i] == address) {
+            gba_callprof_sample();
+            gba_callprof_depth = i;
+            gba_callprof_node = gba_callprof_callerNodes[i];
+            return;
+        }
+    }
+}
+
+int gba_callprof_getDepth() {
+    return gba_callprof_depth;
+}
+
+// Writes one line per call path that was sampled, holding the functions
+// from the outermost one separated by semicolons, then the sample count.
+void gba_callprof_write(FILE *file, gba_callprof_formatter_t *formatter) {
+    uint32_t path[GBA_CALLPROF_MAX_DEPTH];
+    char name[128];
+
+    if(gba_callprof_enabled) {
+        gba_callprof_sample();
+    }
+
+    for(uint32_t i = 0; i < gba_callprof_nodeCount; i++) {
+        if(!gba_callprof_nodes[i].samples) {
+            continue;
+        }
+
+        if(i == 0) {
+            fprintf(file, "[root] %llu\n", (unsigned long long)gba_callprof_nodes[0].samples);
+            continue;
+        }
+
+        int length = 0;
+
+        for(uint32_t node = i; node != 0; node = gba_callprof_nodes[node].parent) {
+            path[length++] = node;
+        }
+
+        while(length--) {
+            uint32_t address = gba_callprof_nodes[path[length]].address;
+
+            if(formatter) {
+                formatter(address, name, sizeof(name));
+            } else {
+                snprintf(name, sizeof(name), "0x%08x", address);
+            }
+
+            fprintf(file, "%s%c", name, length ? ';' : ' ');
+        }
+
+        fprintf(file, "%llu\n", (unsigned long long)gba_callprof_nodes[i].samples);
+    }
+}
+
+// Samples are taken lazily, when the call path is about to change, so that
+// profiling does not add any event to the scheduler.
+static inline void gba_callprof_sample() {
+    if(gba_scheduler_cycleCounter < gba_callprof_nextSample) {
+        return;
+    }
+
+    uint64_t count = (gba_scheduler_cycleCounter - gba_callprof_nextSample) / gba_callprof_interval + 1;
+
+    gba_callprof_nodes[gba_callprof_node].samples += count;
+    gba_callprof_nextSample += count * gba_callprof_interval;
+}
+
+static inline uint32_t gba_callprof_getChild(uint32_t parent, uint32_t address) {
+    uint32_t child = gba_callprof_nodes[parent].firstChild;
+
+    while(child) {
+        if(gba_callprof_nodes[child].address == address) {
+            return child;
+        }
+
+        child = gba_callprof_nodes[child].nextSibling;
+    }
+
+    if(gba_callprof_nodeCount == gba_callprof_nodeCapacity) {
+        return parent;
+    }
+
+    child = gba_callprof_nodeCount++;
+    gba_callprof_nodes[child] = (gba_callprof_node_t){address, parent, 0, gba_callprof_nodes[parent].firstChild, 0};
+    gba_callprof_nodes[parent].firstChild = child;
+
+    return child;
+}
@@ -0,0 +1,25 @@
+#ifndef __CORE_CALLPROF_H__
+#define __CORE_CALLPROF_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define GBA_CALLPROF_MAX_DEPTH 256
+
+// Writes the name of the function at the given address into the buffer.
+typedef void gba_callprof_formatter_t(uint32_t address, char *buffer, size_t size);
+
+// Whether calls are being tracked. The CPU only reports them in builds made
+// with CALLPROF=1.
+extern bool gba_callprof_enabled;
+
+extern void gba_callprof_start(void *buffer, size_t size, uint32_t interval);
+extern void gba_callprof_stop();
+extern void gba_callprof_call(uint32_t address, uint32_t returnAddress);
+extern void gba_callprof_return(uint32_t address);
+extern int gba_callprof_getDepth();
+extern void gba_callprof_write(FILE *file, gba_callprof_formatter_t *formatter);
+
+#endif
@@ -0,0 +1,164 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "core/coverage.h"
+
+bool gba_coverage_enabled;
+uint8_t *gba_coverage_bitmap;
+
+void gba_coverage_start(uint8_t *bitmap);
+void gba_coverage_stop();
+void gba_coverage_mark(uint32_t start, uint32_t end);
+bool gba_coverage_isCovered(const uint8_t *bitmap, uint32_t address);
+size_t gba_coverage_count(const uint8_t *bitmap, size_t offset, size_t size);
+bool gba_coverage_read(FILE *file, uint8_t *bitmap);
+bool gba_coverage_write(FILE *file, const uint8_t *bitmap);
+static inline bool gba_coverage_getBit(uint32_t address, uint32_t *bit, uint32_t *limit);
+
+// Marks the instructions executed from now on into the given bitmap of
+// GBA_COVERAGE_SIZE bytes, keeping the bits already set, so that a bitmap
+// read from a previous run is merged with this one.
+void gba_coverage_start(uint8_t *bitmap) {
+    gba_coverage_bitmap = bitmap;
+    gba_coverage_enabled = true;
+}
+
+void gba_coverage_stop() {
+    gba_coverage_enabled = false;
+}
+
+// Marks the halfwords from start up to, but excluding, end, which must lie
+// in the same memory region. Addresses outside of the covered regions are
+// ignored.
+void gba_coverage_mark(uint32_t start, uint32_t end) {
+    uint32_t first;
+    uint32_t limit;
+
+    if(!gba_coverage_getBit(start, &first, &limit)) {
+        return;
+    }
+
+    uint32_t last = first + ((end - start) >> 1);
+
+    if(last > limit) {
+        last = limit;
+    }
+
+    for(; first < last && (first & 7); first++) {
+        gba_coverage_bitmap[first >> 3] |= 1 << (first & 7);
+    }
+
+    for(; first + 8 <= last; first += 8) {
+        gba_coverage_bitmap[first >> 3] = 0xff;
+    }
+
+    for(; first < last; first++) {
+        gba_coverage_bitmap[first >> 3] |= 1 << (first & 7);
+    }
+}
+
+bool gba_coverage_isCovered(const uint8_t *bitmap, uint32_t address) {
+    uint32_t bit;
+    uint32_t limit;
+
+    if(!gba_coverage_getBit(address, &bit, &limit)) {
+        return false;
+    }
+
+    return (bitmap[bit >> 3] >> (bit & 7)) & 1;
+}
+
+// Counts the covered halfwords in the given bytes of the bitmap.
+size_t gba_coverage_count(const uint8_t *bitmap, size_t offset, size_t size) {
+    size_t count = 0;
+
+    for(size_t i = offset; i < offset + size; i++) {
+        for(uint8_t value = bitmap[i]; value; value &= value - 1) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// Merges the saved bitmap into the given one. Returns false if the file is
+// not a saved bitmap, in which case the given one may be partly merged.
+bool gba_coverage_read(FILE *file, uint8_t *bitmap) {
+    size_t signatureSize = strlen(GBA_COVERAGE_SIGNATURE);
+    char signature[16];
+    uint8_t buffer[4096];
+
+    if(fread(signature, 1, signatureSize, file) != signatureSize || memcmp(signature, GBA_COVERAGE_SIGNATURE, signatureSize)) {
+        return false;
+    }
+
+    for(size_t offset = 0; offset < GBA_COVERAGE_SIZE; offset += sizeof(buffer)) {
+        size_t size = GBA_COVERAGE_SIZE - offset < sizeof(buffer) ? GBA_COVERAGE_SIZE - offset : sizeof(buffer);
+
+        if(fread(buffer, 1, size, file) != size) {
+            return false;
+        }
+
+        for(size_t i = 0; i < size; i++) {
+            bitmap[offset + i] |= buffer[i];
+        }
+    }
+
+    return true;
+}
+
+bool gba_coverage_write(FILE *file, const uint8_t *bitmap) {
+    size_t signatureSize = strlen(GBA_COVERAGE_SIGNATURE);
+
+    return fwrite(GBA_COVERAGE_SIGNATURE, 1, signatureSize, file) == signatureSize
+        && fwrite(bitmap, 1, GBA_COVERAGE_SIZE, file) == GBA_COVERAGE_SIZE;
+}
+
+// Gives the bit of the halfword at the address, and the bit the region of
+// the address ends at.
+static inline bool gba_coverage_getBit(uint32_t address, uint32_t *bit, uint32_t *limit) {
+    uint32_t offset;
+    uint32_t size;
+
+    switch(address >> 24) {
+        case 0x00:
+            if(address >= GBA_BIOS_FILE_SIZE) {
+                return false;
+            }
+
+            offset = GBA_COVERAGE_OFFSET_BIOS;
+            size = GBA_BIOS_FILE_SIZE;
+            break;
+
+        case 0x02:
+            offset = GBA_COVERAGE_OFFSET_EWRAM;
+            size = GBA_EWRAM_SIZE;
+            break;
+
+        case 0x03:
+            offset = GBA_COVERAGE_OFFSET_IWRAM;
+            size = GBA_IWRAM_SIZE;
+            break;
+
+        case 0x08:
+        case 0x09:
+        case 0x0a:
+        case 0x0b:
+        case 0x0c:
+        case 0x0d:
+            offset = GBA_COVERAGE_OFFSET_ROM;
+            size = GBA_MAX_ROM_FILE_SIZE;
+            break;
+
+        default:
+            return false;
+    }
+
+    *bit = offset * 8 + ((address & (size - 1)) >> 1);
+    *limit = (offset + size / 16) * 8;
+
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef __CORE_COVERAGE_H__
+#define __CORE_COVERAGE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "core/defines.h"
+
+// The bitmap holds one bit per halfword of the BIOS, EWRAM, IWRAM and ROM,
+// in that order, bit 0 of each byte being the lowest address. Mirrors are
+// folded onto the same bits.
+#define GBA_COVERAGE_OFFSET_BIOS 0
+#define GBA_COVERAGE_OFFSET_EWRAM (GBA_COVERAGE_OFFSET_BIOS + GBA_BIOS_FILE_SIZE / 16)
+#define GBA_COVERAGE_OFFSET_IWRAM (GBA_COVERAGE_OFFSET_EWRAM + GBA_EWRAM_SIZE / 16)
+#define GBA_COVERAGE_OFFSET_ROM (GBA_COVERAGE_OFFSET_IWRAM + GBA_IWRAM_SIZE / 16)
+#define GBA_COVERAGE_SIZE (GBA_COVERAGE_OFFSET_ROM + GBA_MAX_ROM_FILE_SIZE / 16)
+
+// Saved bitmaps start with this signature.
+#define GBA_COVERAGE_SIGNATURE "GBACOVER"
+
+// Whether executed instructions are being marked. The JIT backend hands
+// over to the cached backend meanwhile, as translated code is not observed.
+extern bool gba_coverage_enabled;
+
+extern void gba_coverage_start(uint8_t *bitmap);
+extern void gba_coverage_stop();
+extern void gba_coverage_mark(uint32_t start, uint32_t end);
+extern bool gba_coverage_isCovered(const uint8_t *bitmap, uint32_t address);
+extern size_t gba_coverage_count(const uint8_t *bitmap, size_t offset, size_t size);
+extern bool gba_coverage_read(FILE *file, uint8_t *bitmap);
+extern bool gba_coverage_write(FILE *file, const uint8_t *bitmap);
+
+#endif
@@ -2,10 +2,25 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef GBA_CPU_PROFILE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#endif
+
 #include "debug.h"
 #include "platform.h"
 #include "core/bus.h"
+#include "core/callprof.h"
+#include "core/coverage.h"
+#include "core/cpu.h"
+#include "core/defines.h"
+#include "core/hle.h"
 #include "core/io.h"
+#include "core/irq.h"
+#include "core/jit.h"
+#include "core/scheduler.h"
+#include "core/trace.h"
 
 typedef enum {
     GBA_CPU_MODE_USR_OLD = 0x00,
@@ -21,6 +36,18 @@ typedef enum {
     GBA_CPU_MODE_SYS = 0x1f
 } gba_cpu_mode_t;
 
+// Register banks. R8 to R12 are only banked in FIQ mode, every other mode
+// shares them with the user bank.
+typedef enum {
+    GBA_CPU_BANK_USR,
+    GBA_CPU_BANK_FIQ,
+    GBA_CPU_BANK_IRQ,
+    GBA_CPU_BANK_SVC,
+    GBA_CPU_BANK_ABT,
+    GBA_CPU_BANK_UND,
+    GBA_CPU_BANK_COUNT
+} gba_cpu_bankIndex_t;
+
 typedef enum {
     GBA_CPU_PIPELINESTATE_FLUSH,
     GBA_CPU_PIPELINESTATE_FETCH,
@@ -47,23 +74,164 @@ typedef enum {
     GBA_CPU_CONDITION_NV
 } gba_cpu_condition_t;
 
+// Operation whose operands the C and V flags are computed from, when they
+// have not been evaluated yet.
+typedef enum {
+    GBA_CPU_LAZYFLAGS_NONE,
+    GBA_CPU_LAZYFLAGS_ADD,
+    GBA_CPU_LAZYFLAGS_SUB
+} gba_cpu_lazyFlags_t;
+
+// Data processing handlers are specialized for each operation, S bit and
+// form of the second operand: an immediate, a register shifted by an
+// immediate, or a register shifted by a register.
+#define GBA_CPU_ARM_DP_VARIANTS(X, op, s) \
+    X(op, s, imm, true, 0, false) \
+    X(op, s, lsl, false, 0, false) \
+    X(op, s, lsr, false, 1, false) \
+    X(op, s, asr, false, 2, false) \
+    X(op, s, ror, false, 3, false) \
+    X(op, s, lslr, false, 0, true) \
+    X(op, s, lsrr, false, 1, true) \
+    X(op, s, asrr, false, 2, true) \
+    X(op, s, rorr, false, 3, true)
+
+#define GBA_CPU_ARM_DP_OPERATION(X, op) \
+    GBA_CPU_ARM_DP_VARIANTS(X, op, 0) \
+    GBA_CPU_ARM_DP_VARIANTS(X, op, 1)
+
+#define GBA_CPU_ARM_DP_OPERATIONS(X) \
+    GBA_CPU_ARM_DP_OPERATION(X, 0) \
+    GBA_CPU_ARM_DP_OPERATION(X, 1) \
+    GBA_CPU_ARM_DP_OPERATION(X, 2) \
+    GBA_CPU_ARM_DP_OPERATION(X, 3) \
+    GBA_CPU_ARM_DP_OPERATION(X, 4) \
+    GBA_CPU_ARM_DP_OPERATION(X, 5) \
+    GBA_CPU_ARM_DP_OPERATION(X, 6) \
+    GBA_CPU_ARM_DP_OPERATION(X, 7) \
+    GBA_CPU_ARM_DP_OPERATION(X, 8) \
+    GBA_CPU_ARM_DP_OPERATION(X, 9) \
+    GBA_CPU_ARM_DP_OPERATION(X, a) \
+    GBA_CPU_ARM_DP_OPERATION(X, b) \
+    GBA_CPU_ARM_DP_OPERATION(X, c) \
+    GBA_CPU_ARM_DP_OPERATION(X, d) \
+    GBA_CPU_ARM_DP_OPERATION(X, e) \
+    GBA_CPU_ARM_DP_OPERATION(X, f)
+
+#define GBA_CPU_ARM_DP_VARIANT_COUNT 9
+
+// Each of the 65536 Thumb encodings is decoded once into a record holding
+// its operands. The registers include the high register bits, and the
+// immediates are sign-extended and scaled to a byte offset where relevant.
+typedef struct {
+    int32_t immediate;
+    uint16_t opcode;
+    uint8_t handler; // Index in gba_cpu_handlers_thumb, 0 if undefined
+    uint8_t rd;
+    uint8_t rs; // Also the base register of memory accesses
+    uint8_t rn; // Also the offset register of memory accesses
+} gba_cpu_thumbRecord_t;
+
 typedef void gba_cpu_opcodeHandlerArm_t(uint32_t opcode);
-typedef void gba_cpu_opcodeHandlerThumb_t(uint16_t opcode);
+typedef void gba_cpu_opcodeHandlerThumb_t(const gba_cpu_thumbRecord_t *record);
+
+// Executes a pair of Thumb instructions, returning false when it stops after
+// the first one.
+typedef bool gba_cpu_fusedHandler_t(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles);
+
+// Code in EWRAM and IWRAM is tracked in pages of this size so that cached
+// blocks can be invalidated when it is overwritten.
+#define GBA_CPU_CODE_PAGE_SHIFT 8
+#define GBA_CPU_CODE_PAGE_COUNT ((GBA_EWRAM_SIZE + GBA_IWRAM_SIZE) >> GBA_CPU_CODE_PAGE_SHIFT)
+#define GBA_CPU_BLOCK_CACHE_SIZE 4096
+#define GBA_CPU_IDLE_LOOP_MAX 16
+
+// Only the serial, keypad and Game Pak interrupts wake the CPU up from the
+// stop state, as the other sources are stopped with it.
+#define GBA_CPU_STOP_WAKEUP_FLAGS ((1 << 7) | (1 << 12) | (1 << 13))
+
+typedef struct {
+    union {
+        gba_cpu_opcodeHandlerArm_t *arm;
+        gba_cpu_opcodeHandlerThumb_t *thumb;
+    } handler;
+
+    uint32_t opcode;
+    uint8_t fused; // Index in gba_cpu_fusedHandlers, 0 unless fused with the next instruction
+    const gba_cpu_thumbRecord_t *record; // Thumb only
+
+#ifdef GBA_CPU_THREADED
+    const void *label;
+#endif
+} gba_cpu_blockInstruction_t;
+
+typedef struct {
+    uint32_t address;
+    uint32_t generation;
+    int page;
+    int length;
+    bool thumb;
+    bool valid;
+    bool idleLoop;
+    gba_cpu_blockInstruction_t instructions[GBA_CPU_BLOCK_MAX_LENGTH];
+    void *jitCode;
+    uint32_t jitEpoch;
+    gba_cpu_aotFunction_t *aotFunction;
+} gba_cpu_block_t;
+
+// Game Pak ROM cannot be written, so the code executed from it is decoded
+// once, a whole page at a time, with a separate page for each instruction
+// set. The pages are taken from a fixed pool until the limit is reached.
+#define GBA_CPU_PREDECODE_PAGE_SHIFT 12
+#define GBA_CPU_PREDECODE_PAGE_COUNT (GBA_MAX_ROM_FILE_SIZE >> GBA_CPU_PREDECODE_PAGE_SHIFT)
+#define GBA_CPU_PREDECODE_POOL_SIZE 256
+
+typedef struct {
+    gba_cpu_blockInstruction_t instructions[1 << (GBA_CPU_PREDECODE_PAGE_SHIFT - 1)];
+} gba_cpu_predecodePage_t;
+
+#ifdef GBA_CPU_PROFILE
+typedef enum {
+    GBA_CPU_HANDLERCLASS_ALU,
+    GBA_CPU_HANDLERCLASS_LOADSTORE,
+    GBA_CPU_HANDLERCLASS_BLOCKTRANSFER,
+    GBA_CPU_HANDLERCLASS_BRANCH,
+    GBA_CPU_HANDLERCLASS_SWI,
+    GBA_CPU_HANDLERCLASS_COUNT
+} gba_cpu_handlerClass_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t nanoseconds;
+    const char *name;
+    int index;
+    bool thumb;
+} gba_cpu_profileEntry_t;
+#endif
+
+typedef struct {
+    uint32_t r[7]; // R8 to R14, while the bank is not active
+    uint32_t spsr;
+} gba_cpu_bank_t;
 
 gba_cpu_pipelineState_t gba_cpu_pipelineState;
 uint32_t gba_cpu_r[16];
-uint32_t gba_cpu_r_usr[7];
-uint32_t gba_cpu_r_irq[2];
-uint32_t gba_cpu_r_fiq[7];
-uint32_t gba_cpu_r_svc[2];
-uint32_t gba_cpu_r_abt[2];
-uint32_t gba_cpu_r_und[2];
-uint32_t gba_cpu_spsr_irq;
-uint32_t gba_cpu_spsr_fiq;
-uint32_t gba_cpu_spsr_svc;
-uint32_t gba_cpu_spsr_abt;
-uint32_t gba_cpu_spsr_und;
+gba_cpu_bank_t gba_cpu_banks[GBA_CPU_BANK_COUNT];
+gba_cpu_bank_t *gba_cpu_bank;
+uint32_t *gba_cpu_spsr; // NULL in user and system modes
 gba_cpu_mode_t gba_cpu_mode;
+
+// Invalid modes use the user bank.
+const gba_cpu_bankIndex_t gba_cpu_modeBank[32] = {
+    [GBA_CPU_MODE_FIQ_OLD] = GBA_CPU_BANK_FIQ,
+    [GBA_CPU_MODE_IRQ_OLD] = GBA_CPU_BANK_IRQ,
+    [GBA_CPU_MODE_SVC_OLD] = GBA_CPU_BANK_SVC,
+    [GBA_CPU_MODE_FIQ] = GBA_CPU_BANK_FIQ,
+    [GBA_CPU_MODE_IRQ] = GBA_CPU_BANK_IRQ,
+    [GBA_CPU_MODE_SVC] = GBA_CPU_BANK_SVC,
+    [GBA_CPU_MODE_ABT] = GBA_CPU_BANK_ABT,
+    [GBA_CPU_MODE_UND] = GBA_CPU_BANK_UND
+};
 bool gba_cpu_flagN;
 bool gba_cpu_flagZ;
 bool gba_cpu_flagC;
@@ -74,17 +242,127 @@ bool gba_cpu_flagT;
 uint32_t gba_cpu_fetchedOpcodeArm;
 uint16_t gba_cpu_fetchedOpcodeThumb;
 uint32_t gba_cpu_decodedOpcodeArmValue;
-uint16_t gba_cpu_decodedOpcodeThumbValue;
+const gba_cpu_thumbRecord_t *gba_cpu_decodedOpcodeThumbRecord;
 gba_cpu_opcodeHandlerArm_t *gba_cpu_decodedOpcodeArmHandler;
 gba_cpu_opcodeHandlerThumb_t *gba_cpu_decodedOpcodeThumbHandler;
 gba_cpu_opcodeHandlerArm_t *gba_cpu_decodeTable_arm[4096];
 gba_cpu_opcodeHandlerThumb_t *gba_cpu_decodeTable_thumb[1024];
+uint8_t gba_cpu_formats_arm[4096];
+uint8_t gba_cpu_formats_thumb[1024];
+gba_cpu_thumbRecord_t gba_cpu_thumbRecords[65536];
 uint32_t gba_cpu_shifterResult;
-bool gba_cpu_shifterCarry;
+
+// The condition flags are evaluated lazily: N and Z from the last result,
+// and C and V from the operands of the last addition or subtraction. The
+// flag variables only hold the evaluated values.
+bool gba_cpu_lazyNZ;
+uint32_t gba_cpu_flagsResult;
+gba_cpu_lazyFlags_t gba_cpu_lazyCV;
+uint32_t gba_cpu_flagsLeft;
+uint32_t gba_cpu_flagsRight;
+gba_cpu_backend_t gba_cpu_backend = GBA_CPU_BACKEND_CACHED;
+gba_cpu_block_t gba_cpu_blockCache[GBA_CPU_BLOCK_CACHE_SIZE];
+gba_cpu_block_t gba_cpu_uncachedBlock;
+uint32_t gba_cpu_codePageGeneration[GBA_CPU_CODE_PAGE_COUNT];
+bool gba_cpu_codePageCached[GBA_CPU_CODE_PAGE_COUNT];
+bool gba_cpu_blockInvalidated;
+bool gba_cpu_halted;
+bool gba_cpu_stopped;
+bool gba_cpu_idleLoopSkipping;
+bool gba_cpu_pipelineEmulation = true;
+bool gba_cpu_fusion = true;
+bool gba_cpu_traced;
+uint32_t gba_cpu_jumpSource; // r15 when the last jump was taken
+uint64_t gba_cpu_idleSkippedCycles;
+uint64_t gba_cpu_fusionCounts[GBA_CPU_FUSION_COUNT];
+gba_cpu_block_t *gba_cpu_idleBlock;
+uint32_t gba_cpu_idleLoops[GBA_CPU_IDLE_LOOP_MAX];
+int gba_cpu_idleLoopCount;
+const gba_cpu_aotBlock_t *gba_cpu_aotBlocks; // Sorted by address, ARM first
+size_t gba_cpu_aotBlockCount;
+uint64_t gba_cpu_aotHits;
+gba_cpu_predecodePage_t gba_cpu_predecodePool[GBA_CPU_PREDECODE_POOL_SIZE];
+int16_t gba_cpu_predecodeIndex[2][GBA_CPU_PREDECODE_PAGE_COUNT]; // -1 until predecoded
+int gba_cpu_predecodeLimit;
+int gba_cpu_predecodedPageCount;
+
+#ifdef GBA_CPU_PROFILE
+uint64_t gba_cpu_profileCounts_arm[4096];
+uint64_t gba_cpu_profileCounts_thumb[1024];
+uint64_t gba_cpu_profileTimes_arm[4096];
+uint64_t gba_cpu_profileTimes_thumb[1024];
+uint64_t gba_cpu_profileOverhead; // Nanoseconds taken by the timing itself
+#endif
+
+#ifdef GBA_CPU_THREADED
+const void *gba_cpu_threadedLabels_arm[4096];
+const void *gba_cpu_threadedLabels_thumb[1024];
+#endif
 
 void gba_cpu_init();
 void gba_cpu_reset(bool skipBoot);
 void gba_cpu_cycle();
+void gba_cpu_run();
+bool gba_cpu_setBackend(gba_cpu_backend_t backend);
+void gba_cpu_invalidateCode(uint32_t address);
+void gba_cpu_invalidateCycles();
+void gba_cpu_halt(bool stop);
+void gba_cpu_setIdleLoopSkipping(bool enabled);
+void gba_cpu_setPipelineEmulation(bool enabled);
+void gba_cpu_setFusion(bool enabled);
+bool gba_cpu_addIdleLoop(uint32_t address);
+void gba_cpu_clearIdleLoops();
+void gba_cpu_setAotBlocks(const gba_cpu_aotBlock_t *blocks, size_t count);
+uint32_t gba_cpu_hashAotBlock(const uint8_t *buffer, size_t size);
+size_t gba_cpu_setPredecodeLimit(size_t size);
+int gba_cpu_getPredecodedPageCount();
+gba_cpu_format_t gba_cpu_getFormatArm(uint32_t opcode);
+gba_cpu_format_t gba_cpu_getFormatThumb(uint16_t opcode);
+void gba_cpu_getState(gba_cpu_state_t *state);
+#ifdef GBA_CPU_PROFILE
+void gba_cpu_printProfile(FILE *file);
+#endif
+bool gba_cpu_jitCheckCondition(uint32_t condition);
+void gba_cpu_jitJump(uint32_t address);
+bool gba_cpu_jitInterpretArm(uint32_t opcode);
+bool gba_cpu_jitInterpretThumb(uint32_t opcode);
+#ifdef GBA_CPU_PROFILE
+static inline uint64_t gba_cpu_getProfileTime();
+static inline void gba_cpu_addProfileTime(uint64_t *time, uint64_t start);
+static inline void gba_cpu_calibrateProfile();
+static inline gba_cpu_handlerClass_t gba_cpu_getHandlerClassArm(gba_cpu_opcodeHandlerArm_t *handler);
+static inline gba_cpu_handlerClass_t gba_cpu_getHandlerClassThumb(gba_cpu_opcodeHandlerThumb_t *handler);
+static int gba_cpu_compareProfileEntries(const void *left, const void *right);
+#endif
+static inline void gba_cpu_runInterpreter();
+static inline void gba_cpu_runTraced();
+static inline void gba_cpu_step();
+static inline void gba_cpu_runCached();
+static inline void gba_cpu_runJit();
+static inline bool gba_cpu_completeJitInstruction(uint32_t size, uint32_t cycles);
+static inline void gba_cpu_refillPipeline();
+static inline uint32_t gba_cpu_getFetchCycles(uint32_t address, bool thumb);
+static inline bool gba_cpu_isIrqPending();
+static inline bool gba_cpu_isStopWakeupRequested();
+static inline int gba_cpu_getCodePage(uint32_t address);
+static inline bool gba_cpu_isCacheable(uint32_t address);
+static inline bool gba_cpu_isImmutable(uint32_t address);
+static inline gba_cpu_block_t *gba_cpu_getBlock(uint32_t address);
+static inline void gba_cpu_buildBlock(gba_cpu_block_t *block, uint32_t address, int maxLength);
+static inline void gba_cpu_decodeInstruction(gba_cpu_blockInstruction_t *instruction, uint32_t address, bool thumb);
+static inline void gba_cpu_fuseInstructions(gba_cpu_block_t *block);
+static inline gba_cpu_aotFunction_t *gba_cpu_findAotFunction(const gba_cpu_block_t *block);
+static inline gba_cpu_fusedHandler_t *gba_cpu_getFusedHandler(const gba_cpu_blockInstruction_t *first, const gba_cpu_blockInstruction_t *second);
+static inline const gba_cpu_blockInstruction_t *gba_cpu_getPredecoded(uint32_t address, bool thumb);
+static inline bool gba_cpu_endsBlockArm(gba_cpu_opcodeHandlerArm_t *handler, uint32_t opcode);
+static inline bool gba_cpu_endsBlockThumb(gba_cpu_opcodeHandlerThumb_t *handler, uint16_t opcode);
+static inline bool gba_cpu_isLoopBranch(gba_cpu_block_t *block, uint32_t address, uint32_t opcode);
+static inline bool gba_cpu_isIdleLoop(gba_cpu_block_t *block);
+static inline bool gba_cpu_getIdleRegistersArm(gba_cpu_opcodeHandlerArm_t *handler, uint32_t opcode, uint16_t *reads, uint16_t *writes);
+static inline bool gba_cpu_getIdleRegistersThumb(gba_cpu_opcodeHandlerThumb_t *handler, uint16_t opcode, uint16_t *reads, uint16_t *writes);
+static inline bool gba_cpu_skipIdleLoop(gba_cpu_block_t *block);
+static inline void gba_cpu_executeBlock(gba_cpu_block_t *block);
+static inline void gba_cpu_coverBlock(const gba_cpu_block_t *block);
 static inline uint32_t gba_cpu_getCpsr();
 static inline void gba_cpu_setCpsr(uint32_t value);
 static inline uint32_t gba_cpu_getSpsr();
@@ -94,17 +372,25 @@ static inline bool gba_cpu_checkCondition(gba_cpu_condition_t condition);
 static inline void gba_cpu_performJump(uint32_t address);
 static inline void gba_cpu_raiseIrq();
 static inline void gba_cpu_raiseSwi();
+static inline void gba_cpu_callSwi(uint8_t number);
 static inline void gba_cpu_raiseUnd();
 static inline void gba_cpu_execute();
 static inline void gba_cpu_decode();
 static inline void gba_cpu_fetch();
 static inline void gba_cpu_initDecodeThumb();
+static inline void gba_cpu_initThumbRecords();
 static inline void gba_cpu_initDecodeArm();
+static ALWAYS_INLINE uint32_t gba_cpu_arm_operand(uint32_t opcode, bool immediate, int shiftType, bool registerShift, bool *carry);
 static inline void gba_cpu_arm_shift(uint32_t opcode);
 static inline uint32_t gba_cpu_util_ror32(uint32_t value, int bits);
 static inline void gba_cpu_writeRegister(int r, uint32_t value);
-static inline void gba_cpu_setFlags_logical(uint32_t result);
 static inline void gba_cpu_setFlags_arithmetical(uint32_t result);
+static inline void gba_cpu_setFlags_add(uint32_t left, uint32_t right, uint32_t result);
+static inline void gba_cpu_setFlags_sub(uint32_t left, uint32_t right, uint32_t result);
+static inline void gba_cpu_materializeFlags();
+static inline void gba_cpu_materializeFlagsCV();
+static inline bool gba_cpu_getFlagC();
+static inline void gba_cpu_setFlagC(bool value);
 static inline bool gba_cpu_getCarry_sbc(uint32_t left, uint32_t right, bool carry);
 static inline bool gba_cpu_getCarry_sub(uint32_t left, uint32_t right);
 static inline bool gba_cpu_getOverflow_sub(uint32_t left, uint32_t right, uint32_t result);
@@ -121,117 +407,278 @@ static inline void gba_cpu_arm_swi(uint32_t opcode);
 static inline void gba_cpu_arm_singleDataTransfer(uint32_t opcode);
 static inline void gba_cpu_arm_psrTransfer_msr(uint32_t opcode, bool spsr, uint32_t operand);
 static inline void gba_cpu_arm_psrTransfer(uint32_t opcode);
-static inline void gba_cpu_arm_and(uint32_t opcode);
-static inline void gba_cpu_arm_eor(uint32_t opcode);
-static inline void gba_cpu_arm_sub(uint32_t opcode);
-static inline void gba_cpu_arm_rsb(uint32_t opcode);
-static inline void gba_cpu_arm_add(uint32_t opcode);
-static inline void gba_cpu_arm_adc(uint32_t opcode);
-static inline void gba_cpu_arm_sbc(uint32_t opcode);
-static inline void gba_cpu_arm_rsc(uint32_t opcode);
-static inline void gba_cpu_arm_tst(uint32_t opcode);
-static inline void gba_cpu_arm_teq(uint32_t opcode);
-static inline void gba_cpu_arm_cmp(uint32_t opcode);
-static inline void gba_cpu_arm_cmn(uint32_t opcode);
-static inline void gba_cpu_arm_orr(uint32_t opcode);
-static inline void gba_cpu_arm_mov(uint32_t opcode);
-static inline void gba_cpu_arm_bic(uint32_t opcode);
-static inline void gba_cpu_arm_mvn(uint32_t opcode);
+static ALWAYS_INLINE void gba_cpu_arm_dataProcessing(uint32_t opcode, int operation, bool s, bool immediate, int shiftType, bool registerShift);
+#define GBA_CPU_ARM_DP_PROTOTYPE(op, s, name, immediate, shiftType, registerShift) \
+    static inline void gba_cpu_arm_dp_##op##_##s##_##name(uint32_t opcode);
+GBA_CPU_ARM_DP_OPERATIONS(GBA_CPU_ARM_DP_PROTOTYPE)
+#undef GBA_CPU_ARM_DP_PROTOTYPE
 static inline void gba_cpu_arm_b(uint32_t opcode);
-static inline void gba_cpu_thumb_sub(uint16_t opcode);
-static inline void gba_cpu_thumb_add(uint16_t opcode);
-static inline void gba_cpu_thumb_lsl(uint16_t opcode);
-static inline void gba_cpu_thumb_lsr(uint16_t opcode);
-static inline void gba_cpu_thumb_asr(uint16_t opcode);
-static inline void gba_cpu_thumb_mov(uint16_t opcode);
-static inline void gba_cpu_thumb_cmp(uint16_t opcode);
-static inline void gba_cpu_thumb_add2(uint16_t opcode);
-static inline void gba_cpu_thumb_sub2(uint16_t opcode);
-static inline void gba_cpu_thumb_ldrStrh(uint16_t opcode);
-static inline void gba_cpu_thumb_ldrStr(uint16_t opcode);
-static inline void gba_cpu_thumb_ldr(uint16_t opcode);
-static inline void gba_cpu_thumb_bx(uint16_t opcode);
-static inline void gba_cpu_thumb_add3(uint16_t opcode);
-static inline void gba_cpu_thumb_cmp3(uint16_t opcode);
-static inline void gba_cpu_thumb_mov2(uint16_t opcode);
-static inline void gba_cpu_thumb_and(uint16_t opcode);
-static inline void gba_cpu_thumb_eor(uint16_t opcode);
-static inline void gba_cpu_thumb_lsl2(uint16_t opcode);
-static inline void gba_cpu_thumb_lsr2(uint16_t opcode);
-static inline void gba_cpu_thumb_asr2(uint16_t opcode);
-static inline void gba_cpu_thumb_adc(uint16_t opcode);
-static inline void gba_cpu_thumb_sbc(uint16_t opcode);
-static inline void gba_cpu_thumb_ror(uint16_t opcode);
-static inline void gba_cpu_thumb_tst(uint16_t opcode);
-static inline void gba_cpu_thumb_neg(uint16_t opcode);
-static inline void gba_cpu_thumb_cmp2(uint16_t opcode);
-static inline void gba_cpu_thumb_cmn(uint16_t opcode);
-static inline void gba_cpu_thumb_orr(uint16_t opcode);
-static inline void gba_cpu_thumb_mul(uint16_t opcode);
-static inline void gba_cpu_thumb_bic(uint16_t opcode);
-static inline void gba_cpu_thumb_mvn(uint16_t opcode);
-static inline void gba_cpu_thumb_ldrStr2(uint16_t opcode);
-static inline void gba_cpu_thumb_ldrStr3(uint16_t opcode);
-static inline void gba_cpu_thumb_ldrStrh2(uint16_t opcode);
-static inline void gba_cpu_thumb_add5(uint16_t opcode);
-static inline void gba_cpu_thumb_pushPop(uint16_t opcode);
-static inline void gba_cpu_thumb_add4(uint16_t opcode);
-static inline void gba_cpu_thumb_swi(uint16_t opcode);
-static inline void gba_cpu_thumb_b(uint16_t opcode);
-static inline void gba_cpu_thumb_ldmStm(uint16_t opcode);
-static inline void gba_cpu_thumb_bl(uint16_t opcode);
-static inline void gba_cpu_thumb_b2(uint16_t opcode);
+static inline void gba_cpu_thumb_sub(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_add(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_lsl(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_lsr(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_asr(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_mov(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_cmp(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_add2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_sub2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldrStrh(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldrStr(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldr(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_bx(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_add3(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_cmp3(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_mov2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_and(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_eor(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_lsl2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_lsr2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_asr2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_adc(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_sbc(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ror(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_tst(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_neg(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_cmp2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_cmn(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_orr(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_mul(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_bic(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_mvn(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldrStr2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldrStr3(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldrStrh2(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_add5(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_pushPop(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_add4(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_swi(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_b(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_ldmStm(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_bl(const gba_cpu_thumbRecord_t *record);
+static inline void gba_cpu_thumb_b2(const gba_cpu_thumbRecord_t *record);
+static ALWAYS_INLINE bool gba_cpu_completeFused(uint32_t cycles);
+static ALWAYS_INLINE bool gba_cpu_checkCondition_sub(gba_cpu_condition_t condition, uint32_t left, uint32_t right);
+static ALWAYS_INLINE void gba_cpu_branchOnCompare(const gba_cpu_thumbRecord_t *record, uint32_t left, uint32_t right);
+static inline bool gba_cpu_fused_bl(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles);
+static inline bool gba_cpu_fused_cmpB(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles);
+static inline bool gba_cpu_fused_cmp2B(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles);
+static inline bool gba_cpu_fused_cmp3B(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles);
+static inline bool gba_cpu_fused_ldrBx(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles);
+
+#define GBA_CPU_HANDLERS_ARM(X) \
+    X(arm_halfwordSignedDataTransfer) \
+    X(arm_blockDataTransfer) \
+    X(arm_swp) \
+    X(arm_mul) \
+    X(arm_mull) \
+    X(arm_bx) \
+    X(arm_swi) \
+    X(arm_singleDataTransfer) \
+    X(arm_psrTransfer) \
+    GBA_CPU_ARM_DP_OPERATIONS(X##_DP) \
+    X(arm_b)
+
+#define GBA_CPU_HANDLERS_THUMB(X) \
+    X(thumb_sub) \
+    X(thumb_add) \
+    X(thumb_lsl) \
+    X(thumb_lsr) \
+    X(thumb_asr) \
+    X(thumb_mov) \
+    X(thumb_cmp) \
+    X(thumb_add2) \
+    X(thumb_sub2) \
+    X(thumb_ldrStrh) \
+    X(thumb_ldrStr) \
+    X(thumb_ldr) \
+    X(thumb_bx) \
+    X(thumb_add3) \
+    X(thumb_cmp3) \
+    X(thumb_mov2) \
+    X(thumb_and) \
+    X(thumb_eor) \
+    X(thumb_lsl2) \
+    X(thumb_lsr2) \
+    X(thumb_asr2) \
+    X(thumb_adc) \
+    X(thumb_sbc) \
+    X(thumb_ror) \
+    X(thumb_tst) \
+    X(thumb_neg) \
+    X(thumb_cmp2) \
+    X(thumb_cmn) \
+    X(thumb_orr) \
+    X(thumb_mul) \
+    X(thumb_bic) \
+    X(thumb_mvn) \
+    X(thumb_ldrStr2) \
+    X(thumb_ldrStr3) \
+    X(thumb_ldrStrh2) \
+    X(thumb_add5) \
+    X(thumb_pushPop) \
+    X(thumb_add4) \
+    X(thumb_swi) \
+    X(thumb_b) \
+    X(thumb_ldmStm) \
+    X(thumb_bl) \
+    X(thumb_b2)
+
+#define GBA_CPU_HANDLER_ENTRY(name) gba_cpu_##name,
+
+static gba_cpu_opcodeHandlerThumb_t *const gba_cpu_handlers_thumb[] = {
+    NULL,
+    GBA_CPU_HANDLERS_THUMB(GBA_CPU_HANDLER_ENTRY)
+};
+
+#define GBA_CPU_FUSED_HANDLERS(X) \
+    X(fused_bl) \
+    X(fused_cmpB) \
+    X(fused_cmp2B) \
+    X(fused_cmp3B) \
+    X(fused_ldrBx)
+
+static gba_cpu_fusedHandler_t *const gba_cpu_fusedHandlers[] = {
+    NULL,
+    GBA_CPU_FUSED_HANDLERS(GBA_CPU_HANDLER_ENTRY)
+};
+
+#define GBA_CPU_FUSED_HANDLER_COUNT (sizeof(gba_cpu_fusedHandlers) / sizeof(gba_cpu_fusedHandlers[0]))
+
+#ifdef GBA_CPU_THREADED
+const void *gba_cpu_threadedLabels_fused[GBA_CPU_FUSED_HANDLER_COUNT];
+#endif
+
+#undef GBA_CPU_HANDLER_ENTRY
+
+// The instrumented build counts the executions of each decode table entry
+// and the time spent in its handler.
+#ifdef GBA_CPU_PROFILE
+#define GBA_CPU_PROFILE_ARM(opcode, call) \
+    do { \
+        int profileIndex = (((opcode) >> 16) & 0xff0) | (((opcode) >> 4) & 0x0f); \
+        uint64_t profileStart = gba_cpu_getProfileTime(); \
+        call; \
+        gba_cpu_addProfileTime(&gba_cpu_profileTimes_arm[profileIndex], profileStart); \
+        gba_cpu_profileCounts_arm[profileIndex]++; \
+    } while(0)
+
+#define GBA_CPU_PROFILE_THUMB(opcode, call) \
+    do { \
+        int profileIndex = ((opcode) & 0xffff) >> 6; \
+        uint64_t profileStart = gba_cpu_getProfileTime(); \
+        call; \
+        gba_cpu_addProfileTime(&gba_cpu_profileTimes_thumb[profileIndex], profileStart); \
+        gba_cpu_profileCounts_thumb[profileIndex]++; \
+    } while(0)
+#else
+#define GBA_CPU_PROFILE_ARM(opcode, call) call
+#define GBA_CPU_PROFILE_THUMB(opcode, call) call
+#endif
+
+// Builds made with CALLPROF=1 report the calls and returns to the call
+// profiler.
+#ifdef GBA_CALLPROF
+#define GBA_CPU_CALLPROF(call) \
+    do { \
+        if(gba_callprof_enabled) { \
+            call; \
+        } \
+    } while(0)
+#else
+#define GBA_CPU_CALLPROF(call)
+#endif
 
 void gba_cpu_init() {
+    static bool recordsBuilt = false;
+
     gba_cpu_initDecodeArm();
     gba_cpu_initDecodeThumb();
+
+#ifdef GBA_CPU_PROFILE
+    gba_cpu_calibrateProfile();
+#endif
+
+    // The records never change, so they are only built once.
+    if(!recordsBuilt) {
+        gba_cpu_initThumbRecords();
+        recordsBuilt = true;
+    }
+
+#ifdef GBA_CPU_THREADED
+    gba_cpu_executeBlock(NULL);
+#endif
 }
 
 void gba_cpu_reset(bool skipBoot) {
     gba_cpu_pipelineState = GBA_CPU_PIPELINESTATE_FETCH;
 
-    for(int i = 0; i < 2; i++) {
-        gba_cpu_r_irq[i] = 0;
-        gba_cpu_r_svc[i] = 0;
-        gba_cpu_r_abt[i] = 0;
-        gba_cpu_r_und[i] = 0;
-    }
+    for(int i = 0; i < GBA_CPU_BANK_COUNT; i++) {
+        for(int j = 0; j < 7; j++) {
+            gba_cpu_banks[i].r[j] = 0;
+        }
 
-    for(int i = 0; i < 7; i++) {
-        gba_cpu_r_fiq[i] = 0;
-        gba_cpu_r_usr[i] = 0;
+        gba_cpu_banks[i].spsr = 0;
     }
 
     for(int i = 0; i < 16; i++) {
         gba_cpu_r[i] = 0;
     }
 
+    gba_cpu_mode = GBA_CPU_MODE_USR;
+    gba_cpu_bank = &gba_cpu_banks[GBA_CPU_BANK_USR];
+    gba_cpu_spsr = NULL;
+
     gba_cpu_flagN = false;
     gba_cpu_flagZ = false;
     gba_cpu_flagC = false;
     gba_cpu_flagV = false;
+    gba_cpu_lazyNZ = false;
+    gba_cpu_lazyCV = GBA_CPU_LAZYFLAGS_NONE;
     gba_cpu_flagI = false;
     gba_cpu_flagF = false;
     gba_cpu_flagT = false;
 
     if(skipBoot) {
         gba_cpu_r[13] = 0x03007f00;
-        gba_cpu_r_irq[0] = 0x03007fa0;
-        gba_cpu_r_svc[0] = 0x03007fe0;
+        gba_cpu_banks[GBA_CPU_BANK_IRQ].r[5] = 0x03007fa0;
+        gba_cpu_banks[GBA_CPU_BANK_SVC].r[5] = 0x03007fe0;
 
         gba_cpu_r[15] = 0x08000000;
-        gba_cpu_mode = GBA_CPU_MODE_SYS;
+        gba_cpu_changeMode(GBA_CPU_MODE_SYS);
     } else {
-        gba_cpu_mode = GBA_CPU_MODE_SVC;
+        gba_cpu_changeMode(GBA_CPU_MODE_SVC);
         gba_cpu_flagI = true;
         gba_cpu_flagF = true;
     }
 
-    gba_cpu_spsr_abt = 0;
-    gba_cpu_spsr_fiq = 0;
-    gba_cpu_spsr_irq = 0;
-    gba_cpu_spsr_svc = 0;
-    gba_cpu_spsr_und = 0;
+    for(int i = 0; i < GBA_CPU_BLOCK_CACHE_SIZE; i++) {
+        gba_cpu_blockCache[i].valid = false;
+    }
+
+    for(int i = 0; i < GBA_CPU_CODE_PAGE_COUNT; i++) {
+        gba_cpu_codePageGeneration[i] = 0;
+        gba_cpu_codePageCached[i] = false;
+    }
+
+    // The ROM may have been replaced.
+    for(int i = 0; i < GBA_CPU_PREDECODE_PAGE_COUNT; i++) {
+        gba_cpu_predecodeIndex[0][i] = -1;
+        gba_cpu_predecodeIndex[1][i] = -1;
+    }
+
+    gba_cpu_predecodedPageCount = 0;
+
+    gba_cpu_halted = false;
+    gba_cpu_stopped = false;
+    gba_cpu_traced = false;
+    gba_cpu_idleSkippedCycles = 0;
+    gba_cpu_idleBlock = NULL;
+
+    for(int i = 0; i < GBA_CPU_FUSION_COUNT; i++) {
+        gba_cpu_fusionCounts[i] = 0;
+    }
+
+    gba_jit_flush();
 }
 
 void gba_cpu_cycle() {
@@ -260,1665 +707,2862 @@ void gba_cpu_cycle() {
     }
 }
 
-static inline uint32_t gba_cpu_getCpsr() {
-    return 0
-        | (gba_cpu_flagN ? 1 << 31 : 0)
-        | (gba_cpu_flagZ ? 1 << 30 : 0)
-        | (gba_cpu_flagC ? 1 << 29 : 0)
-        | (gba_cpu_flagV ? 1 << 28 : 0)
-        | (gba_cpu_flagI ? 1 << 7 : 0)
-        | (gba_cpu_flagF ? 1 << 6 : 0)
-        | (gba_cpu_flagT ? 1 << 5 : 0)
-        | gba_cpu_mode;
-}
+void gba_cpu_run() {
+    // Events may have changed what an idle loop waits for.
+    gba_cpu_idleBlock = NULL;
 
-static inline void gba_cpu_setCpsr(uint32_t value) {
-    gba_cpu_flagN = (value & (1 << 31)) != 0;
-    gba_cpu_flagZ = (value & (1 << 30)) != 0;
-    gba_cpu_flagC = (value & (1 << 29)) != 0;
-    gba_cpu_flagV = (value & (1 << 28)) != 0;
-    gba_cpu_flagI = (value & (1 << 7)) != 0;
-    gba_cpu_flagF = (value & (1 << 6)) != 0;
-    gba_cpu_flagT = (value & (1 << 5)) != 0;
+    // Nothing happens until an event requests an interrupt.
+    if(gba_cpu_halted) {
+        if(!gba_irq_requested || (gba_cpu_stopped && !gba_cpu_isStopWakeupRequested())) {
+            gba_scheduler_cycleCounter = gba_scheduler_nextEventTimestamp;
+            return;
+        }
 
-    gba_cpu_changeMode(value & 0x1f);
-}
+        gba_cpu_halted = false;
+        gba_cpu_stopped = false;
+    }
 
-static inline uint32_t gba_cpu_getSpsr() {
-    switch(gba_cpu_mode) {
-        case GBA_CPU_MODE_FIQ_OLD:
-        case GBA_CPU_MODE_FIQ:
-            return gba_cpu_spsr_fiq;
+    if(gba_trace_active) {
+        gba_cpu_runTraced();
+        return;
+    }
 
-        case GBA_CPU_MODE_IRQ_OLD:
-        case GBA_CPU_MODE_IRQ:
-            return gba_cpu_spsr_irq;
+    gba_cpu_traced = false;
 
-        case GBA_CPU_MODE_SVC_OLD:
-        case GBA_CPU_MODE_SVC:
-            return gba_cpu_spsr_svc;
+    switch(gba_cpu_backend) {
+        case GBA_CPU_BACKEND_INTERPRETER:
+            gba_cpu_runInterpreter();
+            break;
 
-        case GBA_CPU_MODE_ABT:
-            return gba_cpu_spsr_abt;
+        case GBA_CPU_BACKEND_CACHED:
+            gba_cpu_runCached();
+            break;
 
-        case GBA_CPU_MODE_UND:
-            return gba_cpu_spsr_und;
-            
-        default:
-            return gba_cpu_getCpsr();
+        case GBA_CPU_BACKEND_JIT:
+            if(gba_coverage_enabled) {
+                gba_cpu_runCached();
+            } else {
+                gba_cpu_runJit();
+            }
+
+            break;
     }
 }
 
-static inline void gba_cpu_setSpsr(uint32_t value) {
-    switch(gba_cpu_mode) {
-        case GBA_CPU_MODE_FIQ_OLD:
-        case GBA_CPU_MODE_FIQ:
-            gba_cpu_spsr_fiq = value;
-            break;
+// Returns false if the backend is not available on this host, in which case
+// the current one is kept.
+bool gba_cpu_setBackend(gba_cpu_backend_t backend) {
+    if(backend == GBA_CPU_BACKEND_JIT && !gba_jit_init()) {
+        return false;
+    }
 
-        case GBA_CPU_MODE_IRQ_OLD:
-        case GBA_CPU_MODE_IRQ:
-            gba_cpu_spsr_irq = value;
-            break;
+    // The cached backend does not keep the fetched and decoded opcodes up to
+    // date, so the pipeline is refilled when handing over to the interpreter.
+    if(
+        backend == GBA_CPU_BACKEND_INTERPRETER
+        && gba_cpu_backend != GBA_CPU_BACKEND_INTERPRETER
+        && gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_EXECUTE
+    ) {
+        gba_cpu_performJump(gba_cpu_r[15] - (gba_cpu_flagT ? 4 : 8));
+    }
 
-        case GBA_CPU_MODE_SVC_OLD:
-        case GBA_CPU_MODE_SVC:
-            gba_cpu_spsr_svc = value;
-            break;
+    gba_cpu_backend = backend;
 
-        case GBA_CPU_MODE_ABT:
-            gba_cpu_spsr_abt = value;
-            break;
+    return true;
+}
 
-        case GBA_CPU_MODE_UND:
-            gba_cpu_spsr_und = value;
-            break;
-            
-        default:
-            gba_cpu_setCpsr(value);
-            break;
+void gba_cpu_invalidateCode(uint32_t address) {
+    int page = gba_cpu_getCodePage(address);
+
+    if(page >= 0 && gba_cpu_codePageCached[page]) {
+        gba_cpu_codePageGeneration[page]++;
+        gba_cpu_codePageCached[page] = false;
+        gba_cpu_blockInvalidated = true;
     }
 }
 
-static inline void gba_cpu_changeMode(gba_cpu_mode_t newMode) {
-    gba_cpu_mode_t oldMode = gba_cpu_mode;
-
-    switch(oldMode) {
-        case GBA_CPU_MODE_USR_OLD:
-        case GBA_CPU_MODE_USR:
-        case GBA_CPU_MODE_SYS:
-            gba_cpu_r_usr[0] = gba_cpu_r[8];
-            gba_cpu_r_usr[1] = gba_cpu_r[9];
-            gba_cpu_r_usr[2] = gba_cpu_r[10];
-            gba_cpu_r_usr[3] = gba_cpu_r[11];
-            gba_cpu_r_usr[4] = gba_cpu_r[12];
-            gba_cpu_r_usr[5] = gba_cpu_r[13];
-            gba_cpu_r_usr[6] = gba_cpu_r[14];
-            break;
+// Called when the wait states change. The cycles taken by the instructions
+// are computed once per block, and once per translation by the JIT.
+void gba_cpu_invalidateCycles() {
+    gba_cpu_blockInvalidated = true;
+    gba_jit_flush();
+}
 
-        case GBA_CPU_MODE_FIQ_OLD:
-        case GBA_CPU_MODE_FIQ:
-            gba_cpu_r_fiq[0] = gba_cpu_r[8];
-            gba_cpu_r_fiq[1] = gba_cpu_r[9];
-            gba_cpu_r_fiq[2] = gba_cpu_r[10];
-            gba_cpu_r_fiq[3] = gba_cpu_r[11];
-            gba_cpu_r_fiq[4] = gba_cpu_r[12];
-            gba_cpu_r_fiq[5] = gba_cpu_r[13];
-            gba_cpu_r_fiq[6] = gba_cpu_r[14];
-            break;
+// Stops the CPU until an enabled interrupt is requested. In the stop state,
+// only the interrupts listed in GBA_CPU_STOP_WAKEUP_FLAGS wake it up. The
+// video and sound circuits, which hardware also turns off, keep running.
+void gba_cpu_halt(bool stop) {
+    gba_cpu_halted = true;
+    gba_cpu_stopped = stop;
 
-        case GBA_CPU_MODE_IRQ_OLD:
-        case GBA_CPU_MODE_IRQ:
-            gba_cpu_r_usr[0] = gba_cpu_r[8];
-            gba_cpu_r_usr[1] = gba_cpu_r[9];
-            gba_cpu_r_usr[2] = gba_cpu_r[10];
-            gba_cpu_r_usr[3] = gba_cpu_r[11];
-            gba_cpu_r_usr[4] = gba_cpu_r[12];
-            gba_cpu_r_irq[0] = gba_cpu_r[13];
-            gba_cpu_r_irq[1] = gba_cpu_r[14];
-            break;
+    // Ends the block being executed after the current instruction.
+    gba_cpu_blockInvalidated = true;
+}
 
-        case GBA_CPU_MODE_SVC_OLD:
-        case GBA_CPU_MODE_SVC:
-            gba_cpu_r_usr[0] = gba_cpu_r[8];
-            gba_cpu_r_usr[1] = gba_cpu_r[9];
-            gba_cpu_r_usr[2] = gba_cpu_r[10];
-            gba_cpu_r_usr[3] = gba_cpu_r[11];
-            gba_cpu_r_usr[4] = gba_cpu_r[12];
-            gba_cpu_r_svc[0] = gba_cpu_r[13];
-            gba_cpu_r_svc[1] = gba_cpu_r[14];
-            break;
+// When enabled, the cached and JIT backends skip to the next event when a
+// loop that only polls memory goes around without its state changing.
+void gba_cpu_setIdleLoopSkipping(bool enabled) {
+    gba_cpu_idleLoopSkipping = enabled;
+}
 
-        case GBA_CPU_MODE_ABT:
-            gba_cpu_r_usr[0] = gba_cpu_r[8];
-            gba_cpu_r_usr[1] = gba_cpu_r[9];
-            gba_cpu_r_usr[2] = gba_cpu_r[10];
-            gba_cpu_r_usr[3] = gba_cpu_r[11];
-            gba_cpu_r_usr[4] = gba_cpu_r[12];
-            gba_cpu_r_abt[0] = gba_cpu_r[13];
-            gba_cpu_r_abt[1] = gba_cpu_r[14];
-            break;
+// When disabled, the interpreter fetches and decodes each instruction when
+// executing it instead of stepping through the pipeline stages. Only code
+// overwriting the two instructions that follow it behaves differently.
+void gba_cpu_setPipelineEmulation(bool enabled) {
+    // The fetched and decoded opcodes are not kept up to date without it.
+    if(
+        enabled
+        && !gba_cpu_pipelineEmulation
+        && gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_EXECUTE
+    ) {
+        gba_cpu_performJump(gba_cpu_r[15] - (gba_cpu_flagT ? 4 : 8));
+    }
 
-        case GBA_CPU_MODE_UND:
-            gba_cpu_r_usr[0] = gba_cpu_r[8];
-            gba_cpu_r_usr[1] = gba_cpu_r[9];
-            gba_cpu_r_usr[2] = gba_cpu_r[10];
-            gba_cpu_r_usr[3] = gba_cpu_r[11];
-            gba_cpu_r_usr[4] = gba_cpu_r[12];
-            gba_cpu_r_und[0] = gba_cpu_r[13];
-            gba_cpu_r_und[1] = gba_cpu_r[14];
-            break;
+    gba_cpu_pipelineEmulation = enabled;
+}
+
+// The cached blocks are rebuilt with or without the fused pairs.
+void gba_cpu_setFusion(bool enabled) {
+    for(int i = 0; i < GBA_CPU_BLOCK_CACHE_SIZE; i++) {
+        gba_cpu_blockCache[i].valid = false;
     }
 
-    switch(newMode) {
-        case GBA_CPU_MODE_USR_OLD:
-        case GBA_CPU_MODE_USR:
-        case GBA_CPU_MODE_SYS:
-            gba_cpu_r[8] = gba_cpu_r_usr[0];
-            gba_cpu_r[9] = gba_cpu_r_usr[1];
-            gba_cpu_r[10] = gba_cpu_r_usr[2];
-            gba_cpu_r[11] = gba_cpu_r_usr[3];
-            gba_cpu_r[12] = gba_cpu_r_usr[4];
-            gba_cpu_r[13] = gba_cpu_r_usr[5];
-            gba_cpu_r[14] = gba_cpu_r_usr[6];
-            break;
+    gba_cpu_fusion = enabled;
+}
 
-        case GBA_CPU_MODE_FIQ_OLD:
-        case GBA_CPU_MODE_FIQ:
-            gba_cpu_r[8] = gba_cpu_r_fiq[0];
-            gba_cpu_r[9] = gba_cpu_r_fiq[1];
-            gba_cpu_r[10] = gba_cpu_r_fiq[2];
-            gba_cpu_r[11] = gba_cpu_r_fiq[3];
-            gba_cpu_r[12] = gba_cpu_r_fiq[4];
-            gba_cpu_r[13] = gba_cpu_r_fiq[5];
-            gba_cpu_r[14] = gba_cpu_r_fiq[6];
-            break;
+// Marks the loop starting at the given address as idle without checking its
+// instructions, for games whose idle loops are not detected.
+bool gba_cpu_addIdleLoop(uint32_t address) {
+    if(gba_cpu_idleLoopCount == GBA_CPU_IDLE_LOOP_MAX) {
+        return false;
+    }
 
-        case GBA_CPU_MODE_IRQ_OLD:
-        case GBA_CPU_MODE_IRQ:
-            gba_cpu_r[8] = gba_cpu_r_usr[0];
-            gba_cpu_r[9] = gba_cpu_r_usr[1];
-            gba_cpu_r[10] = gba_cpu_r_usr[2];
-            gba_cpu_r[11] = gba_cpu_r_usr[3];
-            gba_cpu_r[12] = gba_cpu_r_usr[4];
-            gba_cpu_r[13] = gba_cpu_r_irq[0];
-            gba_cpu_r[14] = gba_cpu_r_irq[1];
-            break;
+    gba_cpu_idleLoops[gba_cpu_idleLoopCount++] = address;
 
-        case GBA_CPU_MODE_SVC_OLD:
-        case GBA_CPU_MODE_SVC:
-            gba_cpu_r[8] = gba_cpu_r_usr[0];
-            gba_cpu_r[9] = gba_cpu_r_usr[1];
-            gba_cpu_r[10] = gba_cpu_r_usr[2];
-            gba_cpu_r[11] = gba_cpu_r_usr[3];
-            gba_cpu_r[12] = gba_cpu_r_usr[4];
-            gba_cpu_r[13] = gba_cpu_r_svc[0];
-            gba_cpu_r[14] = gba_cpu_r_svc[1];
-            break;
+    for(int i = 0; i < GBA_CPU_BLOCK_CACHE_SIZE; i++) {
+        gba_cpu_blockCache[i].valid = false;
+    }
 
-        case GBA_CPU_MODE_ABT:
-            gba_cpu_r[8] = gba_cpu_r_usr[0];
-            gba_cpu_r[9] = gba_cpu_r_usr[1];
-            gba_cpu_r[10] = gba_cpu_r_usr[2];
-            gba_cpu_r[11] = gba_cpu_r_usr[3];
-            gba_cpu_r[12] = gba_cpu_r_usr[4];
-            gba_cpu_r[13] = gba_cpu_r_abt[0];
-            gba_cpu_r[14] = gba_cpu_r_abt[1];
-            break;
+    return true;
+}
 
-        case GBA_CPU_MODE_UND:
-            gba_cpu_r[8] = gba_cpu_r_usr[0];
-            gba_cpu_r[9] = gba_cpu_r_usr[1];
-            gba_cpu_r[10] = gba_cpu_r_usr[2];
-            gba_cpu_r[11] = gba_cpu_r_usr[3];
-            gba_cpu_r[12] = gba_cpu_r_usr[4];
-            gba_cpu_r[13] = gba_cpu_r_und[0];
-            gba_cpu_r[14] = gba_cpu_r_und[1];
-            break;
-            // TODO: undefined mode
+void gba_cpu_clearIdleLoops() {
+    gba_cpu_idleLoopCount = 0;
+
+    for(int i = 0; i < GBA_CPU_BLOCK_CACHE_SIZE; i++) {
+        gba_cpu_blockCache[i].valid = false;
     }
+}
 
-    gba_cpu_mode = newMode;
+// Uses the given blocks compiled ahead of time, which must be sorted by
+// address with the ARM block first, and stay allocated until replaced.
+void gba_cpu_setAotBlocks(const gba_cpu_aotBlock_t *blocks, size_t count) {
+    for(int i = 0; i < GBA_CPU_BLOCK_CACHE_SIZE; i++) {
+        gba_cpu_blockCache[i].valid = false;
+    }
+
+    gba_cpu_aotBlocks = blocks;
+    gba_cpu_aotBlockCount = count;
+    gba_cpu_aotHits = 0;
 }
 
-static inline bool gba_cpu_checkCondition(gba_cpu_condition_t condition) {
-    switch(condition) {
-        case GBA_CPU_CONDITION_EQ: return gba_cpu_flagZ;
-        case GBA_CPU_CONDITION_NE: return !gba_cpu_flagZ;
-        case GBA_CPU_CONDITION_CS: return gba_cpu_flagC;
-        case GBA_CPU_CONDITION_CC: return !gba_cpu_flagC;
-        case GBA_CPU_CONDITION_MI: return gba_cpu_flagN;
-        case GBA_CPU_CONDITION_PL: return !gba_cpu_flagN;
-        case GBA_CPU_CONDITION_VS: return gba_cpu_flagV;
-        case GBA_CPU_CONDITION_VC: return !gba_cpu_flagV;
-        case GBA_CPU_CONDITION_HI: return gba_cpu_flagC && !gba_cpu_flagZ;
-        case GBA_CPU_CONDITION_LS: return (!gba_cpu_flagC) || gba_cpu_flagZ;
-        case GBA_CPU_CONDITION_GE: return gba_cpu_flagN == gba_cpu_flagV;
-        case GBA_CPU_CONDITION_LT: return gba_cpu_flagN != gba_cpu_flagV;
-        case GBA_CPU_CONDITION_GT: return (!gba_cpu_flagZ) && (gba_cpu_flagN == gba_cpu_flagV);
-        case GBA_CPU_CONDITION_LE: return gba_cpu_flagZ || (gba_cpu_flagN != gba_cpu_flagV);
-        case GBA_CPU_CONDITION_AL: return true;
-        default: return false;
+uint32_t gba_cpu_hashAotBlock(const uint8_t *buffer, size_t size) {
+    uint32_t hash = 0x811c9dc5;
+
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ buffer[i]) * 0x01000193;
     }
+
+    return hash;
 }
 
-static inline void gba_cpu_performJump(uint32_t address) {
-    address -= gba_cpu_flagT ? 2 : 4;
-    address &= gba_cpu_flagT ? 0xfffffffe : 0xfffffffc;
+// Sets the memory the predecoded ROM pages may take, which is rounded down
+// to whole pages and capped by the size of the pool. Zero disables the
+// predecoding. Returns the memory that may actually be taken.
+size_t gba_cpu_setPredecodeLimit(size_t size) {
+    size_t pages = size / sizeof(gba_cpu_predecodePage_t);
 
-    gba_cpu_r[15] = address;
-    gba_cpu_pipelineState = GBA_CPU_PIPELINESTATE_FLUSH;
+    if(pages > GBA_CPU_PREDECODE_POOL_SIZE) {
+        pages = GBA_CPU_PREDECODE_POOL_SIZE;
+    }
+
+    // Pages already taken stay in use until the next reset.
+    gba_cpu_predecodeLimit = pages;
+
+    return pages * sizeof(gba_cpu_predecodePage_t);
 }
 
-static inline void gba_cpu_raiseIrq() {
-    gba_cpu_spsr_irq = gba_cpu_getCpsr();
-    gba_cpu_changeMode(GBA_CPU_MODE_IRQ);
-    gba_cpu_r[14] = gba_cpu_r[15] - (gba_cpu_flagT ? 0 : 4);
-    gba_cpu_flagT = false;
-    gba_cpu_flagI = true;
-    gba_cpu_performJump(0x00000018);
+int gba_cpu_getPredecodedPageCount() {
+    return gba_cpu_predecodedPageCount;
 }
 
-static inline void gba_cpu_raiseSwi() {
-    gba_cpu_spsr_svc = gba_cpu_getCpsr();
-    gba_cpu_changeMode(GBA_CPU_MODE_SVC);
-    gba_cpu_r[14] = gba_cpu_r[15] - (gba_cpu_flagT ? 2 : 4);
-    gba_cpu_flagT = false;
-    gba_cpu_flagI = true;
-    gba_cpu_performJump(0x00000008);
+// Requires gba_cpu_init() to have built the decode tables.
+gba_cpu_format_t gba_cpu_getFormatArm(uint32_t opcode) {
+    return gba_cpu_formats_arm[((opcode >> 16) & 0xff0) | ((opcode >> 4) & 0x0f)];
 }
 
-static inline void gba_cpu_raiseUnd() {
-    gba_cpu_spsr_und = gba_cpu_getCpsr();
-    gba_cpu_changeMode(GBA_CPU_MODE_UND);
-    gba_cpu_r[14] = gba_cpu_r[15] - (gba_cpu_flagT ? 2 : 4);
-    gba_cpu_flagT = false;
-    gba_cpu_flagI = true;
-    gba_cpu_performJump(0x00000004);
+gba_cpu_format_t gba_cpu_getFormatThumb(uint16_t opcode) {
+    return gba_cpu_formats_thumb[opcode >> 6];
 }
 
-static inline void gba_cpu_execute() {
-    if(gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_EXECUTE) {
-        // Check for interrupts
-        if(
-            (gba_io_read16(0x04000208) & 0x0001)
-            && (gba_io_read16(0x04000200) & gba_io_read16(0x04000202) & 0x3fff)
-            && !gba_cpu_flagI
-        ) {
-            gba_cpu_raiseIrq();
-        } else {
-            /*
-            debug("[%08x] r0=%08x r1=%08x r2=%08x r3=%08x r4=%08x r5=%08x r6=%08x r7=%08x r8=%08x r9=%08x r10=%08x r11=%08x r12=%08x r13=%08x r14=%08x r15=%08x cpsr=%08x spsr=%08x\n", 
-                (gba_cpu_flagT ? (gba_cpu_r[15] - 4) : (gba_cpu_r[15] - 8)),
-                gba_cpu_r[0],
-                gba_cpu_r[1],
-                gba_cpu_r[2],
-                gba_cpu_r[3],
-                gba_cpu_r[4],
-                gba_cpu_r[5],
-                gba_cpu_r[6],
-                gba_cpu_r[7],
-                gba_cpu_r[8],
-                gba_cpu_r[9],
-                gba_cpu_r[10],
-                gba_cpu_r[11],
-                gba_cpu_r[12],
-                gba_cpu_r[13],
-                gba_cpu_r[14],
-                gba_cpu_r[15],
-                gba_cpu_getCpsr(),
-                gba_cpu_getSpsr()
-            );
-            */
+void gba_cpu_getState(gba_cpu_state_t *state) {
+    uint32_t size = gba_cpu_flagT ? 2 : 4;
 
-            if(gba_cpu_flagT) {
-                if(gba_cpu_decodedOpcodeThumbHandler) {
-                    gba_cpu_decodedOpcodeThumbHandler(gba_cpu_decodedOpcodeThumbValue);
-                } else {
-                    gba_cpu_raiseUnd();
+    for(int i = 0; i < 15; i++) {
+        state->r[i] = gba_cpu_r[i];
+    }
+
+    // The backends leave the flush state at different times, but r15 always
+    // points after the instructions in the pipeline.
+    switch(gba_cpu_pipelineState) {
+        case GBA_CPU_PIPELINESTATE_FLUSH: state->r[15] = gba_cpu_r[15] + size; break;
+        case GBA_CPU_PIPELINESTATE_FETCH: state->r[15] = gba_cpu_r[15]; break;
+        case GBA_CPU_PIPELINESTATE_DECODE: state->r[15] = gba_cpu_r[15] - size; break;
+        case GBA_CPU_PIPELINESTATE_EXECUTE: state->r[15] = gba_cpu_r[15] - 2 * size; break;
+    }
+
+    state->cpsr = gba_cpu_getCpsr();
+    state->spsr = gba_cpu_getSpsr();
+}
+
+#ifdef GBA_CPU_PROFILE
+// Prints the time spent in each class of handlers, then the most executed
+// decode table entries. Instructions run by translated code are not seen.
+void gba_cpu_printProfile(FILE *file) {
+    #define GBA_CPU_PROFILE_NAME(name) {gba_cpu_##name, #name},
+    #define GBA_CPU_PROFILE_NAME_DP(op, s, name, ...) {gba_cpu_arm_dp_##op##_##s##_##name, "arm_dp_" #op "_" #s "_" #name},
+
+    static const struct {
+        gba_cpu_opcodeHandlerArm_t *handler;
+        const char *name;
+    } namesArm[] = {
+        GBA_CPU_HANDLERS_ARM(GBA_CPU_PROFILE_NAME)
+    };
+
+    static const struct {
+        gba_cpu_opcodeHandlerThumb_t *handler;
+        const char *name;
+    } namesThumb[] = {
+        GBA_CPU_HANDLERS_THUMB(GBA_CPU_PROFILE_NAME)
+    };
+
+    #undef GBA_CPU_PROFILE_NAME
+    #undef GBA_CPU_PROFILE_NAME_DP
+
+    static const char *const classNames[GBA_CPU_HANDLERCLASS_COUNT] = {
+        "ALU",
+        "load/store",
+        "LDM/STM",
+        "branch",
+        "SWI"
+    };
+
+    static gba_cpu_profileEntry_t entries[4096 + 1024];
+    uint64_t classCounts[GBA_CPU_HANDLERCLASS_COUNT] = {0};
+    uint64_t classTimes[GBA_CPU_HANDLERCLASS_COUNT] = {0};
+    int entryCount = 0;
+
+    for(int i = 0; i < 4096 + 1024; i++) {
+        bool thumb = i >= 4096;
+        int index = thumb ? i - 4096 : i;
+        uint64_t count = thumb ? gba_cpu_profileCounts_thumb[index] : gba_cpu_profileCounts_arm[index];
+        gba_cpu_handlerClass_t class;
+        const char *name = "";
+
+        if(count == 0) {
+            continue;
+        }
+
+        if(thumb) {
+            class = gba_cpu_getHandlerClassThumb(gba_cpu_decodeTable_thumb[index]);
+
+            for(size_t j = 0; j < sizeof(namesThumb) / sizeof(namesThumb[0]); j++) {
+                if(namesThumb[j].handler == gba_cpu_decodeTable_thumb[index]) {
+                    name = namesThumb[j].name;
                 }
-            } else {
-                if(gba_cpu_decodedOpcodeArmHandler) {
-                    if(gba_cpu_checkCondition(gba_cpu_decodedOpcodeArmValue >> 28)) {
-                        gba_cpu_decodedOpcodeArmHandler(gba_cpu_decodedOpcodeArmValue);
-                    }
-                } else {
-                    gba_cpu_raiseUnd();
+            }
+        } else {
+            class = gba_cpu_getHandlerClassArm(gba_cpu_decodeTable_arm[index]);
+
+            for(size_t j = 0; j < sizeof(namesArm) / sizeof(namesArm[0]); j++) {
+                if(namesArm[j].handler == gba_cpu_decodeTable_arm[index]) {
+                    name = namesArm[j].name;
                 }
             }
         }
+
+        entries[entryCount].count = count;
+        entries[entryCount].nanoseconds = thumb ? gba_cpu_profileTimes_thumb[index] : gba_cpu_profileTimes_arm[index];
+        entries[entryCount].name = name;
+        entries[entryCount].index = index;
+        entries[entryCount].thumb = thumb;
+        classCounts[class] += count;
+        classTimes[class] += entries[entryCount].nanoseconds;
+        entryCount++;
+    }
+
+    qsort(entries, entryCount, sizeof(entries[0]), gba_cpu_compareProfileEntries);
+
+    fprintf(file, "%-16s %16s %16s %10s\n", "Class", "Executions", "Nanoseconds", "ns/exec");
+
+    for(int i = 0; i < GBA_CPU_HANDLERCLASS_COUNT; i++) {
+        fprintf(
+            file,
+            "%-16s %16llu %16llu %10.2f\n",
+            classNames[i],
+            (unsigned long long)classCounts[i],
+            (unsigned long long)classTimes[i],
+            classCounts[i] ? (double)classTimes[i] / classCounts[i] : 0.0
+        );
+    }
+
+    fprintf(file, "\n%-6s %-8s %-32s %16s %16s\n", "Set", "Entry", "Handler", "Executions", "Nanoseconds");
+
+    for(int i = 0; i < entryCount && i < 64; i++) {
+        fprintf(
+            file,
+            "%-6s 0x%03x    %-32s %16llu %16llu\n",
+            entries[i].thumb ? "Thumb" : "ARM",
+            entries[i].index,
+            entries[i].name,
+            (unsigned long long)entries[i].count,
+            (unsigned long long)entries[i].nanoseconds
+        );
     }
 }
+#endif
 
-static inline void gba_cpu_decode() {
-    if(gba_cpu_pipelineState >= GBA_CPU_PIPELINESTATE_DECODE) {
-        if(gba_cpu_flagT) {
-            gba_cpu_decodedOpcodeThumbValue = gba_cpu_fetchedOpcodeThumb;
-            gba_cpu_decodedOpcodeThumbHandler = gba_cpu_decodeTable_thumb[gba_cpu_fetchedOpcodeThumb >> 6];
-        } else {
-            gba_cpu_decodedOpcodeArmValue = gba_cpu_fetchedOpcodeArm;
-            gba_cpu_decodedOpcodeArmHandler = gba_cpu_decodeTable_arm[((gba_cpu_fetchedOpcodeArm >> 16) & 0xff0) | ((gba_cpu_fetchedOpcodeArm >> 4) & 0x0f)];
+bool gba_cpu_jitCheckCondition(uint32_t condition) {
+    return gba_cpu_checkCondition(condition);
+}
+
+// Leaves the pipeline to be refilled by the dispatcher after a branch taken
+// by translated code when an event is due.
+void gba_cpu_jitJump(uint32_t address) {
+    gba_cpu_performJump(address);
+}
+
+// Executes an instruction the JIT or gbaaot does not translate. Returns true
+// if the translated block can carry on with the next instruction.
+bool gba_cpu_jitInterpretArm(uint32_t opcode) {
+    gba_cpu_opcodeHandlerArm_t *handler = gba_cpu_decodeTable_arm[((opcode >> 16) & 0xff0) | ((opcode >> 4) & 0x0f)];
+    uint32_t cycles = gba_cpu_getFetchCycles(gba_cpu_r[15], false);
+
+    if(handler) {
+        if(gba_cpu_checkCondition(opcode >> 28)) {
+            GBA_CPU_PROFILE_ARM(opcode, handler(opcode));
         }
+    } else {
+        gba_cpu_raiseUnd();
     }
+
+    return gba_cpu_completeJitInstruction(4, cycles);
 }
 
-static inline void gba_cpu_fetch(uint32_t fetchAddress) {
-    if(gba_cpu_flagT) {
-        gba_cpu_fetchedOpcodeThumb = gba_bus_read16(fetchAddress);
-        gba_cpu_r[15] += 2;
+bool gba_cpu_jitInterpretThumb(uint32_t opcode) {
+    const gba_cpu_thumbRecord_t *record = &gba_cpu_thumbRecords[opcode & 0xffff];
+    gba_cpu_opcodeHandlerThumb_t *handler = gba_cpu_handlers_thumb[record->handler];
+    uint32_t cycles = gba_cpu_getFetchCycles(gba_cpu_r[15], true);
+
+    if(handler) {
+        GBA_CPU_PROFILE_THUMB(record->opcode, handler(record));
     } else {
-        gba_cpu_fetchedOpcodeArm = gba_bus_read32(fetchAddress);
-        gba_cpu_r[15] += 4;
+        gba_cpu_raiseUnd();
     }
+
+    return gba_cpu_completeJitInstruction(2, cycles);
 }
 
-static inline void gba_cpu_initDecodeThumb() {
-    for(int i = 0; i < 1024; i++) {
-        uint16_t opcode = i << 6;
+#ifdef GBA_CPU_PROFILE
+static inline uint64_t gba_cpu_getProfileTime() {
+    struct timespec time;
 
-        gba_cpu_decodeTable_thumb[i] = NULL;
+    timespec_get(&time, TIME_UTC);
 
-        switch((opcode & 0xe000) >> 13) {
-            case 0:
-            if((opcode & 0x1800) == 0x1800) {
-                if(opcode & (1 << 9)) {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_sub;
-                } else {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add;
-                }
-            } else {
-                switch((opcode & 0x1800) >> 11) {
-                    case 0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsl; break;
-                    case 1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsr; break;
-                    case 2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_asr; break;
-                }
-            }
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
 
-            break;
+static inline void gba_cpu_addProfileTime(uint64_t *time, uint64_t start) {
+    uint64_t elapsed = gba_cpu_getProfileTime() - start;
 
-            case 1:
-            switch((opcode & 0x1800) >> 11) {
-                case 0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mov; break;
-                case 1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmp; break;
-                case 2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add2; break;
-                case 3: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_sub2; break;
-            }
+    if(elapsed > gba_cpu_profileOverhead) {
+        *time += elapsed - gba_cpu_profileOverhead;
+    }
+}
 
-            break;
+// Measures the time taken by reading the clock, which is taken off every
+// measurement.
+static inline void gba_cpu_calibrateProfile() {
+    uint64_t start = gba_cpu_getProfileTime();
 
-            case 2:
-            if(opcode & (1 << 12)) {
-                if(opcode & (1 << 9)) {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStrh;
-                } else {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStr;
-                }
-            } else {
-                if(opcode & (1 << 11)) {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldr;
-                } else {
-                    if(opcode & (1 << 10)) {
-                        if((opcode & 0x0380) == 0x0300) {
-                            gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_bx;
-                        } else if((opcode & 0x0300) != 0x0300) {
-                            if((opcode & 0x00c0) != 0x0000) {
-                                switch((opcode & 0x0300) >> 8) {
-                                    case 0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add3; break;
-                                    case 1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmp3; break;
-                                    case 2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mov2; break;
-                                }
-                            }
-                        }
-                    } else {
-                        switch((opcode & 0x03c0) >> 6) {
-                            case 0x0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_and; break;
-                            case 0x1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_eor; break;
-                            case 0x2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsl2; break;
-                            case 0x3: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsr2; break;
-                            case 0x4: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_asr2; break;
-                            case 0x5: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_adc; break;
-                            case 0x6: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_sbc; break;
-                            case 0x7: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ror; break;
-                            case 0x8: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_tst; break;
-                            case 0x9: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_neg; break;
-                            case 0xa: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmp2; break;
-                            case 0xb: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmn; break;
-                            case 0xc: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_orr; break;
-                            case 0xd: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mul; break;
-                            case 0xe: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_bic; break;
-                            case 0xf: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mvn; break;
-                        }
-                    }
-                }
-            }
-
-            break;
+    for(int i = 0; i < 1000; i++) {
+        gba_cpu_getProfileTime();
+    }
 
-            case 3:
-                gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStr2;
-                break;
+    gba_cpu_profileOverhead = (gba_cpu_getProfileTime() - start) / 1000;
+}
 
-            case 4:
-                if(opcode & (1 << 12)) {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStr3;
-                } else {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStrh2;
-                }
+static inline gba_cpu_handlerClass_t gba_cpu_getHandlerClassArm(gba_cpu_opcodeHandlerArm_t *handler) {
+    if(handler == gba_cpu_arm_singleDataTransfer || handler == gba_cpu_arm_halfwordSignedDataTransfer || handler == gba_cpu_arm_swp) {
+        return GBA_CPU_HANDLERCLASS_LOADSTORE;
+    } else if(handler == gba_cpu_arm_blockDataTransfer) {
+        return GBA_CPU_HANDLERCLASS_BLOCKTRANSFER;
+    } else if(handler == gba_cpu_arm_b || handler == gba_cpu_arm_bx) {
+        return GBA_CPU_HANDLERCLASS_BRANCH;
+    } else if(handler == gba_cpu_arm_swi) {
+        return GBA_CPU_HANDLERCLASS_SWI;
+    }
 
-                break;
+    return GBA_CPU_HANDLERCLASS_ALU;
+}
 
-            case 5:
-                if(opcode & (1 << 12)) {
-                    if((opcode & 0x0f00) == 0x0000) {
-                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add5;
-                    } else if((opcode & 0x0600) == 0x0400) {
-                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_pushPop;
-                    }
-                } else {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add4;
-                }
+static inline gba_cpu_handlerClass_t gba_cpu_getHandlerClassThumb(gba_cpu_opcodeHandlerThumb_t *handler) {
+    if(
+        handler == gba_cpu_thumb_ldrStrh
+        || handler == gba_cpu_thumb_ldrStr
+        || handler == gba_cpu_thumb_ldr
+        || handler == gba_cpu_thumb_ldrStr2
+        || handler == gba_cpu_thumb_ldrStr3
+        || handler == gba_cpu_thumb_ldrStrh2
+    ) {
+        return GBA_CPU_HANDLERCLASS_LOADSTORE;
+    } else if(handler == gba_cpu_thumb_pushPop || handler == gba_cpu_thumb_ldmStm) {
+        return GBA_CPU_HANDLERCLASS_BLOCKTRANSFER;
+    } else if(handler == gba_cpu_thumb_b || handler == gba_cpu_thumb_b2 || handler == gba_cpu_thumb_bl || handler == gba_cpu_thumb_bx) {
+        return GBA_CPU_HANDLERCLASS_BRANCH;
+    } else if(handler == gba_cpu_thumb_swi) {
+        return GBA_CPU_HANDLERCLASS_SWI;
+    }
 
-                break;
+    return GBA_CPU_HANDLERCLASS_ALU;
+}
 
-            case 6:
-                if(opcode & (1 << 12)) {
-                    if((opcode & 0x0f00) == 0x0f00) {
-                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_swi;
-                    } else {
-                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_b;
-                    }
-                } else {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldmStm;
-                }
+// Sorts by decreasing number of executions.
+static int gba_cpu_compareProfileEntries(const void *left, const void *right) {
+    const gba_cpu_profileEntry_t *a = left;
+    const gba_cpu_profileEntry_t *b = right;
 
-                break;
+    return (a->count < b->count) - (a->count > b->count);
+}
+#endif
 
-            case 7:
-                if(opcode & (1 << 12)) {
-                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_bl;
-                } else {
-                    if(!(opcode & (1 << 11))) {
-                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_b2;
-                    }
-                }
+static inline void gba_cpu_runInterpreter() {
+    while(gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp && !gba_cpu_halted) {
+        uint32_t cycles = gba_cpu_getFetchCycles(gba_cpu_r[15], gba_cpu_flagT);
 
-                break;
+        if(gba_cpu_pipelineEmulation) {
+            gba_cpu_cycle();
+        } else if(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE) {
+            gba_cpu_refillPipeline();
+            continue;
+        } else {
+            gba_cpu_step();
         }
+
+        gba_scheduler_cycleCounter += cycles;
     }
 }
 
-static inline void gba_cpu_initDecodeArm() {
-    for(int i = 0; i < 4096; i++) {
-        uint32_t opcode = ((i & 0xff0) << 16) | ((i & 0x00f) << 4);
-
-        gba_cpu_decodeTable_arm[i] = NULL;
+// Every instruction goes through the execute stage, which records it.
+static inline void gba_cpu_runTraced() {
+    // The other backends do not keep the fetched and decoded opcodes up to
+    // date.
+    if(
+        !gba_cpu_traced
+        && (gba_cpu_backend != GBA_CPU_BACKEND_INTERPRETER || !gba_cpu_pipelineEmulation)
+        && gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_EXECUTE
+    ) {
+        gba_cpu_performJump(gba_cpu_r[15] - (gba_cpu_flagT ? 4 : 8));
+    }
 
-        switch((opcode & 0x0c000000) >> 26) {
-            case 0x0:
-                if((opcode & 0x0ff000f0) == 0x01200010) {
-                    gba_cpu_decodeTable_arm[i] = gba_cpu_arm_bx;
-                } else if((opcode & 0x02000090) == 0x00000090) {
-                    if((opcode & 0x0fb000f0) == 0x01000090) {
-                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_swp;
-                    } else if((opcode & 0x0fc000f0) == 0x00000090) {
-                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_mul;
-                    } else if((opcode & 0x0f8000f0) == 0x00800090) {
-                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_mull;
-                    } else if((opcode & 0x0e000090) == 0x00000090) {
-                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_halfwordSignedDataTransfer;
-                    }
-                } else if((opcode & 0x01900000) == 0x01000000) {
-                    if((opcode & (1 << 25)) || ((opcode & 0x000000f0) == 0x00000000)) {
-                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_psrTransfer;
-                    }
-                } else {
-                    switch((opcode & 0x01e00000) >> 21) {
-                        case 0x0: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_and; break;
-                        case 0x1: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_eor; break;
-                        case 0x2: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_sub; break;
-                        case 0x3: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_rsb; break;
-                        case 0x4: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_add; break;
-                        case 0x5: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_adc; break;
-                        case 0x6: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_sbc; break;
-                        case 0x7: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_rsc; break;
-                        case 0x8: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_tst; break;
-                        case 0x9: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_teq; break;
-                        case 0xa: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_cmp; break;
-                        case 0xb: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_cmn; break;
-                        case 0xc: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_orr; break;
-                        case 0xd: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_mov; break;
-                        case 0xe: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_bic; break;
-                        case 0xf: gba_cpu_decodeTable_arm[i] = gba_cpu_arm_mvn; break;
-                    }
-                }
+    gba_cpu_traced = true;
 
-                break;
+    while(gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp && !gba_cpu_halted) {
+        uint32_t cycles = gba_cpu_getFetchCycles(gba_cpu_r[15], gba_cpu_flagT);
 
-            case 0x1:
-            if((opcode & 0x02000010) != 0x02000010) {
-                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_singleDataTransfer;
-            }
+        gba_cpu_cycle();
+        gba_scheduler_cycleCounter += cycles;
+    }
+}
 
-            break;
+// Executes the instruction two instructions behind r15, which therefore
+// already reads as it would through the pipeline. Only jumps reload it.
+static inline void gba_cpu_step() {
+    if(gba_cpu_isIrqPending()) {
+        gba_cpu_raiseIrq();
+    } else if(gba_cpu_flagT) {
+        const gba_cpu_thumbRecord_t *record = &gba_cpu_thumbRecords[gba_bus_peek16(gba_cpu_r[15] - 4)];
+        gba_cpu_opcodeHandlerThumb_t *handler = gba_cpu_handlers_thumb[record->handler];
+
+        if(gba_coverage_enabled) {
+            gba_coverage_mark(gba_cpu_r[15] - 4, gba_cpu_r[15] - 2);
+        }
 
-            case 0x2:
-            if(opcode & (1 << 25)) {
-                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_b;
-            } else {
-                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_blockDataTransfer;
-            }
+        if(handler) {
+            GBA_CPU_PROFILE_THUMB(record->opcode, handler(record));
+        } else {
+            gba_cpu_raiseUnd();
+        }
+    } else {
+        uint32_t opcode = gba_bus_peek32(gba_cpu_r[15] - 8);
+        gba_cpu_opcodeHandlerArm_t *handler = gba_cpu_decodeTable_arm[((opcode >> 16) & 0xff0) | ((opcode >> 4) & 0x0f)];
 
-            break;
+        if(gba_coverage_enabled) {
+            gba_coverage_mark(gba_cpu_r[15] - 8, gba_cpu_r[15] - 4);
+        }
 
-            case 0x3:
-            if((opcode & 0x03000000) == 0x03000000) {
-                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_swi;
+        if(handler) {
+            if(gba_cpu_checkCondition(opcode >> 28)) {
+                GBA_CPU_PROFILE_ARM(opcode, handler(opcode));
             }
-
-            break;
+        } else {
+            gba_cpu_raiseUnd();
         }
     }
+
+    // Like the fetch stage, which leaves the flush state within the cycle of
+    // the jump itself.
+    gba_cpu_r[15] += gba_cpu_flagT ? 2 : 4;
+
+    if(gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_FLUSH) {
+        gba_cpu_pipelineState = GBA_CPU_PIPELINESTATE_FETCH;
+    }
 }
 
-static inline void gba_cpu_arm_shift(uint32_t opcode) {
-    if(!(opcode & 0x02000000)) {
-        uint32_t rm = opcode & 0x0000000f;
-        uint32_t rm_v = gba_cpu_r[rm];
+static inline void gba_cpu_runCached() {
+    while(gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp && !gba_cpu_halted) {
+        if(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE) {
+            gba_cpu_refillPipeline();
+        } else if(gba_cpu_isIrqPending()) {
+            gba_scheduler_cycleCounter += gba_cpu_getFetchCycles(gba_cpu_r[15], gba_cpu_flagT);
+            gba_cpu_raiseIrq();
+        } else {
+            uint32_t address = gba_cpu_r[15] - (gba_cpu_flagT ? 4 : 8);
+            gba_cpu_block_t *block = gba_cpu_getBlock(address);
 
-        if(!(opcode & 0x00000010)) {
-            int immediate = (opcode & 0x00000f80) >> 7;
+            if(!gba_cpu_skipIdleLoop(block)) {
+                gba_cpu_executeBlock(block);
+            }
 
-            switch((opcode & 0x060) >> 5) {
-                case 0: // LSL
-                    if(immediate == 0) {
-                        gba_cpu_shifterResult = rm_v;
-                        gba_cpu_shifterCarry = gba_cpu_flagC;
-                    } else {
-                        gba_cpu_shifterResult = rm_v << immediate;
-                        gba_cpu_shifterCarry = (rm_v >> (32 - immediate)) & (1 << 0);
-                    }
+            if(gba_coverage_enabled) {
+                gba_cpu_coverBlock(block);
+            }
+        }
+    }
+}
 
-                    break;
+static inline void gba_cpu_runJit() {
+    void *patchSite = NULL;
+    uint32_t patchEpoch = 0;
 
-                case 1: // LSR
-                    if(immediate == 0) {
-                        gba_cpu_shifterResult = 0;
-                        gba_cpu_shifterCarry = rm_v >> 31;
-                    } else {
-                        gba_cpu_shifterResult = rm_v >> immediate;
-                        gba_cpu_shifterCarry = (rm_v >> (immediate - 1)) & (1 << 0);
-                    }
+    while(gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp && !gba_cpu_halted) {
+        if(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE) {
+            gba_cpu_refillPipeline();
+            patchSite = NULL;
+        } else if(gba_cpu_isIrqPending()) {
+            gba_scheduler_cycleCounter += gba_cpu_getFetchCycles(gba_cpu_r[15], gba_cpu_flagT);
+            gba_cpu_raiseIrq();
+            patchSite = NULL;
+        } else {
+            uint32_t address = gba_cpu_r[15] - (gba_cpu_flagT ? 4 : 8);
+            gba_cpu_block_t *block = gba_cpu_getBlock(address);
 
-                    break;
+            if(gba_cpu_skipIdleLoop(block)) {
+                patchSite = NULL;
+                continue;
+            }
 
-                case 2: // ASR
-                    if(immediate == 0) {
-                        gba_cpu_shifterResult = (int)rm_v >> 31;
-                        gba_cpu_shifterCarry = rm_v >> 31;
-                    } else {
-                        gba_cpu_shifterResult = (int)rm_v >> immediate;
-                        gba_cpu_shifterCarry = (rm_v >> (immediate - 1)) & (1 << 0);
-                    }
+            // Translated blocks run until their end unless they access
+            // memory, so the last few cycles before an event are interpreted.
+            uint64_t blockCycles = (uint64_t)block->length * gba_cpu_getFetchCycles(address, block->thumb);
+
+            if(
+                block == &gba_cpu_uncachedBlock
+                || gba_scheduler_nextEventTimestamp - gba_scheduler_cycleCounter < blockCycles
+            ) {
+                gba_cpu_executeBlock(block);
+                patchSite = NULL;
+                continue;
+            }
 
-                    break;
+            if(block->jitCode == NULL || block->jitEpoch != gba_jit_epoch) {
+                uint32_t opcodes[GBA_CPU_BLOCK_MAX_LENGTH];
 
-                case 3: // ROR/RRX
-                    if(immediate == 0) {
-                        // RRX
-                        gba_cpu_shifterResult = (gba_cpu_flagC ? 1 << 31 : 0) | (rm_v >> 1);
-                        gba_cpu_shifterCarry = rm_v & (1 << 0);
-                    } else {
-                        // ROR
-                        gba_cpu_shifterResult = gba_cpu_util_ror32(rm_v, immediate);
-                        gba_cpu_shifterCarry = (rm_v >> (immediate - 1)) & (1 << 0);
-                    }
+                for(int i = 0; i < block->length; i++) {
+                    opcodes[i] = block->instructions[i].opcode;
+                }
 
-                    break;
+                block->jitCode = gba_jit_compile(block->address, block->thumb, opcodes, block->length);
+                block->jitEpoch = gba_jit_epoch;
             }
-        } else {
-            if(rm == 15) {
-                rm_v += 4;
+
+            if(block->jitCode == NULL) {
+                gba_cpu_executeBlock(block);
+                patchSite = NULL;
+                continue;
             }
 
-            if((opcode & 0x00000080) != 0) {
-                gba_cpu_raiseUnd();
+            // Blocks in RAM may be retranslated, so only blocks in memory
+            // that cannot be written are jumped to directly. Idle loops
+            // always go through the dispatcher, which skips them.
+            bool idle = gba_cpu_idleLoopSkipping && block->idleLoop;
+
+            if(patchSite && patchEpoch == gba_jit_epoch && gba_cpu_isImmutable(address) && !idle) {
+                gba_jit_link(patchSite, block->jitCode);
             }
 
-            uint32_t rs = (opcode & 0x00000f00) >> 8;
-            uint32_t shift = gba_cpu_r[rs] & 0x000000ff;
+            // Translated code reads and writes the flag variables directly.
+            gba_cpu_materializeFlags();
+            gba_cpu_blockInvalidated = false;
+            gba_jit_linkBlocked = false;
+            patchSite = gba_jit_run(block->jitCode);
+            patchEpoch = gba_jit_epoch;
 
-            switch((opcode & 0x060) >> 5) {
-                case 0: // LSL
-                    if(shift == 0) {
-                        gba_cpu_shifterResult = rm_v;
-                        gba_cpu_shifterCarry = gba_cpu_flagC;
-                    } else if(shift < 32) {
-                        gba_cpu_shifterResult = rm_v << shift;
-                        gba_cpu_shifterCarry = (rm_v >> (32 - shift)) & (1 << 0);
-                    } else if(shift == 32) {
-                        gba_cpu_shifterResult = 0;
-                        gba_cpu_shifterCarry = rm_v & (1 << 0);
-                    } else {
-                        gba_cpu_shifterResult = 0;
-                        gba_cpu_shifterCarry = false;
-                    }
+            if(idle) {
+                patchSite = NULL;
+            }
+        }
+    }
+}
 
-                    break;
+static inline bool gba_cpu_completeJitInstruction(uint32_t size, uint32_t cycles) {
+    gba_cpu_materializeFlags();
+    gba_scheduler_cycleCounter += cycles;
 
-                case 1: // LSR
-                    if(shift == 0) {
-                        gba_cpu_shifterResult = rm_v;
-                        gba_cpu_shifterCarry = gba_cpu_flagC;
-                    } else if(shift < 32) {
-                        gba_cpu_shifterResult = rm_v >> shift;
-                        gba_cpu_shifterCarry = (rm_v >> (shift - 1)) & (1 << 0);
-                    } else if(shift == 32) {
-                        gba_cpu_shifterResult = 0;
-                        gba_cpu_shifterCarry = rm_v >> 31;
-                    } else {
-                        gba_cpu_shifterResult = 0;
-                        gba_cpu_shifterCarry = false;
-                    }
+    // The instruction may have changed the interrupt state.
+    gba_jit_linkBlocked = true;
 
-                    break;
+    if(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE) {
+        return false;
+    }
 
-                case 2: // ASR
-                    if(shift == 0) {
-                        gba_cpu_shifterResult = rm_v;
-                        gba_cpu_shifterCarry = gba_cpu_flagC;
-                    } else if(shift < 32) {
-                        gba_cpu_shifterResult = (int)rm_v >> shift;
-                        gba_cpu_shifterCarry = (rm_v >> (shift - 1)) & (1 << 0);
-                    } else {
-                        gba_cpu_shifterResult = (int)rm_v >> 31;
-                        gba_cpu_shifterCarry = rm_v >> 31;
-                    }
+    gba_cpu_r[15] += size;
 
-                    break;
-                    
-                case 3: // ROR
-                    {
-                        int rotation = shift & 0x1f;
+    return !gba_cpu_blockInvalidated && gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp;
+}
 
-                        if(shift == 0) {
-                            gba_cpu_shifterResult = rm_v;
-                            gba_cpu_shifterCarry = gba_cpu_flagC;
-                        } else if(rotation == 0) {
-                            gba_cpu_shifterResult = rm_v;
-                            gba_cpu_shifterCarry = rm_v >> 31;
-                        } else {
-                            gba_cpu_shifterResult = gba_cpu_util_ror32(rm_v, rotation);
-                            gba_cpu_shifterCarry = (rm_v >> (rotation - 1)) & (1 << 0);
-                        }
+// Accounts for the cycles the interpreter spends refilling the pipeline
+// after a jump, so that both backends agree on timing. The interpreter
+// leaves the flush state within the cycle of the jump itself, then spends
+// one cycle per stage, which may be interrupted by an event.
+static inline void gba_cpu_refillPipeline() {
+    uint32_t size = gba_cpu_flagT ? 2 : 4;
 
-                        break;
-                    }
-            }
-        }
-    } else {
-        uint32_t rotation = (opcode >> 7) & 0x1e;
-        uint32_t immediate = opcode & 0xff;
+    if(gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_FLUSH) {
+        gba_cpu_r[15] += size;
+        gba_cpu_pipelineState = GBA_CPU_PIPELINESTATE_FETCH;
+    }
 
-        if(rotation) {
-            gba_cpu_shifterResult = gba_cpu_util_ror32(immediate, rotation);
-            gba_cpu_shifterCarry = gba_cpu_shifterResult >> 31;
-        } else {
-            gba_cpu_shifterResult = immediate;
-            gba_cpu_shifterCarry = gba_cpu_flagC;
-        }
+    while(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE && gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp) {
+        gba_scheduler_cycleCounter += gba_cpu_getFetchCycles(gba_cpu_r[15], gba_cpu_flagT);
+        gba_cpu_r[15] += size;
+        gba_cpu_pipelineState++;
     }
 }
 
-static inline uint32_t gba_cpu_util_ror32(uint32_t value, int bits) {
-    return (value >> bits) | (value << (32 - bits));
+// Every cycle of the pipeline is counted as a sequential opcode fetch from
+// the given address. Data accesses add their own cost through the bus.
+static inline uint32_t gba_cpu_getFetchCycles(uint32_t address, bool thumb) {
+    return gba_bus_cycles[thumb ? GBA_BUS_ACCESS_S16 : GBA_BUS_ACCESS_S32][(address >> 24) & 0x0f];
 }
 
+static inline bool gba_cpu_isStopWakeupRequested() {
+    uint16_t ie = gba_io_getRegister(0x04000200)->value;
+    uint16_t if_ = gba_io_getRegister(0x04000202)->value;
 
-static inline void gba_cpu_writeRegister(int rd, uint32_t value) {
-    if(rd == 15) {
-        gba_cpu_performJump(value);
-    } else {
-        gba_cpu_r[rd] = value;
-    }
+    return (ie & if_ & GBA_CPU_STOP_WAKEUP_FLAGS) != 0;
 }
 
-static inline void gba_cpu_setFlags_logical(uint32_t result) {
-    gba_cpu_setFlags_arithmetical(result);
-    gba_cpu_flagC = gba_cpu_shifterCarry;
+static inline bool gba_cpu_isIrqPending() {
+    return gba_irq_pending && !gba_cpu_flagI;
 }
 
-static inline void gba_cpu_setFlags_arithmetical(uint32_t result) {
-    gba_cpu_flagN = result >> 31;
-    gba_cpu_flagZ = result == 0;
-}
+static inline int gba_cpu_getCodePage(uint32_t address) {
+    switch((address & 0x0f000000) >> 24) {
+        case 0x02: // EWRAM
+            return (address & (GBA_EWRAM_SIZE - 1)) >> GBA_CPU_CODE_PAGE_SHIFT;
 
-static inline bool gba_cpu_getCarry_sbc(uint32_t left, uint32_t right, bool carry) {
-    return (left >= right) && ((left - right) >= (!carry));
-}
+        case 0x03: // IWRAM
+            return (GBA_EWRAM_SIZE + (address & (GBA_IWRAM_SIZE - 1))) >> GBA_CPU_CODE_PAGE_SHIFT;
 
-static inline bool gba_cpu_getCarry_sub(uint32_t left, uint32_t right) {
-    return left >= right;
+        default:
+            return -1;
+    }
 }
 
-static inline bool gba_cpu_getOverflow_sub(uint32_t left, uint32_t right, uint32_t result) {
-    return ((left ^ right) & (left ^ result)) >> 31;
+// Only code in memory that cannot be written, or whose writes are tracked,
+// is kept in the block cache.
+static inline bool gba_cpu_isCacheable(uint32_t address) {
+    switch((address & 0x0f000000) >> 24) {
+        case 0x00: // BIOS
+        case 0x02: // EWRAM
+        case 0x03: // IWRAM
+        case 0x08: // Game Pak ROM
+        case 0x09:
+        case 0x0a:
+        case 0x0b:
+        case 0x0c:
+        case 0x0d:
+            return true;
+
+        default:
+            return false;
+    }
 }
 
-static inline bool gba_cpu_getOverflow_add(uint32_t left, uint32_t right, uint32_t result) {
-    return (!((left ^ right) >> 31)) && ((left ^ result) >> 31);
+static inline bool gba_cpu_isImmutable(uint32_t address) {
+    return gba_cpu_isCacheable(address) && gba_cpu_getCodePage(address) < 0;
 }
 
-static inline unsigned int gba_cpu_util_hammingWeight16(uint16_t value) {
-    unsigned int count = 0;
+static inline gba_cpu_block_t *gba_cpu_getBlock(uint32_t address) {
+    if(!gba_cpu_isCacheable(address)) {
+        gba_cpu_buildBlock(&gba_cpu_uncachedBlock, address, 1);
+        return &gba_cpu_uncachedBlock;
+    }
 
-    for(int i = 0; i < 16; i++) {
-        if(value & (1 << i)) {
-            count++;
-        }
+    gba_cpu_block_t *block = &gba_cpu_blockCache[(address >> (gba_cpu_flagT ? 1 : 2)) & (GBA_CPU_BLOCK_CACHE_SIZE - 1)];
+
+    if(
+        !block->valid
+        || block->address != address
+        || block->thumb != gba_cpu_flagT
+        || (block->page >= 0 && block->generation != gba_cpu_codePageGeneration[block->page])
+    ) {
+        gba_cpu_buildBlock(block, address, GBA_CPU_BLOCK_MAX_LENGTH);
     }
 
-    return count;
+    return block;
 }
 
-static inline unsigned int gba_cpu_util_hammingWeight8(uint8_t value) {
-    unsigned int count = 0;
+static inline void gba_cpu_buildBlock(gba_cpu_block_t *block, uint32_t address, int maxLength) {
+    uint32_t size = gba_cpu_flagT ? 2 : 4;
+    bool end = false;
 
-    for(int i = 0; i < 8; i++) {
-        if(value & (1 << i)) {
-            count++;
-        }
+    block->address = address;
+    block->page = gba_cpu_getCodePage(address);
+    block->thumb = gba_cpu_flagT;
+    block->valid = true;
+    block->length = 0;
+    block->jitCode = NULL;
+
+    if(block->page >= 0) {
+        block->generation = gba_cpu_codePageGeneration[block->page];
+        gba_cpu_codePageCached[block->page] = true;
     }
 
-    return count;
-}
+    while(!end) {
+        gba_cpu_blockInstruction_t *instruction = &block->instructions[block->length++];
+        const gba_cpu_blockInstruction_t *predecoded = gba_cpu_getPredecoded(address, gba_cpu_flagT);
 
-static inline void gba_cpu_arm_halfwordSignedDataTransfer(uint32_t opcode) {
-    bool p = (opcode & (1 << 24)) != 0;
-    bool u = (opcode & (1 << 23)) != 0;
-    bool i = (opcode & (1 << 22)) != 0;
-    bool w = (opcode & (1 << 21)) != 0;
-    bool l = (opcode & (1 << 20)) != 0;
-    bool s = (opcode & (1 << 6)) != 0;
-    bool h = (opcode & (1 << 5)) != 0;
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
+        if(predecoded) {
+            *instruction = *predecoded;
+        } else {
+            gba_cpu_decodeInstruction(instruction, address, gba_cpu_flagT);
+        }
 
-    if(!s && !h) {
-        gba_cpu_raiseUnd();
+        if(gba_cpu_flagT) {
+            end = gba_cpu_endsBlockThumb(instruction->handler.thumb, instruction->opcode) || gba_cpu_isLoopBranch(block, address, instruction->opcode);
+        } else {
+            end = gba_cpu_endsBlockArm(instruction->handler.arm, instruction->opcode) || gba_cpu_isLoopBranch(block, address, instruction->opcode);
+        }
+
+        address += size;
+
+        // Blocks never span two code pages, so that checking the generation
+        // of the first page is enough to detect overwritten code.
+        if(block->length == maxLength || (block->page >= 0 && (address & ((1 << GBA_CPU_CODE_PAGE_SHIFT) - 1)) == 0)) {
+            end = true;
+        }
     }
 
-    uint32_t addr = gba_cpu_r[rn];
-    uint32_t offset;
+    if(block->thumb && gba_cpu_fusion) {
+        gba_cpu_fuseInstructions(block);
+    }
 
-    if(i) {
-        offset = ((opcode & 0x00000f00) >> 4) | (opcode & 0x0000000f);
+    block->idleLoop = gba_cpu_isIdleLoop(block);
+    block->aotFunction = gba_cpu_aotBlockCount ? gba_cpu_findAotFunction(block) : NULL;
+    gba_cpu_aotHits += block->aotFunction != NULL;
+}
+
+static inline void gba_cpu_decodeInstruction(gba_cpu_blockInstruction_t *instruction, uint32_t address, bool thumb) {
+    if(thumb) {
+        uint16_t opcode = gba_bus_peek16(address);
+
+        instruction->opcode = opcode;
+        instruction->record = &gba_cpu_thumbRecords[opcode];
+        instruction->handler.thumb = gba_cpu_handlers_thumb[instruction->record->handler];
+        instruction->fused = 0;
+#ifdef GBA_CPU_THREADED
+        instruction->label = gba_cpu_threadedLabels_thumb[opcode >> 6];
+#endif
     } else {
-        if(((opcode & 0x00000f00) >> 8) != 0) {
-            gba_cpu_raiseUnd();
-        }
+        uint32_t opcode = gba_bus_peek32(address);
+
+        instruction->opcode = opcode;
+        instruction->handler.arm = gba_cpu_decodeTable_arm[((opcode >> 16) & 0xff0) | ((opcode >> 4) & 0x0f)];
+        instruction->fused = 0;
+#ifdef GBA_CPU_THREADED
+        instruction->label = gba_cpu_threadedLabels_arm[((opcode >> 16) & 0xff0) | ((opcode >> 4) & 0x0f)];
+#endif
+    }
+}
 
-        uint32_t rm = opcode & 0x0000000f;
+// Compiled blocks are only looked for in ROM, where the hash is checked once
+// per build of the cached block.
+static inline gba_cpu_aotFunction_t *gba_cpu_findAotFunction(const gba_cpu_block_t *block) {
+    uint32_t region = block->address >> 24;
+    size_t low = 0;
+    size_t high = gba_cpu_aotBlockCount;
 
-        offset = gba_cpu_r[rm];
+    if(region < 0x08 || region > 0x0d) {
+        return NULL;
     }
 
-    if(p) {
-        if(u) {
-            addr += offset;
+    while(low < high) {
+        size_t middle = (low + high) / 2;
+        uint32_t address = gba_cpu_aotBlocks[middle].address;
+
+        if(address < block->address || (address == block->address && gba_cpu_aotBlocks[middle].thumb < block->thumb)) {
+            low = middle + 1;
         } else {
-            addr -= offset;
+            high = middle;
         }
-    } else {
-        w = true;
     }
 
-    if(l) {
-        if(w) {
-            if(p) {
-                gba_cpu_r[rn] = addr;
-            } else {
-                if(u) {
-                    gba_cpu_r[rn] = addr + offset;
-                } else {
-                    gba_cpu_r[rn] = addr - offset;
-                }
-            }
-        }
+    const gba_cpu_aotBlock_t *entry = &gba_cpu_aotBlocks[low];
 
-        if(!s && h) { // LDRH
-            if(addr & (1 << 0)) {
-                gba_cpu_writeRegister(rd, gba_cpu_util_ror32(gba_bus_read16(addr), 8));
-            } else {
-                gba_cpu_writeRegister(rd, gba_bus_read16(addr));
-            }
-        } else if((!h) || (addr & (1 << 0))) { // LDRSB
-            uint32_t readValue = gba_bus_read8(addr);
+    if(
+        low == gba_cpu_aotBlockCount
+        || entry->address != block->address
+        || entry->thumb != block->thumb
+        || entry->length != block->length
+    ) {
+        return NULL;
+    }
 
-            if(readValue & (1 << 7)) {
-                readValue |= 0xffffff00;
-            }
+    uint8_t bytes[GBA_CPU_BLOCK_MAX_LENGTH * 4];
+    size_t size = block->length * (block->thumb ? 2 : 4);
 
-            gba_cpu_writeRegister(rd, readValue);
-        } else { // LDRSH
-            uint32_t readValue = gba_bus_read16(addr);
+    for(size_t i = 0; i < size; i += 2) {
+        uint16_t halfword = gba_bus_peek16(block->address + i);
 
-            if(readValue & (1 << 15)) {
-                readValue |= 0xffff0000;
-            }
+        bytes[i] = halfword;
+        bytes[i + 1] = halfword >> 8;
+    }
 
-            gba_cpu_writeRegister(rd, readValue);
-        }
-    } else {
-        uint32_t rd_v = gba_cpu_r[rd];
+    return gba_cpu_hashAotBlock(bytes, size) == entry->hash ? entry->function : NULL;
+}
 
-        if(rd == 15) {
-            rd_v += 4;
-        }
+// Pairs are only fused within a block, and the second instruction keeps its
+// own handler for when the block stops in between, after which execution
+// resumes with a block starting at the second instruction.
+static inline void gba_cpu_fuseInstructions(gba_cpu_block_t *block) {
+    for(int i = 0; i < block->length - 1; i++) {
+        gba_cpu_blockInstruction_t *instruction = &block->instructions[i];
+        gba_cpu_fusedHandler_t *fused = gba_cpu_getFusedHandler(instruction, instruction + 1);
 
-        if(s) {
-            gba_cpu_raiseUnd();
-        } else { // STRH
-            gba_bus_write16(addr, rd_v);
+        if(fused == NULL) {
+            continue;
         }
 
-        if(w) {
-            if(p) {
-                gba_cpu_r[rn] = addr;
-            } else {
-                if(u) {
-                    gba_cpu_r[rn] = addr + offset;
-                } else {
-                    gba_cpu_r[rn] = addr - offset;
-                }
+        for(size_t j = 1; j < GBA_CPU_FUSED_HANDLER_COUNT; j++) {
+            if(gba_cpu_fusedHandlers[j] == fused) {
+                instruction->fused = j;
             }
         }
+
+#ifdef GBA_CPU_THREADED
+        instruction->label = gba_cpu_threadedLabels_fused[instruction->fused];
+#endif
+
+        i++;
     }
 }
 
-static inline void gba_cpu_arm_blockDataTransfer(uint32_t opcode) {
-    bool p = (opcode & (1 << 24)) != 0;
-    bool u = (opcode & (1 << 23)) != 0;
-    bool s = (opcode & (1 << 22)) != 0;
-    bool w = (opcode & (1 << 21)) != 0;
-    bool l = (opcode & (1 << 20)) != 0;
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
-    uint32_t registerCount = gba_cpu_util_hammingWeight16(opcode);
-    uint16_t rlist = opcode;
+static inline gba_cpu_fusedHandler_t *gba_cpu_getFusedHandler(const gba_cpu_blockInstruction_t *first, const gba_cpu_blockInstruction_t *second) {
+    gba_cpu_opcodeHandlerThumb_t *handler = first->handler.thumb;
+    gba_cpu_opcodeHandlerThumb_t *next = second->handler.thumb;
 
-    uint32_t addr = rn_v;
+    if(handler == gba_cpu_thumb_bl && next == gba_cpu_thumb_bl) {
+        if(!(first->opcode & (1 << 11)) && (second->opcode & (1 << 11))) {
+            return gba_cpu_fused_bl;
+        }
+    } else if(next == gba_cpu_thumb_b) {
+        if(handler == gba_cpu_thumb_cmp) {
+            return gba_cpu_fused_cmpB;
+        } else if(handler == gba_cpu_thumb_cmp2) {
+            return gba_cpu_fused_cmp2B;
+        } else if(handler == gba_cpu_thumb_cmp3) {
+            return gba_cpu_fused_cmp3B;
+        }
+    } else if(handler == gba_cpu_thumb_ldr && next == gba_cpu_thumb_bx) {
+        if(first->record->rd == second->record->rs) {
+            return gba_cpu_fused_ldrBx;
+        }
+    }
 
-    if(!rlist) {
-        registerCount = 16;
+    return NULL;
+}
+
+// Returns the predecoded instruction at the given address in ROM, decoding
+// its whole page on first use, or NULL if the address is not in ROM or the
+// pool is exhausted. The three wait state regions share their pages.
+static inline const gba_cpu_blockInstruction_t *gba_cpu_getPredecoded(uint32_t address, bool thumb) {
+    uint32_t region = (address & 0x0f000000) >> 24;
+
+    if(region < 0x08 || region > 0x0d) {
+        return NULL;
     }
 
-    if(p) {
-        if(u) {
-            addr += 4;
-        } else {
-            addr -= 4 * registerCount;
+    uint32_t offset = address & (GBA_MAX_ROM_FILE_SIZE - 1);
+    int16_t *index = &gba_cpu_predecodeIndex[thumb][offset >> GBA_CPU_PREDECODE_PAGE_SHIFT];
+    uint32_t size = thumb ? 2 : 4;
+
+    if(*index < 0) {
+        if(gba_cpu_predecodedPageCount >= gba_cpu_predecodeLimit) {
+            return NULL;
         }
-    } else {
-        if(!u) {
-            addr -= 4 * (registerCount - 1);
+
+        *index = gba_cpu_predecodedPageCount++;
+
+        gba_cpu_predecodePage_t *page = &gba_cpu_predecodePool[*index];
+        uint32_t pageAddress = 0x08000000 | (offset & ~((1 << GBA_CPU_PREDECODE_PAGE_SHIFT) - 1));
+
+        for(uint32_t i = 0; i < (1 << GBA_CPU_PREDECODE_PAGE_SHIFT) / size; i++) {
+            gba_cpu_decodeInstruction(&page->instructions[i], pageAddress + i * size, thumb);
         }
     }
 
-    if(!rlist) {
-        if(l) {
-            gba_cpu_performJump(gba_bus_read32(addr));
-        } else {
-            gba_bus_write32(addr, gba_cpu_r[15] + 4);
-        }
+    return &gba_cpu_predecodePool[*index].instructions[(offset & ((1 << GBA_CPU_PREDECODE_PAGE_SHIFT) - 1)) / size];
+}
 
-        if(u) {
-            gba_cpu_r[rn] += 0x40;
+// Blocks end after instructions that always leave the straight-line flow or
+// that may change the CPU state the block was decoded for. Conditional and
+// other jumps are detected when the block is executed.
+static inline bool gba_cpu_endsBlockArm(gba_cpu_opcodeHandlerArm_t *handler, uint32_t opcode) {
+    bool always = (opcode >> 28) == GBA_CPU_CONDITION_AL;
+
+    return handler == NULL
+        || handler == gba_cpu_arm_swi
+        || handler == gba_cpu_arm_psrTransfer
+        || (always && (handler == gba_cpu_arm_b || handler == gba_cpu_arm_bx));
+}
+
+static inline bool gba_cpu_endsBlockThumb(gba_cpu_opcodeHandlerThumb_t *handler, uint16_t opcode) {
+    return handler == NULL
+        || handler == gba_cpu_thumb_swi
+        || handler == gba_cpu_thumb_bx
+        || handler == gba_cpu_thumb_b2
+        || (handler == gba_cpu_thumb_bl && (opcode & (1 << 11)))
+        || (handler == gba_cpu_thumb_pushPop && (opcode & 0x0900) == 0x0900);
+}
+
+// Blocks also end at a branch back to their first instruction, so that the
+// body of a loop is always a whole block.
+static inline bool gba_cpu_isLoopBranch(gba_cpu_block_t *block, uint32_t address, uint32_t opcode) {
+    uint32_t target;
+
+    if(block->thumb) {
+        if((opcode & 0xf000) == 0xd000 && (opcode & 0x0f00) < 0x0e00) {
+            target = address + 4 + ((int8_t)opcode << 1);
+        } else if((opcode & 0xf800) == 0xe000) {
+            uint32_t immediate = opcode & 0x07ff;
+
+            if(opcode & (1 << 10)) {
+                immediate |= 0xfffff800;
+            }
+
+            target = address + 4 + (immediate << 1);
         } else {
-            gba_cpu_r[rn] -= 0x40;
+            return false;
         }
     } else {
-        if(l) { // LDM
-            if(w) {
-                if(u) {
-                    gba_cpu_r[rn] = rn_v + 4 * registerCount;
-                } else {
-                    gba_cpu_r[rn] = rn_v - 4 * registerCount;
-                }
+        if((opcode & 0x0f000000) == 0x0a000000 && (opcode >> 28) != GBA_CPU_CONDITION_NV) {
+            uint32_t offset = (opcode & 0x00ffffff) << 2;
+
+            if(offset & (1 << 25)) {
+                offset |= 0xfc000000;
             }
 
-            for(int i = 0; i < 16; i++) {
-                if(opcode & (1 << i)) {
-                    if(s) {
-                        bool r15 = i == 15;
-                        bool notUserMode = gba_cpu_mode != GBA_CPU_MODE_USR && gba_cpu_mode != GBA_CPU_MODE_USR_OLD && gba_cpu_mode != GBA_CPU_MODE_SYS;
-                        bool registerBanked = ((gba_cpu_mode == GBA_CPU_MODE_FIQ || gba_cpu_mode == GBA_CPU_MODE_FIQ_OLD) && (i >= 8)) || (i == 13) || (i == 14);
+            target = address + 8 + offset;
+        } else {
+            return false;
+        }
+    }
 
-                        if(r15) {
-                            gba_cpu_setCpsr(gba_cpu_getSpsr());
-                            gba_cpu_performJump(gba_bus_read32(addr));
-                        } else if(notUserMode && registerBanked) {
-                            gba_cpu_r_usr[i - 8] = gba_bus_read32(addr);
-                        } else {
-                            gba_cpu_r[i] = gba_bus_read32(addr);
-                        }
-                    } else {
-                        gba_cpu_writeRegister(i, gba_bus_read32(addr));
-                    }
+    return target == block->address;
+}
 
-                    addr += 4;
-                }
-            }
-        } else { // STM
-            bool firstCycle = true;
-            bool secondCycle = false;
+// A loop is idle when it only loads from memory and computes on registers
+// it wrote itself earlier in the same iteration. Going around it again
+// without memory changing in between then has no effect, so it can be
+// skipped until the next event.
+static inline bool gba_cpu_isIdleLoop(gba_cpu_block_t *block) {
+    uint32_t size = block->thumb ? 2 : 4;
+    int last = block->length - 1;
 
-            for(int i = 0; i < 16; i++) {
-                if(rlist & (1 << i)) {
-                    if(firstCycle) {
-                        firstCycle = false;
-                        secondCycle = true;
-                    } else if(secondCycle) {
-                        if(w) {
-                            if(u) {
-                                gba_cpu_r[rn] = rn_v + registerCount * 4;
-                            } else {
-                                gba_cpu_r[rn] = rn_v - registerCount * 4;
-                            }
-                        }
+    if(!gba_cpu_isLoopBranch(block, block->address + last * size, block->instructions[last].opcode)) {
+        return false;
+    }
 
-                        secondCycle = false;
-                    }
+    for(int i = 0; i < gba_cpu_idleLoopCount; i++) {
+        if(gba_cpu_idleLoops[i] == block->address) {
+            return true;
+        }
+    }
 
-                    if(s) {
-                        bool notUserMode = gba_cpu_mode != GBA_CPU_MODE_USR && gba_cpu_mode != GBA_CPU_MODE_USR_OLD && gba_cpu_mode != GBA_CPU_MODE_SYS;
-                        bool registerBanked = ((gba_cpu_mode == GBA_CPU_MODE_FIQ || gba_cpu_mode == GBA_CPU_MODE_FIQ_OLD) && (i >= 8)) || (i == 13) || (i == 14);
+    uint16_t written = 0;
+    uint16_t reads[GBA_CPU_BLOCK_MAX_LENGTH];
+    uint16_t writes[GBA_CPU_BLOCK_MAX_LENGTH];
 
-                        if(notUserMode && registerBanked) {
-                            gba_bus_write32(addr, gba_cpu_r_usr[i - 8]);
-                        } else {
-                            gba_bus_write32(addr, gba_cpu_r[i]);
-                        }
-                    } else {
-                        if(i == 15 && !secondCycle) {
-                            gba_bus_write32(addr, gba_cpu_r[15] + 4);
-                        } else {
-                            gba_bus_write32(addr, gba_cpu_r[i]);
-                        }
-                    }
+    for(int i = 0; i < last; i++) {
+        gba_cpu_blockInstruction_t *instruction = &block->instructions[i];
+        bool allowed;
 
-                    addr += 4;
-                }
-            }
+        if(block->thumb) {
+            allowed = gba_cpu_getIdleRegistersThumb(instruction->handler.thumb, instruction->opcode, &reads[i], &writes[i]);
+        } else {
+            allowed = gba_cpu_getIdleRegistersArm(instruction->handler.arm, instruction->opcode, &reads[i], &writes[i]);
+        }
 
-            if(w && secondCycle) {
-                if(u) {
-                    gba_cpu_r[rn] = rn_v + 4;
-                } else {
-                    gba_cpu_r[rn] = rn_v - 4;
-                }
-            }
+        if(!allowed || (writes[i] & (1 << 15))) {
+            return false;
         }
+
+        written |= writes[i];
     }
-}
 
-static inline void gba_cpu_arm_swp(uint32_t opcode) {
-    bool b = (opcode & (1 << 22)) != 0;
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    uint32_t rm = opcode & 0x0000000f;
+    // Registers carried over from the previous iteration must not change.
+    uint16_t defined = 0;
 
-    uint32_t rn_v = gba_cpu_r[rn];
+    for(int i = 0; i < last; i++) {
+        if(reads[i] & written & ~defined) {
+            return false;
+        }
 
-    if(b) {
-        uint8_t tmp = gba_bus_read8(rn_v);
-        gba_bus_write8(rn_v, gba_cpu_r[rm]);
-        gba_cpu_r[rd] = tmp;
-    } else {
-        uint32_t tmp = gba_cpu_util_ror32(gba_bus_read32(rn_v), (rn_v & 3) << 3);
-        gba_bus_write32(rn_v, gba_cpu_r[rm]);
-        gba_cpu_r[rd] = tmp;
+        defined |= writes[i];
     }
+
+    return true;
 }
 
-static inline void gba_cpu_arm_mul(uint32_t opcode) {
-    bool a = (opcode & (1 << 21)) != 0;
-    bool s = (opcode & (1 << 20)) != 0;
-    uint32_t rd = (opcode & 0x000f0000) >> 16;
+static inline bool gba_cpu_getIdleRegistersArm(gba_cpu_opcodeHandlerArm_t *handler, uint32_t opcode, uint16_t *reads, uint16_t *writes) {
+    uint32_t rn = (opcode & 0x000f0000) >> 16;
+    uint32_t rd = (opcode & 0x0000f000) >> 12;
     uint32_t rs = (opcode & 0x00000f00) >> 8;
     uint32_t rm = opcode & 0x0000000f;
 
-    uint32_t result = gba_cpu_r[rm] * gba_cpu_r[rs];
+    // Conditional instructions and RRX read flags from the previous
+    // iteration.
+    bool rrx = (opcode & 0x00000ff0) == 0x00000060;
 
-    if(a) {
-        uint32_t rn = (opcode & 0x0000f000) >> 12;
-        result += gba_cpu_r[rn];
+    if((opcode >> 28) != GBA_CPU_CONDITION_AL) {
+        return false;
     }
 
-    gba_cpu_r[rd] = result;
+    *reads = 1 << rn;
+    *writes = 1 << rd;
 
-    if(s) {
-        gba_cpu_setFlags_logical(result);
-    }
-}
+    if(handler == gba_cpu_arm_singleDataTransfer) {
+        // Loads without writeback
+        if((opcode & 0x01300000) != 0x01100000) {
+            return false;
+        }
 
-static inline void gba_cpu_arm_mull(uint32_t opcode) {
-    bool u = (opcode & (1 << 22)) != 0;
-    bool a = (opcode & (1 << 21)) != 0;
-    bool s = (opcode & (1 << 20)) != 0;
-    uint32_t rdhi = (opcode & 0x000f0000) >> 16;
-    uint32_t rdlo = (opcode & 0x0000f000) >> 12;
-    uint32_t rs = (opcode & 0x00000f00) >> 8;
-    uint32_t rm = opcode & 0x0000000f;
-
-    uint64_t result;
+        if(opcode & (1 << 25)) {
+            *reads |= 1 << rm;
+            return !rrx;
+        }
 
-    if(u) {
-        int64_t rm_v = (int32_t)gba_cpu_r[rm];
-        int64_t rs_v = (int32_t)gba_cpu_r[rs];
+        return true;
+    } else if(handler == gba_cpu_arm_halfwordSignedDataTransfer) {
+        if((opcode & 0x01300000) != 0x01100000) {
+            return false;
+        }
 
-        result = rm_v * rs_v;
-    } else {
-        uint64_t rm_v = gba_cpu_r[rm];
-        uint64_t rs_v = gba_cpu_r[rs];
+        if(!(opcode & (1 << 22))) {
+            *reads |= 1 << rm;
+        }
 
-        result = rm_v * rs_v;
-    }
+        return true;
+    } else if(
+        handler != NULL
+        && (opcode & 0x0c000000) == 0x00000000
+        && handler != gba_cpu_arm_swp
+        && handler != gba_cpu_arm_mul
+        && handler != gba_cpu_arm_mull
+        && handler != gba_cpu_arm_bx
+        && handler != gba_cpu_arm_psrTransfer
+    ) {
+        int operation = (opcode & 0x01e00000) >> 21;
+
+        // ADC, SBC and RSC read the carry flag.
+        if(operation >= 0x5 && operation <= 0x7) {
+            return false;
+        }
 
-    if(a) {
-        result += ((uint64_t)gba_cpu_r[rdhi] << 32) | gba_cpu_r[rdlo];
-    }
+        if(operation == 0xd || operation == 0xf) {
+            *reads = 0;
+        }
 
-    gba_cpu_r[rdhi] = result >> 32;
-    gba_cpu_r[rdlo] = result;
+        if(operation >= 0x8 && operation <= 0xb) {
+            *writes = 0;
+        }
 
-    if(s) {
-        gba_cpu_flagZ = result == 0;
-        gba_cpu_flagN = result >> 63;
-    }
-}
+        if(!(opcode & (1 << 25))) {
+            *reads |= 1 << rm;
 
-static inline void gba_cpu_arm_bx(uint32_t opcode) {
-    if((opcode & 0x0ffffff0) != 0x012fff10) {
-        gba_cpu_raiseUnd();
-    } else {
-        uint32_t dest = gba_cpu_r[opcode & 0x0000000f];
+            if(opcode & (1 << 4)) {
+                *reads |= 1 << rs;
+            } else if(rrx) {
+                return false;
+            }
+        }
 
-        gba_cpu_flagT = dest & (1 << 0);
-        gba_cpu_performJump(dest);
+        return true;
     }
-}
-
-static inline void gba_cpu_arm_swi(uint32_t opcode) {
-    UNUSED(opcode);
 
-    gba_cpu_raiseSwi();
+    return false;
 }
 
-static inline void gba_cpu_arm_singleDataTransfer(uint32_t opcode) {
-    bool i = (opcode & (1 << 25)) != 0;
-    bool p = (opcode & (1 << 24)) != 0;
-    bool u = (opcode & (1 << 23)) != 0;
-    bool b = (opcode & (1 << 22)) != 0;
-    bool w = (opcode & (1 << 21)) != 0;
-    bool l = (opcode & (1 << 20)) != 0;
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    uint32_t rn_v = gba_cpu_r[rn];
-    uint32_t rd_v = gba_cpu_r[rd];
-
-    if((!l) && (rd == 15)) {
-        rd_v += 4;
-    }
-
-    if(i) {
-        gba_cpu_arm_shift(opcode ^ 0x02000000);
-    } else {
-        gba_cpu_shifterResult = opcode & 0x00000fff;
-    }
-
-    uint32_t offset = rn_v;
+static inline bool gba_cpu_getIdleRegistersThumb(gba_cpu_opcodeHandlerThumb_t *handler, uint16_t opcode, uint16_t *reads, uint16_t *writes) {
+    uint16_t low = opcode & 0x0007;
+    uint16_t middle = (opcode & 0x0038) >> 3;
+    uint16_t high = (opcode & 0x01c0) >> 6;
+    uint16_t upper = (opcode & 0x0700) >> 8;
+    bool l = (opcode & (1 << 11)) != 0;
 
-    if(p) {
-        if(u) {
-            offset += gba_cpu_shifterResult;
-        } else {
-            offset -= gba_cpu_shifterResult;
+    *reads = 0;
+    *writes = 0;
+
+    if(handler == gba_cpu_thumb_ldrStr2 || handler == gba_cpu_thumb_ldrStrh2) {
+        *reads = 1 << middle;
+        *writes = 1 << low;
+        return l;
+    } else if(handler == gba_cpu_thumb_ldrStr) {
+        *reads = (1 << middle) | (1 << high);
+        *writes = 1 << low;
+        return l;
+    } else if(handler == gba_cpu_thumb_ldrStrh) {
+        *reads = (1 << middle) | (1 << high);
+        *writes = 1 << low;
+        return (opcode & 0x0c00) != 0;
+    } else if(handler == gba_cpu_thumb_ldrStr3) {
+        *reads = 1 << 13;
+        *writes = 1 << upper;
+        return l;
+    } else if(handler == gba_cpu_thumb_ldr || handler == gba_cpu_thumb_mov) {
+        *writes = 1 << upper;
+        return true;
+    } else if(handler == gba_cpu_thumb_cmp) {
+        *reads = 1 << upper;
+        return true;
+    } else if(handler == gba_cpu_thumb_add2 || handler == gba_cpu_thumb_sub2) {
+        *reads = 1 << upper;
+        *writes = 1 << upper;
+        return true;
+    } else if(handler == gba_cpu_thumb_add || handler == gba_cpu_thumb_sub) {
+        *reads = (1 << middle) | ((opcode & (1 << 10)) ? 0 : 1 << high);
+        *writes = 1 << low;
+        return true;
+    } else if(
+        handler == gba_cpu_thumb_lsl
+        || handler == gba_cpu_thumb_lsr
+        || handler == gba_cpu_thumb_asr
+        || handler == gba_cpu_thumb_mvn
+        || handler == gba_cpu_thumb_neg
+    ) {
+        *reads = 1 << middle;
+        *writes = 1 << low;
+        return true;
+    } else if(
+        handler == gba_cpu_thumb_and
+        || handler == gba_cpu_thumb_eor
+        || handler == gba_cpu_thumb_lsl2
+        || handler == gba_cpu_thumb_lsr2
+        || handler == gba_cpu_thumb_asr2
+        || handler == gba_cpu_thumb_ror
+        || handler == gba_cpu_thumb_orr
+        || handler == gba_cpu_thumb_mul
+        || handler == gba_cpu_thumb_bic
+    ) {
+        *reads = (1 << middle) | (1 << low);
+        *writes = 1 << low;
+        return true;
+    } else if(handler == gba_cpu_thumb_tst || handler == gba_cpu_thumb_cmp2 || handler == gba_cpu_thumb_cmn) {
+        *reads = (1 << middle) | (1 << low);
+        return true;
+    } else if(handler == gba_cpu_thumb_cmp3 || handler == gba_cpu_thumb_add3 || handler == gba_cpu_thumb_mov2) {
+        uint16_t rd = low | ((opcode & (1 << 7)) >> 4);
+        uint16_t rs = middle | ((opcode & (1 << 6)) >> 3);
+
+        *reads = 1 << rs;
+
+        if(handler != gba_cpu_thumb_mov2) {
+            *reads |= 1 << rd;
         }
-    } else {
-        w = true;
-    }
 
-    if(w) {
-        if(u) {
-            if(p) {
-                gba_cpu_writeRegister(rn, offset);
-            } else {
-                gba_cpu_writeRegister(rn, offset + gba_cpu_shifterResult);
-            }
-        } else {
-            if(p) {
-                gba_cpu_writeRegister(rn, offset);
-            } else {
-                gba_cpu_writeRegister(rn, offset - gba_cpu_shifterResult);
-            }
+        if(handler != gba_cpu_thumb_cmp3) {
+            *writes = 1 << rd;
         }
-    }
 
-    if(l) {
-        if(b) {
-            gba_cpu_writeRegister(rd, gba_bus_read8(offset));
-        } else {
-            gba_cpu_writeRegister(rd, gba_cpu_util_ror32(gba_bus_read32(offset), (offset & 0x00000003) << 3));
-        }
-    } else {
-        if(b) {
-            gba_bus_write8(offset, rd_v);
-        } else {
-            gba_bus_write32(offset, rd_v);
-        }
+        return true;
     }
-}
 
-static inline void gba_cpu_arm_psrTransfer_msr(uint32_t opcode, bool spsr, uint32_t operand) {
-    uint32_t mask = 0;
+    return false;
+}
 
-    if(opcode & (1 << 19)) mask |= 0xff000000;
-    if(opcode & (1 << 18)) mask |= 0x00ff0000;
-    if(opcode & (1 << 17)) mask |= 0x0000ff00;
-    if(opcode & (1 << 16)) mask |= 0x000000ff;
+// Called before running a block. Skips to the next event when the block is
+// an idle loop that just went around once without reading registers whose
+// value changes on its own.
+static inline bool gba_cpu_skipIdleLoop(gba_cpu_block_t *block) {
+    if(!gba_cpu_idleLoopSkipping) {
+        return false;
+    }
 
-    uint32_t registerValue;
+    if(block->idleLoop && block == gba_cpu_idleBlock && !gba_io_volatileRead) {
+        gba_cpu_idleSkippedCycles += gba_scheduler_nextEventTimestamp - gba_scheduler_cycleCounter;
+        gba_scheduler_cycleCounter = gba_scheduler_nextEventTimestamp;
+        gba_cpu_idleBlock = NULL;
 
-    if(spsr) {
-        registerValue = gba_cpu_getSpsr();
-    } else {
-        registerValue = gba_cpu_getCpsr();
+        return true;
     }
 
-    registerValue &= ~mask;
-    registerValue |= operand & mask;
+    gba_cpu_idleBlock = block->idleLoop ? block : NULL;
+    gba_io_volatileRead = false;
 
-    if(spsr) {
-        gba_cpu_setSpsr(registerValue);
-    } else {
-        gba_cpu_setCpsr(registerValue);
-    }
+    return false;
 }
 
-static inline void gba_cpu_arm_psrTransfer(uint32_t opcode) {
-    bool msr = (opcode & (1 << 21)) != 0;
-    bool spsr = (opcode & (1 << 22)) != 0;
+// Marks the instructions of the block up to the one that jumped, or up to
+// the one it stopped before. A skipped idle loop ran before, and is marked
+// as a whole.
+static inline void gba_cpu_coverBlock(const gba_cpu_block_t *block) {
+    uint32_t size = block->thumb ? 2 : 4;
+    uint32_t end = block->address + block->length * size;
+    uint32_t stop;
 
-    if(msr) {
-        bool immediate = (opcode & (1 << 25)) != 0;
+    if(gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_EXECUTE) {
+        stop = gba_cpu_r[15] - 2 * size;
+    } else {
+        stop = gba_cpu_jumpSource - size;
+    }
 
-        if(immediate) {
-            uint32_t shift = (opcode & 0x00000f00) >> 8;
-            uint32_t imm = opcode & 0x000000ff;
+    if(stop > block->address && stop < end) {
+        end = stop;
+    }
 
-            uint32_t operand = gba_cpu_util_ror32(imm, shift << 1);
+    gba_coverage_mark(block->address, end);
+}
 
-            gba_cpu_arm_psrTransfer_msr(opcode, spsr, operand);
-        } else {
-            if((opcode & 0x00000ff0) != 0x00000000) {
-                gba_cpu_raiseUnd();
+#ifdef GBA_CPU_THREADED
+
+#define GBA_CPU_THREADED_ENTRY(name) {gba_cpu_##name, &&gba_cpu_threaded_##name},
+#define GBA_CPU_THREADED_ENTRY_DP(op, s, name, ...) GBA_CPU_THREADED_ENTRY(arm_dp_##op##_##s##_##name)
+
+// Every handler ends with its own copy of the dispatch code, so that each
+// indirect jump gets its own branch predictor history.
+#define GBA_CPU_THREADED_DISPATCH() \
+    gba_scheduler_cycleCounter += cycles; \
+    \
+    if(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE) { \
+        return; \
+    } \
+    \
+    gba_cpu_r[15] += size; \
+    \
+    if(gba_cpu_blockInvalidated || gba_scheduler_cycleCounter >= gba_scheduler_nextEventTimestamp || instruction == last) { \
+        return; \
+    } \
+    \
+    instruction++; \
+    goto *instruction->label;
+
+#define GBA_CPU_THREADED_HANDLER_ARM(name) \
+    gba_cpu_threaded_##name: \
+        if(gba_cpu_checkCondition(instruction->opcode >> 28)) { \
+            GBA_CPU_PROFILE_ARM(instruction->opcode, gba_cpu_##name(instruction->opcode)); \
+        } \
+        \
+        GBA_CPU_THREADED_DISPATCH()
+
+#define GBA_CPU_THREADED_HANDLER_ARM_DP(op, s, name, ...) GBA_CPU_THREADED_HANDLER_ARM(arm_dp_##op##_##s##_##name)
+
+#define GBA_CPU_THREADED_LABEL_FUSED(name) &&gba_cpu_threaded_##name,
+
+// The fused handler completes the first instruction itself, and the
+// dispatch code the second one.
+#define GBA_CPU_THREADED_HANDLER_FUSED(name) \
+    gba_cpu_threaded_##name: \
+        if(!gba_cpu_##name(instruction->record, instruction[1].record, cycles)) { \
+            return; \
+        } \
+        \
+        instruction++; \
+        GBA_CPU_THREADED_DISPATCH()
+
+#define GBA_CPU_THREADED_HANDLER_THUMB(name) \
+    gba_cpu_threaded_##name: \
+        GBA_CPU_PROFILE_THUMB(instruction->opcode, gba_cpu_##name(instruction->record)); \
+        GBA_CPU_THREADED_DISPATCH()
+
+// Labels as values are a GNU extension.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// Runs the instructions of a block by jumping from one handler label to the
+// next. When called without a block, fills the label tables instead.
+static inline void gba_cpu_executeBlock(gba_cpu_block_t *block) {
+    static const struct {
+        gba_cpu_opcodeHandlerArm_t *handler;
+        const void *label;
+    } labelsArm[] = {
+        GBA_CPU_HANDLERS_ARM(GBA_CPU_THREADED_ENTRY)
+    };
+
+    static const struct {
+        gba_cpu_opcodeHandlerThumb_t *handler;
+        const void *label;
+    } labelsThumb[] = {
+        GBA_CPU_HANDLERS_THUMB(GBA_CPU_THREADED_ENTRY)
+    };
+
+    static const void *const labelsFused[] = {
+        &&gba_cpu_threaded_undefined,
+        GBA_CPU_FUSED_HANDLERS(GBA_CPU_THREADED_LABEL_FUSED)
+    };
+
+    if(block == NULL) {
+        for(int i = 0; i < 4096; i++) {
+            gba_cpu_threadedLabels_arm[i] = &&gba_cpu_threaded_undefined;
+
+            for(size_t j = 0; j < sizeof(labelsArm) / sizeof(labelsArm[0]); j++) {
+                if(gba_cpu_decodeTable_arm[i] == labelsArm[j].handler) {
+                    gba_cpu_threadedLabels_arm[i] = labelsArm[j].label;
+                }
             }
+        }
 
-            uint32_t rm = opcode & 0x0000000f;
+        for(int i = 0; i < 1024; i++) {
+            gba_cpu_threadedLabels_thumb[i] = &&gba_cpu_threaded_undefined;
 
-            gba_cpu_arm_psrTransfer_msr(opcode, spsr, gba_cpu_r[rm]);
-        }
-    } else {
-        if((opcode & 0x000f0fff) != 0x000f0000) {
-            gba_cpu_raiseUnd();
+            for(size_t j = 0; j < sizeof(labelsThumb) / sizeof(labelsThumb[0]); j++) {
+                if(gba_cpu_decodeTable_thumb[i] == labelsThumb[j].handler) {
+                    gba_cpu_threadedLabels_thumb[i] = labelsThumb[j].label;
+                }
+            }
         }
 
-        uint32_t rd = (opcode & 0x0000f000) >> 12;
-
-        if(spsr) {
-            gba_cpu_r[rd] = gba_cpu_getSpsr();
-        } else {
-            gba_cpu_r[rd] = gba_cpu_getCpsr();
+        for(size_t i = 0; i < GBA_CPU_FUSED_HANDLER_COUNT; i++) {
+            gba_cpu_threadedLabels_fused[i] = labelsFused[i];
         }
+
+        return;
     }
-}
 
-static inline void gba_cpu_arm_and(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+    uint32_t size = block->thumb ? 2 : 4;
+    uint32_t cycles = gba_cpu_getFetchCycles(block->address, block->thumb);
+    gba_cpu_blockInstruction_t *instruction = block->instructions;
+    gba_cpu_blockInstruction_t *last = &block->instructions[block->length - 1];
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+    gba_cpu_blockInvalidated = false;
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+    if(block->aotFunction) {
+        // Like translated code, compiled blocks use the flag variables.
+        gba_cpu_materializeFlags();
+        block->aotFunction(cycles);
+        return;
     }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+    goto *instruction->label;
 
-    uint32_t result = rn_v & gba_cpu_shifterResult;
-
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_setFlags_logical(result);
-        }
-    }
+    GBA_CPU_HANDLERS_ARM(GBA_CPU_THREADED_HANDLER_ARM)
+    GBA_CPU_HANDLERS_THUMB(GBA_CPU_THREADED_HANDLER_THUMB)
+    GBA_CPU_FUSED_HANDLERS(GBA_CPU_THREADED_HANDLER_FUSED)
 
-    gba_cpu_writeRegister(rd, result);
+gba_cpu_threaded_undefined:
+    gba_cpu_raiseUnd();
+    GBA_CPU_THREADED_DISPATCH()
 }
 
-static inline void gba_cpu_arm_eor(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+#pragma GCC diagnostic pop
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+#else
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+static inline void gba_cpu_executeBlock(gba_cpu_block_t *block) {
+    uint32_t size = block->thumb ? 2 : 4;
+    uint32_t cycles = gba_cpu_getFetchCycles(block->address, block->thumb);
+
+    gba_cpu_blockInvalidated = false;
+
+    if(block->aotFunction) {
+        // Like translated code, compiled blocks use the flag variables.
+        gba_cpu_materializeFlags();
+        block->aotFunction(cycles);
+        return;
     }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+    for(int i = 0; i < block->length; i++) {
+        gba_cpu_blockInstruction_t *instruction = &block->instructions[i];
 
-    uint32_t result = rn_v ^ gba_cpu_shifterResult;
+        if(block->thumb) {
+            if(instruction->fused) {
+                // The fused handler completes the first instruction itself.
+                if(!gba_cpu_fusedHandlers[instruction->fused](instruction->record, instruction[1].record, cycles)) {
+                    return;
+                }
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+                instruction = &block->instructions[++i];
+            } else if(instruction->handler.thumb) {
+                GBA_CPU_PROFILE_THUMB(instruction->opcode, instruction->handler.thumb(instruction->record));
+            } else {
+                gba_cpu_raiseUnd();
+            }
         } else {
-            gba_cpu_setFlags_logical(result);
+            if(instruction->handler.arm) {
+                if(gba_cpu_checkCondition(instruction->opcode >> 28)) {
+                    GBA_CPU_PROFILE_ARM(instruction->opcode, instruction->handler.arm(instruction->opcode));
+                }
+            } else {
+                gba_cpu_raiseUnd();
+            }
         }
-    }
 
-    gba_cpu_writeRegister(rd, result);
-}
-
-static inline void gba_cpu_arm_sub(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
-
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+        gba_scheduler_cycleCounter += cycles;
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
+        // A jump leaves the pipeline flushed and ends the block.
+        if(gba_cpu_pipelineState != GBA_CPU_PIPELINESTATE_EXECUTE) {
+            return;
         }
-    }
-
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
 
-    uint32_t result = rn_v - gba_cpu_shifterResult;
+        gba_cpu_r[15] += size;
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_flagC = gba_cpu_getCarry_sub(rn_v, gba_cpu_shifterResult);
-            gba_cpu_flagV = gba_cpu_getOverflow_sub(rn_v, gba_cpu_shifterResult, result);
-            gba_cpu_setFlags_arithmetical(result);
+        if(gba_cpu_blockInvalidated || gba_scheduler_cycleCounter >= gba_scheduler_nextEventTimestamp) {
+            return;
         }
     }
-
-    gba_cpu_writeRegister(rd, result);
 }
 
-static inline void gba_cpu_arm_rsb(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+#endif
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+static inline uint32_t gba_cpu_getCpsr() {
+    gba_cpu_materializeFlags();
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
-    }
+    return 0
+        | (gba_cpu_flagN ? 1 << 31 : 0)
+        | (gba_cpu_flagZ ? 1 << 30 : 0)
+        | (gba_cpu_flagC ? 1 << 29 : 0)
+        | (gba_cpu_flagV ? 1 << 28 : 0)
+        | (gba_cpu_flagI ? 1 << 7 : 0)
+        | (gba_cpu_flagF ? 1 << 6 : 0)
+        | (gba_cpu_flagT ? 1 << 5 : 0)
+        | gba_cpu_mode;
+}
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+static inline void gba_cpu_setCpsr(uint32_t value) {
+    gba_cpu_flagN = (value & (1 << 31)) != 0;
+    gba_cpu_flagZ = (value & (1 << 30)) != 0;
+    gba_cpu_flagC = (value & (1 << 29)) != 0;
+    gba_cpu_flagV = (value & (1 << 28)) != 0;
+    gba_cpu_lazyNZ = false;
+    gba_cpu_lazyCV = GBA_CPU_LAZYFLAGS_NONE;
+    gba_cpu_flagI = (value & (1 << 7)) != 0;
+    gba_cpu_flagF = (value & (1 << 6)) != 0;
+    gba_cpu_flagT = (value & (1 << 5)) != 0;
 
-    uint32_t result = gba_cpu_shifterResult - rn_v;
+    gba_cpu_changeMode(value & 0x1f);
+}
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_flagC = gba_cpu_getCarry_sub(gba_cpu_shifterResult, rn_v);
-            gba_cpu_flagV = gba_cpu_getOverflow_sub(gba_cpu_shifterResult, rn_v, result);
-            gba_cpu_setFlags_arithmetical(result);
-        }
+static inline uint32_t gba_cpu_getSpsr() {
+    if(gba_cpu_spsr) {
+        return *gba_cpu_spsr;
+    } else {
+        return gba_cpu_getCpsr();
     }
+}
 
-    gba_cpu_writeRegister(rd, result);
+static inline void gba_cpu_setSpsr(uint32_t value) {
+    if(gba_cpu_spsr) {
+        *gba_cpu_spsr = value;
+    } else {
+        gba_cpu_setCpsr(value);
+    }
 }
 
-static inline void gba_cpu_arm_add(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+static inline void gba_cpu_changeMode(gba_cpu_mode_t newMode) {
+    gba_cpu_bank_t *oldBank = gba_cpu_bank;
+    gba_cpu_bank_t *newBank = &gba_cpu_banks[gba_cpu_modeBank[newMode]];
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+    if(newBank != oldBank) {
+        gba_cpu_bank_t *fiqBank = &gba_cpu_banks[GBA_CPU_BANK_FIQ];
+        gba_cpu_bank_t *usrBank = &gba_cpu_banks[GBA_CPU_BANK_USR];
+
+        if(oldBank == fiqBank || newBank == fiqBank) {
+            gba_cpu_bank_t *saveBank = oldBank == fiqBank ? fiqBank : usrBank;
+            gba_cpu_bank_t *loadBank = newBank == fiqBank ? fiqBank : usrBank;
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
+            for(int i = 0; i < 5; i++) {
+                saveBank->r[i] = gba_cpu_r[8 + i];
+                gba_cpu_r[8 + i] = loadBank->r[i];
+            }
         }
-    }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+        oldBank->r[5] = gba_cpu_r[13];
+        oldBank->r[6] = gba_cpu_r[14];
+        gba_cpu_r[13] = newBank->r[5];
+        gba_cpu_r[14] = newBank->r[6];
 
-    uint32_t result = rn_v + gba_cpu_shifterResult;
+        gba_cpu_bank = newBank;
+        gba_cpu_spsr = newBank == usrBank ? NULL : &newBank->spsr;
+    }
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+    gba_cpu_mode = newMode;
+}
+
+static inline bool gba_cpu_checkCondition(gba_cpu_condition_t condition) {
+    if(condition == GBA_CPU_CONDITION_AL) {
+        return true;
+    }
+
+    gba_cpu_materializeFlags();
+
+    switch(condition) {
+        case GBA_CPU_CONDITION_EQ: return gba_cpu_flagZ;
+        case GBA_CPU_CONDITION_NE: return !gba_cpu_flagZ;
+        case GBA_CPU_CONDITION_CS: return gba_cpu_flagC;
+        case GBA_CPU_CONDITION_CC: return !gba_cpu_flagC;
+        case GBA_CPU_CONDITION_MI: return gba_cpu_flagN;
+        case GBA_CPU_CONDITION_PL: return !gba_cpu_flagN;
+        case GBA_CPU_CONDITION_VS: return gba_cpu_flagV;
+        case GBA_CPU_CONDITION_VC: return !gba_cpu_flagV;
+        case GBA_CPU_CONDITION_HI: return gba_cpu_flagC && !gba_cpu_flagZ;
+        case GBA_CPU_CONDITION_LS: return (!gba_cpu_flagC) || gba_cpu_flagZ;
+        case GBA_CPU_CONDITION_GE: return gba_cpu_flagN == gba_cpu_flagV;
+        case GBA_CPU_CONDITION_LT: return gba_cpu_flagN != gba_cpu_flagV;
+        case GBA_CPU_CONDITION_GT: return (!gba_cpu_flagZ) && (gba_cpu_flagN == gba_cpu_flagV);
+        case GBA_CPU_CONDITION_LE: return gba_cpu_flagZ || (gba_cpu_flagN != gba_cpu_flagV);
+        case GBA_CPU_CONDITION_AL: return true;
+        default: return false;
+    }
+}
+
+static inline void gba_cpu_performJump(uint32_t address) {
+    address -= gba_cpu_flagT ? 2 : 4;
+    address &= gba_cpu_flagT ? 0xfffffffe : 0xfffffffc;
+
+    gba_cpu_jumpSource = gba_cpu_r[15];
+    gba_cpu_r[15] = address;
+    gba_cpu_pipelineState = GBA_CPU_PIPELINESTATE_FLUSH;
+}
+
+static inline void gba_cpu_raiseIrq() {
+    uint32_t cpsr = gba_cpu_getCpsr();
+
+    gba_cpu_changeMode(GBA_CPU_MODE_IRQ);
+    *gba_cpu_spsr = cpsr;
+    gba_cpu_r[14] = gba_cpu_r[15] - (gba_cpu_flagT ? 0 : 4);
+    gba_cpu_flagT = false;
+    gba_cpu_flagI = true;
+    gba_cpu_performJump(0x00000018);
+}
+
+static inline void gba_cpu_raiseSwi() {
+    uint32_t cpsr = gba_cpu_getCpsr();
+
+    gba_cpu_changeMode(GBA_CPU_MODE_SVC);
+    *gba_cpu_spsr = cpsr;
+    gba_cpu_r[14] = gba_cpu_r[15] - (gba_cpu_flagT ? 2 : 4);
+    gba_cpu_flagT = false;
+    gba_cpu_flagI = true;
+    gba_cpu_performJump(0x00000008);
+}
+
+// Services the SWI natively when running without a BIOS image. A waiting SWI
+// halts the CPU and is executed again once an interrupt wakes it up.
+static inline void gba_cpu_callSwi(uint8_t number) {
+    if(gba_hle_enabled) {
+        switch(gba_hle_swi(number)) {
+            case GBA_HLE_RESULT_DONE:
+            return;
+
+            case GBA_HLE_RESULT_WAIT:
+            gba_cpu_performJump(gba_cpu_r[15] - (gba_cpu_flagT ? 4 : 8));
+            gba_cpu_halt(false);
+            return;
+
+            default:
+            break;
+        }
+    }
+
+    gba_cpu_raiseSwi();
+}
+
+static inline void gba_cpu_raiseUnd() {
+    uint32_t cpsr = gba_cpu_getCpsr();
+
+    gba_cpu_changeMode(GBA_CPU_MODE_UND);
+    *gba_cpu_spsr = cpsr;
+    gba_cpu_r[14] = gba_cpu_r[15] - (gba_cpu_flagT ? 2 : 4);
+    gba_cpu_flagT = false;
+    gba_cpu_flagI = true;
+    gba_cpu_performJump(0x00000004);
+}
+
+static inline void gba_cpu_execute() {
+    if(gba_cpu_pipelineState == GBA_CPU_PIPELINESTATE_EXECUTE) {
+        // Check for interrupts
+        if(gba_cpu_isIrqPending()) {
+            gba_cpu_raiseIrq();
+        } else {
+            bool thumb = gba_cpu_flagT;
+            uint32_t address = gba_cpu_r[15] - (thumb ? 4 : 8);
+
+            if(gba_coverage_enabled) {
+                gba_coverage_mark(address, address + (thumb ? 2 : 4));
+            }
+
+            if(gba_cpu_flagT) {
+                if(gba_cpu_decodedOpcodeThumbHandler) {
+                    GBA_CPU_PROFILE_THUMB(gba_cpu_decodedOpcodeThumbRecord->opcode, gba_cpu_decodedOpcodeThumbHandler(gba_cpu_decodedOpcodeThumbRecord));
+                } else {
+                    gba_cpu_raiseUnd();
+                }
+            } else {
+                if(gba_cpu_decodedOpcodeArmHandler) {
+                    if(gba_cpu_checkCondition(gba_cpu_decodedOpcodeArmValue >> 28)) {
+                        GBA_CPU_PROFILE_ARM(gba_cpu_decodedOpcodeArmValue, gba_cpu_decodedOpcodeArmHandler(gba_cpu_decodedOpcodeArmValue));
+                    }
+                } else {
+                    gba_cpu_raiseUnd();
+                }
+            }
+
+            if(gba_trace_active) {
+                gba_trace_record(
+                    address,
+                    thumb ? gba_cpu_decodedOpcodeThumbRecord->opcode : gba_cpu_decodedOpcodeArmValue,
+                    thumb,
+                    gba_cpu_getCpsr(),
+                    gba_cpu_r
+                );
+            }
+        }
+    }
+}
+
+static inline void gba_cpu_decode() {
+    if(gba_cpu_pipelineState >= GBA_CPU_PIPELINESTATE_DECODE) {
+        if(gba_cpu_flagT) {
+            gba_cpu_decodedOpcodeThumbRecord = &gba_cpu_thumbRecords[gba_cpu_fetchedOpcodeThumb];
+            gba_cpu_decodedOpcodeThumbHandler = gba_cpu_handlers_thumb[gba_cpu_decodedOpcodeThumbRecord->handler];
+        } else {
+            gba_cpu_decodedOpcodeArmValue = gba_cpu_fetchedOpcodeArm;
+            gba_cpu_decodedOpcodeArmHandler = gba_cpu_decodeTable_arm[((gba_cpu_fetchedOpcodeArm >> 16) & 0xff0) | ((gba_cpu_fetchedOpcodeArm >> 4) & 0x0f)];
+        }
+    }
+}
+
+static inline void gba_cpu_fetch(uint32_t fetchAddress) {
+    if(gba_cpu_flagT) {
+        gba_cpu_fetchedOpcodeThumb = gba_bus_peek16(fetchAddress);
+        gba_cpu_r[15] += 2;
+    } else {
+        gba_cpu_fetchedOpcodeArm = gba_bus_peek32(fetchAddress);
+        gba_cpu_r[15] += 4;
+    }
+}
+
+static inline void gba_cpu_initDecodeThumb() {
+    for(int i = 0; i < 1024; i++) {
+        uint16_t opcode = i << 6;
+
+        gba_cpu_decodeTable_thumb[i] = NULL;
+
+        switch((opcode & 0xe000) >> 13) {
+            case 0:
+            if((opcode & 0x1800) == 0x1800) {
+                gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_ADDSUB;
+
+                if(opcode & (1 << 9)) {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_sub;
+                } else {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add;
+                }
+            } else {
+                gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_MOVESHIFTED;
+
+                switch((opcode & 0x1800) >> 11) {
+                    case 0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsl; break;
+                    case 1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsr; break;
+                    case 2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_asr; break;
+                }
+            }
+
+            break;
+
+            case 1:
+            gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_IMMEDIATE;
+
+            switch((opcode & 0x1800) >> 11) {
+                case 0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mov; break;
+                case 1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmp; break;
+                case 2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add2; break;
+                case 3: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_sub2; break;
+            }
+
+            break;
+
+            case 2:
+            if(opcode & (1 << 12)) {
+                if(opcode & (1 << 9)) {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStrh;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_SIGNEDTRANSFER;
+                } else {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStr;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_REGISTEROFFSET;
+                }
+            } else {
+                if(opcode & (1 << 11)) {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldr;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_PCLOAD;
+                } else {
+                    if(opcode & (1 << 10)) {
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_HIREGISTER;
+
+                        if((opcode & 0x0380) == 0x0300) {
+                            gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_bx;
+                        } else if((opcode & 0x0300) != 0x0300) {
+                            if((opcode & 0x00c0) != 0x0000) {
+                                switch((opcode & 0x0300) >> 8) {
+                                    case 0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add3; break;
+                                    case 1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmp3; break;
+                                    case 2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mov2; break;
+                                }
+                            }
+                        }
+                    } else {
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_ALU;
+
+                        switch((opcode & 0x03c0) >> 6) {
+                            case 0x0: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_and; break;
+                            case 0x1: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_eor; break;
+                            case 0x2: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsl2; break;
+                            case 0x3: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_lsr2; break;
+                            case 0x4: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_asr2; break;
+                            case 0x5: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_adc; break;
+                            case 0x6: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_sbc; break;
+                            case 0x7: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ror; break;
+                            case 0x8: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_tst; break;
+                            case 0x9: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_neg; break;
+                            case 0xa: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmp2; break;
+                            case 0xb: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_cmn; break;
+                            case 0xc: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_orr; break;
+                            case 0xd: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mul; break;
+                            case 0xe: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_bic; break;
+                            case 0xf: gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_mvn; break;
+                        }
+                    }
+                }
+            }
+
+            break;
+
+            case 3:
+                gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStr2;
+                gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_IMMEDIATEOFFSET;
+                break;
+
+            case 4:
+                if(opcode & (1 << 12)) {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStr3;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_SPTRANSFER;
+                } else {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldrStrh2;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_HALFWORDTRANSFER;
+                }
+
+                break;
+
+            case 5:
+                if(opcode & (1 << 12)) {
+                    if((opcode & 0x0f00) == 0x0000) {
+                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add5;
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_SPADD;
+                    } else if((opcode & 0x0600) == 0x0400) {
+                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_pushPop;
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_PUSHPOP;
+                    }
+                } else {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_add4;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_LOADADDRESS;
+                }
+
+                break;
+
+            case 6:
+                if(opcode & (1 << 12)) {
+                    if((opcode & 0x0f00) == 0x0f00) {
+                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_swi;
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_SWI;
+                    } else {
+                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_b;
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_CONDITIONALBRANCH;
+                    }
+                } else {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_ldmStm;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_BLOCKTRANSFER;
+                }
+
+                break;
+
+            case 7:
+                if(opcode & (1 << 12)) {
+                    gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_bl;
+                    gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_LONGBRANCH;
+                } else {
+                    if(!(opcode & (1 << 11))) {
+                        gba_cpu_decodeTable_thumb[i] = gba_cpu_thumb_b2;
+                        gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_THUMB_BRANCH;
+                    }
+                }
+
+                break;
+        }
+
+        if(!gba_cpu_decodeTable_thumb[i]) {
+            gba_cpu_formats_thumb[i] = GBA_CPU_FORMAT_UNDEFINED;
+        }
+    }
+}
+
+static inline void gba_cpu_initThumbRecords() {
+    for(int i = 0; i < 1024; i++) {
+        gba_cpu_opcodeHandlerThumb_t *handler = gba_cpu_decodeTable_thumb[i];
+        uint8_t index = 0;
+
+        for(size_t j = 1; j < sizeof(gba_cpu_handlers_thumb) / sizeof(gba_cpu_handlers_thumb[0]); j++) {
+            if(gba_cpu_handlers_thumb[j] == handler) {
+                index = j;
+            }
+        }
+
+        for(int j = 0; j < 64; j++) {
+            uint16_t opcode = (i << 6) | j;
+            gba_cpu_thumbRecord_t *record = &gba_cpu_thumbRecords[opcode];
+            int32_t offset11 = (opcode & 0x07ff) - ((opcode & (1 << 10)) ? 0x0800 : 0);
+
+            record->opcode = opcode;
+            record->handler = index;
+            record->rd = opcode & 0x0007;
+            record->rs = (opcode & 0x0038) >> 3;
+            record->rn = (opcode & 0x01c0) >> 6;
+            record->immediate = 0;
+
+            if(handler == gba_cpu_thumb_add || handler == gba_cpu_thumb_sub) {
+                record->immediate = record->rn;
+            } else if(handler == gba_cpu_thumb_lsl || handler == gba_cpu_thumb_lsr || handler == gba_cpu_thumb_asr) {
+                record->immediate = (opcode & 0x07c0) >> 6;
+            } else if(
+                handler == gba_cpu_thumb_mov
+                || handler == gba_cpu_thumb_cmp
+                || handler == gba_cpu_thumb_add2
+                || handler == gba_cpu_thumb_sub2
+            ) {
+                record->rd = (opcode & 0x0700) >> 8;
+                record->immediate = opcode & 0x00ff;
+            } else if(handler == gba_cpu_thumb_ldr || handler == gba_cpu_thumb_ldrStr3 || handler == gba_cpu_thumb_add4) {
+                record->rd = (opcode & 0x0700) >> 8;
+                record->immediate = (opcode & 0x00ff) << 2;
+            } else if(
+                handler == gba_cpu_thumb_add3
+                || handler == gba_cpu_thumb_cmp3
+                || handler == gba_cpu_thumb_mov2
+                || handler == gba_cpu_thumb_bx
+            ) {
+                record->rd += (opcode & (1 << 7)) ? 8 : 0;
+                record->rs += (opcode & (1 << 6)) ? 8 : 0;
+            } else if(handler == gba_cpu_thumb_ldrStr2) {
+                record->immediate = ((opcode & 0x07c0) >> 6) << ((opcode & (1 << 12)) ? 0 : 2);
+            } else if(handler == gba_cpu_thumb_ldrStrh2) {
+                record->immediate = ((opcode & 0x07c0) >> 6) << 1;
+            } else if(handler == gba_cpu_thumb_add5) {
+                record->immediate = (opcode & 0x007f) << 2;
+
+                if(opcode & (1 << 7)) {
+                    record->immediate = -record->immediate;
+                }
+            } else if(handler == gba_cpu_thumb_ldmStm) {
+                record->rs = (opcode & 0x0700) >> 8;
+                record->immediate = opcode & 0x00ff;
+            } else if(handler == gba_cpu_thumb_pushPop || handler == gba_cpu_thumb_swi) {
+                record->immediate = opcode & 0x00ff;
+            } else if(handler == gba_cpu_thumb_b) {
+                record->immediate = (int8_t)(opcode & 0x00ff) * 2;
+            } else if(handler == gba_cpu_thumb_bl) {
+                record->immediate = (opcode & (1 << 11)) ? (opcode & 0x07ff) << 1 : offset11 * 4096;
+            } else if(handler == gba_cpu_thumb_b2) {
+                record->immediate = offset11 * 2;
+            }
+        }
+    }
+}
+
+static inline void gba_cpu_initDecodeArm() {
+    #define GBA_CPU_ARM_DP_ENTRY(op, s, name, immediate, shiftType, registerShift) gba_cpu_arm_dp_##op##_##s##_##name,
+
+    static gba_cpu_opcodeHandlerArm_t *const dataProcessingHandlers[] = {
+        GBA_CPU_ARM_DP_OPERATIONS(GBA_CPU_ARM_DP_ENTRY)
+    };
+
+    #undef GBA_CPU_ARM_DP_ENTRY
+
+    for(int i = 0; i < 4096; i++) {
+        uint32_t opcode = ((i & 0xff0) << 16) | ((i & 0x00f) << 4);
+
+        gba_cpu_decodeTable_arm[i] = NULL;
+        gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_UNDEFINED;
+
+        switch((opcode & 0x0c000000) >> 26) {
+            case 0x0:
+                if((opcode & 0x0ff000f0) == 0x01200010) {
+                    gba_cpu_decodeTable_arm[i] = gba_cpu_arm_bx;
+                    gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_BX;
+                } else if((opcode & 0x02000090) == 0x00000090) {
+                    if((opcode & 0x0fb000f0) == 0x01000090) {
+                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_swp;
+                        gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_SWP;
+                    } else if((opcode & 0x0fc000f0) == 0x00000090) {
+                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_mul;
+                        gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_MUL;
+                    } else if((opcode & 0x0f8000f0) == 0x00800090) {
+                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_mull;
+                        gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_MULL;
+                    } else if((opcode & 0x0e000090) == 0x00000090) {
+                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_halfwordSignedDataTransfer;
+                        gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_HALFWORDSIGNEDDATATRANSFER;
+                    }
+                } else if((opcode & 0x01900000) == 0x01000000) {
+                    if((opcode & (1 << 25)) || ((opcode & 0x000000f0) == 0x00000000)) {
+                        gba_cpu_decodeTable_arm[i] = gba_cpu_arm_psrTransfer;
+                        gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_PSRTRANSFER;
+                    }
+                } else {
+                    int operation = (opcode & 0x01e00000) >> 21;
+                    int sBit = (opcode & (1 << 20)) != 0;
+                    int variant = 0;
+
+                    if(!(opcode & (1 << 25))) {
+                        variant = (opcode & (1 << 4)) ? 5 : 1;
+                        variant += (opcode & 0x00000060) >> 5;
+                    }
+
+                    gba_cpu_decodeTable_arm[i] = dataProcessingHandlers[(operation * 2 + sBit) * GBA_CPU_ARM_DP_VARIANT_COUNT + variant];
+                    gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_DATAPROCESSING;
+                }
+
+                break;
+
+            case 0x1:
+            if((opcode & 0x02000010) != 0x02000010) {
+                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_singleDataTransfer;
+                gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_SINGLEDATATRANSFER;
+            }
+
+            break;
+
+            case 0x2:
+            if(opcode & (1 << 25)) {
+                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_b;
+                gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_B;
+            } else {
+                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_blockDataTransfer;
+                gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_BLOCKDATATRANSFER;
+            }
+
+            break;
+
+            case 0x3:
+            if((opcode & 0x03000000) == 0x03000000) {
+                gba_cpu_decodeTable_arm[i] = gba_cpu_arm_swi;
+                gba_cpu_formats_arm[i] = GBA_CPU_FORMAT_ARM_SWI;
+            }
+
+            break;
+        }
+    }
+}
+
+// Computes the second operand of a data processing instruction. The carry
+// out of the shifter is only stored when requested, as reading the C flag
+// for the shifts that keep it forces the flags to be evaluated.
+static ALWAYS_INLINE uint32_t gba_cpu_arm_operand(uint32_t opcode, bool immediate, int shiftType, bool registerShift, bool *carry) {
+    uint32_t result = 0;
+    bool carryOut = false;
+    bool carryKept = false;
+
+    if(!immediate) {
+        uint32_t rm = opcode & 0x0000000f;
+        uint32_t rm_v = gba_cpu_r[rm];
+
+        if(!registerShift) {
+            int amount = (opcode & 0x00000f80) >> 7;
+
+            switch(shiftType) {
+                case 0: // LSL
+                    if(amount == 0) {
+                        result = rm_v;
+                        carryKept = true;
+                    } else {
+                        result = rm_v << amount;
+                        carryOut = (rm_v >> (32 - amount)) & (1 << 0);
+                    }
+
+                    break;
+
+                case 1: // LSR
+                    if(amount == 0) {
+                        result = 0;
+                        carryOut = rm_v >> 31;
+                    } else {
+                        result = rm_v >> amount;
+                        carryOut = (rm_v >> (amount - 1)) & (1 << 0);
+                    }
+
+                    break;
+
+                case 2: // ASR
+                    if(amount == 0) {
+                        result = (int)rm_v >> 31;
+                        carryOut = rm_v >> 31;
+                    } else {
+                        result = (int)rm_v >> amount;
+                        carryOut = (rm_v >> (amount - 1)) & (1 << 0);
+                    }
+
+                    break;
+
+                case 3: // ROR/RRX
+                    if(amount == 0) {
+                        // RRX
+                        result = (gba_cpu_getFlagC() ? 1 << 31 : 0) | (rm_v >> 1);
+                        carryOut = rm_v & (1 << 0);
+                    } else {
+                        // ROR
+                        result = gba_cpu_util_ror32(rm_v, amount);
+                        carryOut = (rm_v >> (amount - 1)) & (1 << 0);
+                    }
+
+                    break;
+            }
         } else {
-            gba_cpu_flagC = result < rn_v;
-            gba_cpu_flagV = gba_cpu_getOverflow_add(rn_v, gba_cpu_shifterResult, result);
-            gba_cpu_setFlags_arithmetical(result);
+            if(rm == 15) {
+                rm_v += 4;
+            }
+
+            if((opcode & 0x00000080) != 0) {
+                gba_cpu_raiseUnd();
+            }
+
+            uint32_t rs = (opcode & 0x00000f00) >> 8;
+            uint32_t shift = gba_cpu_r[rs] & 0x000000ff;
+
+            switch(shiftType) {
+                case 0: // LSL
+                    if(shift == 0) {
+                        result = rm_v;
+                        carryKept = true;
+                    } else if(shift < 32) {
+                        result = rm_v << shift;
+                        carryOut = (rm_v >> (32 - shift)) & (1 << 0);
+                    } else if(shift == 32) {
+                        result = 0;
+                        carryOut = rm_v & (1 << 0);
+                    } else {
+                        result = 0;
+                        carryOut = false;
+                    }
+
+                    break;
+
+                case 1: // LSR
+                    if(shift == 0) {
+                        result = rm_v;
+                        carryKept = true;
+                    } else if(shift < 32) {
+                        result = rm_v >> shift;
+                        carryOut = (rm_v >> (shift - 1)) & (1 << 0);
+                    } else if(shift == 32) {
+                        result = 0;
+                        carryOut = rm_v >> 31;
+                    } else {
+                        result = 0;
+                        carryOut = false;
+                    }
+
+                    break;
+
+                case 2: // ASR
+                    if(shift == 0) {
+                        result = rm_v;
+                        carryKept = true;
+                    } else if(shift < 32) {
+                        result = (int)rm_v >> shift;
+                        carryOut = (rm_v >> (shift - 1)) & (1 << 0);
+                    } else {
+                        result = (int)rm_v >> 31;
+                        carryOut = rm_v >> 31;
+                    }
+
+                    break;
+                    
+                case 3: // ROR
+                    {
+                        int rotation = shift & 0x1f;
+
+                        if(shift == 0) {
+                            result = rm_v;
+                            carryKept = true;
+                        } else if(rotation == 0) {
+                            result = rm_v;
+                            carryOut = rm_v >> 31;
+                        } else {
+                            result = gba_cpu_util_ror32(rm_v, rotation);
+                            carryOut = (rm_v >> (rotation - 1)) & (1 << 0);
+                        }
+
+                        break;
+                    }
+            }
+        }
+    } else {
+        uint32_t rotation = (opcode >> 7) & 0x1e;
+        uint32_t value = opcode & 0xff;
+
+        if(rotation) {
+            result = gba_cpu_util_ror32(value, rotation);
+            carryOut = result >> 31;
+        } else {
+            result = value;
+            carryKept = true;
+        }
+    }
+
+    if(carry) {
+        *carry = carryKept ? gba_cpu_getFlagC() : carryOut;
+    }
+
+    return result;
+}
+
+static inline void gba_cpu_arm_shift(uint32_t opcode) {
+    gba_cpu_shifterResult = gba_cpu_arm_operand(
+        opcode,
+        (opcode & (1 << 25)) != 0,
+        (opcode & 0x00000060) >> 5,
+        (opcode & (1 << 4)) != 0,
+        NULL
+    );
+}
+
+static inline uint32_t gba_cpu_util_ror32(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+
+static inline void gba_cpu_writeRegister(int rd, uint32_t value) {
+    if(rd == 15) {
+        gba_cpu_performJump(value);
+    } else {
+        gba_cpu_r[rd] = value;
+    }
+}
+
+static inline void gba_cpu_setFlags_arithmetical(uint32_t result) {
+    gba_cpu_flagsResult = result;
+    gba_cpu_lazyNZ = true;
+}
+
+static inline void gba_cpu_setFlags_add(uint32_t left, uint32_t right, uint32_t result) {
+    gba_cpu_lazyCV = GBA_CPU_LAZYFLAGS_ADD;
+    gba_cpu_flagsLeft = left;
+    gba_cpu_flagsRight = right;
+    gba_cpu_setFlags_arithmetical(result);
+}
+
+static inline void gba_cpu_setFlags_sub(uint32_t left, uint32_t right, uint32_t result) {
+    gba_cpu_lazyCV = GBA_CPU_LAZYFLAGS_SUB;
+    gba_cpu_flagsLeft = left;
+    gba_cpu_flagsRight = right;
+    gba_cpu_setFlags_arithmetical(result);
+}
+
+static inline void gba_cpu_materializeFlags() {
+    if(gba_cpu_lazyNZ) {
+        gba_cpu_flagN = gba_cpu_flagsResult >> 31;
+        gba_cpu_flagZ = gba_cpu_flagsResult == 0;
+        gba_cpu_lazyNZ = false;
+    }
+
+    gba_cpu_materializeFlagsCV();
+}
+
+static inline void gba_cpu_materializeFlagsCV() {
+    uint32_t result;
+
+    switch(gba_cpu_lazyCV) {
+        case GBA_CPU_LAZYFLAGS_NONE:
+            return;
+
+        case GBA_CPU_LAZYFLAGS_ADD:
+            result = gba_cpu_flagsLeft + gba_cpu_flagsRight;
+            gba_cpu_flagC = result < gba_cpu_flagsLeft;
+            gba_cpu_flagV = gba_cpu_getOverflow_add(gba_cpu_flagsLeft, gba_cpu_flagsRight, result);
+            break;
+
+        case GBA_CPU_LAZYFLAGS_SUB:
+            result = gba_cpu_flagsLeft - gba_cpu_flagsRight;
+            gba_cpu_flagC = gba_cpu_getCarry_sub(gba_cpu_flagsLeft, gba_cpu_flagsRight);
+            gba_cpu_flagV = gba_cpu_getOverflow_sub(gba_cpu_flagsLeft, gba_cpu_flagsRight, result);
+            break;
+    }
+
+    gba_cpu_lazyCV = GBA_CPU_LAZYFLAGS_NONE;
+}
+
+static inline bool gba_cpu_getFlagC() {
+    gba_cpu_materializeFlagsCV();
+    return gba_cpu_flagC;
+}
+
+// V is evaluated first, as it would be lost otherwise.
+static inline void gba_cpu_setFlagC(bool value) {
+    gba_cpu_materializeFlagsCV();
+    gba_cpu_flagC = value;
+}
+
+static inline bool gba_cpu_getCarry_sbc(uint32_t left, uint32_t right, bool carry) {
+    return (left >= right) && ((left - right) >= (!carry));
+}
+
+static inline bool gba_cpu_getCarry_sub(uint32_t left, uint32_t right) {
+    return left >= right;
+}
+
+static inline bool gba_cpu_getOverflow_sub(uint32_t left, uint32_t right, uint32_t result) {
+    return ((left ^ right) & (left ^ result)) >> 31;
+}
+
+static inline bool gba_cpu_getOverflow_add(uint32_t left, uint32_t right, uint32_t result) {
+    return (!((left ^ right) >> 31)) && ((left ^ result) >> 31);
+}
+
+static inline unsigned int gba_cpu_util_hammingWeight16(uint16_t value) {
+    unsigned int count = 0;
+
+    for(int i = 0; i < 16; i++) {
+        if(value & (1 << i)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static inline unsigned int gba_cpu_util_hammingWeight8(uint8_t value) {
+    unsigned int count = 0;
+
+    for(int i = 0; i < 8; i++) {
+        if(value & (1 << i)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static inline void gba_cpu_arm_halfwordSignedDataTransfer(uint32_t opcode) {
+    bool p = (opcode & (1 << 24)) != 0;
+    bool u = (opcode & (1 << 23)) != 0;
+    bool i = (opcode & (1 << 22)) != 0;
+    bool w = (opcode & (1 << 21)) != 0;
+    bool l = (opcode & (1 << 20)) != 0;
+    bool s = (opcode & (1 << 6)) != 0;
+    bool h = (opcode & (1 << 5)) != 0;
+    uint32_t rn = (opcode & 0x000f0000) >> 16;
+    uint32_t rd = (opcode & 0x0000f000) >> 12;
+
+    if(!s && !h) {
+        gba_cpu_raiseUnd();
+    }
+
+    uint32_t addr = gba_cpu_r[rn];
+    uint32_t offset;
+
+    if(i) {
+        offset = ((opcode & 0x00000f00) >> 4) | (opcode & 0x0000000f);
+    } else {
+        if(((opcode & 0x00000f00) >> 8) != 0) {
+            gba_cpu_raiseUnd();
+        }
+
+        uint32_t rm = opcode & 0x0000000f;
+
+        offset = gba_cpu_r[rm];
+    }
+
+    if(p) {
+        if(u) {
+            addr += offset;
+        } else {
+            addr -= offset;
+        }
+    } else {
+        w = true;
+    }
+
+    if(l) {
+        if(w) {
+            if(p) {
+                gba_cpu_r[rn] = addr;
+            } else {
+                if(u) {
+                    gba_cpu_r[rn] = addr + offset;
+                } else {
+                    gba_cpu_r[rn] = addr - offset;
+                }
+            }
+        }
+
+        if(!s && h) { // LDRH
+            if(addr & (1 << 0)) {
+                gba_cpu_writeRegister(rd, gba_cpu_util_ror32(gba_bus_read16(addr), 8));
+            } else {
+                gba_cpu_writeRegister(rd, gba_bus_read16(addr));
+            }
+        } else if((!h) || (addr & (1 << 0))) { // LDRSB
+            uint32_t readValue = gba_bus_read8(addr);
+
+            if(readValue & (1 << 7)) {
+                readValue |= 0xffffff00;
+            }
+
+            gba_cpu_writeRegister(rd, readValue);
+        } else { // LDRSH
+            uint32_t readValue = gba_bus_read16(addr);
+
+            if(readValue & (1 << 15)) {
+                readValue |= 0xffff0000;
+            }
+
+            gba_cpu_writeRegister(rd, readValue);
+        }
+    } else {
+        uint32_t rd_v = gba_cpu_r[rd];
+
+        if(rd == 15) {
+            rd_v += 4;
+        }
+
+        if(s) {
+            gba_cpu_raiseUnd();
+        } else { // STRH
+            gba_bus_write16(addr, rd_v);
+        }
+
+        if(w) {
+            if(p) {
+                gba_cpu_r[rn] = addr;
+            } else {
+                if(u) {
+                    gba_cpu_r[rn] = addr + offset;
+                } else {
+                    gba_cpu_r[rn] = addr - offset;
+                }
+            }
         }
     }
-
-    gba_cpu_writeRegister(rd, result);
 }
 
-static inline void gba_cpu_arm_adc(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
-
+static inline void gba_cpu_arm_blockDataTransfer(uint32_t opcode) {
+    bool p = (opcode & (1 << 24)) != 0;
+    bool u = (opcode & (1 << 23)) != 0;
+    bool s = (opcode & (1 << 22)) != 0;
+    bool w = (opcode & (1 << 21)) != 0;
+    bool l = (opcode & (1 << 20)) != 0;
     uint32_t rn = (opcode & 0x000f0000) >> 16;
     uint32_t rn_v = gba_cpu_r[rn];
+    uint32_t registerCount = gba_cpu_util_hammingWeight16(opcode);
+    uint16_t rlist = opcode;
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+    uint32_t addr = rn_v;
+
+    if(!rlist) {
+        registerCount = 16;
     }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+    if(p) {
+        if(u) {
+            addr += 4;
+        } else {
+            addr -= 4 * registerCount;
+        }
+    } else {
+        if(!u) {
+            addr -= 4 * (registerCount - 1);
+        }
+    }
 
-    uint64_t result = (uint64_t)rn_v + (uint64_t)gba_cpu_shifterResult + gba_cpu_flagC;
+    if(!rlist) {
+        if(l) {
+            gba_cpu_performJump(gba_bus_read32(addr));
+        } else {
+            gba_bus_write32(addr, gba_cpu_r[15] + 4);
+        }
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+        if(u) {
+            gba_cpu_r[rn] += 0x40;
         } else {
-            gba_cpu_flagC = result > UINT32_MAX;
-            gba_cpu_flagV = gba_cpu_getOverflow_add(rn_v, gba_cpu_shifterResult, result);
-            gba_cpu_setFlags_arithmetical(result);
+            gba_cpu_r[rn] -= 0x40;
         }
-    }
+    } else {
+        if(l) { // LDM
+            if(w) {
+                if(u) {
+                    gba_cpu_r[rn] = rn_v + 4 * registerCount;
+                } else {
+                    gba_cpu_r[rn] = rn_v - 4 * registerCount;
+                }
+            }
 
-    gba_cpu_writeRegister(rd, result);
-}
+            uint32_t *burst = s ? NULL : gba_bus_getBurst32(addr, registerCount, false);
 
-static inline void gba_cpu_arm_sbc(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+            for(int i = 0; burst && i < 16; i++) {
+                if(rlist & (1 << i)) {
+                    gba_cpu_writeRegister(i, *burst++);
+                }
+            }
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+            for(int i = 0; !burst && i < 16; i++) {
+                if(opcode & (1 << i)) {
+                    if(s) {
+                        bool r15 = i == 15;
+                        bool notUserMode = gba_cpu_bank != &gba_cpu_banks[GBA_CPU_BANK_USR];
+                        bool registerBanked = (gba_cpu_bank == &gba_cpu_banks[GBA_CPU_BANK_FIQ] && (i >= 8)) || (i == 13) || (i == 14);
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
-    }
+                        if(r15) {
+                            gba_cpu_setCpsr(gba_cpu_getSpsr());
+                            gba_cpu_performJump(gba_bus_read32(addr));
+                        } else if(notUserMode && registerBanked) {
+                            gba_cpu_banks[GBA_CPU_BANK_USR].r[i - 8] = gba_bus_read32(addr);
+                        } else {
+                            gba_cpu_r[i] = gba_bus_read32(addr);
+                        }
+                    } else {
+                        gba_cpu_writeRegister(i, gba_bus_read32(addr));
+                    }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+                    addr += 4;
+                    gba_bus_sequential = true;
+                }
+            }
 
-    uint64_t result = (uint64_t)rn_v - (uint64_t)gba_cpu_shifterResult - !gba_cpu_flagC;
+            // The jump has aligned the popped address, whatever the state.
+            if(rlist & (1 << 15)) {
+                GBA_CPU_CALLPROF(gba_callprof_return(gba_cpu_r[15] + (gba_cpu_flagT ? 2 : 4)));
+            }
+        } else { // STM
+            bool firstCycle = true;
+            bool secondCycle = false;
+            uint32_t *burst = s ? NULL : gba_bus_getBurst32(addr, registerCount, true);
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_flagC = gba_cpu_getCarry_sbc(rn_v, gba_cpu_shifterResult, gba_cpu_flagC);
-            gba_cpu_flagV = gba_cpu_getOverflow_sub(rn_v, gba_cpu_shifterResult, result);
-            gba_cpu_setFlags_arithmetical(result);
+            // The base is written back after the first register is stored.
+            for(int i = 0; burst && i < 16; i++) {
+                if(rlist & (1 << i)) {
+                    if(firstCycle) {
+                        *burst++ = gba_cpu_r[i];
+                        firstCycle = false;
+
+                        if(w) {
+                            if(u) {
+                                gba_cpu_r[rn] = rn_v + registerCount * 4;
+                            } else {
+                                gba_cpu_r[rn] = rn_v - registerCount * 4;
+                            }
+                        }
+                    } else {
+                        *burst++ = i == 15 ? gba_cpu_r[15] + 4 : gba_cpu_r[i];
+                    }
+                }
+            }
+
+            for(int i = 0; !burst && i < 16; i++) {
+                if(rlist & (1 << i)) {
+                    if(firstCycle) {
+                        firstCycle = false;
+                        secondCycle = true;
+                    } else if(secondCycle) {
+                        if(w) {
+                            if(u) {
+                                gba_cpu_r[rn] = rn_v + registerCount * 4;
+                            } else {
+                                gba_cpu_r[rn] = rn_v - registerCount * 4;
+                            }
+                        }
+
+                        secondCycle = false;
+                    }
+
+                    if(s) {
+                        bool notUserMode = gba_cpu_bank != &gba_cpu_banks[GBA_CPU_BANK_USR];
+                        bool registerBanked = (gba_cpu_bank == &gba_cpu_banks[GBA_CPU_BANK_FIQ] && (i >= 8)) || (i == 13) || (i == 14);
+
+                        if(notUserMode && registerBanked) {
+                            gba_bus_write32(addr, gba_cpu_banks[GBA_CPU_BANK_USR].r[i - 8]);
+                        } else {
+                            gba_bus_write32(addr, gba_cpu_r[i]);
+                        }
+                    } else {
+                        if(i == 15 && !secondCycle) {
+                            gba_bus_write32(addr, gba_cpu_r[15] + 4);
+                        } else {
+                            gba_bus_write32(addr, gba_cpu_r[i]);
+                        }
+                    }
+
+                    addr += 4;
+                    gba_bus_sequential = true;
+                }
+            }
+
+            if(w && secondCycle) {
+                if(u) {
+                    gba_cpu_r[rn] = rn_v + 4;
+                } else {
+                    gba_cpu_r[rn] = rn_v - 4;
+                }
+            }
         }
-    }
 
-    gba_cpu_writeRegister(rd, result);
+        gba_bus_sequential = false;
+    }
 }
 
-static inline void gba_cpu_arm_rsc(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
-
+static inline void gba_cpu_arm_swp(uint32_t opcode) {
+    bool b = (opcode & (1 << 22)) != 0;
     uint32_t rn = (opcode & 0x000f0000) >> 16;
+    uint32_t rd = (opcode & 0x0000f000) >> 12;
+    uint32_t rm = opcode & 0x0000000f;
+
     uint32_t rn_v = gba_cpu_r[rn];
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+    if(b) {
+        uint8_t tmp = gba_bus_read8(rn_v);
+        gba_bus_write8(rn_v, gba_cpu_r[rm]);
+        gba_cpu_r[rd] = tmp;
+    } else {
+        uint32_t tmp = gba_cpu_util_ror32(gba_bus_read32(rn_v), (rn_v & 3) << 3);
+        gba_bus_write32(rn_v, gba_cpu_r[rm]);
+        gba_cpu_r[rd] = tmp;
     }
+}
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
+static inline void gba_cpu_arm_mul(uint32_t opcode) {
+    bool a = (opcode & (1 << 21)) != 0;
     bool s = (opcode & (1 << 20)) != 0;
+    uint32_t rd = (opcode & 0x000f0000) >> 16;
+    uint32_t rs = (opcode & 0x00000f00) >> 8;
+    uint32_t rm = opcode & 0x0000000f;
 
-    uint64_t result = (uint64_t)gba_cpu_shifterResult - (uint64_t)rn_v - !gba_cpu_flagC;
+    uint32_t result = gba_cpu_r[rm] * gba_cpu_r[rs];
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_flagC = gba_cpu_getCarry_sbc(gba_cpu_shifterResult, rn_v, gba_cpu_flagC);
-            gba_cpu_flagV = gba_cpu_getOverflow_sub(gba_cpu_shifterResult, rn_v, result);
-            gba_cpu_setFlags_arithmetical(result);
-        }
+    if(a) {
+        uint32_t rn = (opcode & 0x0000f000) >> 12;
+        result += gba_cpu_r[rn];
     }
 
-    gba_cpu_writeRegister(rd, result);
+    gba_cpu_r[rd] = result;
+
+    if(s) {
+        gba_cpu_setFlags_arithmetical(result);
+    }
 }
 
-static inline void gba_cpu_arm_tst(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+static inline void gba_cpu_arm_mull(uint32_t opcode) {
+    bool u = (opcode & (1 << 22)) != 0;
+    bool a = (opcode & (1 << 21)) != 0;
+    bool s = (opcode & (1 << 20)) != 0;
+    uint32_t rdhi = (opcode & 0x000f0000) >> 16;
+    uint32_t rdlo = (opcode & 0x0000f000) >> 12;
+    uint32_t rs = (opcode & 0x00000f00) >> 8;
+    uint32_t rm = opcode & 0x0000000f;
+
+    uint64_t result;
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+    if(u) {
+        int64_t rm_v = (int32_t)gba_cpu_r[rm];
+        int64_t rs_v = (int32_t)gba_cpu_r[rs];
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+        result = rm_v * rs_v;
+    } else {
+        uint64_t rm_v = gba_cpu_r[rm];
+        uint64_t rs_v = gba_cpu_r[rs];
+
+        result = rm_v * rs_v;
     }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+    if(a) {
+        result += ((uint64_t)gba_cpu_r[rdhi] << 32) | gba_cpu_r[rdlo];
+    }
 
-    uint32_t result = rn_v & gba_cpu_shifterResult;
+    gba_cpu_r[rdhi] = result >> 32;
+    gba_cpu_r[rdlo] = result;
 
     if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_setFlags_logical(result);
-        }
+        gba_cpu_flagZ = result == 0;
+        gba_cpu_flagN = result >> 63;
+        gba_cpu_lazyNZ = false;
+    }
+}
+
+static inline void gba_cpu_arm_bx(uint32_t opcode) {
+    if((opcode & 0x0ffffff0) != 0x012fff10) {
+        gba_cpu_raiseUnd();
+    } else {
+        uint32_t dest = gba_cpu_r[opcode & 0x0000000f];
+
+        GBA_CPU_CALLPROF(gba_callprof_return(dest));
+        gba_cpu_flagT = dest & (1 << 0);
+        gba_cpu_performJump(dest);
     }
 }
 
-static inline void gba_cpu_arm_teq(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+static inline void gba_cpu_arm_swi(uint32_t opcode) {
+    gba_cpu_callSwi((opcode >> 16) & 0xff);
+}
 
+static inline void gba_cpu_arm_singleDataTransfer(uint32_t opcode) {
+    bool i = (opcode & (1 << 25)) != 0;
+    bool p = (opcode & (1 << 24)) != 0;
+    bool u = (opcode & (1 << 23)) != 0;
+    bool b = (opcode & (1 << 22)) != 0;
+    bool w = (opcode & (1 << 21)) != 0;
+    bool l = (opcode & (1 << 20)) != 0;
     uint32_t rn = (opcode & 0x000f0000) >> 16;
+    uint32_t rd = (opcode & 0x0000f000) >> 12;
     uint32_t rn_v = gba_cpu_r[rn];
+    uint32_t rd_v = gba_cpu_r[rd];
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+    if((!l) && (rd == 15)) {
+        rd_v += 4;
     }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+    if(i) {
+        gba_cpu_arm_shift(opcode ^ 0x02000000);
+    } else {
+        gba_cpu_shifterResult = opcode & 0x00000fff;
+    }
 
-    uint32_t result = rn_v ^ gba_cpu_shifterResult;
+    uint32_t offset = rn_v;
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+    if(p) {
+        if(u) {
+            offset += gba_cpu_shifterResult;
         } else {
-            gba_cpu_setFlags_logical(result);
+            offset -= gba_cpu_shifterResult;
         }
+    } else {
+        w = true;
     }
-}
-
-static inline void gba_cpu_arm_cmp(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
-
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
+    if(w) {
+        if(u) {
+            if(p) {
+                gba_cpu_writeRegister(rn, offset);
+            } else {
+                gba_cpu_writeRegister(rn, offset + gba_cpu_shifterResult);
+            }
+        } else {
+            if(p) {
+                gba_cpu_writeRegister(rn, offset);
+            } else {
+                gba_cpu_writeRegister(rn, offset - gba_cpu_shifterResult);
+            }
         }
     }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
-
-    uint32_t result = rn_v - gba_cpu_shifterResult;
-
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+    if(l) {
+        if(b) {
+            gba_cpu_writeRegister(rd, gba_bus_read8(offset));
         } else {
-            gba_cpu_flagC = gba_cpu_getCarry_sub(rn_v, gba_cpu_shifterResult);
-            gba_cpu_flagV = gba_cpu_getOverflow_sub(rn_v, gba_cpu_shifterResult, result);
-            gba_cpu_setFlags_arithmetical(result);
+            gba_cpu_writeRegister(rd, gba_cpu_util_ror32(gba_bus_read32(offset), (offset & 0x00000003) << 3));
+        }
+    } else {
+        if(b) {
+            gba_bus_write8(offset, rd_v);
+        } else {
+            gba_bus_write32(offset, rd_v);
         }
     }
 }
 
-static inline void gba_cpu_arm_cmn(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+static inline void gba_cpu_arm_psrTransfer_msr(uint32_t opcode, bool spsr, uint32_t operand) {
+    uint32_t mask = 0;
 
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+    if(opcode & (1 << 19)) mask |= 0xff000000;
+    if(opcode & (1 << 18)) mask |= 0x00ff0000;
+    if(opcode & (1 << 17)) mask |= 0x0000ff00;
+    if(opcode & (1 << 16)) mask |= 0x000000ff;
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
-    }
+    uint32_t registerValue;
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+    if(spsr) {
+        registerValue = gba_cpu_getSpsr();
+    } else {
+        registerValue = gba_cpu_getCpsr();
+    }
 
-    uint32_t result = rn_v + gba_cpu_shifterResult;
+    registerValue &= ~mask;
+    registerValue |= operand & mask;
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_flagC = result < rn_v;
-            gba_cpu_flagV = gba_cpu_getOverflow_add(rn_v, gba_cpu_shifterResult, result);
-            gba_cpu_setFlags_arithmetical(result);
-        }
+    if(spsr) {
+        gba_cpu_setSpsr(registerValue);
+    } else {
+        gba_cpu_setCpsr(registerValue);
     }
 }
 
-static inline void gba_cpu_arm_orr(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
-
-    uint32_t rn = (opcode & 0x000f0000) >> 16;
-    uint32_t rn_v = gba_cpu_r[rn];
+static inline void gba_cpu_arm_psrTransfer(uint32_t opcode) {
+    bool msr = (opcode & (1 << 21)) != 0;
+    bool spsr = (opcode & (1 << 22)) != 0;
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
-    }
+    if(msr) {
+        bool immediate = (opcode & (1 << 25)) != 0;
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+        if(immediate) {
+            uint32_t shift = (opcode & 0x00000f00) >> 8;
+            uint32_t imm = opcode & 0x000000ff;
 
-    uint32_t result = rn_v | gba_cpu_shifterResult;
+            uint32_t operand = gba_cpu_util_ror32(imm, shift << 1);
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+            gba_cpu_arm_psrTransfer_msr(opcode, spsr, operand);
         } else {
-            gba_cpu_setFlags_logical(result);
-        }
-    }
+            if((opcode & 0x00000ff0) != 0x00000000) {
+                gba_cpu_raiseUnd();
+            }
 
-    gba_cpu_writeRegister(rd, result);
-}
+            uint32_t rm = opcode & 0x0000000f;
 
-static inline void gba_cpu_arm_mov(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+            gba_cpu_arm_psrTransfer_msr(opcode, spsr, gba_cpu_r[rm]);
+        }
+    } else {
+        if((opcode & 0x000f0fff) != 0x000f0000) {
+            gba_cpu_raiseUnd();
+        }
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+        uint32_t rd = (opcode & 0x0000f000) >> 12;
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
+        if(spsr) {
+            gba_cpu_r[rd] = gba_cpu_getSpsr();
         } else {
-            gba_cpu_setFlags_logical(gba_cpu_shifterResult);
+            gba_cpu_r[rd] = gba_cpu_getCpsr();
         }
     }
-
-    gba_cpu_writeRegister(rd, gba_cpu_shifterResult);
 }
 
-static inline void gba_cpu_arm_bic(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+static ALWAYS_INLINE void gba_cpu_arm_dataProcessing(uint32_t opcode, int operation, bool s, bool immediate, int shiftType, bool registerShift) {
+    bool logical = operation <= 0x1 || operation == 0x8 || operation == 0x9 || operation >= 0xc;
+    bool carry = false;
+    uint32_t operand = gba_cpu_arm_operand(opcode, immediate, shiftType, registerShift, (s && logical) ? &carry : NULL);
 
     uint32_t rn = (opcode & 0x000f0000) >> 16;
     uint32_t rn_v = gba_cpu_r[rn];
 
-    if(rn == 15) {
-        if((!(opcode & (1 << 25))) && (opcode & (1 << 4))) {
-            rn_v += 4;
-        }
+    if(rn == 15 && registerShift) {
+        rn_v += 4;
     }
 
     uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
-
-    uint32_t result = rn_v & ~gba_cpu_shifterResult;
+    uint64_t result = 0;
+
+    switch(operation) {
+        case 0x0: result = rn_v & operand; break; // AND
+        case 0x1: result = rn_v ^ operand; break; // EOR
+        case 0x2: result = rn_v - operand; break; // SUB
+        case 0x3: result = operand - rn_v; break; // RSB
+        case 0x4: result = rn_v + operand; break; // ADD
+        case 0x5: result = (uint64_t)rn_v + (uint64_t)operand + gba_cpu_getFlagC(); break; // ADC
+        case 0x6: result = (uint64_t)rn_v - (uint64_t)operand - !gba_cpu_getFlagC(); break; // SBC
+        case 0x7: result = (uint64_t)operand - (uint64_t)rn_v - !gba_cpu_getFlagC(); break; // RSC
+        case 0x8: result = rn_v & operand; break; // TST
+        case 0x9: result = rn_v ^ operand; break; // TEQ
+        case 0xa: result = rn_v - operand; break; // CMP
+        case 0xb: result = rn_v + operand; break; // CMN
+        case 0xc: result = rn_v | operand; break; // ORR
+        case 0xd: result = operand; break; // MOV
+        case 0xe: result = rn_v & ~operand; break; // BIC
+        case 0xf: result = ~operand; break; // MVN
+    }
 
     if(s) {
         if(rd == 15) {
             gba_cpu_setCpsr(gba_cpu_getSpsr());
+        } else if(logical) {
+            gba_cpu_setFlags_arithmetical(result);
+            gba_cpu_setFlagC(carry);
         } else {
-            gba_cpu_setFlags_logical(result);
-        }
-    }
+            switch(operation) {
+                case 0x2:
+                case 0xa:
+                    gba_cpu_setFlags_sub(rn_v, operand, result);
+                    break;
 
-    gba_cpu_writeRegister(rd, result);
-}
+                case 0x3:
+                    gba_cpu_setFlags_sub(operand, rn_v, result);
+                    break;
 
-static inline void gba_cpu_arm_mvn(uint32_t opcode) {
-    gba_cpu_arm_shift(opcode);
+                case 0x4:
+                case 0xb:
+                    gba_cpu_setFlags_add(rn_v, operand, result);
+                    break;
 
-    uint32_t rd = (opcode & 0x0000f000) >> 12;
-    bool s = (opcode & (1 << 20)) != 0;
+                case 0x5:
+                    gba_cpu_flagC = result > UINT32_MAX;
+                    gba_cpu_flagV = gba_cpu_getOverflow_add(rn_v, operand, result);
+                    gba_cpu_setFlags_arithmetical(result);
+                    break;
 
-    uint32_t result = ~gba_cpu_shifterResult;
+                case 0x6:
+                    gba_cpu_flagC = gba_cpu_getCarry_sbc(rn_v, operand, gba_cpu_flagC);
+                    gba_cpu_flagV = gba_cpu_getOverflow_sub(rn_v, operand, result);
+                    gba_cpu_setFlags_arithmetical(result);
+                    break;
 
-    if(s) {
-        if(rd == 15) {
-            gba_cpu_setCpsr(gba_cpu_getSpsr());
-        } else {
-            gba_cpu_setFlags_logical(result);
+                case 0x7:
+                    gba_cpu_flagC = gba_cpu_getCarry_sbc(operand, rn_v, gba_cpu_flagC);
+                    gba_cpu_flagV = gba_cpu_getOverflow_sub(operand, rn_v, result);
+                    gba_cpu_setFlags_arithmetical(result);
+                    break;
+            }
         }
     }
 
-    gba_cpu_writeRegister(rd, result);
+    if(operation < 0x8 || operation > 0xb) {
+        gba_cpu_writeRegister(rd, result);
+    }
 }
 
+// One handler per operation, S bit and operand form, with everything but the
+// registers resolved at compile time.
+#define GBA_CPU_ARM_DP_HANDLER(op, s, name, immediate, shiftType, registerShift) \
+    static inline void gba_cpu_arm_dp_##op##_##s##_##name(uint32_t opcode) { \
+        gba_cpu_arm_dataProcessing(opcode, 0x##op, s, immediate, shiftType, registerShift); \
+    }
+
+GBA_CPU_ARM_DP_OPERATIONS(GBA_CPU_ARM_DP_HANDLER)
+
+#undef GBA_CPU_ARM_DP_HANDLER
+
 static inline void gba_cpu_arm_b(uint32_t opcode) {
     bool l = (opcode & (1 << 24)) != 0;
 
@@ -1932,67 +3576,67 @@ static inline void gba_cpu_arm_b(uint32_t opcode) {
         offset |= 0xfc000000;
     }
 
+    if(l) {
+        GBA_CPU_CALLPROF(gba_callprof_call(gba_cpu_r[15] + offset, gba_cpu_r[14]));
+    }
+
     gba_cpu_performJump(gba_cpu_r[15] + offset);
 }
 
-static inline void gba_cpu_thumb_sub(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
-    bool i = (opcode & (1 << 10)) != 0;
+static inline void gba_cpu_thumb_sub(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
+    bool i = (record->opcode & (1 << 10)) != 0;
     uint32_t rs_v = gba_cpu_r[rs];
 
     uint32_t op2;
 
     if(i) {
-        op2 = (opcode & 0x01c0) >> 6;
+        op2 = record->immediate;
     } else {
-        uint16_t rn = (opcode & 0x01c0) >> 6;
+        uint16_t rn = record->rn;
         op2 = gba_cpu_r[rn];
     }
 
     uint32_t result = rs_v - op2;
 
-    gba_cpu_flagC = gba_cpu_getCarry_sub(rs_v, op2);
-    gba_cpu_flagV = gba_cpu_getOverflow_sub(rs_v, op2, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_sub(rs_v, op2, result);
 
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_add(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
-    bool i = (opcode & (1 << 10)) != 0;
+static inline void gba_cpu_thumb_add(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
+    bool i = (record->opcode & (1 << 10)) != 0;
     uint32_t rs_v = gba_cpu_r[rs];
 
     uint32_t op2;
 
     if(i) {
-        op2 = (opcode & 0x01c0) >> 6;
+        op2 = record->immediate;
     } else {
-        uint16_t rn = (opcode & 0x01c0) >> 6;
+        uint16_t rn = record->rn;
         op2 = gba_cpu_r[rn];
     }
 
     uint32_t result = rs_v + op2;
 
-    gba_cpu_flagC = result < op2;
-    gba_cpu_flagV = gba_cpu_getOverflow_add(rs_v, op2, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_add(rs_v, op2, result);
 
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_lsl(uint16_t opcode) {
-    uint16_t offset = (opcode & 0x07c0) >> 6;
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_lsl(const gba_cpu_thumbRecord_t *record) {
+    uint16_t offset = record->immediate;
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
 
     if(offset) {
         gba_cpu_r[rd] = rs_v << offset;
-        gba_cpu_flagC = rs_v >> (32 - offset);
+        gba_cpu_setFlagC(rs_v >> (32 - offset));
     } else {
         gba_cpu_r[rd] = rs_v;
     }
@@ -2000,101 +3644,94 @@ static inline void gba_cpu_thumb_lsl(uint16_t opcode) {
     gba_cpu_setFlags_arithmetical(gba_cpu_r[rd]);
 }
 
-static inline void gba_cpu_thumb_lsr(uint16_t opcode) {
-    uint16_t offset = (opcode & 0x07c0) >> 6;
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_lsr(const gba_cpu_thumbRecord_t *record) {
+    uint16_t offset = record->immediate;
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
 
     if(offset) {
         gba_cpu_r[rd] = rs_v >> offset;
-        gba_cpu_flagC = (rs_v >> (offset - 1)) & (1 << 0);
+        gba_cpu_setFlagC((rs_v >> (offset - 1)) & (1 << 0));
     } else {
         gba_cpu_r[rd] = 0;
-        gba_cpu_flagC = rs_v >> 31;
+        gba_cpu_setFlagC(rs_v >> 31);
     }
 
     gba_cpu_setFlags_arithmetical(gba_cpu_r[rd]);
 }
 
-static inline void gba_cpu_thumb_asr(uint16_t opcode) {
-    uint16_t offset = (opcode & 0x07c0) >> 6;
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_asr(const gba_cpu_thumbRecord_t *record) {
+    uint16_t offset = record->immediate;
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
 
     if(offset) {
         gba_cpu_r[rd] = (int)rs_v >> offset;
-        gba_cpu_flagC = (rs_v >> (offset - 1)) & (1 << 0);
+        gba_cpu_setFlagC((rs_v >> (offset - 1)) & (1 << 0));
     } else {
         gba_cpu_r[rd] = (int)rs_v >> 31;
-        gba_cpu_flagC = rs_v >> 31;
+        gba_cpu_setFlagC(rs_v >> 31);
     }
 
     gba_cpu_setFlags_arithmetical(gba_cpu_r[rd]);
 }
 
-static inline void gba_cpu_thumb_mov(uint16_t opcode) {
-    uint16_t rd = (opcode & 0x0700) >> 8;
-    uint16_t offset = opcode & 0x00ff;
+static inline void gba_cpu_thumb_mov(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rd = record->rd;
+    uint16_t offset = record->immediate;
 
     gba_cpu_r[rd] = offset;
 
-    gba_cpu_flagZ = offset == 0;
-    gba_cpu_flagN = false;
+    gba_cpu_setFlags_arithmetical(offset);
 }
 
-static inline void gba_cpu_thumb_cmp(uint16_t opcode) {
-    uint16_t rd = (opcode & 0x0700) >> 8;
-    uint16_t offset = opcode & 0x00ff;
+static inline void gba_cpu_thumb_cmp(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rd = record->rd;
+    uint16_t offset = record->immediate;
 
     uint32_t rd_v = gba_cpu_r[rd];
 
     uint32_t result = rd_v - offset;
 
-    gba_cpu_flagC = gba_cpu_getCarry_sub(rd_v, offset);
-    gba_cpu_flagV = gba_cpu_getOverflow_sub(rd_v, offset, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_sub(rd_v, offset, result);
 }
 
-static inline void gba_cpu_thumb_add2(uint16_t opcode) {
-    uint16_t rd = (opcode & 0x0700) >> 8;
-    uint16_t offset = opcode & 0x00ff;
+static inline void gba_cpu_thumb_add2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rd = record->rd;
+    uint16_t offset = record->immediate;
 
     uint32_t rd_v = gba_cpu_r[rd];
 
     uint32_t result = rd_v + offset;
 
-    gba_cpu_flagC = result < offset;
-    gba_cpu_flagV = gba_cpu_getOverflow_add(rd_v, offset, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_add(rd_v, offset, result);
 
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_sub2(uint16_t opcode) {
-    uint16_t rd = (opcode & 0x0700) >> 8;
-    uint16_t offset = opcode & 0x00ff;
+static inline void gba_cpu_thumb_sub2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rd = record->rd;
+    uint16_t offset = record->immediate;
 
     uint32_t rd_v = gba_cpu_r[rd];
 
     uint32_t result = rd_v - offset;
 
-    gba_cpu_flagC = gba_cpu_getCarry_sub(rd_v, offset);
-    gba_cpu_flagV = gba_cpu_getOverflow_sub(rd_v, offset, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_sub(rd_v, offset, result);
 
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_ldrStrh(uint16_t opcode) {
-    bool h = (opcode & (1 << 11)) != 0;
-    bool s = (opcode & (1 << 10)) != 0;
-    uint16_t ro = (opcode & 0x01c0) >> 6;
-    uint16_t rb = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_ldrStrh(const gba_cpu_thumbRecord_t *record) {
+    bool h = (record->opcode & (1 << 11)) != 0;
+    bool s = (record->opcode & (1 << 10)) != 0;
+    uint16_t ro = record->rn;
+    uint16_t rb = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t ro_v = gba_cpu_r[ro];
     uint32_t rb_v = gba_cpu_r[rb];
@@ -2129,12 +3766,12 @@ static inline void gba_cpu_thumb_ldrStrh(uint16_t opcode) {
     }
 }
 
-static inline void gba_cpu_thumb_ldrStr(uint16_t opcode) {
-    bool l = (opcode & (1 << 11)) != 0;
-    bool b = (opcode & (1 << 10)) != 0;
-    uint16_t ro = (opcode & 0x01c0) >> 6;
-    uint16_t rb = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_ldrStr(const gba_cpu_thumbRecord_t *record) {
+    bool l = (record->opcode & (1 << 11)) != 0;
+    bool b = (record->opcode & (1 << 10)) != 0;
+    uint16_t ro = record->rn;
+    uint16_t rb = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t ro_v = gba_cpu_r[ro];
     uint32_t rb_v = gba_cpu_r[rb];
@@ -2158,81 +3795,51 @@ static inline void gba_cpu_thumb_ldrStr(uint16_t opcode) {
     }
 }
 
-static inline void gba_cpu_thumb_ldr(uint16_t opcode) {
-    uint16_t rd = (opcode & 0x0700) >> 8;
-    uint16_t immediate = opcode & 0x00ff;
-    uint32_t result = (gba_cpu_r[15] & 0xfffffffc) + (immediate << 2);
+static inline void gba_cpu_thumb_ldr(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rd = record->rd;
+    uint32_t result = (gba_cpu_r[15] & 0xfffffffc) + record->immediate;
 
     gba_cpu_r[rd] = gba_bus_read32(result);
 }
 
-static inline void gba_cpu_thumb_bx(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-
-    if(opcode & (1 << 6)) {
-        rs += 8;
-    }
+static inline void gba_cpu_thumb_bx(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
 
     uint32_t dest = gba_cpu_r[rs];
 
+    GBA_CPU_CALLPROF(gba_callprof_return(dest));
     gba_cpu_flagT = dest & (1 << 0);
     gba_cpu_performJump(dest);
 }
 
-static inline void gba_cpu_thumb_add3(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
-
-    if(opcode & (1 << 7)) {
-        rd += 8;
-    }
-
-    if(opcode & (1 << 6)) {
-        rs += 8;
-    }
+static inline void gba_cpu_thumb_add3(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     gba_cpu_writeRegister(rd, gba_cpu_r[rd] + gba_cpu_r[rs]);
 }
 
-static inline void gba_cpu_thumb_cmp3(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
-
-    if(opcode & (1 << 7)) {
-        rd += 8;
-    }
-
-    if(opcode & (1 << 6)) {
-        rs += 8;
-    }
+static inline void gba_cpu_thumb_cmp3(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
 
     uint32_t result = rd_v - rs_v;
-    gba_cpu_flagC = gba_cpu_getCarry_sub(rd_v, rs_v);
-    gba_cpu_flagV = gba_cpu_getOverflow_sub(rd_v, rs_v, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_sub(rd_v, rs_v, result);
 }
 
-static inline void gba_cpu_thumb_mov2(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
-
-    if(opcode & (1 << 7)) {
-        rd += 8;
-    }
-
-    if(opcode & (1 << 6)) {
-        rs += 8;
-    }
+static inline void gba_cpu_thumb_mov2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     gba_cpu_writeRegister(rd, gba_cpu_r[rs]);
 }
 
-static inline void gba_cpu_thumb_and(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_and(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2244,9 +3851,9 @@ static inline void gba_cpu_thumb_and(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_eor(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_eor(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2258,9 +3865,9 @@ static inline void gba_cpu_thumb_eor(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_lsl2(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_lsl2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2271,13 +3878,13 @@ static inline void gba_cpu_thumb_lsl2(uint16_t opcode) {
         result = rd_v;
     } else if(rs_v < 32) {
         result = rd_v << rs_v;
-        gba_cpu_flagC = (rd_v >> (32 - rs_v)) & (1 << 0);
+        gba_cpu_setFlagC((rd_v >> (32 - rs_v)) & (1 << 0));
     } else if(rs_v == 32) {
         result = 0;
-        gba_cpu_flagC = rd_v & (1 << 0);
+        gba_cpu_setFlagC(rd_v & (1 << 0));
     } else {
         result = 0;
-        gba_cpu_flagC = false;
+        gba_cpu_setFlagC(false);
     }
 
     gba_cpu_setFlags_arithmetical(result);
@@ -2285,9 +3892,9 @@ static inline void gba_cpu_thumb_lsl2(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_lsr2(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_lsr2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2298,13 +3905,13 @@ static inline void gba_cpu_thumb_lsr2(uint16_t opcode) {
         result = rd_v;
     } else if(rs_v < 32) {
         result = rd_v >> rs_v;
-        gba_cpu_flagC = (rd_v >> (rs_v - 1)) & (1 << 0);
+        gba_cpu_setFlagC((rd_v >> (rs_v - 1)) & (1 << 0));
     } else if(rs_v == 32) {
         result = 0;
-        gba_cpu_flagC = rd_v >> 31;
+        gba_cpu_setFlagC(rd_v >> 31);
     } else {
         result = 0;
-        gba_cpu_flagC = false;
+        gba_cpu_setFlagC(false);
     }
 
     gba_cpu_setFlags_arithmetical(result);
@@ -2312,9 +3919,9 @@ static inline void gba_cpu_thumb_lsr2(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_asr2(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_asr2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2325,10 +3932,10 @@ static inline void gba_cpu_thumb_asr2(uint16_t opcode) {
         result = rd_v;
     } else if(rs_v < 32) {
         result = (int)rd_v >> rs_v;
-        gba_cpu_flagC = (rd_v >> (rs_v - 1)) & (1 << 0);
+        gba_cpu_setFlagC((rd_v >> (rs_v - 1)) & (1 << 0));
     } else {
         result = (int)rd_v >> 31;
-        gba_cpu_flagC = rd_v >> 31;
+        gba_cpu_setFlagC(rd_v >> 31);
     }
 
     gba_cpu_setFlags_arithmetical(result);
@@ -2336,14 +3943,14 @@ static inline void gba_cpu_thumb_asr2(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_adc(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_adc(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
 
-    uint64_t result = (uint64_t)rd_v + (uint64_t)rs_v + gba_cpu_flagC;
+    uint64_t result = (uint64_t)rd_v + (uint64_t)rs_v + gba_cpu_getFlagC();
 
     gba_cpu_flagC = result > UINT32_MAX;
     gba_cpu_flagV = gba_cpu_getOverflow_add(rd_v, rs_v, result);
@@ -2352,14 +3959,14 @@ static inline void gba_cpu_thumb_adc(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_sbc(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_sbc(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
 
-    uint64_t result = (uint64_t)rd_v - (uint64_t)rs_v - !gba_cpu_flagC;
+    uint64_t result = (uint64_t)rd_v - (uint64_t)rs_v - !gba_cpu_getFlagC();
 
     gba_cpu_flagC = gba_cpu_getCarry_sbc(rd_v, rs_v, gba_cpu_flagC);
     gba_cpu_flagV = gba_cpu_getOverflow_sub(rd_v, rs_v, result);
@@ -2368,9 +3975,9 @@ static inline void gba_cpu_thumb_sbc(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_ror(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_ror(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2382,10 +3989,10 @@ static inline void gba_cpu_thumb_ror(uint16_t opcode) {
         result = rd_v;
     } else if(rotation == 0) {
         result = rd_v;
-        gba_cpu_flagC = rd_v >> 31;
+        gba_cpu_setFlagC(rd_v >> 31);
     } else {
         result = gba_cpu_util_ror32(rd_v, rotation);
-        gba_cpu_flagC = (rd_v >> (rotation - 1)) & (1 << 0);
+        gba_cpu_setFlagC((rd_v >> (rotation - 1)) & (1 << 0));
     }
 
     gba_cpu_setFlags_arithmetical(result);
@@ -2393,9 +4000,9 @@ static inline void gba_cpu_thumb_ror(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_tst(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_tst(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2405,52 +4012,46 @@ static inline void gba_cpu_thumb_tst(uint16_t opcode) {
     gba_cpu_setFlags_arithmetical(result);
 }
 
-static inline void gba_cpu_thumb_neg(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_neg(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
 
     uint32_t result = -rs_v;
-    gba_cpu_flagC = gba_cpu_getCarry_sub(0, rs_v);
-    gba_cpu_flagV = gba_cpu_getOverflow_sub(0, rs_v, result);
 
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_sub(0, rs_v, result);
 
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_cmp2(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_cmp2(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
 
     uint32_t result = rd_v - rs_v;
 
-    gba_cpu_flagC = gba_cpu_getCarry_sub(rd_v, rs_v);
-    gba_cpu_flagV = gba_cpu_getOverflow_sub(rd_v, rs_v, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_sub(rd_v, rs_v, result);
 }
 
-static inline void gba_cpu_thumb_cmn(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_cmn(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
 
     uint32_t result = rd_v + rs_v;
 
-    gba_cpu_flagC = result < rd_v;
-    gba_cpu_flagV = gba_cpu_getOverflow_add(rd_v, rs_v, result);
-    gba_cpu_setFlags_arithmetical(result);
+    gba_cpu_setFlags_add(rd_v, rs_v, result);
 }
 
-static inline void gba_cpu_thumb_orr(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_orr(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2462,9 +4063,9 @@ static inline void gba_cpu_thumb_orr(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_mul(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_mul(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2476,9 +4077,9 @@ static inline void gba_cpu_thumb_mul(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_bic(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_bic(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
     uint32_t rd_v = gba_cpu_r[rd];
@@ -2490,9 +4091,9 @@ static inline void gba_cpu_thumb_bic(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_mvn(uint16_t opcode) {
-    uint16_t rs = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_mvn(const gba_cpu_thumbRecord_t *record) {
+    uint16_t rs = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rs_v = gba_cpu_r[rs];
 
@@ -2503,18 +4104,16 @@ static inline void gba_cpu_thumb_mvn(uint16_t opcode) {
     gba_cpu_r[rd] = result;
 }
 
-static inline void gba_cpu_thumb_ldrStr2(uint16_t opcode) {
-    bool b = (opcode & (1 << 12)) != 0;
-    bool l = (opcode & (1 << 11)) != 0;
-    uint16_t offset = (opcode & 0x07c0) >> 6;
-    uint16_t rb = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_ldrStr2(const gba_cpu_thumbRecord_t *record) {
+    bool b = (record->opcode & (1 << 12)) != 0;
+    bool l = (record->opcode & (1 << 11)) != 0;
+    uint16_t rb = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rb_v = gba_cpu_r[rb];
+    uint32_t addr = rb_v + record->immediate;
 
     if(b) {
-        uint32_t addr = rb_v + offset;
-
         if(l) {
             gba_cpu_r[rd] = gba_bus_read8(addr);
         } else {
@@ -2522,8 +4121,6 @@ static inline void gba_cpu_thumb_ldrStr2(uint16_t opcode) {
             gba_bus_write8(addr, rd_v);
         }
     } else {
-        uint32_t addr = rb_v + (offset << 2);
-
         if(l) {
             gba_cpu_r[rd] = gba_cpu_util_ror32(gba_bus_read32(addr), (addr & 0x00000003) << 3);
         } else {
@@ -2533,13 +4130,12 @@ static inline void gba_cpu_thumb_ldrStr2(uint16_t opcode) {
     }
 }
 
-static inline void gba_cpu_thumb_ldrStr3(uint16_t opcode) {
-    bool l = (opcode & (1 << 11)) != 0;
+static inline void gba_cpu_thumb_ldrStr3(const gba_cpu_thumbRecord_t *record) {
+    bool l = (record->opcode & (1 << 11)) != 0;
 
-    uint16_t rd = (opcode & 0x0700) >> 8;
-    uint16_t immediate = opcode & 0x00ff;
+    uint16_t rd = record->rd;
 
-    uint32_t offset = gba_cpu_r[13] + (immediate << 2);
+    uint32_t offset = gba_cpu_r[13] + record->immediate;
 
     if(l) {
         gba_cpu_r[rd] = gba_cpu_util_ror32(gba_bus_read32(offset), (offset & 0x00000003) << 3);
@@ -2549,15 +4145,14 @@ static inline void gba_cpu_thumb_ldrStr3(uint16_t opcode) {
     }
 }
 
-static inline void gba_cpu_thumb_ldrStrh2(uint16_t opcode) {
-    bool l = (opcode & (1 << 11)) != 0;
-    uint16_t offset = (opcode & 0x07c0) >> 6;
-    uint16_t rb = (opcode & 0x0038) >> 3;
-    uint16_t rd = opcode & 0x0007;
+static inline void gba_cpu_thumb_ldrStrh2(const gba_cpu_thumbRecord_t *record) {
+    bool l = (record->opcode & (1 << 11)) != 0;
+    uint16_t rb = record->rs;
+    uint16_t rd = record->rd;
 
     uint32_t rb_v = gba_cpu_r[rb];
 
-    uint32_t addr = rb_v + (offset << 1);
+    uint32_t addr = rb_v + record->immediate;
 
     if(l) {
         gba_cpu_r[rd] = gba_cpu_util_ror32(gba_bus_read16(addr), (addr & 0x00000001) << 3);
@@ -2567,21 +4162,14 @@ static inline void gba_cpu_thumb_ldrStrh2(uint16_t opcode) {
     }
 }
 
-static inline void gba_cpu_thumb_add5(uint16_t opcode) {
-    bool s = (opcode & (1 << 7)) != 0;
-    uint16_t immediate = (opcode & 0x007f) << 2;
-
-    if(s) {
-        gba_cpu_r[13] -= immediate;
-    } else {
-        gba_cpu_r[13] += immediate;
-    }
+static inline void gba_cpu_thumb_add5(const gba_cpu_thumbRecord_t *record) {
+    gba_cpu_r[13] += record->immediate;
 }
 
-static inline void gba_cpu_thumb_pushPop(uint16_t opcode) {
-    bool l = (opcode & (1 << 11)) != 0;
-    bool r = (opcode & (1 << 8)) != 0;
-    uint8_t rlist = opcode;
+static inline void gba_cpu_thumb_pushPop(const gba_cpu_thumbRecord_t *record) {
+    bool l = (record->opcode & (1 << 11)) != 0;
+    bool r = (record->opcode & (1 << 8)) != 0;
+    uint8_t rlist = record->immediate;
     uint32_t registerCount = gba_cpu_util_hammingWeight8(rlist);
 
     if(r) {
@@ -2598,6 +4186,31 @@ static inline void gba_cpu_thumb_pushPop(uint16_t opcode) {
         addr = gba_cpu_r[13];
     }
 
+    uint32_t *burst = gba_bus_getBurst32(addr, registerCount, !l);
+
+    if(burst) {
+        for(int i = 0; i < 8; i++) {
+            if(rlist & (1 << i)) {
+                if(l) {
+                    gba_cpu_r[i] = *burst++;
+                } else {
+                    *burst++ = gba_cpu_r[i];
+                }
+            }
+        }
+
+        if(r) {
+            if(l) {
+                GBA_CPU_CALLPROF(gba_callprof_return(*burst));
+                gba_cpu_performJump(*burst);
+            } else {
+                *burst = gba_cpu_r[14];
+            }
+        }
+
+        return;
+    }
+
     for(int i = 0; i < 8; i++) {
         if(rlist & (1 << i)) {
             if(l) {
@@ -2607,49 +4220,51 @@ static inline void gba_cpu_thumb_pushPop(uint16_t opcode) {
             }
 
             addr += 4;
+            gba_bus_sequential = true;
         }
     }
 
     if(r) {
         if(l) {
-            gba_cpu_performJump(gba_bus_read32(addr));
+            uint32_t dest = gba_bus_read32(addr);
+
+            GBA_CPU_CALLPROF(gba_callprof_return(dest));
+            gba_cpu_performJump(dest);
         } else {
             gba_bus_write32(addr, gba_cpu_r[14]);
         }
     }
+
+    gba_bus_sequential = false;
 }
 
-static inline void gba_cpu_thumb_add4(uint16_t opcode) {
-    bool sp = (opcode & (1 << 11));
-    uint16_t rd = (opcode & 0x07c0) >> 8;
-    uint16_t immediate = opcode & 0x00ff;
+static inline void gba_cpu_thumb_add4(const gba_cpu_thumbRecord_t *record) {
+    bool sp = (record->opcode & (1 << 11));
+    uint16_t rd = record->rd;
 
     if(sp) {
-        gba_cpu_r[rd] = gba_cpu_r[13] + (immediate << 2);
+        gba_cpu_r[rd] = gba_cpu_r[13] + record->immediate;
     } else {
-        gba_cpu_r[rd] = (gba_cpu_r[15] & 0xfffffffc) + (immediate << 2);
+        gba_cpu_r[rd] = (gba_cpu_r[15] & 0xfffffffc) + record->immediate;
     }
 }
 
-static inline void gba_cpu_thumb_swi(uint16_t opcode) {
-    UNUSED(opcode);
-
-    gba_cpu_raiseSwi();
+static inline void gba_cpu_thumb_swi(const gba_cpu_thumbRecord_t *record) {
+    gba_cpu_callSwi(record->immediate);
 }
 
-static inline void gba_cpu_thumb_b(uint16_t opcode) {
-    gba_cpu_condition_t condition = (opcode & 0x0f00) >> 8;
-    int8_t immediate = opcode;
+static inline void gba_cpu_thumb_b(const gba_cpu_thumbRecord_t *record) {
+    gba_cpu_condition_t condition = (record->opcode & 0x0f00) >> 8;
 
     if(gba_cpu_checkCondition(condition)) {
-        gba_cpu_performJump(gba_cpu_r[15] + (immediate << 1));
+        gba_cpu_performJump(gba_cpu_r[15] + record->immediate);
     }
 }
 
-static inline void gba_cpu_thumb_ldmStm(uint16_t opcode) {
-    bool l = (opcode & (1 << 11)) != 0;
-    uint16_t rb = (opcode & 0x0700) >> 8;
-    uint8_t rlist = opcode;
+static inline void gba_cpu_thumb_ldmStm(const gba_cpu_thumbRecord_t *record) {
+    bool l = (record->opcode & (1 << 11)) != 0;
+    uint16_t rb = record->rs;
+    uint8_t rlist = record->immediate;
 
     if(rlist) {
         unsigned int registerCount = gba_cpu_util_hammingWeight8(rlist);
@@ -2673,7 +4288,21 @@ static inline void gba_cpu_thumb_ldmStm(uint16_t opcode) {
             gba_cpu_r[rb] += registerCount * 4;
         }
 
-        for(int i = 0; i < 7; i++) {
+        uint32_t *burst = gba_bus_getBurst32(addr, gba_cpu_util_hammingWeight8(rlist & 0x7f), !l);
+
+        for(int i = 0; burst && i < 7; i++) {
+            if(rlist & (1 << i)) {
+                if(l) {
+                    gba_cpu_r[i] = *burst++;
+                } else {
+                    *burst++ = gba_cpu_r[i];
+                }
+
+                addr += 4;
+            }
+        }
+
+        for(int i = 0; !burst && i < 7; i++) {
             if(rlist & (1 << i)) {
                 if(l) {
                     gba_cpu_r[i] = gba_bus_read32(addr);
@@ -2682,9 +4311,11 @@ static inline void gba_cpu_thumb_ldmStm(uint16_t opcode) {
                 }
 
                 addr += 4;
+                gba_bus_sequential = true;
             }
         }
 
+        gba_bus_sequential = false;
         gba_cpu_r[rb] = addr;
     } else {
         if(l) {
@@ -2697,33 +4328,137 @@ static inline void gba_cpu_thumb_ldmStm(uint16_t opcode) {
     }
 }
 
-static inline void gba_cpu_thumb_bl(uint16_t opcode) {
-    bool h = (opcode & (1 << 11)) != 0;
-    uint32_t offset = opcode & 0x07ff;
+static inline void gba_cpu_thumb_bl(const gba_cpu_thumbRecord_t *record) {
+    bool h = (record->opcode & (1 << 11)) != 0;
 
     if(h) {
-        gba_cpu_r[14] += (offset << 1);
+        gba_cpu_r[14] += record->immediate;
         
         uint32_t pc_v = gba_cpu_r[15];
         
+        GBA_CPU_CALLPROF(gba_callprof_call(gba_cpu_r[14], pc_v - 2));
         gba_cpu_performJump(gba_cpu_r[14]);
 
         gba_cpu_r[14] = (pc_v - 2) | 0x00000001;
     } else {
-        if(opcode & (1 << 10)) {
-            offset |= 0xfffff800;
-        }
+        gba_cpu_r[14] = gba_cpu_r[15] + record->immediate;
+    }
+}
+
+// Completes the first instruction of a pair like the block executor, none of
+// them jumping, and returns false if the block would stop before the second
+// one, for an event after which an interrupt may be raised.
+static ALWAYS_INLINE bool gba_cpu_completeFused(uint32_t cycles) {
+    gba_scheduler_cycleCounter += cycles;
+    gba_cpu_r[15] += 2;
+
+    return !gba_cpu_blockInvalidated && gba_scheduler_cycleCounter < gba_scheduler_nextEventTimestamp;
+}
+
+// Evaluates a condition on the flags set by subtracting right from left,
+// which are left lazy.
+static ALWAYS_INLINE bool gba_cpu_checkCondition_sub(gba_cpu_condition_t condition, uint32_t left, uint32_t right) {
+    uint32_t result = left - right;
+
+    switch(condition) {
+        case GBA_CPU_CONDITION_EQ: return left == right;
+        case GBA_CPU_CONDITION_NE: return left != right;
+        case GBA_CPU_CONDITION_CS: return left >= right;
+        case GBA_CPU_CONDITION_CC: return left < right;
+        case GBA_CPU_CONDITION_MI: return (int32_t)result < 0;
+        case GBA_CPU_CONDITION_PL: return (int32_t)result >= 0;
+        case GBA_CPU_CONDITION_VS: return gba_cpu_getOverflow_sub(left, right, result);
+        case GBA_CPU_CONDITION_VC: return !gba_cpu_getOverflow_sub(left, right, result);
+        case GBA_CPU_CONDITION_HI: return left > right;
+        case GBA_CPU_CONDITION_LS: return left <= right;
+        case GBA_CPU_CONDITION_GE: return (int32_t)left >= (int32_t)right;
+        case GBA_CPU_CONDITION_LT: return (int32_t)left < (int32_t)right;
+        case GBA_CPU_CONDITION_GT: return (int32_t)left > (int32_t)right;
+        case GBA_CPU_CONDITION_LE: return (int32_t)left <= (int32_t)right;
+        case GBA_CPU_CONDITION_AL: return true;
+        default: return false;
+    }
+}
+
+static ALWAYS_INLINE void gba_cpu_branchOnCompare(const gba_cpu_thumbRecord_t *record, uint32_t left, uint32_t right) {
+    if(gba_cpu_checkCondition_sub((record->opcode & 0x0f00) >> 8, left, right)) {
+        gba_cpu_performJump(gba_cpu_r[15] + record->immediate);
+    }
+}
+
+static inline bool gba_cpu_fused_bl(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles) {
+    GBA_CPU_PROFILE_THUMB(first->opcode, gba_cpu_thumb_bl(first));
+
+    if(!gba_cpu_completeFused(cycles)) {
+        return false;
+    }
+
+    GBA_CPU_PROFILE_THUMB(second->opcode, gba_cpu_thumb_bl(second));
+    gba_cpu_fusionCounts[GBA_CPU_FUSION_BL]++;
+
+    return true;
+}
+
+static inline bool gba_cpu_fused_cmpB(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles) {
+    uint32_t left = gba_cpu_r[first->rd];
+
+    GBA_CPU_PROFILE_THUMB(first->opcode, gba_cpu_thumb_cmp(first));
+
+    if(!gba_cpu_completeFused(cycles)) {
+        return false;
+    }
+
+    GBA_CPU_PROFILE_THUMB(second->opcode, gba_cpu_branchOnCompare(second, left, first->immediate));
+    gba_cpu_fusionCounts[GBA_CPU_FUSION_CMP_B]++;
 
-        gba_cpu_r[14] = gba_cpu_r[15] + (offset << 12);
+    return true;
+}
+
+static inline bool gba_cpu_fused_cmp2B(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles) {
+    uint32_t left = gba_cpu_r[first->rd];
+    uint32_t right = gba_cpu_r[first->rs];
+
+    GBA_CPU_PROFILE_THUMB(first->opcode, gba_cpu_thumb_cmp2(first));
+
+    if(!gba_cpu_completeFused(cycles)) {
+        return false;
+    }
+
+    GBA_CPU_PROFILE_THUMB(second->opcode, gba_cpu_branchOnCompare(second, left, right));
+    gba_cpu_fusionCounts[GBA_CPU_FUSION_CMP_B]++;
+
+    return true;
+}
+
+static inline bool gba_cpu_fused_cmp3B(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles) {
+    uint32_t left = gba_cpu_r[first->rd];
+    uint32_t right = gba_cpu_r[first->rs];
+
+    GBA_CPU_PROFILE_THUMB(first->opcode, gba_cpu_thumb_cmp3(first));
+
+    if(!gba_cpu_completeFused(cycles)) {
+        return false;
     }
+
+    GBA_CPU_PROFILE_THUMB(second->opcode, gba_cpu_branchOnCompare(second, left, right));
+    gba_cpu_fusionCounts[GBA_CPU_FUSION_CMP_B]++;
+
+    return true;
 }
 
-static inline void gba_cpu_thumb_b2(uint16_t opcode) {
-    uint32_t immediate = opcode & 0x07ff;
+static inline bool gba_cpu_fused_ldrBx(const gba_cpu_thumbRecord_t *first, const gba_cpu_thumbRecord_t *second, uint32_t cycles) {
+    GBA_CPU_PROFILE_THUMB(first->opcode, gba_cpu_thumb_ldr(first));
 
-    if(opcode & (1 << 10)) {
-        immediate |= 0xfffff800;
+    if(!gba_cpu_completeFused(cycles)) {
+        return false;
     }
 
-    gba_cpu_performJump(gba_cpu_r[15] + (immediate << 1));
+    GBA_CPU_PROFILE_THUMB(second->opcode, gba_cpu_thumb_bx(second));
+    gba_cpu_fusionCounts[GBA_CPU_FUSION_LDR_BX]++;
+
+    return true;
+}
+
+static inline void gba_cpu_thumb_b2(const gba_cpu_thumbRecord_t *record) {
+    gba_cpu_performJump(gba_cpu_r[15] + record->immediate);
 }
@@ -2,9 +2,134 @@
 #define __CORE_CPU_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef GBA_CPU_PROFILE
+#include <stdio.h>
+#endif
+
+#define GBA_CPU_BLOCK_MAX_LENGTH 32
+
+typedef enum {
+    GBA_CPU_BACKEND_INTERPRETER,
+    GBA_CPU_BACKEND_CACHED,
+    GBA_CPU_BACKEND_JIT
+} gba_cpu_backend_t;
+
+// Instruction formats, as classified by the decode tables. The Thumb ones
+// follow the numbering of the ARM7TDMI data sheet.
+typedef enum {
+    GBA_CPU_FORMAT_UNDEFINED,
+    GBA_CPU_FORMAT_ARM_DATAPROCESSING,
+    GBA_CPU_FORMAT_ARM_PSRTRANSFER,
+    GBA_CPU_FORMAT_ARM_MUL,
+    GBA_CPU_FORMAT_ARM_MULL,
+    GBA_CPU_FORMAT_ARM_SWP,
+    GBA_CPU_FORMAT_ARM_BX,
+    GBA_CPU_FORMAT_ARM_HALFWORDSIGNEDDATATRANSFER,
+    GBA_CPU_FORMAT_ARM_SINGLEDATATRANSFER,
+    GBA_CPU_FORMAT_ARM_BLOCKDATATRANSFER,
+    GBA_CPU_FORMAT_ARM_B,
+    GBA_CPU_FORMAT_ARM_SWI,
+    GBA_CPU_FORMAT_THUMB_MOVESHIFTED, // 1
+    GBA_CPU_FORMAT_THUMB_ADDSUB, // 2
+    GBA_CPU_FORMAT_THUMB_IMMEDIATE, // 3
+    GBA_CPU_FORMAT_THUMB_ALU, // 4
+    GBA_CPU_FORMAT_THUMB_HIREGISTER, // 5
+    GBA_CPU_FORMAT_THUMB_PCLOAD, // 6
+    GBA_CPU_FORMAT_THUMB_REGISTEROFFSET, // 7
+    GBA_CPU_FORMAT_THUMB_SIGNEDTRANSFER, // 8
+    GBA_CPU_FORMAT_THUMB_IMMEDIATEOFFSET, // 9
+    GBA_CPU_FORMAT_THUMB_HALFWORDTRANSFER, // 10
+    GBA_CPU_FORMAT_THUMB_SPTRANSFER, // 11
+    GBA_CPU_FORMAT_THUMB_LOADADDRESS, // 12
+    GBA_CPU_FORMAT_THUMB_SPADD, // 13
+    GBA_CPU_FORMAT_THUMB_PUSHPOP, // 14
+    GBA_CPU_FORMAT_THUMB_BLOCKTRANSFER, // 15
+    GBA_CPU_FORMAT_THUMB_CONDITIONALBRANCH, // 16
+    GBA_CPU_FORMAT_THUMB_SWI, // 17
+    GBA_CPU_FORMAT_THUMB_BRANCH, // 18
+    GBA_CPU_FORMAT_THUMB_LONGBRANCH // 19
+} gba_cpu_format_t;
+
+// Pairs of Thumb instructions that the cached backend executes as a single
+// operation.
+typedef enum {
+    GBA_CPU_FUSION_BL, // Both halves of BL
+    GBA_CPU_FUSION_CMP_B, // CMP, then a conditional branch
+    GBA_CPU_FUSION_LDR_BX, // Literal load, then BX to the loaded address
+    GBA_CPU_FUSION_COUNT
+} gba_cpu_fusion_t;
+
+// State as defined by the architecture, whatever the backend and the
+// pipeline state, for comparing the backends.
+typedef struct {
+    uint32_t r[16]; // r15 holds the address of the next instruction
+    uint32_t cpsr;
+    uint32_t spsr;
+} gba_cpu_state_t;
+
+// A block of ROM code compiled ahead of time to C by gbaaot. It replaces
+// the cached block starting at the same address in the same state when
+// that block has the same length and the opcodes match the hash. The
+// function runs the block like the cached backend, given the fetch cycles
+// of its instructions.
+typedef void gba_cpu_aotFunction_t(uint32_t cycles);
+
+typedef struct {
+    uint32_t address;
+    bool thumb;
+    int length;
+    uint32_t hash; // FNV-1a of the bytes of the block
+    gba_cpu_aotFunction_t *function;
+} gba_cpu_aotBlock_t;
+
+// Cached blocks bound to a block compiled ahead of time since the blocks
+// were set.
+extern uint64_t gba_cpu_aotHits;
+
+// CPU state accessed directly by the code generated by the JIT and gbaaot.
+extern uint32_t gba_cpu_r[16];
+extern bool gba_cpu_flagN;
+extern bool gba_cpu_flagZ;
+extern bool gba_cpu_flagC;
+extern bool gba_cpu_flagV;
+extern bool gba_cpu_blockInvalidated;
+
+// Cycles skipped in idle loops since the last reset.
+extern uint64_t gba_cpu_idleSkippedCycles;
+
+// Pairs executed as a single operation since the last reset. The pairs
+// split by an event are not counted.
+extern uint64_t gba_cpu_fusionCounts[GBA_CPU_FUSION_COUNT];
 
 extern void gba_cpu_init();
 extern void gba_cpu_reset(bool skipBoot);
 extern void gba_cpu_cycle();
+extern void gba_cpu_run();
+extern bool gba_cpu_setBackend(gba_cpu_backend_t backend);
+extern void gba_cpu_invalidateCode(uint32_t address);
+extern void gba_cpu_invalidateCycles();
+extern void gba_cpu_halt(bool stop);
+extern void gba_cpu_setIdleLoopSkipping(bool enabled);
+extern void gba_cpu_setPipelineEmulation(bool enabled);
+extern void gba_cpu_setFusion(bool enabled);
+extern bool gba_cpu_addIdleLoop(uint32_t address);
+extern void gba_cpu_clearIdleLoops();
+extern void gba_cpu_setAotBlocks(const gba_cpu_aotBlock_t *blocks, size_t count);
+extern uint32_t gba_cpu_hashAotBlock(const uint8_t *buffer, size_t size);
+extern size_t gba_cpu_setPredecodeLimit(size_t size);
+extern int gba_cpu_getPredecodedPageCount();
+extern gba_cpu_format_t gba_cpu_getFormatArm(uint32_t opcode);
+extern gba_cpu_format_t gba_cpu_getFormatThumb(uint16_t opcode);
+extern void gba_cpu_getState(gba_cpu_state_t *state);
+#ifdef GBA_CPU_PROFILE
+extern void gba_cpu_printProfile(FILE *file);
+#endif
+extern bool gba_cpu_jitCheckCondition(uint32_t condition);
+extern void gba_cpu_jitJump(uint32_t address);
+extern bool gba_cpu_jitInterpretArm(uint32_t opcode);
+extern bool gba_cpu_jitInterpretThumb(uint32_t opcode);
 
 #endif
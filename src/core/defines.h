@@ -7,6 +7,10 @@
 #define GBA_SCREEN_WIDTH 240
 #define GBA_SCREEN_HEIGHT 160
 
+#define GBA_PPU_HDRAW_CYCLES 960
+#define GBA_PPU_HBLANK_CYCLES 272
+#define GBA_PPU_LINE_COUNT 228
+
 #define GBA_EWRAM_SIZE 262144
 #define GBA_IWRAM_SIZE 32768
 #define GBA_PALETTE_SIZE 1024
@@ -0,0 +1,643 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/cpu.h"
+#include "core/disasm.h"
+
+// The text is built with plain stores rather than snprintf(), which is too
+// slow to annotate long traces.
+typedef struct {
+    char *pointer;
+} gba_disasm_output_t;
+
+static const char *const gba_disasm_conditions[16] = {
+    "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
+    "hi", "ls", "ge", "lt", "gt", "le", "", "nv"
+};
+
+static const char *const gba_disasm_registers[16] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc"
+};
+
+static const char *const gba_disasm_dataProcessing[16] = {
+    "and", "eor", "sub", "rsb", "add", "adc", "sbc", "rsc",
+    "tst", "teq", "cmp", "cmn", "orr", "mov", "bic", "mvn"
+};
+
+static const char *const gba_disasm_shifts[4] = {
+    "lsl", "lsr", "asr", "ror"
+};
+
+static const char *const gba_disasm_blockModes[4] = {
+    "da", "ia", "db", "ib"
+};
+
+size_t gba_disasm_arm(uint32_t address, uint32_t opcode, char *buffer);
+size_t gba_disasm_thumb(uint32_t address, uint32_t opcode, char *buffer);
+static inline void gba_disasm_arm_dataProcessing(gba_disasm_output_t *output, uint32_t opcode, const char *condition);
+static inline void gba_disasm_arm_psrTransfer(gba_disasm_output_t *output, uint32_t opcode, const char *condition);
+static inline void gba_disasm_arm_halfwordSignedDataTransfer(gba_disasm_output_t *output, uint32_t opcode, const char *condition);
+static inline void gba_disasm_arm_singleDataTransfer(gba_disasm_output_t *output, uint32_t address, uint32_t opcode, const char *condition);
+static inline void gba_disasm_arm_blockDataTransfer(gba_disasm_output_t *output, uint32_t opcode, const char *condition);
+static inline void gba_disasm_thumb_alu(gba_disasm_output_t *output, uint16_t opcode);
+static inline void gba_disasm_thumb_hiRegister(gba_disasm_output_t *output, uint16_t opcode);
+static inline void gba_disasm_thumb_transfer(gba_disasm_output_t *output, uint16_t opcode, gba_cpu_format_t format);
+static inline void gba_disasm_append(gba_disasm_output_t *output, const char *string);
+static inline void gba_disasm_appendRegister(gba_disasm_output_t *output, int r);
+static inline void gba_disasm_appendDecimal(gba_disasm_output_t *output, uint32_t value);
+static inline void gba_disasm_appendHex(gba_disasm_output_t *output, uint32_t value);
+static inline void gba_disasm_appendImmediate(gba_disasm_output_t *output, uint32_t value);
+static inline void gba_disasm_appendOffset(gba_disasm_output_t *output, bool up, uint32_t value);
+static inline void gba_disasm_appendRegisterList(gba_disasm_output_t *output, uint16_t list);
+static inline void gba_disasm_appendShift(gba_disasm_output_t *output, uint32_t opcode);
+
+size_t gba_disasm_arm(uint32_t address, uint32_t opcode, char *buffer) {
+    gba_disasm_output_t output = {buffer};
+    const char *condition = gba_disasm_conditions[opcode >> 28];
+
+    switch(gba_cpu_getFormatArm(opcode)) {
+        case GBA_CPU_FORMAT_ARM_DATAPROCESSING:
+            gba_disasm_arm_dataProcessing(&output, opcode, condition);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_PSRTRANSFER:
+            gba_disasm_arm_psrTransfer(&output, opcode, condition);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_MUL:
+            gba_disasm_append(&output, (opcode & (1 << 21)) ? "mla" : "mul");
+            gba_disasm_append(&output, (opcode & (1 << 20)) ? "s" : "");
+            gba_disasm_append(&output, condition);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendRegister(&output, (opcode >> 16) & 0xf);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, opcode & 0xf);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, (opcode >> 8) & 0xf);
+
+            if(opcode & (1 << 21)) {
+                gba_disasm_append(&output, ", ");
+                gba_disasm_appendRegister(&output, (opcode >> 12) & 0xf);
+            }
+
+            break;
+
+        case GBA_CPU_FORMAT_ARM_MULL:
+            gba_disasm_append(&output, (opcode & (1 << 22)) ? "s" : "u");
+            gba_disasm_append(&output, (opcode & (1 << 21)) ? "mlal" : "mull");
+            gba_disasm_append(&output, (opcode & (1 << 20)) ? "s" : "");
+            gba_disasm_append(&output, condition);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendRegister(&output, (opcode >> 12) & 0xf);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, (opcode >> 16) & 0xf);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, opcode & 0xf);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, (opcode >> 8) & 0xf);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_SWP:
+            gba_disasm_append(&output, "swp");
+            gba_disasm_append(&output, (opcode & (1 << 22)) ? "b" : "");
+            gba_disasm_append(&output, condition);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendRegister(&output, (opcode >> 12) & 0xf);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, opcode & 0xf);
+            gba_disasm_append(&output, ", [");
+            gba_disasm_appendRegister(&output, (opcode >> 16) & 0xf);
+            gba_disasm_append(&output, "]");
+            break;
+
+        case GBA_CPU_FORMAT_ARM_BX:
+            gba_disasm_append(&output, "bx");
+            gba_disasm_append(&output, condition);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendRegister(&output, opcode & 0xf);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_HALFWORDSIGNEDDATATRANSFER:
+            gba_disasm_arm_halfwordSignedDataTransfer(&output, opcode, condition);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_SINGLEDATATRANSFER:
+            gba_disasm_arm_singleDataTransfer(&output, address, opcode, condition);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_BLOCKDATATRANSFER:
+            gba_disasm_arm_blockDataTransfer(&output, opcode, condition);
+            break;
+
+        case GBA_CPU_FORMAT_ARM_B:
+            gba_disasm_append(&output, (opcode & (1 << 24)) ? "bl" : "b");
+            gba_disasm_append(&output, condition);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendHex(&output, address + 8 + ((int32_t)(opcode << 8) >> 6));
+            break;
+
+        case GBA_CPU_FORMAT_ARM_SWI:
+            gba_disasm_append(&output, "swi");
+            gba_disasm_append(&output, condition);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendImmediate(&output, opcode & 0x00ffffff);
+            break;
+
+        default:
+            gba_disasm_append(&output, "undefined");
+            break;
+    }
+
+    *output.pointer = '\0';
+
+    return 4;
+}
+
+size_t gba_disasm_thumb(uint32_t address, uint32_t opcode, char *buffer) {
+    static const char *const shifts[3] = {"lsl", "lsr", "asr"};
+    static const char *const immediates[4] = {"mov", "cmp", "add", "sub"};
+
+    gba_disasm_output_t output = {buffer};
+    uint16_t next = opcode >> 16;
+    size_t size = 2;
+    int rd = opcode & 0x7;
+    int rs = (opcode >> 3) & 0x7;
+    int rn = (opcode >> 6) & 0x7;
+    int rh = (opcode >> 8) & 0x7;
+
+    opcode &= 0xffff;
+
+    gba_cpu_format_t format = gba_cpu_getFormatThumb(opcode);
+
+    switch(format) {
+        case GBA_CPU_FORMAT_THUMB_MOVESHIFTED: {
+            uint32_t amount = (opcode >> 6) & 0x1f;
+
+            gba_disasm_append(&output, shifts[(opcode >> 11) & 0x3]);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendRegister(&output, rd);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, rs);
+            gba_disasm_append(&output, ", #");
+            gba_disasm_appendDecimal(&output, (amount == 0 && (opcode & 0x1800)) ? 32 : amount);
+            break;
+        }
+
+        case GBA_CPU_FORMAT_THUMB_ADDSUB:
+            gba_disasm_append(&output, (opcode & (1 << 9)) ? "sub " : "add ");
+            gba_disasm_appendRegister(&output, rd);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendRegister(&output, rs);
+            gba_disasm_append(&output, ", ");
+
+            if(opcode & (1 << 10)) {
+                gba_disasm_appendImmediate(&output, rn);
+            } else {
+                gba_disasm_appendRegister(&output, rn);
+            }
+
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_IMMEDIATE:
+            gba_disasm_append(&output, immediates[(opcode >> 11) & 0x3]);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendRegister(&output, rh);
+            gba_disasm_append(&output, ", ");
+            gba_disasm_appendImmediate(&output, opcode & 0xff);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_ALU:
+            gba_disasm_thumb_alu(&output, opcode);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_HIREGISTER:
+            gba_disasm_thumb_hiRegister(&output, opcode);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_PCLOAD:
+            gba_disasm_append(&output, "ldr ");
+            gba_disasm_appendRegister(&output, rh);
+            gba_disasm_append(&output, ", [pc, ");
+            gba_disasm_appendImmediate(&output, (opcode & 0xff) << 2);
+            gba_disasm_append(&output, "] ; ");
+            gba_disasm_appendHex(&output, ((address + 4) & ~2) + ((opcode & 0xff) << 2));
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_REGISTEROFFSET:
+        case GBA_CPU_FORMAT_THUMB_SIGNEDTRANSFER:
+        case GBA_CPU_FORMAT_THUMB_IMMEDIATEOFFSET:
+        case GBA_CPU_FORMAT_THUMB_HALFWORDTRANSFER:
+        case GBA_CPU_FORMAT_THUMB_SPTRANSFER:
+            gba_disasm_thumb_transfer(&output, opcode, format);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_LOADADDRESS:
+            gba_disasm_append(&output, "add ");
+            gba_disasm_appendRegister(&output, rh);
+            gba_disasm_append(&output, (opcode & (1 << 11)) ? ", sp, " : ", pc, ");
+            gba_disasm_appendImmediate(&output, (opcode & 0xff) << 2);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_SPADD:
+            gba_disasm_append(&output, "add sp, ");
+            gba_disasm_appendOffset(&output, !(opcode & (1 << 7)), (opcode & 0x7f) << 2);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_PUSHPOP: {
+            uint16_t list = opcode & 0xff;
+
+            if(opcode & (1 << 8)) {
+                list |= (opcode & (1 << 11)) ? (1 << 15) : (1 << 14);
+            }
+
+            gba_disasm_append(&output, (opcode & (1 << 11)) ? "pop " : "push ");
+            gba_disasm_appendRegisterList(&output, list);
+            break;
+        }
+
+        case GBA_CPU_FORMAT_THUMB_BLOCKTRANSFER:
+            gba_disasm_append(&output, (opcode & (1 << 11)) ? "ldmia " : "stmia ");
+            gba_disasm_appendRegister(&output, rh);
+            gba_disasm_append(&output, "!, ");
+            gba_disasm_appendRegisterList(&output, opcode & 0xff);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_CONDITIONALBRANCH:
+            gba_disasm_append(&output, "b");
+            gba_disasm_append(&output, gba_disasm_conditions[(opcode >> 8) & 0xf]);
+            gba_disasm_append(&output, " ");
+            gba_disasm_appendHex(&output, address + 4 + (int8_t)(opcode & 0xff) * 2);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_SWI:
+            gba_disasm_append(&output, "swi ");
+            gba_disasm_appendImmediate(&output, opcode & 0xff);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_BRANCH:
+            gba_disasm_append(&output, "b ");
+            gba_disasm_appendHex(&output, address + 4 + ((int32_t)(opcode << 21) >> 20));
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_LONGBRANCH:
+            if(opcode & (1 << 11)) {
+                gba_disasm_append(&output, "bl suffix ");
+                gba_disasm_appendImmediate(&output, (opcode & 0x7ff) << 1);
+            } else if((next & 0xf800) == 0xf800) {
+                gba_disasm_append(&output, "bl ");
+                gba_disasm_appendHex(&output, address + 4 + ((int32_t)(opcode << 21) >> 9) + ((next & 0x7ff) << 1));
+                size = 4;
+            } else {
+                int32_t offset = (int32_t)(opcode << 21) >> 9;
+
+                gba_disasm_append(&output, "bl prefix ");
+                gba_disasm_appendOffset(&output, offset >= 0, offset >= 0 ? offset : -offset);
+            }
+
+            break;
+
+        default:
+            gba_disasm_append(&output, "undefined");
+            break;
+    }
+
+    *output.pointer = '\0';
+
+    return size;
+}
+
+static inline void gba_disasm_arm_dataProcessing(gba_disasm_output_t *output, uint32_t opcode, const char *condition) {
+    int operation = (opcode >> 21) & 0xf;
+    bool test = (operation & 0xc) == 0x8;
+    bool move = (operation & 0xd) == 0xd;
+
+    gba_disasm_append(output, gba_disasm_dataProcessing[operation]);
+    gba_disasm_append(output, ((opcode & (1 << 20)) && !test) ? "s" : "");
+    gba_disasm_append(output, condition);
+    gba_disasm_append(output, " ");
+
+    if(!test) {
+        gba_disasm_appendRegister(output, (opcode >> 12) & 0xf);
+        gba_disasm_append(output, ", ");
+    }
+
+    if(!move) {
+        gba_disasm_appendRegister(output, (opcode >> 16) & 0xf);
+        gba_disasm_append(output, ", ");
+    }
+
+    if(opcode & (1 << 25)) {
+        int rotation = (opcode >> 7) & 0x1e;
+        uint32_t value = opcode & 0xff;
+
+        gba_disasm_appendImmediate(output, rotation ? (value >> rotation) | (value << (32 - rotation)) : value);
+    } else {
+        gba_disasm_appendShift(output, opcode);
+    }
+}
+
+static inline void gba_disasm_arm_psrTransfer(gba_disasm_output_t *output, uint32_t opcode, const char *condition) {
+    const char *psr = (opcode & (1 << 22)) ? "spsr" : "cpsr";
+
+    if(!(opcode & (1 << 21))) {
+        gba_disasm_append(output, "mrs");
+        gba_disasm_append(output, condition);
+        gba_disasm_append(output, " ");
+        gba_disasm_appendRegister(output, (opcode >> 12) & 0xf);
+        gba_disasm_append(output, ", ");
+        gba_disasm_append(output, psr);
+        return;
+    }
+
+    gba_disasm_append(output, "msr");
+    gba_disasm_append(output, condition);
+    gba_disasm_append(output, " ");
+    gba_disasm_append(output, psr);
+    gba_disasm_append(output, "_");
+    gba_disasm_append(output, (opcode & (1 << 16)) ? "c" : "");
+    gba_disasm_append(output, (opcode & (1 << 17)) ? "x" : "");
+    gba_disasm_append(output, (opcode & (1 << 18)) ? "s" : "");
+    gba_disasm_append(output, (opcode & (1 << 19)) ? "f" : "");
+    gba_disasm_append(output, ", ");
+
+    if(opcode & (1 << 25)) {
+        int rotation = (opcode >> 7) & 0x1e;
+        uint32_t value = opcode & 0xff;
+
+        gba_disasm_appendImmediate(output, rotation ? (value >> rotation) | (value << (32 - rotation)) : value);
+    } else {
+        gba_disasm_appendRegister(output, opcode & 0xf);
+    }
+}
+
+static inline void gba_disasm_arm_halfwordSignedDataTransfer(gba_disasm_output_t *output, uint32_t opcode, const char *condition) {
+    static const char *const loads[4] = {"ldr", "ldrh", "ldrsb", "ldrsh"};
+
+    bool preIndexed = opcode & (1 << 24);
+    bool up = opcode & (1 << 23);
+
+    gba_disasm_append(output, (opcode & (1 << 20)) ? loads[(opcode >> 5) & 0x3] : "strh");
+    gba_disasm_append(output, condition);
+    gba_disasm_append(output, " ");
+    gba_disasm_appendRegister(output, (opcode >> 12) & 0xf);
+    gba_disasm_append(output, ", [");
+    gba_disasm_appendRegister(output, (opcode >> 16) & 0xf);
+
+    if(preIndexed && (opcode & (1 << 22)) && !(opcode & 0xf0f)) {
+        gba_disasm_append(output, (opcode & (1 << 21)) ? "]!" : "]");
+        return;
+    }
+
+    gba_disasm_append(output, preIndexed ? ", " : "], ");
+
+    if(opcode & (1 << 22)) {
+        gba_disasm_appendOffset(output, up, ((opcode >> 4) & 0xf0) | (opcode & 0xf));
+    } else {
+        gba_disasm_append(output, up ? "" : "-");
+        gba_disasm_appendRegister(output, opcode & 0xf);
+    }
+
+    if(preIndexed) {
+        gba_disasm_append(output, (opcode & (1 << 21)) ? "]!" : "]");
+    }
+}
+
+static inline void gba_disasm_arm_singleDataTransfer(gba_disasm_output_t *output, uint32_t address, uint32_t opcode, const char *condition) {
+    bool preIndexed = opcode & (1 << 24);
+    bool up = opcode & (1 << 23);
+
+    gba_disasm_append(output, (opcode & (1 << 20)) ? "ldr" : "str");
+    gba_disasm_append(output, (opcode & (1 << 22)) ? "b" : "");
+    gba_disasm_append(output, (!preIndexed && (opcode & (1 << 21))) ? "t" : "");
+    gba_disasm_append(output, condition);
+    gba_disasm_append(output, " ");
+    gba_disasm_appendRegister(output, (opcode >> 12) & 0xf);
+    gba_disasm_append(output, ", [");
+    gba_disasm_appendRegister(output, (opcode >> 16) & 0xf);
+
+    if(preIndexed && !(opcode & ((1 << 25) | 0xfff))) {
+        gba_disasm_append(output, (opcode & (1 << 21)) ? "]!" : "]");
+        return;
+    }
+
+    gba_disasm_append(output, preIndexed ? ", " : "], ");
+
+    if(opcode & (1 << 25)) {
+        gba_disasm_append(output, up ? "" : "-");
+        gba_disasm_appendShift(output, opcode);
+    } else {
+        gba_disasm_appendOffset(output, up, opcode & 0xfff);
+    }
+
+    if(preIndexed) {
+        gba_disasm_append(output, (opcode & (1 << 21)) ? "]!" : "]");
+    }
+
+    // Literal pool loads
+    if(preIndexed && !(opcode & (1 << 25)) && ((opcode >> 16) & 0xf) == 15) {
+        gba_disasm_append(output, " ; ");
+        gba_disasm_appendHex(output, up ? address + 8 + (opcode & 0xfff) : address + 8 - (opcode & 0xfff));
+    }
+}
+
+static inline void gba_disasm_arm_blockDataTransfer(gba_disasm_output_t *output, uint32_t opcode, const char *condition) {
+    gba_disasm_append(output, (opcode & (1 << 20)) ? "ldm" : "stm");
+    gba_disasm_append(output, gba_disasm_blockModes[(opcode >> 23) & 0x3]);
+    gba_disasm_append(output, condition);
+    gba_disasm_append(output, " ");
+    gba_disasm_appendRegister(output, (opcode >> 16) & 0xf);
+    gba_disasm_append(output, (opcode & (1 << 21)) ? "!, " : ", ");
+    gba_disasm_appendRegisterList(output, opcode & 0xffff);
+    gba_disasm_append(output, (opcode & (1 << 22)) ? "^" : "");
+}
+
+static inline void gba_disasm_thumb_alu(gba_disasm_output_t *output, uint16_t opcode) {
+    static const char *const operations[16] = {
+        "and", "eor", "lsl", "lsr", "asr", "adc", "sbc", "ror",
+        "tst", "neg", "cmp", "cmn", "orr", "mul", "bic", "mvn"
+    };
+
+    gba_disasm_append(output, operations[(opcode >> 6) & 0xf]);
+    gba_disasm_append(output, " ");
+    gba_disasm_appendRegister(output, opcode & 0x7);
+    gba_disasm_append(output, ", ");
+    gba_disasm_appendRegister(output, (opcode >> 3) & 0x7);
+}
+
+static inline void gba_disasm_thumb_hiRegister(gba_disasm_output_t *output, uint16_t opcode) {
+    static const char *const operations[4] = {"add ", "cmp ", "mov ", "bx "};
+
+    int rd = (opcode & 0x7) | ((opcode >> 4) & 0x8);
+    int rs = (opcode >> 3) & 0xf;
+    int operation = (opcode >> 8) & 0x3;
+
+    gba_disasm_append(output, operations[operation]);
+
+    if(operation != 3) {
+        gba_disasm_appendRegister(output, rd);
+        gba_disasm_append(output, ", ");
+    }
+
+    gba_disasm_appendRegister(output, rs);
+}
+
+static inline void gba_disasm_thumb_transfer(gba_disasm_output_t *output, uint16_t opcode, gba_cpu_format_t format) {
+    static const char *const registerOffset[4] = {"str", "strb", "ldr", "ldrb"};
+    static const char *const signedTransfer[4] = {"strh", "ldrsb", "ldrh", "ldrsh"};
+    static const char *const immediateOffset[4] = {"str", "ldr", "strb", "ldrb"};
+
+    int rd = opcode & 0x7;
+    int rb = (opcode >> 3) & 0x7;
+    bool load = opcode & (1 << 11);
+
+    switch(format) {
+        case GBA_CPU_FORMAT_THUMB_REGISTEROFFSET:
+        case GBA_CPU_FORMAT_THUMB_SIGNEDTRANSFER:
+            gba_disasm_append(output, (format == GBA_CPU_FORMAT_THUMB_REGISTEROFFSET ? registerOffset : signedTransfer)[(opcode >> 10) & 0x3]);
+            gba_disasm_append(output, " ");
+            gba_disasm_appendRegister(output, rd);
+            gba_disasm_append(output, ", [");
+            gba_disasm_appendRegister(output, rb);
+            gba_disasm_append(output, ", ");
+            gba_disasm_appendRegister(output, (opcode >> 6) & 0x7);
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_IMMEDIATEOFFSET:
+            gba_disasm_append(output, immediateOffset[(opcode >> 11) & 0x3]);
+            gba_disasm_append(output, " ");
+            gba_disasm_appendRegister(output, rd);
+            gba_disasm_append(output, ", [");
+            gba_disasm_appendRegister(output, rb);
+
+            if(opcode & 0x07c0) {
+                gba_disasm_append(output, ", ");
+                gba_disasm_appendImmediate(output, ((opcode >> 6) & 0x1f) << ((opcode & (1 << 12)) ? 0 : 2));
+            }
+
+            break;
+
+        case GBA_CPU_FORMAT_THUMB_HALFWORDTRANSFER:
+            gba_disasm_append(output, load ? "ldrh " : "strh ");
+            gba_disasm_appendRegister(output, rd);
+            gba_disasm_append(output, ", [");
+            gba_disasm_appendRegister(output, rb);
+
+            if(opcode & 0x07c0) {
+                gba_disasm_append(output, ", ");
+                gba_disasm_appendImmediate(output, ((opcode >> 6) & 0x1f) << 1);
+            }
+
+            break;
+
+        default:
+            gba_disasm_append(output, load ? "ldr " : "str ");
+            gba_disasm_appendRegister(output, (opcode >> 8) & 0x7);
+            gba_disasm_append(output, ", [sp, ");
+            gba_disasm_appendImmediate(output, (opcode & 0xff) << 2);
+            break;
+    }
+
+    gba_disasm_append(output, "]");
+}
+
+static inline void gba_disasm_append(gba_disasm_output_t *output, const char *string) {
+    while(*string) {
+        *output->pointer++ = *string++;
+    }
+}
+
+static inline void gba_disasm_appendRegister(gba_disasm_output_t *output, int r) {
+    gba_disasm_append(output, gba_disasm_registers[r]);
+}
+
+static inline void gba_disasm_appendDecimal(gba_disasm_output_t *output, uint32_t value) {
+    if(value >= 10) {
+        *output->pointer++ = '0' + value / 10;
+    }
+
+    *output->pointer++ = '0' + value % 10;
+}
+
+static inline void gba_disasm_appendHex(gba_disasm_output_t *output, uint32_t value) {
+    static const char digits[] = "0123456789abcdef";
+
+    int shift = 28;
+
+    while(shift > 0 && !(value >> shift)) {
+        shift -= 4;
+    }
+
+    *output->pointer++ = '0';
+    *output->pointer++ = 'x';
+
+    for(; shift >= 0; shift -= 4) {
+        *output->pointer++ = digits[(value >> shift) & 0xf];
+    }
+}
+
+static inline void gba_disasm_appendImmediate(gba_disasm_output_t *output, uint32_t value) {
+    *output->pointer++ = '#';
+    gba_disasm_appendHex(output, value);
+}
+
+static inline void gba_disasm_appendOffset(gba_disasm_output_t *output, bool up, uint32_t value) {
+    gba_disasm_append(output, up ? "#" : "#-");
+    gba_disasm_appendHex(output, value);
+}
+
+// Consecutive registers are shown as ranges.
+static inline void gba_disasm_appendRegisterList(gba_disasm_output_t *output, uint16_t list) {
+    bool first = true;
+
+    *output->pointer++ = '{';
+
+    for(int r = 0; r < 16; r++) {
+        if(!(list & (1 << r))) {
+            continue;
+        }
+
+        int last = r;
+
+        while(last < 15 && (list & (1 << (last + 1)))) {
+            last++;
+        }
+
+        gba_disasm_append(output, first ? "" : ", ");
+        gba_disasm_appendRegister(output, r);
+
+        if(last > r) {
+            gba_disasm_append(output, last > r + 1 ? "-" : ", ");
+            gba_disasm_appendRegister(output, last);
+        }
+
+        first = false;
+        r = last;
+    }
+
+    *output->pointer++ = '}';
+}
+
+// Register operand shifted by an immediate or a register, like the operand 2
+// of data processing instructions.
+static inline void gba_disasm_appendShift(gba_disasm_output_t *output, uint32_t opcode) {
+    int type = (opcode >> 5) & 0x3;
+    uint32_t amount = (opcode >> 7) & 0x1f;
+
+    gba_disasm_appendRegister(output, opcode & 0xf);
+
+    if(opcode & (1 << 4)) {
+        gba_disasm_append(output, ", ");
+        gba_disasm_append(output, gba_disasm_shifts[type]);
+        gba_disasm_append(output, " ");
+        gba_disasm_appendRegister(output, (opcode >> 8) & 0xf);
+    } else if(amount == 0 && type == 3) {
+        gba_disasm_append(output, ", rrx");
+    } else if(amount != 0 || type != 0) {
+        gba_disasm_append(output, ", ");
+        gba_disasm_append(output, gba_disasm_shifts[type]);
+        gba_disasm_append(output, " #");
+        gba_disasm_appendDecimal(output, amount ? amount : 32);
+    }
+}
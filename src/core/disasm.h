@@ -0,0 +1,17 @@
+#ifndef __CORE_DISASM_H__
+#define __CORE_DISASM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of the buffers receiving the text of an instruction, which is always
+// shorter.
+#define GBA_DISASM_BUFFER_SIZE 80
+
+// Both functions return the number of bytes disassembled. For Thumb, the
+// upper halfword of the opcode may hold the next instruction, in which case
+// both halves of a BL instruction are disassembled together.
+extern size_t gba_disasm_arm(uint32_t address, uint32_t opcode, char *buffer);
+extern size_t gba_disasm_thumb(uint32_t address, uint32_t opcode, char *buffer);
+
+#endif
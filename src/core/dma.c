@@ -5,6 +5,7 @@
 #include "core/bus.h"
 #include "core/gba.h"
 #include "core/io.h"
+#include "core/scheduler.h"
 
 typedef enum {
     GBA_DMA_CHANNEL_DAC_INCREMENT,
@@ -47,14 +48,15 @@ typedef struct {
 gba_dma_channel_t gba_dma_channels[4];
 
 void gba_dma_reset();
-bool gba_dma_cycle();
+void gba_dma_onDmaEvent(uint64_t timestamp);
 static inline void gba_dma_writeCallback_cntH(gba_dma_channel_t *channel, uint16_t value);
 void gba_dma_writeCallback_cntH0(uint32_t address, uint16_t value);
 void gba_dma_writeCallback_cntH1(uint32_t address, uint16_t value);
 void gba_dma_writeCallback_cntH2(uint32_t address, uint16_t value);
 void gba_dma_writeCallback_cntH3(uint32_t address, uint16_t value);
 static inline void gba_dma_channel_init(gba_dma_channel_t *channel, int index);
-static inline bool gba_dma_channel_cycle(gba_dma_channel_t *channel);
+static inline void gba_dma_channel_start(gba_dma_channel_t *channel);
+static inline void gba_dma_channel_transfer(gba_dma_channel_t *channel);
 static inline void gba_dma_channel_finish(gba_dma_channel_t *channel);
 static inline void gba_dma_channel_repeat(gba_dma_channel_t *channel);
 static inline void gba_dma_channel_reloadRegisters(gba_dma_channel_t *channel, bool repeat);
@@ -68,16 +70,21 @@ void gba_dma_reset() {
     for(int i = 0; i < 4; i++) {
         gba_dma_channel_init(&gba_dma_channels[i], i);
     }
+
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_DMA, gba_dma_onDmaEvent);
 }
 
-bool gba_dma_cycle() {
+// The CPU is stalled while a DMA is running, so the whole transfer is
+// performed at once and the emulated time is advanced by its duration.
+// Channels are serviced in priority order.
+void gba_dma_onDmaEvent(uint64_t timestamp) {
+    UNUSED(timestamp);
+
     for(int i = 0; i < 4; i++) {
-        if(gba_dma_channel_cycle(&gba_dma_channels[i])) {
-            return true;
+        if(gba_dma_channels[i].running) {
+            gba_dma_channel_transfer(&gba_dma_channels[i]);
         }
     }
-
-    return false;
 }
 
 static inline void gba_dma_writeCallback_cntH(gba_dma_channel_t *channel, uint16_t value) {
@@ -88,7 +95,7 @@ static inline void gba_dma_writeCallback_cntH(gba_dma_channel_t *channel, uint16
     channel->repeat = (value & (1 << 9)) != 0;
     channel->bitWidth = (value & (1 << 10)) != 0;
     channel->gamePakDRQ = (value & (1 << 11)) != 0;
-    channel->startTiming = (value & (1 << 12)) != 0;
+    channel->startTiming = (value & 0x3000) >> 12;
     channel->irq = (value & (1 << 14)) != 0;
     channel->enabled = (value & (1 << 15)) != 0;
 
@@ -97,8 +104,8 @@ static inline void gba_dma_writeCallback_cntH(gba_dma_channel_t *channel, uint16
     } else {
         gba_dma_channel_reloadRegisters(channel, false);
 
-        if(channel->startTiming == GBA_DMA_CHANNEL_STARTTIMING_IMMEDIATELY) {
-            channel->running = true;
+        if(channel->enabled && channel->startTiming == GBA_DMA_CHANNEL_STARTTIMING_IMMEDIATELY) {
+            gba_dma_channel_start(channel);
         }
     }
 }
@@ -128,8 +135,13 @@ static inline void gba_dma_channel_init(gba_dma_channel_t *channel, int index) {
     channel->iobase = 0x040000b0 + ((uint32_t)index * 12);
 }
 
-static inline bool gba_dma_channel_cycle(gba_dma_channel_t *channel) {
-    if(channel->running) {
+static inline void gba_dma_channel_start(gba_dma_channel_t *channel) {
+    channel->running = true;
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_DMA, gba_scheduler_cycleCounter);
+}
+
+static inline void gba_dma_channel_transfer(gba_dma_channel_t *channel) {
+    while(channel->running) {
         if(channel->bitWidth) {
             gba_bus_write32(channel->destinationAddress, gba_bus_read32(channel->sourceAddress));
 
@@ -165,26 +177,24 @@ static inline bool gba_dma_channel_cycle(gba_dma_channel_t *channel) {
         }
 
         channel->wordCount--;
+        gba_bus_sequential = true;
 
         if(channel->wordCount == 0) {
             gba_dma_channel_finish(channel);
+            break;
         }
-
-        return true;
     }
 
-    return false;
+    gba_bus_sequential = false;
 }
 
 static inline void gba_dma_channel_finish(gba_dma_channel_t *channel) {
     channel->running = false;
 
-    if(channel->repeat) {
+    // Immediate transfers ignore the repeat bit, otherwise they would never
+    // give the bus back to the CPU.
+    if(channel->repeat && channel->startTiming != GBA_DMA_CHANNEL_STARTTIMING_IMMEDIATELY) {
         gba_dma_channel_repeat(channel);
-
-        if(channel->startTiming == GBA_DMA_CHANNEL_STARTTIMING_IMMEDIATELY) {
-            channel->running = true;
-        }
     } else {
         channel->enabled = false;
         gba_io_getRegister(channel->iobase + 10)->value &= 0x7fff;
@@ -236,7 +246,7 @@ static inline void gba_dma_channel_reloadWordCount(gba_dma_channel_t *channel) {
 void gba_dma_onVblank() {
     for(int i = 0; i < 4; i++) {
         if(gba_dma_channels[i].enabled && !gba_dma_channels[i].running && gba_dma_channels[i].startTiming == GBA_DMA_CHANNEL_STARTTIMING_VBLANK) {
-            gba_dma_channels[i].running = true;
+            gba_dma_channel_start(&gba_dma_channels[i]);
         }
     }
 }
@@ -244,7 +254,7 @@ void gba_dma_onVblank() {
 void gba_dma_onHblank() {
     for(int i = 0; i < 4; i++) {
         if(gba_dma_channels[i].enabled && !gba_dma_channels[i].running && gba_dma_channels[i].startTiming == GBA_DMA_CHANNEL_STARTTIMING_HBLANK) {
-            gba_dma_channels[i].running = true;
+            gba_dma_channel_start(&gba_dma_channels[i]);
         }
     }
 }
@@ -5,7 +5,6 @@
 #include <stdint.h>
 
 extern void gba_dma_reset();
-extern bool gba_dma_cycle();
 extern void gba_dma_writeCallback_cntH0(uint32_t address, uint16_t value);
 extern void gba_dma_writeCallback_cntH1(uint32_t address, uint16_t value);
 extern void gba_dma_writeCallback_cntH2(uint32_t address, uint16_t value);
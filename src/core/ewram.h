@@ -3,6 +3,11 @@
 
 #include <stdint.h>
 
+#include "core/defines.h"
+
+// Exposed for the bus, which copies bursts of words directly.
+extern uint8_t gba_ewram_buffer[GBA_EWRAM_SIZE];
+
 extern void gba_ewram_reset();
 extern uint8_t gba_ewram_read8(uint32_t address);
 extern uint16_t gba_ewram_read16(uint32_t address);
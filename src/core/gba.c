@@ -3,14 +3,19 @@
 
 #include "platform.h"
 #include "core/bios.h"
+#include "core/bus.h"
 #include "core/cartridge.h"
 #include "core/cpu.h"
 #include "core/dma.h"
 #include "core/ewram.h"
+#include "core/hle.h"
 #include "core/io.h"
+#include "core/irq.h"
 #include "core/iwram.h"
 #include "core/ppu.h"
+#include "core/scheduler.h"
 #include "core/timer.h"
+#include "core/trace.h"
 
 bool gba_skipBoot;
 bool gba_frame;
@@ -25,6 +30,7 @@ void gba_setRom(const void *buffer, size_t size);
 void gba_setSram(void *buffer, size_t size);
 void gba_setInterruptFlag(uint16_t flag);
 void gba_writeToIF(uint32_t address, uint16_t flag);
+void gba_writeToHALTCNT(uint32_t address, uint16_t value);
 
 void gba_frameAdvance() {
     gba_frame = false;
@@ -34,13 +40,11 @@ void gba_frameAdvance() {
     }
 }
 
+// Runs the CPU until the next scheduled hardware event is due, then
+// dispatches every event that is due.
 void gba_cycle() {
-    if(!gba_dma_cycle()) {
-        gba_cpu_cycle();
-    }
-
-    gba_ppu_cycle();
-    gba_timer_cycle();
+    gba_cpu_run();
+    gba_scheduler_processEvents();
 }
 
 size_t gba_getSramSize() {
@@ -54,16 +58,26 @@ void gba_init(bool skipBoot) {
 }
 
 void gba_reset() {
+    gba_scheduler_reset();
     gba_cpu_reset(gba_skipBoot);
     gba_dma_reset();
     gba_ewram_reset();
     gba_io_reset();
+    gba_irq_reset();
+    gba_bus_reset();
     gba_iwram_reset();
     gba_ppu_reset();
     gba_timer_reset();
 }
 
+// Without a BIOS image, the SWIs are emulated at a high level.
 void gba_setBios(const void *buffer) {
+    if(buffer) {
+        gba_hle_disable();
+    } else {
+        buffer = gba_hle_init();
+    }
+
     gba_bios_init(buffer);
     gba_reset();
 }
@@ -80,14 +94,27 @@ void gba_setSram(void *buffer, size_t size) {
 
 void gba_setInterruptFlag(uint16_t flag) {
     gba_io_getRegister(0x04000202)->value |= flag;
+    gba_irq_update();
 }
 
 void gba_writeToIF(uint32_t address, uint16_t flag) {
     UNUSED(address);
 
     gba_io_getRegister(0x04000202)->value &= ~flag;
+    gba_irq_update();
+}
+
+// HALTCNT is the upper byte of the POSTFLG register, so it is written by
+// halfword and word writes to POSTFLG too, but not by byte writes to it.
+void gba_writeToHALTCNT(uint32_t address, uint16_t value) {
+    UNUSED(address);
+
+    if(gba_io_writtenBytes & 0xff00) {
+        gba_cpu_halt((value & 0x8000) != 0);
+    }
 }
 
 void gba_onFrame() {
     gba_frame = true;
+    gba_trace_onFrame();
 }
@@ -0,0 +1,518 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/bus.h"
+#include "core/cpu.h"
+#include "core/defines.h"
+#include "core/hle.h"
+
+typedef struct {
+    uint32_t address;
+    bool vram;
+    uint8_t pending;
+} gba_hle_output_t;
+
+bool gba_hle_enabled;
+
+// Set while an IntrWait call is halting the CPU, so that executing it again
+// after an interrupt does not discard the flags that woke it up.
+static bool gba_hle_intrWaiting;
+
+// Exception vectors of the minimal BIOS. The IRQ handler calls the user
+// handler stored at 0x03007ffc, like the real BIOS does.
+static const uint32_t gba_hle_vectors[] = {
+    0xe3a0f302, // mov pc, #0x08000000
+    0xe1b0f00e, // movs pc, lr
+    0xe1b0f00e, // movs pc, lr
+    0xe25ef004, // subs pc, lr, #4
+    0xe25ef008, // subs pc, lr, #8
+    0xeafffffe, // b .
+    0xea000000, // b 0x00000020
+    0xe25ef004, // subs pc, lr, #4
+    0xe92d500f, // stmfd sp!, {r0-r3, r12, lr}
+    0xe3a00301, // mov r0, #0x04000000
+    0xe28fe000, // add lr, pc, #0
+    0xe510f004, // ldr pc, [r0, #-4]
+    0xe8bd500f, // ldmfd sp!, {r0-r3, r12, lr}
+    0xe25ef004  // subs pc, lr, #4
+};
+
+// First quarter of a sine period in 256 steps, in 1.14 fixed point.
+static const int16_t gba_hle_sineTable[65] = {
+    0x0000, 0x0192, 0x0324, 0x04b5, 0x0646, 0x07d6, 0x0964, 0x0af1,
+    0x0c7c, 0x0e06, 0x0f8d, 0x1112, 0x1294, 0x1413, 0x1590, 0x1709,
+    0x187e, 0x19ef, 0x1b5d, 0x1cc6, 0x1e2b, 0x1f8c, 0x20e7, 0x223d,
+    0x238e, 0x24da, 0x2620, 0x2760, 0x289a, 0x29ce, 0x2afb, 0x2c21,
+    0x2d41, 0x2e5a, 0x2f6c, 0x3076, 0x3179, 0x3274, 0x3368, 0x3453,
+    0x3537, 0x3612, 0x36e5, 0x37b0, 0x3871, 0x392b, 0x39db, 0x3a82,
+    0x3b21, 0x3bb6, 0x3c42, 0x3cc5, 0x3d3f, 0x3daf, 0x3e15, 0x3e72,
+    0x3ec5, 0x3f0f, 0x3f4f, 0x3f85, 0x3fb1, 0x3fd4, 0x3fec, 0x3ffb,
+    0x4000
+};
+
+static uint32_t gba_hle_bios[GBA_BIOS_FILE_SIZE / 4];
+
+const void *gba_hle_init();
+void gba_hle_disable();
+gba_hle_result_t gba_hle_swi(uint8_t number);
+static inline gba_hle_result_t gba_hle_intrWait(bool discard, uint16_t flags);
+static inline void gba_hle_div(int32_t numerator, int32_t denominator);
+static inline void gba_hle_sqrt();
+static inline uint16_t gba_hle_arcTan(int32_t tangent);
+static inline void gba_hle_arcTan2();
+static inline void gba_hle_cpuSet();
+static inline void gba_hle_cpuFastSet();
+static inline int32_t gba_hle_sin(uint8_t angle);
+static inline int32_t gba_hle_cos(uint8_t angle);
+static inline void gba_hle_bgAffineSet();
+static inline void gba_hle_objAffineSet();
+static inline void gba_hle_output_write(gba_hle_output_t *output, uint8_t value);
+static inline uint8_t gba_hle_output_read(gba_hle_output_t *output, uint32_t address);
+static inline void gba_hle_lz77UnComp(bool vram);
+static inline void gba_hle_huffUnComp();
+static inline void gba_hle_rlUnComp(bool vram);
+
+const void *gba_hle_init() {
+    for(int i = 0; i < GBA_BIOS_FILE_SIZE / 4; i++) {
+        gba_hle_bios[i] = 0;
+    }
+
+    for(size_t i = 0; i < sizeof(gba_hle_vectors) / sizeof(gba_hle_vectors[0]); i++) {
+        gba_hle_bios[i] = gba_hle_vectors[i];
+    }
+
+    gba_hle_enabled = true;
+    gba_hle_intrWaiting = false;
+
+    return gba_hle_bios;
+}
+
+void gba_hle_disable() {
+    gba_hle_enabled = false;
+}
+
+// Services the SWI with the given comment field. Returns
+// GBA_HLE_RESULT_WAIT when the CPU must halt and execute the SWI again once
+// woken up.
+gba_hle_result_t gba_hle_swi(uint8_t number) {
+    switch(number) {
+        case 0x02: // Halt
+        gba_cpu_halt(false);
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x03: // Stop
+        gba_cpu_halt(true);
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x04: // IntrWait
+        return gba_hle_intrWait(gba_cpu_r[0] != 0, gba_cpu_r[1]);
+
+        case 0x05: // VBlankIntrWait
+        return gba_hle_intrWait(true, 0x0001);
+
+        case 0x06: // Div
+        gba_hle_div(gba_cpu_r[0], gba_cpu_r[1]);
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x07: // DivArm
+        gba_hle_div(gba_cpu_r[1], gba_cpu_r[0]);
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x08: // Sqrt
+        gba_hle_sqrt();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x09: // ArcTan
+        gba_cpu_r[0] = gba_hle_arcTan((int16_t)gba_cpu_r[0]);
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x0a: // ArcTan2
+        gba_hle_arcTan2();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x0b: // CpuSet
+        gba_hle_cpuSet();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x0c: // CpuFastSet
+        gba_hle_cpuFastSet();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x0e: // BgAffineSet
+        gba_hle_bgAffineSet();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x0f: // ObjAffineSet
+        gba_hle_objAffineSet();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x11: // LZ77UnCompWram
+        case 0x12: // LZ77UnCompVram
+        gba_hle_lz77UnComp(number == 0x12);
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x13: // HuffUnComp
+        gba_hle_huffUnComp();
+        return GBA_HLE_RESULT_DONE;
+
+        case 0x14: // RLUnCompWram
+        case 0x15: // RLUnCompVram
+        gba_hle_rlUnComp(number == 0x15);
+        return GBA_HLE_RESULT_DONE;
+
+        default:
+        return GBA_HLE_RESULT_UNHANDLED;
+    }
+}
+
+// The interrupt handler acknowledges interrupts by setting their flags at
+// 0x03007ff8.
+static inline gba_hle_result_t gba_hle_intrWait(bool discard, uint16_t flags) {
+    uint16_t acknowledged = gba_bus_read16(0x03007ff8);
+
+    if(discard && !gba_hle_intrWaiting) {
+        acknowledged &= ~flags;
+    } else if(acknowledged & flags) {
+        gba_bus_write16(0x03007ff8, acknowledged & ~flags);
+        gba_hle_intrWaiting = false;
+        return GBA_HLE_RESULT_DONE;
+    }
+
+    gba_bus_write16(0x03007ff8, acknowledged);
+    gba_bus_write16(0x04000208, 0x0001);
+    gba_hle_intrWaiting = true;
+
+    return GBA_HLE_RESULT_WAIT;
+}
+
+static inline void gba_hle_div(int32_t numerator, int32_t denominator) {
+    int32_t quotient;
+    int32_t remainder;
+
+    if(denominator == 0) {
+        // The real BIOS never returns, this is what it leaves in the
+        // registers on the first iteration.
+        quotient = numerator < 0 ? -1 : 1;
+        remainder = numerator;
+    } else if(numerator == INT32_MIN && denominator == -1) {
+        quotient = INT32_MIN;
+        remainder = 0;
+    } else {
+        quotient = numerator / denominator;
+        remainder = numerator % denominator;
+    }
+
+    gba_cpu_r[0] = quotient;
+    gba_cpu_r[1] = remainder;
+    gba_cpu_r[3] = quotient < 0 ? -(uint32_t)quotient : (uint32_t)quotient;
+}
+
+static inline void gba_hle_sqrt() {
+    uint32_t value = gba_cpu_r[0];
+    uint32_t result = 0;
+
+    for(uint32_t bit = 1 << 30; bit != 0; bit >>= 2) {
+        if(value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+    }
+
+    gba_cpu_r[0] = result;
+}
+
+// Same polynomial approximation as the real BIOS, for a 1.14 fixed point
+// tangent in the [-1, 1] range.
+static inline uint16_t gba_hle_arcTan(int32_t tangent) {
+    int32_t square = -((tangent * tangent) >> 14);
+    int32_t result = ((0xa9 * square) >> 14) + 0x390;
+
+    result = ((result * square) >> 14) + 0x91c;
+    result = ((result * square) >> 14) + 0xfb6;
+    result = ((result * square) >> 14) + 0x16aa;
+    result = ((result * square) >> 14) + 0x2081;
+    result = ((result * square) >> 14) + 0x3651;
+    result = ((result * square) >> 14) + 0xa2f9;
+
+    return (tangent * result) >> 16;
+}
+
+static inline void gba_hle_arcTan2() {
+    int32_t x = (int16_t)gba_cpu_r[0];
+    int32_t y = (int16_t)gba_cpu_r[1];
+    uint16_t result;
+
+    if(y == 0) {
+        result = x >= 0 ? 0x0000 : 0x8000;
+    } else if(x == 0) {
+        result = y >= 0 ? 0x4000 : 0xc000;
+    } else if(y >= 0) {
+        if(x >= 0 && x >= y) {
+            result = gba_hle_arcTan(y * 16384 / x);
+        } else if(x < 0 && -x >= y) {
+            result = gba_hle_arcTan(y * 16384 / x) + 0x8000;
+        } else {
+            result = 0x4000 - gba_hle_arcTan(x * 16384 / y);
+        }
+    } else {
+        if(x <= 0 && -x > -y) {
+            result = gba_hle_arcTan(y * 16384 / x) + 0x8000;
+        } else if(x > 0 && x >= -y) {
+            result = gba_hle_arcTan(y * 16384 / x);
+        } else {
+            result = 0xc000 - gba_hle_arcTan(x * 16384 / y);
+        }
+    }
+
+    gba_cpu_r[0] = result;
+}
+
+static inline void gba_hle_cpuSet() {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t destination = gba_cpu_r[1];
+    uint32_t count = gba_cpu_r[2] & 0x001fffff;
+    bool fill = gba_cpu_r[2] & (1 << 24);
+
+    if(gba_cpu_r[2] & (1 << 26)) {
+        uint32_t value = gba_bus_read32(source);
+
+        for(uint32_t i = 0; i < count; i++) {
+            if(!fill) {
+                value = gba_bus_read32(source + i * 4);
+            }
+
+            gba_bus_write32(destination + i * 4, value);
+        }
+    } else {
+        uint16_t value = gba_bus_read16(source);
+
+        for(uint32_t i = 0; i < count; i++) {
+            if(!fill) {
+                value = gba_bus_read16(source + i * 2);
+            }
+
+            gba_bus_write16(destination + i * 2, value);
+        }
+    }
+}
+
+static inline void gba_hle_cpuFastSet() {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t destination = gba_cpu_r[1];
+    uint32_t count = ((gba_cpu_r[2] & 0x001fffff) + 7) & ~7;
+    bool fill = gba_cpu_r[2] & (1 << 24);
+    uint32_t value = gba_bus_read32(source);
+
+    for(uint32_t i = 0; i < count; i++) {
+        if(!fill) {
+            value = gba_bus_read32(source + i * 4);
+        }
+
+        gba_bus_write32(destination + i * 4, value);
+    }
+}
+
+static inline int32_t gba_hle_sin(uint8_t angle) {
+    int index = angle & 0x3f;
+
+    switch(angle >> 6) {
+        case 0: return gba_hle_sineTable[index];
+        case 1: return gba_hle_sineTable[64 - index];
+        case 2: return -gba_hle_sineTable[index];
+        default: return -gba_hle_sineTable[64 - index];
+    }
+}
+
+static inline int32_t gba_hle_cos(uint8_t angle) {
+    return gba_hle_sin(angle + 64);
+}
+
+static inline void gba_hle_bgAffineSet() {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t destination = gba_cpu_r[1];
+
+    for(uint32_t i = 0; i < gba_cpu_r[2]; i++) {
+        int32_t originX = gba_bus_read32(source);
+        int32_t originY = gba_bus_read32(source + 4);
+        int32_t centerX = (int16_t)gba_bus_read16(source + 8);
+        int32_t centerY = (int16_t)gba_bus_read16(source + 10);
+        int32_t scaleX = (int16_t)gba_bus_read16(source + 12);
+        int32_t scaleY = (int16_t)gba_bus_read16(source + 14);
+        uint8_t angle = gba_bus_read16(source + 16) >> 8;
+
+        int32_t sin = gba_hle_sin(angle);
+        int32_t cos = gba_hle_cos(angle);
+        int16_t pa = (scaleX * cos) >> 14;
+        int16_t pb = -((scaleX * sin) >> 14);
+        int16_t pc = (scaleY * sin) >> 14;
+        int16_t pd = (scaleY * cos) >> 14;
+
+        gba_bus_write16(destination, pa);
+        gba_bus_write16(destination + 2, pb);
+        gba_bus_write16(destination + 4, pc);
+        gba_bus_write16(destination + 6, pd);
+        gba_bus_write32(destination + 8, originX - (pa * centerX + pb * centerY));
+        gba_bus_write32(destination + 12, originY - (pc * centerX + pd * centerY));
+
+        source += 20;
+        destination += 16;
+    }
+}
+
+static inline void gba_hle_objAffineSet() {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t destination = gba_cpu_r[1];
+    uint32_t offset = gba_cpu_r[3];
+
+    for(uint32_t i = 0; i < gba_cpu_r[2]; i++) {
+        int32_t scaleX = (int16_t)gba_bus_read16(source);
+        int32_t scaleY = (int16_t)gba_bus_read16(source + 2);
+        uint8_t angle = gba_bus_read16(source + 4) >> 8;
+
+        int32_t sin = gba_hle_sin(angle);
+        int32_t cos = gba_hle_cos(angle);
+
+        gba_bus_write16(destination, (scaleX * cos) >> 14);
+        gba_bus_write16(destination + offset, -((scaleX * sin) >> 14));
+        gba_bus_write16(destination + offset * 2, (scaleY * sin) >> 14);
+        gba_bus_write16(destination + offset * 3, (scaleY * cos) >> 14);
+
+        source += 8;
+        destination += offset * 4;
+    }
+}
+
+// VRAM ignores 8-bit writes, so the VRAM variants of the decompressors pair
+// the output bytes into halfwords.
+static inline void gba_hle_output_write(gba_hle_output_t *output, uint8_t value) {
+    if(!output->vram) {
+        gba_bus_write8(output->address, value);
+    } else if(output->address & 1) {
+        gba_bus_write16(output->address - 1, output->pending | (value << 8));
+    } else {
+        output->pending = value;
+    }
+
+    output->address++;
+}
+
+static inline uint8_t gba_hle_output_read(gba_hle_output_t *output, uint32_t address) {
+    if(output->vram && address == (output->address & ~1)) {
+        return output->pending;
+    }
+
+    return gba_bus_read8(address);
+}
+
+static inline void gba_hle_lz77UnComp(bool vram) {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t remaining = gba_bus_read32(source) >> 8;
+    gba_hle_output_t output = {gba_cpu_r[1], vram, 0};
+
+    source += 4;
+
+    while(remaining > 0) {
+        uint8_t flags = gba_bus_read8(source++);
+
+        for(int i = 0; i < 8 && remaining > 0; i++, flags <<= 1) {
+            if(flags & 0x80) {
+                uint8_t byte0 = gba_bus_read8(source++);
+                uint8_t byte1 = gba_bus_read8(source++);
+                uint32_t length = (byte0 >> 4) + 3;
+                uint32_t displacement = (((byte0 & 0x0f) << 8) | byte1) + 1;
+
+                for(; length > 0 && remaining > 0; length--, remaining--) {
+                    gba_hle_output_write(&output, gba_hle_output_read(&output, output.address - displacement));
+                }
+            } else {
+                gba_hle_output_write(&output, gba_bus_read8(source++));
+                remaining--;
+            }
+        }
+    }
+}
+
+static inline void gba_hle_huffUnComp() {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t destination = gba_cpu_r[1];
+    uint32_t header = gba_bus_read32(source);
+    uint32_t remaining = header >> 8;
+    uint32_t dataSize = header & 0x0f;
+    uint32_t tree = source + 4;
+    uint32_t root = tree + 1;
+    uint32_t node = root;
+    uint32_t block = 0;
+    uint32_t blockSize = 0;
+
+    if(dataSize != 4 && dataSize != 8) {
+        return;
+    }
+
+    source = tree + (gba_bus_read8(tree) + 1) * 2;
+
+    while(remaining > 0) {
+        uint32_t bits = gba_bus_read32(source);
+
+        source += 4;
+
+        for(int i = 0; i < 32 && remaining > 0; i++, bits <<= 1) {
+            uint8_t value = gba_bus_read8(node);
+            uint32_t child = (node & ~1) + (value & 0x3f) * 2 + 2;
+            bool leaf;
+
+            if(bits & 0x80000000) {
+                child++;
+                leaf = value & 0x40;
+            } else {
+                leaf = value & 0x80;
+            }
+
+            if(!leaf) {
+                node = child;
+                continue;
+            }
+
+            block |= (gba_bus_read8(child) & ((1 << dataSize) - 1)) << blockSize;
+            blockSize += dataSize;
+            node = root;
+
+            if(blockSize == 32) {
+                gba_bus_write32(destination, block);
+                destination += 4;
+                remaining = remaining > 4 ? remaining - 4 : 0;
+                block = 0;
+                blockSize = 0;
+            }
+        }
+    }
+}
+
+static inline void gba_hle_rlUnComp(bool vram) {
+    uint32_t source = gba_cpu_r[0];
+    uint32_t remaining = gba_bus_read32(source) >> 8;
+    gba_hle_output_t output = {gba_cpu_r[1], vram, 0};
+
+    source += 4;
+
+    while(remaining > 0) {
+        uint8_t flag = gba_bus_read8(source++);
+
+        if(flag & 0x80) {
+            uint32_t length = (flag & 0x7f) + 3;
+            uint8_t value = gba_bus_read8(source++);
+
+            for(; length > 0 && remaining > 0; length--, remaining--) {
+                gba_hle_output_write(&output, value);
+            }
+        } else {
+            uint32_t length = (flag & 0x7f) + 1;
+
+            for(; length > 0 && remaining > 0; length--, remaining--) {
+                gba_hle_output_write(&output, gba_bus_read8(source++));
+            }
+        }
+    }
+}
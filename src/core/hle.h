@@ -0,0 +1,21 @@
+#ifndef __CORE_HLE_H__
+#define __CORE_HLE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    GBA_HLE_RESULT_UNHANDLED,
+    GBA_HLE_RESULT_DONE,
+    GBA_HLE_RESULT_WAIT
+} gba_hle_result_t;
+
+// Set when no BIOS image was provided, in which case the SWIs are serviced
+// natively and a minimal BIOS only provides the exception vectors.
+extern bool gba_hle_enabled;
+
+extern const void *gba_hle_init();
+extern void gba_hle_disable();
+extern gba_hle_result_t gba_hle_swi(uint8_t number);
+
+#endif
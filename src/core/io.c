@@ -1,16 +1,22 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "debug.h"
+#include "core/bus.h"
 #include "core/dma.h"
 #include "core/gba.h"
 #include "core/io.h"
+#include "core/irq.h"
+#include "core/keypad.h"
 #include "core/timer.h"
 
 gba_io_register_t gba_io_registers[512];
 gba_io_register_t gba_io_register_internalMemoryControl_low;
 gba_io_register_t gba_io_register_internalMemoryControl_high;
 gba_io_register_t gba_io_nullRegister;
+bool gba_io_volatileRead;
+uint16_t gba_io_writtenBytes;
 
 void gba_io_reset();
 uint8_t gba_io_read8(uint32_t address);
@@ -21,22 +27,27 @@ void gba_io_write16(uint32_t address, uint16_t value);
 void gba_io_write32(uint32_t address, uint32_t value);
 gba_io_register_t *gba_io_getRegister(uint32_t address);
 void gba_io_initRegister(uint32_t address, uint16_t initialValue, gba_io_writeCallack_t *writeCallback, uint16_t readMask, uint16_t writeMask);
+void gba_io_setReadCallback(uint32_t address, gba_io_readCallback_t *readCallback);
+static inline void gba_io_writeRegister(uint32_t address, uint16_t value);
 
 void gba_io_reset() {
     memset(gba_io_registers, 0, sizeof(gba_io_registers));
 
     gba_io_register_internalMemoryControl_low.value = 0x0000;
     gba_io_register_internalMemoryControl_low.writeCallback = NULL;
+    gba_io_register_internalMemoryControl_low.readCallback = NULL;
     gba_io_register_internalMemoryControl_low.readMask = 0xffff;
     gba_io_register_internalMemoryControl_low.writeMask = 0xffff;
 
     gba_io_register_internalMemoryControl_high.value = 0x0000;
     gba_io_register_internalMemoryControl_high.writeCallback = NULL;
+    gba_io_register_internalMemoryControl_high.readCallback = NULL;
     gba_io_register_internalMemoryControl_high.readMask = 0xffff;
     gba_io_register_internalMemoryControl_high.writeMask = 0xffff;
 
     gba_io_nullRegister.value = 0x0000;
     gba_io_nullRegister.writeCallback = NULL;
+    gba_io_nullRegister.readCallback = NULL;
     gba_io_nullRegister.readMask = 0xffff;
     gba_io_nullRegister.writeMask = 0xffff;
 
@@ -115,10 +126,17 @@ void gba_io_reset() {
     gba_io_initRegister(0x0400010c, 0x0000, gba_timer_writeCallback_channel3_reload, 0xffff, 0x0000); // TM3D
     gba_io_initRegister(0x0400010e, 0x0000, gba_timer_writeCallback_channel3_control, 0x00c3, 0x00c3); // TM3CNT
     gba_io_initRegister(0x04000130, 0xffff, NULL, 0x03ff, 0x0000); // KEYINPUT
-    gba_io_initRegister(0x04000132, 0x0000, NULL, 0xc3ff, 0xc3ff); // KEYCNT
-    gba_io_initRegister(0x04000200, 0x0000, NULL, 0x3fff, 0x3fff); // IE
+    gba_io_initRegister(0x04000132, 0x0000, gba_keypad_writeCallback_keycnt, 0xc3ff, 0xc3ff); // KEYCNT
+    gba_io_initRegister(0x04000200, 0x0000, gba_irq_writeCallback_ie, 0x3fff, 0x3fff); // IE
     gba_io_initRegister(0x04000202, 0x0000, gba_writeToIF, 0x3fff, 0x0000); // IF
-    gba_io_initRegister(0x04000208, 0x0000, NULL, 0x0001, 0x0001); // IME
+    gba_io_initRegister(0x04000204, 0x0000, gba_bus_writeCallback_waitcnt, 0x5fff, 0x5fff); // WAITCNT
+    gba_io_initRegister(0x04000208, 0x0000, gba_irq_writeCallback_ime, 0x0001, 0x0001); // IME
+    gba_io_initRegister(0x04000300, 0x0000, gba_writeToHALTCNT, 0x0001, 0x0001); // POSTFLG, HALTCNT
+
+    gba_io_setReadCallback(0x04000100, gba_timer_readCallback_channel0_counter); // TM0D
+    gba_io_setReadCallback(0x04000104, gba_timer_readCallback_channel1_counter); // TM1D
+    gba_io_setReadCallback(0x04000108, gba_timer_readCallback_channel2_counter); // TM2D
+    gba_io_setReadCallback(0x0400010c, gba_timer_readCallback_channel3_counter); // TM3D
 }
 
 uint8_t gba_io_read8(uint32_t address) {
@@ -138,6 +156,11 @@ uint16_t gba_io_read16(uint32_t address) {
         debug("io_read16(0x%08x) -> 0x%04x\n", address, reg->value & reg->readMask);
     }
 
+    if(reg->readCallback) {
+        gba_io_volatileRead = true;
+        return reg->readCallback(address) & reg->readMask;
+    }
+
     return reg->value & reg->readMask;
 }
 
@@ -156,22 +179,13 @@ void gba_io_write8(uint32_t address, uint8_t value) {
         v |= value;
     }
 
-    gba_io_write16(address, v);
+    gba_io_writtenBytes = (address & 1) ? 0xff00 : 0x00ff;
+    gba_io_writeRegister(address, v);
 }
 
 void gba_io_write16(uint32_t address, uint16_t value) {
-    gba_io_register_t *reg = gba_io_getRegister(address);
-
-    reg->value &= ~reg->writeMask;
-    reg->value |= value & reg->writeMask;
-
-    if(reg->writeCallback) {
-        reg->writeCallback(address, value);
-    }
-
-    if(reg == &gba_io_nullRegister) {
-        debug("io_write16(0x%08x, 0x%04x)\n", address, value);
-    }
+    gba_io_writtenBytes = 0xffff;
+    gba_io_writeRegister(address, value);
 }
 
 void gba_io_write32(uint32_t address, uint32_t value) {
@@ -201,3 +215,26 @@ void gba_io_initRegister(uint32_t address, uint16_t initialValue, gba_io_writeCa
         reg->writeMask = writeMask;
     }
 }
+
+void gba_io_setReadCallback(uint32_t address, gba_io_readCallback_t *readCallback) {
+    gba_io_register_t *reg = gba_io_getRegister(address);
+
+    if(reg != &gba_io_nullRegister) {
+        reg->readCallback = readCallback;
+    }
+}
+
+static inline void gba_io_writeRegister(uint32_t address, uint16_t value) {
+    gba_io_register_t *reg = gba_io_getRegister(address);
+
+    reg->value &= ~reg->writeMask;
+    reg->value |= value & reg->writeMask;
+
+    if(reg->writeCallback) {
+        reg->writeCallback(address, value);
+    }
+
+    if(reg == &gba_io_nullRegister) {
+        debug("io_write16(0x%08x, 0x%04x)\n", address, value);
+    }
+}
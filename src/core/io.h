@@ -1,17 +1,28 @@
 #ifndef __CORE_IO_H__
 #define __CORE_IO_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef void gba_io_writeCallack_t(uint32_t address, uint16_t value);
+typedef uint16_t gba_io_readCallback_t(uint32_t address);
 
 typedef struct {
     uint16_t value;
     uint16_t readMask;
     uint16_t writeMask;
     gba_io_writeCallack_t *writeCallback;
+    gba_io_readCallback_t *readCallback;
 } gba_io_register_t;
 
+// Set when a register whose value changes without being written, such as a
+// timer counter, is read.
+extern bool gba_io_volatileRead;
+
+// Bytes of the register being written, 0x00ff or 0xff00 for byte writes and
+// 0xffff otherwise, for the callbacks of registers made of two bytes.
+extern uint16_t gba_io_writtenBytes;
+
 extern void gba_io_reset();
 extern uint8_t gba_io_read8(uint32_t address);
 extern uint16_t gba_io_read16(uint32_t address);
@@ -20,5 +31,6 @@ extern void gba_io_write8(uint32_t address, uint8_t value);
 extern void gba_io_write16(uint32_t address, uint16_t value);
 extern void gba_io_write32(uint32_t address, uint32_t value);
 extern gba_io_register_t *gba_io_getRegister(uint32_t address);
+extern void gba_io_setReadCallback(uint32_t address, gba_io_readCallback_t *readCallback);
 
 #endif
@@ -0,0 +1,52 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "core/cpu.h"
+#include "core/io.h"
+#include "core/irq.h"
+#include "core/jit.h"
+
+bool gba_irq_pending;
+bool gba_irq_requested;
+
+void gba_irq_reset();
+void gba_irq_update();
+void gba_irq_writeCallback_ie(uint32_t address, uint16_t value);
+void gba_irq_writeCallback_ime(uint32_t address, uint16_t value);
+
+void gba_irq_reset() {
+    gba_irq_update();
+}
+
+void gba_irq_update() {
+    uint16_t ie = gba_io_getRegister(0x04000200)->value;
+    uint16_t if_ = gba_io_getRegister(0x04000202)->value;
+    uint16_t ime = gba_io_getRegister(0x04000208)->value;
+
+    gba_irq_requested = (ie & if_ & 0x3fff) != 0;
+    bool pending = (ime & 0x0001) && gba_irq_requested;
+
+    // The backends only check for interrupts between blocks, so a store
+    // making one pending ends the block after the current instruction.
+    if(pending && !gba_irq_pending) {
+        gba_cpu_blockInvalidated = true;
+        gba_jit_linkBlocked = true;
+    }
+
+    gba_irq_pending = pending;
+}
+
+void gba_irq_writeCallback_ie(uint32_t address, uint16_t value) {
+    UNUSED(address);
+    UNUSED(value);
+
+    gba_irq_update();
+}
+
+void gba_irq_writeCallback_ime(uint32_t address, uint16_t value) {
+    UNUSED(address);
+    UNUSED(value);
+
+    gba_irq_update();
+}
@@ -0,0 +1,20 @@
+#ifndef __CORE_IRQ_H__
+#define __CORE_IRQ_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Whether IME is set and an interrupt is both enabled in IE and requested in
+// IF. Recomputed whenever one of these registers changes.
+extern bool gba_irq_pending;
+
+// Whether an interrupt is both enabled in IE and requested in IF, which wakes
+// the CPU up from the halt and stop states.
+extern bool gba_irq_requested;
+
+extern void gba_irq_reset();
+extern void gba_irq_update();
+extern void gba_irq_writeCallback_ie(uint32_t address, uint16_t value);
+extern void gba_irq_writeCallback_ime(uint32_t address, uint16_t value);
+
+#endif
@@ -3,6 +3,11 @@
 
 #include <stdint.h>
 
+#include "core/defines.h"
+
+// Exposed for the bus, which copies bursts of words directly.
+extern uint8_t gba_iwram_buffer[GBA_IWRAM_SIZE];
+
 extern void gba_iwram_reset();
 extern uint8_t gba_iwram_read8(uint32_t address);
 extern uint16_t gba_iwram_read16(uint32_t address);
@@ -0,0 +1,2074 @@
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+#include "core/bus.h"
+#include "core/cpu.h"
+#include "core/jit.h"
+#include "core/scheduler.h"
+
+#if defined(__x86_64__) && defined(GBAEMU_OS_UNIX)
+#define GBA_JIT_SUPPORTED
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint32_t gba_jit_epoch;
+bool gba_jit_linkBlocked;
+uint64_t gba_jit_cacheHits;
+
+#ifdef GBA_JIT_SUPPORTED
+
+#define GBA_JIT_BUFFER_SIZE (16 * 1024 * 1024)
+
+// Space that must be left in the buffer before translating a block. It is
+// well above the size of the code generated for the longest block.
+#define GBA_JIT_BLOCK_RESERVE (64 * 1024)
+
+#define GBA_JIT_CACHED_REGISTER_COUNT 5
+#define GBA_JIT_CONDITION_AL 14
+
+// Bumped whenever the format of the persistent cache changes. The cache is
+// also only read back by the build of this file that wrote it.
+#define GBA_JIT_CACHE_VERSION 1
+#define GBA_JIT_CACHE_SIGNATURE "GBAJITC"
+
+// Checksum of the core sources and of the compiler flags, set by the
+// Makefile so that the cache is discarded whenever the code the
+// translations depend on changes.
+#ifndef GBA_JIT_BUILD_ID
+#define GBA_JIT_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+// Symbols are named so that the build ID changes along with the table.
+#define GBA_JIT_ADD_SYMBOL(symbol) do { \
+    gba_jit_symbolNames[count] = #symbol; \
+    gba_jit_symbols[count++] = (uintptr_t)(symbol); \
+} while(0)
+#define GBA_JIT_MAX_SYMBOLS 32
+
+// Relocations of pointers into the buffer, which only the patch sites of
+// the exits are.
+#define GBA_JIT_SYMBOL_CODE UINT32_MAX
+
+#define GBA_JIT_HASH_BASIS 0x811c9dc5
+
+typedef enum {
+    GBA_JIT_RAX,
+    GBA_JIT_RCX,
+    GBA_JIT_RDX,
+    GBA_JIT_RBX,
+    GBA_JIT_RSP,
+    GBA_JIT_RBP,
+    GBA_JIT_RSI,
+    GBA_JIT_RDI,
+    GBA_JIT_R8,
+    GBA_JIT_R9,
+    GBA_JIT_R10,
+    GBA_JIT_R11,
+    GBA_JIT_R12,
+    GBA_JIT_R13,
+    GBA_JIT_R14,
+    GBA_JIT_R15
+} gba_jit_hostRegister_t;
+
+typedef enum {
+    GBA_JIT_HOSTCONDITION_O = 0x0,
+    GBA_JIT_HOSTCONDITION_B = 0x2,
+    GBA_JIT_HOSTCONDITION_AE = 0x3,
+    GBA_JIT_HOSTCONDITION_E = 0x4,
+    GBA_JIT_HOSTCONDITION_NE = 0x5,
+    GBA_JIT_HOSTCONDITION_BE = 0x6,
+    GBA_JIT_HOSTCONDITION_S = 0x8
+} gba_jit_hostCondition_t;
+
+typedef enum {
+    GBA_JIT_KIND_ALU,
+    GBA_JIT_KIND_LOAD,
+    GBA_JIT_KIND_STORE,
+    GBA_JIT_KIND_BRANCH
+} gba_jit_kind_t;
+
+// ARM data processing opcodes, which the Thumb ALU operations are mapped to.
+typedef enum {
+    GBA_JIT_ALU_AND,
+    GBA_JIT_ALU_EOR,
+    GBA_JIT_ALU_SUB,
+    GBA_JIT_ALU_RSB,
+    GBA_JIT_ALU_ADD,
+    GBA_JIT_ALU_ADC,
+    GBA_JIT_ALU_SBC,
+    GBA_JIT_ALU_RSC,
+    GBA_JIT_ALU_TST,
+    GBA_JIT_ALU_TEQ,
+    GBA_JIT_ALU_CMP,
+    GBA_JIT_ALU_CMN,
+    GBA_JIT_ALU_ORR,
+    GBA_JIT_ALU_MOV,
+    GBA_JIT_ALU_BIC,
+    GBA_JIT_ALU_MVN
+} gba_jit_aluOperation_t;
+
+typedef enum {
+    GBA_JIT_SHIFT_LSL,
+    GBA_JIT_SHIFT_LSR,
+    GBA_JIT_SHIFT_ASR,
+    GBA_JIT_SHIFT_ROR
+} gba_jit_shiftType_t;
+
+typedef enum {
+    GBA_JIT_CARRY_UNCHANGED,
+    GBA_JIT_CARRY_CLEAR,
+    GBA_JIT_CARRY_SET,
+    GBA_JIT_CARRY_SHIFTER
+} gba_jit_shifterCarry_t;
+
+// A guest instruction that can be translated to native code. Register
+// fields are -1 when unused. Reading r15 yields the address of the
+// instruction plus two instructions, like the interpreter does.
+typedef struct {
+    gba_jit_kind_t kind;
+    uint32_t condition;
+    gba_jit_aluOperation_t aluOperation;
+    bool setFlags;
+    int rd;
+    int rn;
+    int rm;
+    uint32_t immediate;
+    gba_jit_shiftType_t shiftType;
+    int shiftAmount;
+    gba_jit_shifterCarry_t shifterCarry;
+    int size;
+    bool link;
+    uint32_t linkValue;
+} gba_jit_operation_t;
+
+// A block translated from ROM, found again by its address and the state its
+// translation depends on. The offset is relative to the start of the blocks
+// in the buffer.
+typedef struct {
+    uint32_t address;
+    uint32_t length;
+    uint32_t thumb;
+    uint32_t opcodesHash;
+    uint32_t cyclesHash;
+    uint32_t offset;
+} gba_jit_cacheEntry_t;
+
+// The 64-bit immediate at the given offset holds a host address, which is
+// saved as the index of the symbol it points to.
+typedef struct {
+    uint32_t offset;
+    uint32_t symbol;
+} gba_jit_relocation_t;
+
+// The cache file holds the header, the entries, the relocations and the
+// translated code, in this order.
+typedef struct {
+    char signature[8];
+    uint32_t buildId;
+    uint32_t codeOffset;
+    uint64_t romHash;
+    uint32_t codeSize;
+    uint32_t entryCount;
+    uint32_t relocationCount;
+    uint32_t padding;
+} gba_jit_cacheHeader_t;
+
+static const gba_jit_hostRegister_t gba_jit_cachedRegisters[GBA_JIT_CACHED_REGISTER_COUNT] = {
+    GBA_JIT_RBP,
+    GBA_JIT_R12,
+    GBA_JIT_R13,
+    GBA_JIT_R14,
+    GBA_JIT_R15
+};
+
+uint8_t *gba_jit_buffer;
+uint8_t *gba_jit_bufferStart;
+uint8_t *gba_jit_code;
+uint8_t *gba_jit_epilogue;
+void *gba_jit_trampoline;
+int gba_jit_cachedGuest[GBA_JIT_CACHED_REGISTER_COUNT];
+bool gba_jit_cachedDirty[GBA_JIT_CACHED_REGISTER_COUNT];
+bool gba_jit_cachedPinned[GBA_JIT_CACHED_REGISTER_COUNT];
+uint32_t gba_jit_cachedLastUse[GBA_JIT_CACHED_REGISTER_COUNT];
+uint32_t gba_jit_useCounter;
+int gba_jit_pendingCycles;
+int gba_jit_fetchCycles;
+int gba_jit_remainingInstructions;
+uint32_t gba_jit_address;
+bool gba_jit_thumb;
+
+// The blocks loaded from the persistent cache end at gba_jit_cacheEnd, and
+// are kept when the translated code is discarded.
+uint8_t *gba_jit_cacheEnd;
+char *gba_jit_cachePath;
+uint64_t gba_jit_cacheRomHash;
+bool gba_jit_cacheEnabled;
+bool gba_jit_recording;
+bool gba_jit_relocatable;
+gba_jit_cacheEntry_t *gba_jit_cacheEntries;
+uint32_t gba_jit_cacheEntryCount;
+uint32_t gba_jit_cacheEntryCapacity;
+uint32_t gba_jit_loadedEntryCount;
+gba_jit_relocation_t *gba_jit_relocations;
+uint32_t gba_jit_relocationCount;
+uint32_t gba_jit_relocationCapacity;
+uint32_t gba_jit_loadedRelocationCount;
+uint32_t *gba_jit_cacheTable;
+uint32_t gba_jit_cacheTableMask;
+uintptr_t gba_jit_symbols[GBA_JIT_MAX_SYMBOLS];
+const char *gba_jit_symbolNames[GBA_JIT_MAX_SYMBOLS];
+uint32_t gba_jit_symbolCount;
+
+#endif
+
+bool gba_jit_init();
+void gba_jit_flush();
+void *gba_jit_compile(uint32_t address, bool thumb, const uint32_t *opcodes, int length);
+void *gba_jit_run(void *code);
+void gba_jit_link(void *patchSite, void *code);
+bool gba_jit_openCache(const char *fileName, uint64_t romHash);
+bool gba_jit_closeCache();
+uint32_t gba_jit_getBuildId();
+
+#ifdef GBA_JIT_SUPPORTED
+
+static inline void gba_jit_initSymbols();
+static inline uint32_t gba_jit_getSymbol(uintptr_t pointer);
+static inline bool gba_jit_isCacheable(uint32_t address);
+static inline uint32_t gba_jit_getCacheSlot(const gba_jit_cacheEntry_t *entry);
+static inline void *gba_jit_findCached(const gba_jit_cacheEntry_t *key);
+static inline void gba_jit_addCacheEntry(const gba_jit_cacheEntry_t *entry);
+static inline void gba_jit_addRelocation(uint32_t offset, uint32_t symbol);
+static inline bool gba_jit_reserve(void **array, uint32_t *capacity, uint32_t count, size_t size);
+static inline bool gba_jit_buildCacheTable();
+static inline void gba_jit_resetCache();
+static inline void gba_jit_disableCache();
+static inline bool gba_jit_loadCache();
+static inline bool gba_jit_readCache(const uint8_t *file, size_t size);
+static inline bool gba_jit_saveCache();
+static inline uint32_t gba_jit_hash(uint32_t hash, const void *data, size_t size);
+static uint32_t gba_jit_read8(uint32_t address);
+static uint32_t gba_jit_read16(uint32_t address);
+static uint32_t gba_jit_read32(uint32_t address);
+static inline bool gba_jit_decodeArm(uint32_t opcode, gba_jit_operation_t *operation);
+static inline bool gba_jit_decodeThumb(uint16_t opcode, gba_jit_operation_t *operation);
+static inline bool gba_jit_translate(uint32_t opcode);
+static inline void gba_jit_prepare(const gba_jit_operation_t *operation);
+static inline uint8_t *gba_jit_emitConditionCheck(uint32_t condition);
+static inline void gba_jit_emitAlu(const gba_jit_operation_t *operation);
+static inline void gba_jit_emitAddress(const gba_jit_operation_t *operation);
+static inline void gba_jit_emitLoad(const gba_jit_operation_t *operation);
+static inline void gba_jit_emitStore(const gba_jit_operation_t *operation);
+static inline void gba_jit_emitBranch(const gba_jit_operation_t *operation);
+static inline void gba_jit_emitFallback(uint32_t opcode);
+static inline void gba_jit_emitBudgetCheck(int cycles);
+static inline void gba_jit_emitEventCheck(bool invalidation);
+static inline void gba_jit_emitExit(uint32_t address, int cycles, bool link);
+static inline void gba_jit_emitReturn(bool link);
+static inline void gba_jit_resetRegisters();
+static inline int gba_jit_allocateRegister(int guest, bool load);
+static inline gba_jit_hostRegister_t gba_jit_getRegister(int guest);
+static inline void gba_jit_flushRegisters(bool release);
+static inline uint32_t gba_jit_getPc();
+static inline void gba_jit_emitReadGuest(gba_jit_hostRegister_t reg, int guest);
+static inline void gba_jit_emitAluGuest(uint8_t opcode, int extension, gba_jit_hostRegister_t reg, int guest);
+static inline void gba_jit_emit8(uint8_t value);
+static inline void gba_jit_emit32(uint32_t value);
+static inline void gba_jit_emit64(uint64_t value);
+static inline void gba_jit_emitRex(bool w, int reg, int rm);
+static inline void gba_jit_emitModRm(int mod, int reg, int rm);
+static inline void gba_jit_emitRegReg(uint8_t opcode, gba_jit_hostRegister_t rm, gba_jit_hostRegister_t reg);
+static inline void gba_jit_emitRegImm(int extension, gba_jit_hostRegister_t rm, uint32_t immediate);
+static inline void gba_jit_emitShiftImm(int extension, gba_jit_hostRegister_t rm, int amount);
+static inline void gba_jit_emitNot(gba_jit_hostRegister_t rm);
+static inline void gba_jit_emitMovImm32(gba_jit_hostRegister_t reg, uint32_t immediate);
+static inline void gba_jit_emitMovImm64(gba_jit_hostRegister_t reg, uint64_t immediate);
+static inline void gba_jit_emitMovPointer(gba_jit_hostRegister_t reg, uintptr_t pointer);
+static inline void gba_jit_emitLoadGuest(gba_jit_hostRegister_t reg, int guest);
+static inline void gba_jit_emitStoreGuest(int guest, gba_jit_hostRegister_t reg);
+static inline void gba_jit_emitStoreGuestImm(int guest, uint32_t immediate);
+static inline void gba_jit_emitSetFlag(bool *flag, gba_jit_hostCondition_t condition);
+static inline void gba_jit_emitStoreFlag(bool *flag, bool value);
+static inline void gba_jit_emitAddCycles(int cycles);
+static inline void gba_jit_emitCall(uintptr_t function);
+static inline uint8_t *gba_jit_emitJump();
+static inline uint8_t *gba_jit_emitJumpIf(gba_jit_hostCondition_t condition);
+static inline void gba_jit_patch(uint8_t *field, const uint8_t *target);
+
+bool gba_jit_init() {
+    if(gba_jit_buffer) {
+        return true;
+    }
+
+    void *buffer = mmap(NULL, GBA_JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(buffer == MAP_FAILED) {
+        return false;
+    }
+
+    gba_jit_buffer = buffer;
+    gba_jit_code = gba_jit_buffer;
+
+    // Trampoline: saves the callee-saved registers, points rbx to the guest
+    // registers and jumps to the block passed as the first argument.
+    gba_jit_trampoline = gba_jit_code;
+    gba_jit_emit8(0x53); // push rbx
+    gba_jit_emit8(0x55); // push rbp
+    gba_jit_emit8(0x41); gba_jit_emit8(0x54); // push r12
+    gba_jit_emit8(0x41); gba_jit_emit8(0x55); // push r13
+    gba_jit_emit8(0x41); gba_jit_emit8(0x56); // push r14
+    gba_jit_emit8(0x41); gba_jit_emit8(0x57); // push r15
+    gba_jit_emit8(0x48); gba_jit_emit8(0x83); gba_jit_emit8(0xec); gba_jit_emit8(0x08); // sub rsp, 8
+    gba_jit_emitMovImm64(GBA_JIT_RBX, (uintptr_t)gba_cpu_r);
+    gba_jit_emit8(0xff); gba_jit_emit8(0xe7); // jmp rdi
+
+    // Epilogue: every block returns through here, with the patch site of
+    // its exit in rax when the next block may be linked to it.
+    gba_jit_epilogue = gba_jit_code;
+    gba_jit_emit8(0x48); gba_jit_emit8(0x83); gba_jit_emit8(0xc4); gba_jit_emit8(0x08); // add rsp, 8
+    gba_jit_emit8(0x41); gba_jit_emit8(0x5f); // pop r15
+    gba_jit_emit8(0x41); gba_jit_emit8(0x5e); // pop r14
+    gba_jit_emit8(0x41); gba_jit_emit8(0x5d); // pop r13
+    gba_jit_emit8(0x41); gba_jit_emit8(0x5c); // pop r12
+    gba_jit_emit8(0x5d); // pop rbp
+    gba_jit_emit8(0x5b); // pop rbx
+    gba_jit_emit8(0xc3); // ret
+
+    gba_jit_bufferStart = gba_jit_code;
+    gba_jit_cacheEnd = gba_jit_code;
+    gba_jit_initSymbols();
+    gba_jit_epoch++;
+
+    return true;
+}
+
+void gba_jit_flush() {
+    if(gba_jit_buffer) {
+        gba_jit_code = gba_jit_cacheEnd;
+    }
+
+    if(gba_jit_cacheEnabled) {
+        gba_jit_resetCache();
+    }
+
+    gba_jit_epoch++;
+}
+
+void *gba_jit_compile(uint32_t address, bool thumb, const uint32_t *opcodes, int length) {
+    if(!gba_jit_buffer) {
+        return NULL;
+    }
+
+    gba_jit_cacheEntry_t entry;
+
+    gba_jit_recording = gba_jit_cacheEnabled && gba_jit_isCacheable(address);
+
+    if(gba_jit_recording) {
+        entry.address = address;
+        entry.length = length;
+        entry.thumb = thumb;
+        entry.opcodesHash = gba_jit_hash(GBA_JIT_HASH_BASIS, opcodes, length * sizeof(uint32_t));
+        entry.cyclesHash = gba_jit_hash(GBA_JIT_HASH_BASIS, gba_bus_cycles, sizeof(gba_bus_cycles));
+
+        void *cached = gba_jit_findCached(&entry);
+
+        if(cached) {
+            gba_jit_recording = false;
+            gba_jit_cacheHits++;
+            return cached;
+        }
+    }
+
+    if(gba_jit_code + GBA_JIT_BLOCK_RESERVE > gba_jit_buffer + GBA_JIT_BUFFER_SIZE) {
+        // The blocks loaded from the cache are discarded as well.
+        gba_jit_cacheEnd = gba_jit_bufferStart;
+        gba_jit_loadedEntryCount = 0;
+        gba_jit_loadedRelocationCount = 0;
+        gba_jit_flush();
+    }
+
+    void *code = gba_jit_code;
+    bool end = false;
+    uint32_t relocationCount = gba_jit_relocationCount;
+
+    gba_jit_relocatable = true;
+
+    gba_jit_thumb = thumb;
+    gba_jit_address = address;
+    gba_jit_pendingCycles = 0;
+    gba_jit_fetchCycles = gba_bus_cycles[thumb ? GBA_BUS_ACCESS_S16 : GBA_BUS_ACCESS_S32][(address >> 24) & 0x0f];
+    gba_jit_resetRegisters();
+    gba_jit_emitBudgetCheck(length * gba_jit_fetchCycles);
+
+    for(int i = 0; i < length && !end; i++) {
+        gba_jit_remainingInstructions = length - i - 1;
+        end = gba_jit_translate(opcodes[i]);
+        gba_jit_address += thumb ? 2 : 4;
+    }
+
+    if(!end) {
+        gba_jit_emitExit(gba_jit_address, 0, true);
+    }
+
+    if(gba_jit_recording) {
+        if(gba_jit_relocatable) {
+            entry.offset = (uint8_t *)code - gba_jit_bufferStart;
+            gba_jit_addCacheEntry(&entry);
+        } else {
+            gba_jit_relocationCount = relocationCount;
+        }
+
+        gba_jit_recording = false;
+    }
+
+    return code;
+}
+
+void *gba_jit_run(void *code) {
+    void *(*trampoline)(void *);
+
+    // ISO C does not allow converting object pointers to function pointers.
+    memcpy(&trampoline, &gba_jit_trampoline, sizeof(trampoline));
+
+    return trampoline(code);
+}
+
+void gba_jit_link(void *patchSite, void *code) {
+    gba_jit_patch(patchSite, code);
+}
+
+// Loads the blocks that were translated from the ROM with the given hash by
+// this build in a previous run, and records the blocks translated from now
+// on so that gba_jit_closeCache() saves them to the same file. Returns
+// whether blocks were loaded.
+bool gba_jit_openCache(const char *fileName, uint64_t romHash) {
+    if(!gba_jit_buffer) {
+        return false;
+    }
+
+    gba_jit_disableCache();
+    gba_jit_cachePath = malloc(strlen(fileName) + 1);
+
+    if(!gba_jit_cachePath) {
+        return false;
+    }
+
+    strcpy(gba_jit_cachePath, fileName);
+    gba_jit_cacheRomHash = romHash;
+    gba_jit_cacheEnabled = true;
+
+    // The loaded blocks take the place of the code translated so far.
+    gba_jit_code = gba_jit_bufferStart;
+    gba_jit_cacheEnd = gba_jit_bufferStart;
+    gba_jit_epoch++;
+
+    if(!gba_jit_loadCache()) {
+        gba_jit_cacheEnd = gba_jit_bufferStart;
+        gba_jit_code = gba_jit_bufferStart;
+        gba_jit_cacheEntryCount = 0;
+        gba_jit_loadedEntryCount = 0;
+        gba_jit_relocationCount = 0;
+        gba_jit_loadedRelocationCount = 0;
+        gba_jit_buildCacheTable();
+
+        return false;
+    }
+
+    return true;
+}
+
+// Saves the blocks translated from ROM and stops recording them. Returns
+// whether the cache file was written.
+bool gba_jit_closeCache() {
+    bool result = gba_jit_cacheEnabled && gba_jit_saveCache();
+
+    gba_jit_disableCache();
+
+    return result;
+}
+
+// Identifies the translations made by this build, from the cache format,
+// the core sources and the symbols the relocations refer to by index.
+uint32_t gba_jit_getBuildId() {
+    static const char build[] = GBA_JIT_BUILD_ID
+#ifdef GBA_CALLPROF
+        " callprof"
+#endif
+#ifdef GBA_CPU_PROFILE
+        " profile"
+#endif
+        ;
+    uint32_t version = GBA_JIT_CACHE_VERSION;
+    uint32_t hash = gba_jit_hash(GBA_JIT_HASH_BASIS, &version, sizeof(version));
+
+    hash = gba_jit_hash(hash, build, sizeof(build));
+
+    if(!gba_jit_symbolCount) {
+        gba_jit_initSymbols();
+    }
+
+    for(uint32_t i = 0; i < gba_jit_symbolCount; i++) {
+        hash = gba_jit_hash(hash, gba_jit_symbolNames[i], strlen(gba_jit_symbolNames[i]) + 1);
+    }
+
+    return hash;
+}
+
+static inline void gba_jit_initSymbols() {
+    uint32_t count = 0;
+
+    GBA_JIT_ADD_SYMBOL(gba_cpu_r);
+    GBA_JIT_ADD_SYMBOL(&gba_cpu_flagN);
+    GBA_JIT_ADD_SYMBOL(&gba_cpu_flagZ);
+    GBA_JIT_ADD_SYMBOL(&gba_cpu_flagC);
+    GBA_JIT_ADD_SYMBOL(&gba_cpu_flagV);
+    GBA_JIT_ADD_SYMBOL(&gba_cpu_blockInvalidated);
+    GBA_JIT_ADD_SYMBOL(&gba_scheduler_cycleCounter);
+    GBA_JIT_ADD_SYMBOL(&gba_scheduler_nextEventTimestamp);
+    GBA_JIT_ADD_SYMBOL(&gba_jit_linkBlocked);
+    GBA_JIT_ADD_SYMBOL(gba_cpu_jitCheckCondition);
+    GBA_JIT_ADD_SYMBOL(gba_cpu_jitJump);
+    GBA_JIT_ADD_SYMBOL(gba_cpu_jitInterpretArm);
+    GBA_JIT_ADD_SYMBOL(gba_cpu_jitInterpretThumb);
+    GBA_JIT_ADD_SYMBOL(gba_jit_read8);
+    GBA_JIT_ADD_SYMBOL(gba_jit_read16);
+    GBA_JIT_ADD_SYMBOL(gba_jit_read32);
+    GBA_JIT_ADD_SYMBOL(gba_bus_write8);
+    GBA_JIT_ADD_SYMBOL(gba_bus_write16);
+    GBA_JIT_ADD_SYMBOL(gba_bus_write32);
+
+    gba_jit_symbolCount = count;
+}
+
+// Blocks referring to any other address are not saved.
+static inline uint32_t gba_jit_getSymbol(uintptr_t pointer) {
+    if(pointer >= (uintptr_t)gba_jit_bufferStart && pointer < (uintptr_t)gba_jit_buffer + GBA_JIT_BUFFER_SIZE) {
+        return GBA_JIT_SYMBOL_CODE;
+    }
+
+    for(uint32_t i = 0; i < gba_jit_symbolCount; i++) {
+        if(gba_jit_symbols[i] == pointer) {
+            return i;
+        }
+    }
+
+    gba_jit_relocatable = false;
+
+    return 0;
+}
+
+// Only the code in ROM is known to be the same in the next run.
+static inline bool gba_jit_isCacheable(uint32_t address) {
+    return address >= 0x08000000 && address < 0x0e000000;
+}
+
+static inline uint32_t gba_jit_getCacheSlot(const gba_jit_cacheEntry_t *entry) {
+    return (entry->address * 0x9e3779b1) ^ entry->opcodesHash;
+}
+
+static inline void *gba_jit_findCached(const gba_jit_cacheEntry_t *key) {
+    if(!gba_jit_cacheTable) {
+        return NULL;
+    }
+
+    uint32_t slot = gba_jit_getCacheSlot(key);
+
+    while(true) {
+        uint32_t index = gba_jit_cacheTable[slot & gba_jit_cacheTableMask];
+
+        if(index == 0) {
+            return NULL;
+        }
+
+        const gba_jit_cacheEntry_t *entry = &gba_jit_cacheEntries[index - 1];
+
+        if(
+            entry->address == key->address
+            && entry->length == key->length
+            && entry->thumb == key->thumb
+            && entry->opcodesHash == key->opcodesHash
+            && entry->cyclesHash == key->cyclesHash
+        ) {
+            return gba_jit_bufferStart + entry->offset;
+        }
+
+        slot++;
+    }
+}
+
+static inline void gba_jit_addCacheEntry(const gba_jit_cacheEntry_t *entry) {
+    if(!gba_jit_reserve((void **)&gba_jit_cacheEntries, &gba_jit_cacheEntryCapacity, gba_jit_cacheEntryCount + 1, sizeof(gba_jit_cacheEntry_t))) {
+        gba_jit_disableCache();
+        return;
+    }
+
+    gba_jit_cacheEntries[gba_jit_cacheEntryCount++] = *entry;
+
+    // The table is kept at most half full.
+    if(gba_jit_cacheEntryCount * 2 > gba_jit_cacheTableMask) {
+        if(!gba_jit_buildCacheTable()) {
+            gba_jit_disableCache();
+        }
+
+        return;
+    }
+
+    uint32_t slot = gba_jit_getCacheSlot(entry);
+
+    while(gba_jit_cacheTable[slot & gba_jit_cacheTableMask]) {
+        slot++;
+    }
+
+    gba_jit_cacheTable[slot & gba_jit_cacheTableMask] = gba_jit_cacheEntryCount;
+}
+
+static inline void gba_jit_addRelocation(uint32_t offset, uint32_t symbol) {
+    if(!gba_jit_reserve((void **)&gba_jit_relocations, &gba_jit_relocationCapacity, gba_jit_relocationCount + 1, sizeof(gba_jit_relocation_t))) {
+        gba_jit_disableCache();
+        gba_jit_recording = false;
+        return;
+    }
+
+    gba_jit_relocations[gba_jit_relocationCount++] = (gba_jit_relocation_t){offset, symbol};
+}
+
+static inline bool gba_jit_reserve(void **array, uint32_t *capacity, uint32_t count, size_t size) {
+    if(count <= *capacity) {
+        return true;
+    }
+
+    uint32_t newCapacity = *capacity ? *capacity * 2 : 1024;
+
+    while(newCapacity < count) {
+        newCapacity *= 2;
+    }
+
+    void *buffer = realloc(*array, newCapacity * size);
+
+    if(!buffer) {
+        return false;
+    }
+
+    *array = buffer;
+    *capacity = newCapacity;
+
+    return true;
+}
+
+static inline bool gba_jit_buildCacheTable() {
+    uint32_t size = 1024;
+
+    while(size < gba_jit_cacheEntryCount * 4) {
+        size *= 2;
+    }
+
+    uint32_t *table = calloc(size, sizeof(uint32_t));
+
+    if(!table) {
+        return false;
+    }
+
+    free(gba_jit_cacheTable);
+    gba_jit_cacheTable = table;
+    gba_jit_cacheTableMask = size - 1;
+
+    for(uint32_t i = 0; i < gba_jit_cacheEntryCount; i++) {
+        const gba_jit_cacheEntry_t *entry = &gba_jit_cacheEntries[i];
+        uint32_t slot = gba_jit_getCacheSlot(entry);
+
+        while(gba_jit_cacheTable[slot & gba_jit_cacheTableMask]) {
+            slot++;
+        }
+
+        gba_jit_cacheTable[slot & gba_jit_cacheTableMask] = i + 1;
+    }
+
+    return true;
+}
+
+// Forgets the blocks translated since the cache was loaded. The loaded
+// blocks may have been linked to them, so their exits are unlinked.
+static inline void gba_jit_resetCache() {
+    for(uint32_t i = 0; i < gba_jit_loadedRelocationCount; i++) {
+        if(gba_jit_relocations[i].symbol == GBA_JIT_SYMBOL_CODE) {
+            uint8_t *patchSite;
+
+            memcpy(&patchSite, gba_jit_bufferStart + gba_jit_relocations[i].offset, sizeof(patchSite));
+            gba_jit_patch(patchSite, patchSite + 4);
+        }
+    }
+
+    gba_jit_cacheEntryCount = gba_jit_loadedEntryCount;
+    gba_jit_relocationCount = gba_jit_loadedRelocationCount;
+
+    if(!gba_jit_buildCacheTable()) {
+        gba_jit_disableCache();
+    }
+}
+
+// The loaded blocks are left in the buffer until the next flush, which no
+// longer keeps them.
+static inline void gba_jit_disableCache() {
+    free(gba_jit_cachePath);
+    free(gba_jit_cacheEntries);
+    free(gba_jit_relocations);
+    free(gba_jit_cacheTable);
+    gba_jit_cachePath = NULL;
+    gba_jit_cacheEntries = NULL;
+    gba_jit_relocations = NULL;
+    gba_jit_cacheTable = NULL;
+    gba_jit_cacheEntryCount = 0;
+    gba_jit_cacheEntryCapacity = 0;
+    gba_jit_loadedEntryCount = 0;
+    gba_jit_relocationCount = 0;
+    gba_jit_relocationCapacity = 0;
+    gba_jit_loadedRelocationCount = 0;
+    gba_jit_cacheTableMask = 0;
+    gba_jit_cacheEnabled = false;
+    gba_jit_cacheEnd = gba_jit_bufferStart;
+}
+
+static inline bool gba_jit_loadCache() {
+    int file = open(gba_jit_cachePath, O_RDONLY);
+    struct stat status;
+
+    if(file < 0) {
+        return false;
+    }
+
+    if(fstat(file, &status) || status.st_size < (off_t)sizeof(gba_jit_cacheHeader_t)) {
+        close(file);
+        return false;
+    }
+
+    void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    bool result = false;
+
+    if(data != MAP_FAILED) {
+        result = gba_jit_readCache(data, status.st_size);
+        munmap(data, status.st_size);
+    }
+
+    close(file);
+
+    return result;
+}
+
+// The file is checked against this run and the host addresses are bound to
+// the symbols of this process before any of its blocks is used.
+static inline bool gba_jit_readCache(const uint8_t *file, size_t size) {
+    gba_jit_cacheHeader_t header;
+
+    memcpy(&header, file, sizeof(header));
+
+    uint64_t entriesSize = (uint64_t)header.entryCount * sizeof(gba_jit_cacheEntry_t);
+    uint64_t relocationsSize = (uint64_t)header.relocationCount * sizeof(gba_jit_relocation_t);
+
+    if(
+        memcmp(header.signature, GBA_JIT_CACHE_SIGNATURE, sizeof(header.signature)) != 0
+        || header.buildId != gba_jit_getBuildId()
+        || header.romHash != gba_jit_cacheRomHash
+        || header.codeOffset != gba_jit_bufferStart - gba_jit_buffer
+        || header.codeSize > GBA_JIT_BUFFER_SIZE - header.codeOffset - GBA_JIT_BLOCK_RESERVE
+        || sizeof(header) + entriesSize + relocationsSize + header.codeSize != size
+    ) {
+        return false;
+    }
+
+    if(
+        !gba_jit_reserve((void **)&gba_jit_cacheEntries, &gba_jit_cacheEntryCapacity, header.entryCount, sizeof(gba_jit_cacheEntry_t))
+        || !gba_jit_reserve((void **)&gba_jit_relocations, &gba_jit_relocationCapacity, header.relocationCount, sizeof(gba_jit_relocation_t))
+    ) {
+        return false;
+    }
+
+    const uint8_t *code = file + sizeof(header) + entriesSize + relocationsSize;
+
+    memcpy(gba_jit_cacheEntries, file + sizeof(header), entriesSize);
+    memcpy(gba_jit_relocations, file + sizeof(header) + entriesSize, relocationsSize);
+    memcpy(gba_jit_bufferStart, code, header.codeSize);
+
+    for(uint32_t i = 0; i < header.entryCount; i++) {
+        if(gba_jit_cacheEntries[i].offset >= header.codeSize) {
+            return false;
+        }
+    }
+
+    for(uint32_t i = 0; i < header.relocationCount; i++) {
+        gba_jit_relocation_t *relocation = &gba_jit_relocations[i];
+        uint64_t value;
+
+        if((uint64_t)relocation->offset + sizeof(value) > header.codeSize) {
+            return false;
+        }
+
+        memcpy(&value, code + relocation->offset, sizeof(value));
+
+        if(relocation->symbol == GBA_JIT_SYMBOL_CODE) {
+            if(value < header.codeOffset || value + 4 > (uint64_t)header.codeOffset + header.codeSize) {
+                return false;
+            }
+
+            value += (uintptr_t)gba_jit_buffer;
+        } else if(relocation->symbol < gba_jit_symbolCount) {
+            value = gba_jit_symbols[relocation->symbol];
+        } else {
+            return false;
+        }
+
+        memcpy(gba_jit_bufferStart + relocation->offset, &value, sizeof(value));
+    }
+
+    gba_jit_cacheEntryCount = header.entryCount;
+    gba_jit_loadedEntryCount = header.entryCount;
+    gba_jit_relocationCount = header.relocationCount;
+    gba_jit_loadedRelocationCount = header.relocationCount;
+    gba_jit_cacheEnd = gba_jit_bufferStart + header.codeSize;
+    gba_jit_code = gba_jit_cacheEnd;
+
+    return gba_jit_buildCacheTable();
+}
+
+// The exits are saved unlinked, as they may have been linked to blocks that
+// are not saved. The file is renamed into place once complete, so that other
+// runs never read a partial file.
+static inline bool gba_jit_saveCache() {
+    gba_jit_cacheHeader_t header;
+    uint32_t codeSize = gba_jit_code - gba_jit_bufferStart;
+    uint8_t *code = malloc(codeSize ? codeSize : 1);
+
+    if(!code) {
+        return false;
+    }
+
+    memcpy(code, gba_jit_bufferStart, codeSize);
+
+    for(uint32_t i = 0; i < gba_jit_relocationCount; i++) {
+        const gba_jit_relocation_t *relocation = &gba_jit_relocations[i];
+        uint64_t value = relocation->symbol;
+
+        if(relocation->symbol == GBA_JIT_SYMBOL_CODE) {
+            uint8_t *patchSite;
+            int32_t offset = 0;
+
+            memcpy(&patchSite, code + relocation->offset, sizeof(patchSite));
+            memcpy(code + (patchSite - gba_jit_bufferStart), &offset, sizeof(offset));
+            value = patchSite - gba_jit_buffer;
+        }
+
+        memcpy(code + relocation->offset, &value, sizeof(value));
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.signature, GBA_JIT_CACHE_SIGNATURE, sizeof(header.signature));
+    header.buildId = gba_jit_getBuildId();
+    header.codeOffset = gba_jit_bufferStart - gba_jit_buffer;
+    header.romHash = gba_jit_cacheRomHash;
+    header.codeSize = codeSize;
+    header.entryCount = gba_jit_cacheEntryCount;
+    header.relocationCount = gba_jit_relocationCount;
+
+    size_t pathSize = strlen(gba_jit_cachePath) + 16;
+    char *temporaryPath = malloc(pathSize);
+    bool result = false;
+
+    if(temporaryPath) {
+        snprintf(temporaryPath, pathSize, "%s.%d", gba_jit_cachePath, (int)getpid());
+
+        FILE *file = fopen(temporaryPath, "wb");
+
+        if(file) {
+            result = fwrite(&header, sizeof(header), 1, file) == 1
+                && fwrite(gba_jit_cacheEntries, sizeof(gba_jit_cacheEntry_t), gba_jit_cacheEntryCount, file) == gba_jit_cacheEntryCount
+                && fwrite(gba_jit_relocations, sizeof(gba_jit_relocation_t), gba_jit_relocationCount, file) == gba_jit_relocationCount
+                && fwrite(code, 1, codeSize, file) == codeSize;
+            result = fclose(file) == 0 && result;
+            result = result && rename(temporaryPath, gba_jit_cachePath) == 0;
+
+            if(!result) {
+                remove(temporaryPath);
+            }
+        }
+
+        free(temporaryPath);
+    }
+
+    free(code);
+
+    return result;
+}
+
+// FNV-1a
+static inline uint32_t gba_jit_hash(uint32_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+static uint32_t gba_jit_read8(uint32_t address) {
+    return gba_bus_read8(address);
+}
+
+static uint32_t gba_jit_read16(uint32_t address) {
+    uint32_t value = gba_bus_read16(address);
+    int rotation = (address & 0x00000001) << 3;
+
+    return rotation ? (value >> rotation) | (value << (32 - rotation)) : value;
+}
+
+static uint32_t gba_jit_read32(uint32_t address) {
+    uint32_t value = gba_bus_read32(address);
+    int rotation = (address & 0x00000003) << 3;
+
+    return rotation ? (value >> rotation) | (value << (32 - rotation)) : value;
+}
+
+static inline bool gba_jit_decodeArm(uint32_t opcode, gba_jit_operation_t *operation) {
+    memset(operation, 0, sizeof(gba_jit_operation_t));
+    operation->condition = opcode >> 28;
+    operation->rd = (opcode & 0x0000f000) >> 12;
+    operation->rn = (opcode & 0x000f0000) >> 16;
+    operation->rm = -1;
+
+    if(operation->condition > GBA_JIT_CONDITION_AL) {
+        return false;
+    }
+
+    switch((opcode & 0x0e000000) >> 25) {
+        case 0x0:
+        case 0x1:
+            if(
+                (opcode & 0x0ff000f0) == 0x01200010 // BX
+                || (opcode & 0x02000090) == 0x00000090 // Multiplications, swaps, halfword transfers
+                || (opcode & 0x01900000) == 0x01000000 // PSR transfers
+            ) {
+                return false;
+            }
+
+            operation->kind = GBA_JIT_KIND_ALU;
+            operation->aluOperation = (opcode & 0x01e00000) >> 21;
+            operation->setFlags = (opcode & (1 << 20)) != 0;
+
+            if(
+                operation->rd == 15
+                || operation->aluOperation == GBA_JIT_ALU_ADC
+                || operation->aluOperation == GBA_JIT_ALU_SBC
+                || operation->aluOperation == GBA_JIT_ALU_RSC
+            ) {
+                return false;
+            }
+
+            if(operation->aluOperation == GBA_JIT_ALU_MOV || operation->aluOperation == GBA_JIT_ALU_MVN) {
+                operation->rn = -1;
+            }
+
+            if(opcode & (1 << 25)) {
+                int rotation = (opcode & 0x00000f00) >> 7;
+                uint32_t immediate = opcode & 0x000000ff;
+
+                if(rotation) {
+                    operation->immediate = (immediate >> rotation) | (immediate << (32 - rotation));
+                    operation->shifterCarry = (operation->immediate >> 31) ? GBA_JIT_CARRY_SET : GBA_JIT_CARRY_CLEAR;
+                } else {
+                    operation->immediate = immediate;
+                }
+            } else {
+                // Shifts by a register are left to the interpreter.
+                if(opcode & (1 << 4)) {
+                    return false;
+                }
+
+                operation->rm = opcode & 0x0000000f;
+                operation->shiftType = (opcode & 0x00000060) >> 5;
+                operation->shiftAmount = (opcode & 0x00000f80) >> 7;
+
+                // LSR #32, ASR #32 and RRX
+                if(operation->shiftAmount == 0 && operation->shiftType != GBA_JIT_SHIFT_LSL) {
+                    return false;
+                }
+
+                if(operation->shiftAmount) {
+                    operation->shifterCarry = GBA_JIT_CARRY_SHIFTER;
+                }
+            }
+
+            return true;
+
+        case 0x2:
+        case 0x3:
+            // Only immediate offsets without write-back are translated.
+            if(
+                (opcode & (1 << 25))
+                || !(opcode & (1 << 24))
+                || (opcode & (1 << 21))
+                || operation->rd == 15
+            ) {
+                return false;
+            }
+
+            operation->kind = (opcode & (1 << 20)) ? GBA_JIT_KIND_LOAD : GBA_JIT_KIND_STORE;
+            operation->size = (opcode & (1 << 22)) ? 1 : 4;
+            operation->immediate = opcode & 0x00000fff;
+
+            if(!(opcode & (1 << 23))) {
+                operation->immediate = -operation->immediate;
+            }
+
+            if(operation->rn == 15) {
+                operation->immediate += gba_jit_getPc();
+                operation->rn = -1;
+            }
+
+            return true;
+
+        case 0x5:
+            {
+                uint32_t offset = (opcode & 0x00ffffff) << 2;
+
+                if(offset & (1 << 25)) {
+                    offset |= 0xfc000000;
+                }
+
+#ifdef GBA_CALLPROF
+                // Calls are reported to the call profiler by the interpreter.
+                if(opcode & (1 << 24)) {
+                    return false;
+                }
+#endif
+
+                operation->kind = GBA_JIT_KIND_BRANCH;
+                operation->immediate = (gba_jit_getPc() + offset) & 0xfffffffc;
+                operation->link = (opcode & (1 << 24)) != 0;
+                operation->linkValue = gba_jit_address + 4;
+
+                return true;
+            }
+
+        default:
+            return false;
+    }
+}
+
+static inline bool gba_jit_decodeThumb(uint16_t opcode, gba_jit_operation_t *operation) {
+    memset(operation, 0, sizeof(gba_jit_operation_t));
+    operation->condition = GBA_JIT_CONDITION_AL;
+    operation->kind = GBA_JIT_KIND_ALU;
+    operation->rn = -1;
+    operation->rm = -1;
+
+    switch((opcode & 0xe000) >> 13) {
+        case 0:
+            operation->rd = opcode & 0x0007;
+            operation->setFlags = true;
+
+            if((opcode & 0x1800) == 0x1800) { // ADD/SUB
+                operation->aluOperation = (opcode & (1 << 9)) ? GBA_JIT_ALU_SUB : GBA_JIT_ALU_ADD;
+                operation->rn = (opcode & 0x0038) >> 3;
+
+                if(opcode & (1 << 10)) {
+                    operation->immediate = (opcode & 0x01c0) >> 6;
+                } else {
+                    operation->rm = (opcode & 0x01c0) >> 6;
+                }
+            } else { // LSL/LSR/ASR
+                operation->aluOperation = GBA_JIT_ALU_MOV;
+                operation->rm = (opcode & 0x0038) >> 3;
+                operation->shiftType = (opcode & 0x1800) >> 11;
+                operation->shiftAmount = (opcode & 0x07c0) >> 6;
+
+                if(operation->shiftAmount == 0 && operation->shiftType != GBA_JIT_SHIFT_LSL) {
+                    return false;
+                }
+
+                if(operation->shiftAmount) {
+                    operation->shifterCarry = GBA_JIT_CARRY_SHIFTER;
+                }
+            }
+
+            return true;
+
+        case 1: // MOV/CMP/ADD/SUB immediate
+            {
+                static const gba_jit_aluOperation_t operations[4] = {
+                    GBA_JIT_ALU_MOV,
+                    GBA_JIT_ALU_CMP,
+                    GBA_JIT_ALU_ADD,
+                    GBA_JIT_ALU_SUB
+                };
+
+                operation->aluOperation = operations[(opcode & 0x1800) >> 11];
+                operation->setFlags = true;
+                operation->rd = (opcode & 0x0700) >> 8;
+                operation->immediate = opcode & 0x00ff;
+
+                if(operation->aluOperation != GBA_JIT_ALU_MOV) {
+                    operation->rn = operation->rd;
+                }
+
+                return true;
+            }
+
+        case 2:
+            if(opcode & (1 << 12)) { // Register offset
+                operation->rd = opcode & 0x0007;
+                operation->rn = (opcode & 0x0038) >> 3;
+                operation->rm = (opcode & 0x01c0) >> 6;
+                operation->kind = (opcode & (1 << 11)) ? GBA_JIT_KIND_LOAD : GBA_JIT_KIND_STORE;
+
+                if(opcode & (1 << 9)) {
+                    // LDSB and LDSH are left to the interpreter.
+                    if(opcode & (1 << 10)) {
+                        return false;
+                    }
+
+                    operation->size = 2;
+                } else {
+                    operation->size = (opcode & (1 << 10)) ? 1 : 4;
+                }
+
+                return true;
+            } else if(opcode & (1 << 11)) { // PC-relative load
+                operation->kind = GBA_JIT_KIND_LOAD;
+                operation->size = 4;
+                operation->rd = (opcode & 0x0700) >> 8;
+                operation->immediate = (gba_jit_getPc() & 0xfffffffc) + ((opcode & 0x00ff) << 2);
+
+                return true;
+            } else if(opcode & (1 << 10)) { // Hi register operations
+                if((opcode & 0x0300) == 0x0300 || (opcode & 0x00c0) == 0x0000) {
+                    return false;
+                }
+
+                operation->rd = (opcode & 0x0007) | ((opcode & 0x0080) >> 4);
+                operation->rm = ((opcode & 0x0038) >> 3) | ((opcode & 0x0040) >> 3);
+
+                switch((opcode & 0x0300) >> 8) {
+                    case 0:
+                        operation->aluOperation = GBA_JIT_ALU_ADD;
+                        operation->rn = operation->rd;
+                        break;
+
+                    case 1:
+                        operation->aluOperation = GBA_JIT_ALU_CMP;
+                        operation->rn = operation->rd;
+                        operation->setFlags = true;
+                        return true;
+
+                    case 2:
+                        operation->aluOperation = GBA_JIT_ALU_MOV;
+                        break;
+                }
+
+                return operation->rd != 15;
+            } else { // ALU operations
+                operation->rd = opcode & 0x0007;
+                operation->rn = operation->rd;
+                operation->rm = (opcode & 0x0038) >> 3;
+                operation->setFlags = true;
+
+                switch((opcode & 0x03c0) >> 6) {
+                    case 0x0: operation->aluOperation = GBA_JIT_ALU_AND; break;
+                    case 0x1: operation->aluOperation = GBA_JIT_ALU_EOR; break;
+                    case 0x8: operation->aluOperation = GBA_JIT_ALU_TST; break;
+                    case 0xa: operation->aluOperation = GBA_JIT_ALU_CMP; break;
+                    case 0xb: operation->aluOperation = GBA_JIT_ALU_CMN; break;
+                    case 0xc: operation->aluOperation = GBA_JIT_ALU_ORR; break;
+                    case 0xe: operation->aluOperation = GBA_JIT_ALU_BIC; break;
+
+                    case 0x9: // NEG is RSB rd, rs, #0
+                        operation->aluOperation = GBA_JIT_ALU_RSB;
+                        operation->rn = operation->rm;
+                        operation->rm = -1;
+                        break;
+
+                    case 0xf:
+                        operation->aluOperation = GBA_JIT_ALU_MVN;
+                        operation->rn = -1;
+                        break;
+
+                    default:
+                        return false;
+                }
+
+                return true;
+            }
+
+        case 3: // Immediate offset
+            operation->kind = (opcode & (1 << 11)) ? GBA_JIT_KIND_LOAD : GBA_JIT_KIND_STORE;
+            operation->size = (opcode & (1 << 12)) ? 1 : 4;
+            operation->rd = opcode & 0x0007;
+            operation->rn = (opcode & 0x0038) >> 3;
+            operation->immediate = ((opcode & 0x07c0) >> 6) * operation->size;
+            return true;
+
+        case 4:
+            operation->kind = (opcode & (1 << 11)) ? GBA_JIT_KIND_LOAD : GBA_JIT_KIND_STORE;
+
+            if(opcode & (1 << 12)) { // SP-relative
+                operation->size = 4;
+                operation->rd = (opcode & 0x0700) >> 8;
+                operation->rn = 13;
+                operation->immediate = (opcode & 0x00ff) << 2;
+            } else { // Halfword immediate offset
+                operation->size = 2;
+                operation->rd = opcode & 0x0007;
+                operation->rn = (opcode & 0x0038) >> 3;
+                operation->immediate = (opcode & 0x07c0) >> 5;
+            }
+
+            return true;
+
+        case 5:
+            if(opcode & (1 << 12)) {
+                // PUSH and POP are left to the interpreter.
+                if((opcode & 0x0f00) != 0x0000) {
+                    return false;
+                }
+
+                operation->aluOperation = (opcode & (1 << 7)) ? GBA_JIT_ALU_SUB : GBA_JIT_ALU_ADD;
+                operation->rd = 13;
+                operation->rn = 13;
+                operation->immediate = (opcode & 0x007f) << 2;
+            } else {
+                operation->rd = (opcode & 0x0700) >> 8;
+
+                if(opcode & (1 << 11)) {
+                    operation->aluOperation = GBA_JIT_ALU_ADD;
+                    operation->rn = 13;
+                    operation->immediate = (opcode & 0x00ff) << 2;
+                } else {
+                    operation->aluOperation = GBA_JIT_ALU_MOV;
+                    operation->immediate = (gba_jit_getPc() & 0xfffffffc) + ((opcode & 0x00ff) << 2);
+                }
+            }
+
+            return true;
+
+        case 6:
+            // SWI and LDMIA/STMIA are left to the interpreter.
+            if(!(opcode & (1 << 12)) || (opcode & 0x0f00) == 0x0f00) {
+                return false;
+            }
+
+            operation->kind = GBA_JIT_KIND_BRANCH;
+            operation->condition = (opcode & 0x0f00) >> 8;
+            operation->immediate = (gba_jit_getPc() + ((int8_t)opcode << 1)) & 0xfffffffe;
+            return true;
+
+        case 7:
+            {
+                uint32_t offset = opcode & 0x07ff;
+
+                if(opcode & (1 << 10)) {
+                    offset |= 0xfffff800;
+                }
+
+                if((opcode & 0x1800) == 0x1000) { // BL, first half
+                    operation->aluOperation = GBA_JIT_ALU_MOV;
+                    operation->rd = 14;
+                    operation->immediate = gba_jit_getPc() + (offset << 12);
+                    return true;
+                } else if((opcode & 0x1800) == 0x0000) { // B
+                    operation->kind = GBA_JIT_KIND_BRANCH;
+                    operation->immediate = (gba_jit_getPc() + (offset << 1)) & 0xfffffffe;
+                    return true;
+                }
+
+                // The second half of BL jumps to an address held in LR,
+                // which is left to the interpreter.
+                return false;
+            }
+    }
+
+    return false;
+}
+
+// Translates one instruction. Returns true when the instruction always
+// leaves the block.
+static inline bool gba_jit_translate(uint32_t opcode) {
+    gba_jit_operation_t operation;
+    bool decoded;
+
+    if(gba_jit_thumb) {
+        decoded = gba_jit_decodeThumb(opcode, &operation);
+    } else {
+        decoded = gba_jit_decodeArm(opcode, &operation);
+    }
+
+    if(!decoded) {
+        gba_jit_emitFallback(opcode);
+        return false;
+    }
+
+    gba_jit_prepare(&operation);
+
+    uint8_t *skip = gba_jit_emitConditionCheck(operation.condition);
+
+    switch(operation.kind) {
+        case GBA_JIT_KIND_ALU:
+            gba_jit_emitAlu(&operation);
+            break;
+
+        case GBA_JIT_KIND_LOAD:
+            gba_jit_emitLoad(&operation);
+            break;
+
+        case GBA_JIT_KIND_STORE:
+            gba_jit_emitStore(&operation);
+            break;
+
+        case GBA_JIT_KIND_BRANCH:
+            gba_jit_emitBranch(&operation);
+            break;
+    }
+
+    if(skip) {
+        gba_jit_patch(skip, gba_jit_code);
+    }
+
+    gba_jit_pendingCycles += gba_jit_fetchCycles;
+
+    return operation.kind == GBA_JIT_KIND_BRANCH && operation.condition == GBA_JIT_CONDITION_AL;
+}
+
+// Loads the registers used by an instruction into host registers before its
+// condition is checked, so that the register cache is in the same state
+// whether the instruction is executed or skipped.
+static inline void gba_jit_prepare(const gba_jit_operation_t *operation) {
+    for(int i = 0; i < GBA_JIT_CACHED_REGISTER_COUNT; i++) {
+        gba_jit_cachedPinned[i] = false;
+    }
+
+    if(operation->kind == GBA_JIT_KIND_BRANCH) {
+        return;
+    }
+
+    if(operation->rn >= 0 && operation->rn != 15) {
+        gba_jit_allocateRegister(operation->rn, true);
+    }
+
+    if(operation->rm >= 0 && operation->rm != 15) {
+        gba_jit_allocateRegister(operation->rm, true);
+    }
+
+    bool conditional = operation->condition != GBA_JIT_CONDITION_AL;
+
+    switch(operation->kind) {
+        case GBA_JIT_KIND_ALU:
+            if(
+                operation->aluOperation != GBA_JIT_ALU_TST
+                && operation->aluOperation != GBA_JIT_ALU_TEQ
+                && operation->aluOperation != GBA_JIT_ALU_CMP
+                && operation->aluOperation != GBA_JIT_ALU_CMN
+            ) {
+                gba_jit_cachedDirty[gba_jit_allocateRegister(operation->rd, conditional)] = true;
+            }
+
+            break;
+
+        case GBA_JIT_KIND_LOAD:
+            gba_jit_cachedDirty[gba_jit_allocateRegister(operation->rd, conditional)] = true;
+            gba_jit_emitAddCycles(gba_jit_pendingCycles);
+            gba_jit_pendingCycles = 0;
+            break;
+
+        case GBA_JIT_KIND_STORE:
+            gba_jit_allocateRegister(operation->rd, true);
+            gba_jit_emitAddCycles(gba_jit_pendingCycles);
+            gba_jit_pendingCycles = 0;
+            break;
+
+        case GBA_JIT_KIND_BRANCH:
+            break;
+    }
+}
+
+// Emits a jump that is taken when the condition fails, and returns its
+// offset field so that it can be patched to skip the instruction.
+static inline uint8_t *gba_jit_emitConditionCheck(uint32_t condition) {
+    bool *flag;
+    bool expected = (condition & 1) == 0;
+
+    switch(condition) {
+        case 0x0: // EQ
+        case 0x1: // NE
+            flag = &gba_cpu_flagZ;
+            break;
+
+        case 0x2: // CS
+        case 0x3: // CC
+            flag = &gba_cpu_flagC;
+            break;
+
+        case 0x4: // MI
+        case 0x5: // PL
+            flag = &gba_cpu_flagN;
+            break;
+
+        case 0x6: // VS
+        case 0x7: // VC
+            flag = &gba_cpu_flagV;
+            break;
+
+        case GBA_JIT_CONDITION_AL:
+            return NULL;
+
+        default:
+            gba_jit_emitMovImm32(GBA_JIT_RDI, condition);
+            gba_jit_emitCall((uintptr_t)gba_cpu_jitCheckCondition);
+            gba_jit_emit8(0x84); gba_jit_emit8(0xc0); // test al, al
+            return gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_E);
+    }
+
+    gba_jit_emitMovPointer(GBA_JIT_RDX, (uintptr_t)flag);
+    gba_jit_emit8(0x80); gba_jit_emit8(0x3a); gba_jit_emit8(0x00); // cmp byte [rdx], 0
+
+    return gba_jit_emitJumpIf(expected ? GBA_JIT_HOSTCONDITION_E : GBA_JIT_HOSTCONDITION_NE);
+}
+
+static inline void gba_jit_emitAlu(const gba_jit_operation_t *operation) {
+    static const int shiftExtensions[4] = {4, 5, 7, 1};
+    gba_jit_hostRegister_t result = GBA_JIT_RAX;
+    bool logical;
+    bool add = false;
+    bool write = true;
+
+    // The second operand is computed in eax.
+    if(operation->rm < 0) {
+        gba_jit_emitMovImm32(GBA_JIT_RAX, operation->immediate);
+    } else {
+        gba_jit_emitReadGuest(GBA_JIT_RAX, operation->rm);
+
+        if(operation->shiftAmount) {
+            gba_jit_emitShiftImm(shiftExtensions[operation->shiftType], GBA_JIT_RAX, operation->shiftAmount);
+        }
+    }
+
+    switch(operation->aluOperation) {
+        case GBA_JIT_ALU_ADD:
+        case GBA_JIT_ALU_SUB:
+        case GBA_JIT_ALU_RSB:
+        case GBA_JIT_ALU_CMP:
+        case GBA_JIT_ALU_CMN:
+            logical = false;
+            break;
+
+        default:
+            logical = true;
+            break;
+    }
+
+    // The carry out of the shifter is only used by logical operations.
+    if(logical && operation->setFlags) {
+        switch(operation->shifterCarry) {
+            case GBA_JIT_CARRY_UNCHANGED: break;
+            case GBA_JIT_CARRY_CLEAR: gba_jit_emitStoreFlag(&gba_cpu_flagC, false); break;
+            case GBA_JIT_CARRY_SET: gba_jit_emitStoreFlag(&gba_cpu_flagC, true); break;
+            case GBA_JIT_CARRY_SHIFTER: gba_jit_emitSetFlag(&gba_cpu_flagC, GBA_JIT_HOSTCONDITION_B); break;
+        }
+    }
+
+    switch(operation->aluOperation) {
+        case GBA_JIT_ALU_TST:
+            write = false;
+            // fall through
+
+        case GBA_JIT_ALU_AND:
+            gba_jit_emitAluGuest(0x21, 4, GBA_JIT_RAX, operation->rn);
+            break;
+
+        case GBA_JIT_ALU_TEQ:
+            write = false;
+            // fall through
+
+        case GBA_JIT_ALU_EOR:
+            gba_jit_emitAluGuest(0x31, 6, GBA_JIT_RAX, operation->rn);
+            break;
+
+        case GBA_JIT_ALU_ORR:
+            gba_jit_emitAluGuest(0x09, 1, GBA_JIT_RAX, operation->rn);
+            break;
+
+        case GBA_JIT_ALU_BIC:
+            gba_jit_emitNot(GBA_JIT_RAX);
+            gba_jit_emitAluGuest(0x21, 4, GBA_JIT_RAX, operation->rn);
+            break;
+
+        case GBA_JIT_ALU_MVN:
+            gba_jit_emitNot(GBA_JIT_RAX);
+            break;
+
+        case GBA_JIT_ALU_MOV:
+            break;
+
+        case GBA_JIT_ALU_CMN:
+            write = false;
+            // fall through
+
+        case GBA_JIT_ALU_ADD:
+            add = true;
+            gba_jit_emitAluGuest(0x01, 0, GBA_JIT_RAX, operation->rn);
+            break;
+
+        case GBA_JIT_ALU_CMP:
+            write = false;
+            // fall through
+
+        case GBA_JIT_ALU_SUB:
+            gba_jit_emitReadGuest(GBA_JIT_RCX, operation->rn);
+            gba_jit_emitRegReg(0x29, GBA_JIT_RCX, GBA_JIT_RAX);
+            result = GBA_JIT_RCX;
+            break;
+
+        case GBA_JIT_ALU_RSB:
+            gba_jit_emitAluGuest(0x29, 5, GBA_JIT_RAX, operation->rn);
+            break;
+
+        default:
+            break;
+    }
+
+    if(operation->setFlags) {
+        if(logical) {
+            gba_jit_emitRegReg(0x85, result, result); // test
+        }
+
+        gba_jit_emitSetFlag(&gba_cpu_flagN, GBA_JIT_HOSTCONDITION_S);
+        gba_jit_emitSetFlag(&gba_cpu_flagZ, GBA_JIT_HOSTCONDITION_E);
+
+        if(!logical) {
+            // The ARM carry flag is set when a subtraction does not borrow.
+            gba_jit_emitSetFlag(&gba_cpu_flagC, add ? GBA_JIT_HOSTCONDITION_B : GBA_JIT_HOSTCONDITION_AE);
+            gba_jit_emitSetFlag(&gba_cpu_flagV, GBA_JIT_HOSTCONDITION_O);
+        }
+    }
+
+    if(write) {
+        gba_jit_emitRegReg(0x89, gba_jit_getRegister(operation->rd), result);
+    }
+}
+
+// Computes the address of a memory access in edi.
+static inline void gba_jit_emitAddress(const gba_jit_operation_t *operation) {
+    if(operation->rn < 0) {
+        gba_jit_emitMovImm32(GBA_JIT_RDI, operation->immediate);
+    } else {
+        gba_jit_emitReadGuest(GBA_JIT_RDI, operation->rn);
+
+        if(operation->rm >= 0) {
+            gba_jit_emitAluGuest(0x01, 0, GBA_JIT_RDI, operation->rm);
+        } else if(operation->immediate) {
+            gba_jit_emitRegImm(0, GBA_JIT_RDI, operation->immediate);
+        }
+    }
+}
+
+static inline void gba_jit_emitLoad(const gba_jit_operation_t *operation) {
+    gba_jit_hostRegister_t rd = gba_jit_getRegister(operation->rd);
+    bool literal = false;
+
+    // Literal pools in memory that cannot be written are read once, when
+    // the block is translated.
+    if(operation->rn < 0 && operation->size == 4) {
+        switch((operation->immediate & 0x0f000000) >> 24) {
+            case 0x00:
+            case 0x08:
+            case 0x09:
+            case 0x0a:
+            case 0x0b:
+            case 0x0c:
+            case 0x0d:
+                literal = true;
+                break;
+        }
+    }
+
+    if(literal) {
+        gba_jit_emitMovImm32(rd, gba_bus_peek32(operation->immediate));
+        gba_jit_emitAddCycles(gba_bus_cycles[GBA_BUS_ACCESS_N32][(operation->immediate >> 24) & 0x0f]);
+    } else {
+        gba_jit_emitAddress(operation);
+
+        switch(operation->size) {
+            case 1: gba_jit_emitCall((uintptr_t)gba_jit_read8); break;
+            case 2: gba_jit_emitCall((uintptr_t)gba_jit_read16); break;
+            case 4: gba_jit_emitCall((uintptr_t)gba_jit_read32); break;
+        }
+
+        gba_jit_emitRegReg(0x89, rd, GBA_JIT_RAX);
+    }
+
+    gba_jit_emitEventCheck(false);
+}
+
+static inline void gba_jit_emitStore(const gba_jit_operation_t *operation) {
+    gba_jit_emitAddress(operation);
+    gba_jit_emitReadGuest(GBA_JIT_RSI, operation->rd);
+
+    // Writes to the IO registers may raise an interrupt, so the next block
+    // must go through the dispatcher.
+    gba_jit_emitRegReg(0x89, GBA_JIT_RAX, GBA_JIT_RDI);
+    gba_jit_emitRegImm(4, GBA_JIT_RAX, 0x0f000000);
+    gba_jit_emitRegImm(7, GBA_JIT_RAX, 0x04000000);
+    uint8_t *notIo = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_NE);
+    gba_jit_emitStoreFlag(&gba_jit_linkBlocked, true);
+    gba_jit_patch(notIo, gba_jit_code);
+
+    switch(operation->size) {
+        case 1: gba_jit_emitCall((uintptr_t)gba_bus_write8); break;
+        case 2: gba_jit_emitCall((uintptr_t)gba_bus_write16); break;
+        case 4: gba_jit_emitCall((uintptr_t)gba_bus_write32); break;
+    }
+
+    // Leave the block after this instruction if the store scheduled an
+    // event or overwrote cached code.
+    gba_jit_emitEventCheck(true);
+}
+
+// Taken branches refill the pipeline right away, which costs the same two
+// fetches from the target as in the other backends, unless an event is due
+// before that.
+static inline void gba_jit_emitBranch(const gba_jit_operation_t *operation) {
+    gba_jit_flushRegisters(false);
+
+    if(operation->link) {
+        gba_jit_emitStoreGuestImm(14, operation->linkValue);
+    }
+
+    int refillCycles = gba_bus_cycles[gba_jit_thumb ? GBA_BUS_ACCESS_S16 : GBA_BUS_ACCESS_S32][(operation->immediate >> 24) & 0x0f];
+
+    gba_jit_emitAddCycles(gba_jit_pendingCycles + gba_jit_fetchCycles);
+    gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_cycleCounter);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x8b); gba_jit_emit8(0x08); // mov rcx, [rax]
+    gba_jit_emit8(0x48); gba_jit_emit8(0x81); gba_jit_emit8(0xc1); gba_jit_emit32(refillCycles + 1); // add rcx, refillCycles + 1
+    gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_nextEventTimestamp);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x3b); gba_jit_emit8(0x08); // cmp rcx, [rax]
+    uint8_t *refill = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_BE);
+    gba_jit_emitMovImm32(GBA_JIT_RDI, operation->immediate);
+    gba_jit_emitCall((uintptr_t)gba_cpu_jitJump);
+    gba_jit_emitReturn(false);
+    gba_jit_patch(refill, gba_jit_code);
+    gba_jit_emitAddCycles(refillCycles * 2);
+    gba_jit_emitStoreGuestImm(15, operation->immediate + (gba_jit_thumb ? 4 : 8));
+    gba_jit_emitReturn(true);
+}
+
+static inline void gba_jit_emitFallback(uint32_t opcode) {
+    gba_jit_flushRegisters(true);
+    gba_jit_emitAddCycles(gba_jit_pendingCycles);
+    gba_jit_pendingCycles = 0;
+    gba_jit_emitStoreGuestImm(15, gba_jit_getPc());
+    gba_jit_emitMovImm32(GBA_JIT_RDI, opcode);
+
+    if(gba_jit_thumb) {
+        gba_jit_emitCall((uintptr_t)gba_cpu_jitInterpretThumb);
+    } else {
+        gba_jit_emitCall((uintptr_t)gba_cpu_jitInterpretArm);
+    }
+
+    gba_jit_emit8(0x84); gba_jit_emit8(0xc0); // test al, al
+    uint8_t *continueBlock = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_NE);
+    gba_jit_emitReturn(false);
+    gba_jit_patch(continueBlock, gba_jit_code);
+
+    // The memory accesses of the instruction may have used up the cycles
+    // that the rest of the block was relying on.
+    if(gba_jit_remainingInstructions > 1) {
+        gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_cycleCounter);
+        gba_jit_emit8(0x48); gba_jit_emit8(0x8b); gba_jit_emit8(0x08); // mov rcx, [rax]
+        gba_jit_emit8(0x48); gba_jit_emit8(0x81); gba_jit_emit8(0xc1); gba_jit_emit32(gba_jit_fetchCycles * (gba_jit_remainingInstructions - 1)); // add rcx, cycles
+        gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_nextEventTimestamp);
+        gba_jit_emit8(0x48); gba_jit_emit8(0x3b); gba_jit_emit8(0x08); // cmp rcx, [rax]
+        uint8_t *enoughCycles = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_B);
+        gba_jit_emitReturn(false);
+        gba_jit_patch(enoughCycles, gba_jit_code);
+    }
+}
+
+// Blocks only run when the next event is not due before their last
+// instruction, which is checked again here for blocks entered through a
+// link.
+static inline void gba_jit_emitBudgetCheck(int cycles) {
+    gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_cycleCounter);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x8b); gba_jit_emit8(0x08); // mov rcx, [rax]
+    gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_nextEventTimestamp);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x8b); gba_jit_emit8(0x10); // mov rdx, [rax]
+    gba_jit_emit8(0x48); gba_jit_emit8(0x39); gba_jit_emit8(0xd1); // cmp rcx, rdx
+    uint8_t *eventDue = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_AE);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x29); gba_jit_emit8(0xca); // sub rdx, rcx
+    gba_jit_emit8(0x48); gba_jit_emit8(0x81); gba_jit_emit8(0xfa); gba_jit_emit32(cycles); // cmp rdx, cycles
+    uint8_t *enoughCycles = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_AE);
+    gba_jit_patch(eventDue, gba_jit_code);
+    gba_jit_emitReturn(false);
+    gba_jit_patch(enoughCycles, gba_jit_code);
+}
+
+// Memory accesses take a variable number of cycles, so the block is left
+// after one of them when the next event is due before the end of the block.
+// The instructions left are then run by the dispatcher, which stops at the
+// event like the interpreter does.
+static inline void gba_jit_emitEventCheck(bool invalidation) {
+    int remaining = gba_jit_remainingInstructions > 1 ? gba_jit_remainingInstructions : 1;
+
+    gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_cycleCounter);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x8b); gba_jit_emit8(0x08); // mov rcx, [rax]
+    gba_jit_emit8(0x48); gba_jit_emit8(0x81); gba_jit_emit8(0xc1); gba_jit_emit32(gba_jit_fetchCycles * remaining); // add rcx, cycles
+    gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_nextEventTimestamp);
+    gba_jit_emit8(0x48); gba_jit_emit8(0x3b); gba_jit_emit8(0x08); // cmp rcx, [rax]
+    uint8_t *eventDue = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_AE);
+    uint8_t *continueBlock;
+
+    if(invalidation) {
+        gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_cpu_blockInvalidated);
+        gba_jit_emit8(0x80); gba_jit_emit8(0x38); gba_jit_emit8(0x00); // cmp byte [rax], 0
+        continueBlock = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_E);
+    } else {
+        continueBlock = gba_jit_emitJump();
+    }
+
+    gba_jit_patch(eventDue, gba_jit_code);
+    gba_jit_emitExit(gba_jit_address + (gba_jit_thumb ? 2 : 4), gba_jit_fetchCycles, false);
+    gba_jit_patch(continueBlock, gba_jit_code);
+}
+
+// Emits a side exit to the given guest address. The register cache is left
+// untouched, as the code following the exit still relies on it.
+static inline void gba_jit_emitExit(uint32_t address, int cycles, bool link) {
+    gba_jit_flushRegisters(false);
+    gba_jit_emitStoreGuestImm(15, address + (gba_jit_thumb ? 4 : 8));
+    gba_jit_emitAddCycles(gba_jit_pendingCycles + cycles);
+    gba_jit_emitReturn(link);
+}
+
+// Returns to the dispatcher. Exits that can be linked start with a jump to
+// the return path that the dispatcher can later point to the next block.
+static inline void gba_jit_emitReturn(bool link) {
+    if(link) {
+        gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_jit_linkBlocked);
+        gba_jit_emit8(0x80); gba_jit_emit8(0x38); gba_jit_emit8(0x00); // cmp byte [rax], 0
+        uint8_t *blocked = gba_jit_emitJumpIf(GBA_JIT_HOSTCONDITION_NE);
+        uint8_t *patchSite = gba_jit_emitJump();
+        gba_jit_patch(patchSite, gba_jit_code);
+        gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)patchSite);
+        gba_jit_patch(gba_jit_emitJump(), gba_jit_epilogue);
+        gba_jit_patch(blocked, gba_jit_code);
+    }
+
+    gba_jit_emit8(0x31); gba_jit_emit8(0xc0); // xor eax, eax
+    gba_jit_patch(gba_jit_emitJump(), gba_jit_epilogue);
+}
+
+static inline void gba_jit_resetRegisters() {
+    for(int i = 0; i < GBA_JIT_CACHED_REGISTER_COUNT; i++) {
+        gba_jit_cachedGuest[i] = -1;
+        gba_jit_cachedDirty[i] = false;
+        gba_jit_cachedPinned[i] = false;
+        gba_jit_cachedLastUse[i] = 0;
+    }
+
+    gba_jit_useCounter = 0;
+}
+
+// Returns the cache slot holding a guest register, evicting the least
+// recently used register that the current instruction does not need.
+static inline int gba_jit_allocateRegister(int guest, bool load) {
+    int slot = -1;
+
+    for(int i = 0; i < GBA_JIT_CACHED_REGISTER_COUNT; i++) {
+        if(gba_jit_cachedGuest[i] == guest) {
+            slot = i;
+        }
+    }
+
+    if(slot < 0) {
+        for(int i = 0; i < GBA_JIT_CACHED_REGISTER_COUNT; i++) {
+            if(!gba_jit_cachedPinned[i] && (slot < 0 || gba_jit_cachedLastUse[i] < gba_jit_cachedLastUse[slot])) {
+                slot = i;
+            }
+        }
+
+        if(gba_jit_cachedGuest[slot] >= 0 && gba_jit_cachedDirty[slot]) {
+            gba_jit_emitStoreGuest(gba_jit_cachedGuest[slot], gba_jit_cachedRegisters[slot]);
+        }
+
+        gba_jit_cachedGuest[slot] = guest;
+        gba_jit_cachedDirty[slot] = false;
+
+        if(load) {
+            gba_jit_emitLoadGuest(gba_jit_cachedRegisters[slot], guest);
+        }
+    }
+
+    gba_jit_cachedPinned[slot] = true;
+    gba_jit_cachedLastUse[slot] = ++gba_jit_useCounter;
+
+    return slot;
+}
+
+static inline gba_jit_hostRegister_t gba_jit_getRegister(int guest) {
+    for(int i = 0; i < GBA_JIT_CACHED_REGISTER_COUNT; i++) {
+        if(gba_jit_cachedGuest[i] == guest) {
+            return gba_jit_cachedRegisters[i];
+        }
+    }
+
+    return GBA_JIT_RAX;
+}
+
+// Writes the modified guest registers back. When they are not released,
+// the cache keeps considering them as modified, because the write-back only
+// happens on a side exit.
+static inline void gba_jit_flushRegisters(bool release) {
+    for(int i = 0; i < GBA_JIT_CACHED_REGISTER_COUNT; i++) {
+        if(gba_jit_cachedGuest[i] >= 0 && gba_jit_cachedDirty[i]) {
+            gba_jit_emitStoreGuest(gba_jit_cachedGuest[i], gba_jit_cachedRegisters[i]);
+        }
+
+        if(release) {
+            gba_jit_cachedGuest[i] = -1;
+            gba_jit_cachedDirty[i] = false;
+        }
+    }
+}
+
+static inline uint32_t gba_jit_getPc() {
+    return gba_jit_address + (gba_jit_thumb ? 4 : 8);
+}
+
+static inline void gba_jit_emitReadGuest(gba_jit_hostRegister_t reg, int guest) {
+    if(guest == 15) {
+        gba_jit_emitMovImm32(reg, gba_jit_getPc());
+    } else {
+        gba_jit_emitRegReg(0x89, reg, gba_jit_getRegister(guest));
+    }
+}
+
+static inline void gba_jit_emitAluGuest(uint8_t opcode, int extension, gba_jit_hostRegister_t reg, int guest) {
+    if(guest == 15) {
+        gba_jit_emitRegImm(extension, reg, gba_jit_getPc());
+    } else {
+        gba_jit_emitRegReg(opcode, reg, gba_jit_getRegister(guest));
+    }
+}
+
+static inline void gba_jit_emit8(uint8_t value) {
+    *gba_jit_code++ = value;
+}
+
+static inline void gba_jit_emit32(uint32_t value) {
+    memcpy(gba_jit_code, &value, sizeof(value));
+    gba_jit_code += sizeof(value);
+}
+
+static inline void gba_jit_emit64(uint64_t value) {
+    memcpy(gba_jit_code, &value, sizeof(value));
+    gba_jit_code += sizeof(value);
+}
+
+static inline void gba_jit_emitRex(bool w, int reg, int rm) {
+    uint8_t rex = 0x40 | (w ? 0x08 : 0x00) | ((reg & 8) ? 0x04 : 0x00) | ((rm & 8) ? 0x01 : 0x00);
+
+    if(rex != 0x40) {
+        gba_jit_emit8(rex);
+    }
+}
+
+static inline void gba_jit_emitModRm(int mod, int reg, int rm) {
+    gba_jit_emit8((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+// <opcode> r/m32, r32
+static inline void gba_jit_emitRegReg(uint8_t opcode, gba_jit_hostRegister_t rm, gba_jit_hostRegister_t reg) {
+    gba_jit_emitRex(false, reg, rm);
+    gba_jit_emit8(opcode);
+    gba_jit_emitModRm(3, reg, rm);
+}
+
+// <extension> r/m32, imm32, from the group 1 instructions
+static inline void gba_jit_emitRegImm(int extension, gba_jit_hostRegister_t rm, uint32_t immediate) {
+    gba_jit_emitRex(false, 0, rm);
+    gba_jit_emit8(0x81);
+    gba_jit_emitModRm(3, extension, rm);
+    gba_jit_emit32(immediate);
+}
+
+static inline void gba_jit_emitShiftImm(int extension, gba_jit_hostRegister_t rm, int amount) {
+    gba_jit_emitRex(false, 0, rm);
+    gba_jit_emit8(0xc1);
+    gba_jit_emitModRm(3, extension, rm);
+    gba_jit_emit8(amount);
+}
+
+static inline void gba_jit_emitNot(gba_jit_hostRegister_t rm) {
+    gba_jit_emitRex(false, 0, rm);
+    gba_jit_emit8(0xf7);
+    gba_jit_emitModRm(3, 2, rm);
+}
+
+static inline void gba_jit_emitMovImm32(gba_jit_hostRegister_t reg, uint32_t immediate) {
+    gba_jit_emitRex(false, 0, reg);
+    gba_jit_emit8(0xb8 | (reg & 7));
+    gba_jit_emit32(immediate);
+}
+
+static inline void gba_jit_emitMovImm64(gba_jit_hostRegister_t reg, uint64_t immediate) {
+    gba_jit_emitRex(true, 0, reg);
+    gba_jit_emit8(0xb8 | (reg & 7));
+    gba_jit_emit64(immediate);
+}
+
+// Host addresses are recorded when the block is to be saved in the
+// persistent cache, which stores the index of the symbol instead.
+static inline void gba_jit_emitMovPointer(gba_jit_hostRegister_t reg, uintptr_t pointer) {
+    gba_jit_emitRex(true, 0, reg);
+    gba_jit_emit8(0xb8 | (reg & 7));
+
+    if(gba_jit_recording) {
+        gba_jit_addRelocation(gba_jit_code - gba_jit_bufferStart, gba_jit_getSymbol(pointer));
+    }
+
+    gba_jit_emit64(pointer);
+}
+
+// mov reg, [rbx + guest * 4]
+static inline void gba_jit_emitLoadGuest(gba_jit_hostRegister_t reg, int guest) {
+    gba_jit_emitRex(false, reg, GBA_JIT_RBX);
+    gba_jit_emit8(0x8b);
+    gba_jit_emitModRm(1, reg, GBA_JIT_RBX);
+    gba_jit_emit8(guest * 4);
+}
+
+// mov [rbx + guest * 4], reg
+static inline void gba_jit_emitStoreGuest(int guest, gba_jit_hostRegister_t reg) {
+    gba_jit_emitRex(false, reg, GBA_JIT_RBX);
+    gba_jit_emit8(0x89);
+    gba_jit_emitModRm(1, reg, GBA_JIT_RBX);
+    gba_jit_emit8(guest * 4);
+}
+
+// mov dword [rbx + guest * 4], immediate
+static inline void gba_jit_emitStoreGuestImm(int guest, uint32_t immediate) {
+    gba_jit_emit8(0xc7);
+    gba_jit_emitModRm(1, 0, GBA_JIT_RBX);
+    gba_jit_emit8(guest * 4);
+    gba_jit_emit32(immediate);
+}
+
+// set<condition> byte [flag], which leaves the host flags untouched
+static inline void gba_jit_emitSetFlag(bool *flag, gba_jit_hostCondition_t condition) {
+    gba_jit_emitMovPointer(GBA_JIT_RDX, (uintptr_t)flag);
+    gba_jit_emit8(0x0f);
+    gba_jit_emit8(0x90 | condition);
+    gba_jit_emitModRm(0, 0, GBA_JIT_RDX);
+}
+
+static inline void gba_jit_emitStoreFlag(bool *flag, bool value) {
+    gba_jit_emitMovPointer(GBA_JIT_RDX, (uintptr_t)flag);
+    gba_jit_emit8(0xc6);
+    gba_jit_emitModRm(0, 0, GBA_JIT_RDX);
+    gba_jit_emit8(value);
+}
+
+static inline void gba_jit_emitAddCycles(int cycles) {
+    if(cycles) {
+        gba_jit_emitMovPointer(GBA_JIT_RAX, (uintptr_t)&gba_scheduler_cycleCounter);
+        gba_jit_emit8(0x48); gba_jit_emit8(0x81); gba_jit_emit8(0x00); gba_jit_emit32(cycles); // add qword [rax], cycles
+    }
+}
+
+static inline void gba_jit_emitCall(uintptr_t function) {
+    gba_jit_emitMovPointer(GBA_JIT_RAX, function);
+    gba_jit_emit8(0xff);
+    gba_jit_emitModRm(3, 2, GBA_JIT_RAX);
+}
+
+static inline uint8_t *gba_jit_emitJump() {
+    gba_jit_emit8(0xe9);
+
+    uint8_t *field = gba_jit_code;
+
+    gba_jit_emit32(0);
+
+    return field;
+}
+
+static inline uint8_t *gba_jit_emitJumpIf(gba_jit_hostCondition_t condition) {
+    gba_jit_emit8(0x0f);
+    gba_jit_emit8(0x80 | condition);
+
+    uint8_t *field = gba_jit_code;
+
+    gba_jit_emit32(0);
+
+    return field;
+}
+
+static inline void gba_jit_patch(uint8_t *field, const uint8_t *target) {
+    int32_t offset = target - (field + 4);
+
+    memcpy(field, &offset, sizeof(offset));
+}
+
+#else
+
+// The JIT only targets x86-64 Unix hosts. Elsewhere it reports that it is
+// unavailable and the CPU keeps using the cached interpreter.
+
+bool gba_jit_init() {
+    return false;
+}
+
+void gba_jit_flush() {
+    gba_jit_epoch++;
+}
+
+void *gba_jit_compile(uint32_t address, bool thumb, const uint32_t *opcodes, int length) {
+    UNUSED(address);
+    UNUSED(thumb);
+    UNUSED(opcodes);
+    UNUSED(length);
+
+    return NULL;
+}
+
+void *gba_jit_run(void *code) {
+    UNUSED(code);
+
+    return NULL;
+}
+
+void gba_jit_link(void *patchSite, void *code) {
+    UNUSED(patchSite);
+    UNUSED(code);
+}
+
+bool gba_jit_openCache(const char *fileName, uint64_t romHash) {
+    UNUSED(fileName);
+    UNUSED(romHash);
+
+    return false;
+}
+
+bool gba_jit_closeCache() {
+    return false;
+}
+
+uint32_t gba_jit_getBuildId() {
+    return 0;
+}
+
+#endif
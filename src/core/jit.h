@@ -0,0 +1,28 @@
+#ifndef __CORE_JIT_H__
+#define __CORE_JIT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Incremented every time the translated code is discarded, so that callers
+// holding pointers to it know that they must translate their blocks again.
+extern uint32_t gba_jit_epoch;
+
+// Set by the translated code when the block that just ran may have changed
+// the interrupt state, in which case it cannot jump directly to the next
+// block.
+extern bool gba_jit_linkBlocked;
+
+// Blocks found in the persistent cache instead of being translated.
+extern uint64_t gba_jit_cacheHits;
+
+extern bool gba_jit_init();
+extern void gba_jit_flush();
+extern void *gba_jit_compile(uint32_t address, bool thumb, const uint32_t *opcodes, int length);
+extern void *gba_jit_run(void *code);
+extern void gba_jit_link(void *patchSite, void *code);
+extern bool gba_jit_openCache(const char *fileName, uint64_t romHash);
+extern bool gba_jit_closeCache();
+extern uint32_t gba_jit_getBuildId();
+
+#endif
@@ -1,11 +1,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "platform.h"
 #include "core/gba.h"
 #include "core/io.h"
+#include "core/keypad.h"
 
 void gba_keypad_update(bool *pressedKeys);
-void gba_keypad_cycle();
+void gba_keypad_writeCallback_keycnt(uint32_t address, uint16_t value);
+static inline void gba_keypad_checkInterrupt();
 
 void gba_keypad_update(bool *pressedKeys) {
     uint16_t value = 0xffff;
@@ -18,9 +21,21 @@ void gba_keypad_update(bool *pressedKeys) {
 
     gba_io_register_t *keyinput = gba_io_getRegister(0x04000130);
     keyinput->value = value;
+
+    gba_keypad_checkInterrupt();
+}
+
+void gba_keypad_writeCallback_keycnt(uint32_t address, uint16_t value) {
+    UNUSED(address);
+    UNUSED(value);
+
+    gba_keypad_checkInterrupt();
 }
 
-void gba_keypad_cycle() {
+// The interrupt is requested when any of the selected keys is pressed, or
+// all of them in AND mode. As the condition only changes with KEYINPUT or
+// KEYCNT, it is evaluated when either is written.
+static inline void gba_keypad_checkInterrupt() {
     gba_io_register_t *keyinput = gba_io_getRegister(0x04000130);
     gba_io_register_t *keycnt = gba_io_getRegister(0x04000132);
 
@@ -2,8 +2,9 @@
 #define __CORE_KEYPAD_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 extern void gba_keypad_update(bool *pressedKeys);
-extern void gba_keypad_cycle();
+extern void gba_keypad_writeCallback_keycnt(uint32_t address, uint16_t value);
 
 #endif
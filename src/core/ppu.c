@@ -6,6 +6,7 @@
 #include "core/dma.h"
 #include "core/gba.h"
 #include "core/io.h"
+#include "core/scheduler.h"
 #include "frontend/frontend.h"
 
 uint8_t gba_ppu_palette[GBA_PALETTE_SIZE];
@@ -14,11 +15,11 @@ uint8_t gba_ppu_oam[GBA_OAM_SIZE];
 
 uint32_t gba_ppu_frameBuffer[GBA_SCREEN_WIDTH * GBA_SCREEN_HEIGHT];
 uint_least32_t gba_ppu_currentRow;
-uint_least32_t gba_ppu_currentColumn;
-uint_least32_t gba_ppu_currentCycle;
 unsigned int gba_ppu_layers[4];
 
 void gba_ppu_reset();
+void gba_ppu_onHblankEvent(uint64_t timestamp);
+void gba_ppu_onHdrawEvent(uint64_t timestamp);
 uint8_t gba_ppu_palette_read8(uint32_t address);
 uint16_t gba_ppu_palette_read16(uint32_t address);
 uint32_t gba_ppu_palette_read32(uint32_t address);
@@ -55,60 +56,64 @@ void gba_ppu_reset() {
     memset(gba_ppu_palette, 0, GBA_PALETTE_SIZE);
     memset(gba_ppu_vram, 0, GBA_VRAM_SIZE);
     memset(gba_ppu_oam, 0, GBA_OAM_SIZE);
+
+    gba_ppu_currentRow = 0;
+
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_PPU_HBLANK, gba_ppu_onHblankEvent);
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_PPU_HDRAW, gba_ppu_onHdrawEvent);
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_PPU_HBLANK, gba_scheduler_cycleCounter + GBA_PPU_HDRAW_CYCLES);
 }
 
-void gba_ppu_cycle() {
-    if((gba_ppu_currentCycle & 0x03) == 0x03) {
-        gba_io_register_t *dispstat = gba_io_getRegister(0x04000004);
+void gba_ppu_onHblankEvent(uint64_t timestamp) {
+    gba_io_register_t *dispstat = gba_io_getRegister(0x04000004);
 
-        if(gba_ppu_currentColumn == 308) {
-            gba_ppu_currentColumn = 0;
-            gba_ppu_currentRow++;
+    dispstat->value |= (1 << 1);
 
-            dispstat->value &= ~(1 << 1);
+    if(dispstat->value & (1 << 4)) {
+        gba_setInterruptFlag(1 << 1);
+    }
 
-            if((dispstat->value >> 8) == gba_ppu_currentRow) {
-                dispstat->value |= (1 << 2);
+    if(gba_ppu_currentRow < GBA_SCREEN_HEIGHT) {
+        gba_ppu_drawLine();
+        gba_ppu_onHblank();
+    }
 
-                if(dispstat->value & (1 << 5)) {
-                    gba_setInterruptFlag(1 << 2);
-                }
-            } else {
-                dispstat->value &= ~(1 << 2);
-            }
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_PPU_HDRAW, timestamp + GBA_PPU_HBLANK_CYCLES);
+}
 
-            if(gba_ppu_currentRow == 228) {
-                gba_ppu_currentRow = 0;
-                gba_ppu_currentCycle = 0;
-                dispstat->value &= ~(1 << 0);
-            } else if(gba_ppu_currentRow == GBA_SCREEN_HEIGHT) {
-                dispstat->value |= (1 << 0);
-
-                if(dispstat->value & (1 << 3)) {
-                    gba_setInterruptFlag(1 << 0);
-                }
-                
-                gba_ppu_onVblank();
-            }
+void gba_ppu_onHdrawEvent(uint64_t timestamp) {
+    gba_io_register_t *dispstat = gba_io_getRegister(0x04000004);
 
-            gba_io_getRegister(0x04000006)->value = gba_ppu_currentRow;
-        } else if(gba_ppu_currentColumn == GBA_SCREEN_WIDTH) {
-            dispstat->value |= (1 << 1);
+    gba_ppu_currentRow++;
 
-            if(dispstat->value & (1 << 4)) {
-                gba_setInterruptFlag(1 << 1);
-                gba_dma_onHblank();
-            }
+    dispstat->value &= ~(1 << 1);
 
-            if(gba_ppu_currentRow < GBA_SCREEN_HEIGHT) {
-                gba_ppu_drawLine();
-            }
+    if(gba_ppu_currentRow == GBA_PPU_LINE_COUNT) {
+        gba_ppu_currentRow = 0;
+        dispstat->value &= ~(1 << 0);
+    } else if(gba_ppu_currentRow == GBA_SCREEN_HEIGHT) {
+        dispstat->value |= (1 << 0);
+
+        if(dispstat->value & (1 << 3)) {
+            gba_setInterruptFlag(1 << 0);
         }
 
-        gba_ppu_currentColumn++;
+        gba_ppu_onVblank();
+    }
+
+    if((dispstat->value >> 8) == gba_ppu_currentRow) {
+        dispstat->value |= (1 << 2);
+
+        if(dispstat->value & (1 << 5)) {
+            gba_setInterruptFlag(1 << 2);
+        }
+    } else {
+        dispstat->value &= ~(1 << 2);
     }
 
-    gba_ppu_currentCycle++;
+    gba_io_getRegister(0x04000006)->value = gba_ppu_currentRow;
+
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_PPU_HBLANK, timestamp + GBA_PPU_HDRAW_CYCLES);
 }
 
 uint8_t gba_ppu_palette_read8(uint32_t address) {
@@ -0,0 +1,116 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/scheduler.h"
+
+struct gba_scheduler_node_s;
+
+typedef struct gba_scheduler_node_s {
+    struct gba_scheduler_node_s *next;
+    uint64_t timestamp;
+    gba_scheduler_callback_t *callback;
+    bool scheduled;
+} gba_scheduler_node_t;
+
+uint64_t gba_scheduler_cycleCounter;
+uint64_t gba_scheduler_nextEventTimestamp;
+gba_scheduler_node_t gba_scheduler_nodes[GBA_SCHEDULER_EVENT_COUNT];
+gba_scheduler_node_t *gba_scheduler_queue;
+
+void gba_scheduler_reset();
+void gba_scheduler_setCallback(gba_scheduler_event_t event, gba_scheduler_callback_t *callback);
+void gba_scheduler_schedule(gba_scheduler_event_t event, uint64_t timestamp);
+void gba_scheduler_cancel(gba_scheduler_event_t event);
+bool gba_scheduler_isScheduled(gba_scheduler_event_t event);
+void gba_scheduler_processEvents();
+static inline void gba_scheduler_unlink(gba_scheduler_node_t *node);
+static inline void gba_scheduler_updateNextEventTimestamp();
+
+void gba_scheduler_reset() {
+    for(int i = 0; i < GBA_SCHEDULER_EVENT_COUNT; i++) {
+        gba_scheduler_nodes[i].next = NULL;
+        gba_scheduler_nodes[i].timestamp = 0;
+        gba_scheduler_nodes[i].scheduled = false;
+    }
+
+    gba_scheduler_queue = NULL;
+    gba_scheduler_cycleCounter = 0;
+    gba_scheduler_updateNextEventTimestamp();
+}
+
+void gba_scheduler_setCallback(gba_scheduler_event_t event, gba_scheduler_callback_t *callback) {
+    gba_scheduler_nodes[event].callback = callback;
+}
+
+void gba_scheduler_schedule(gba_scheduler_event_t event, uint64_t timestamp) {
+    gba_scheduler_node_t *node = &gba_scheduler_nodes[event];
+
+    if(node->scheduled) {
+        gba_scheduler_unlink(node);
+    }
+
+    node->timestamp = timestamp;
+    node->scheduled = true;
+
+    // Events sharing a timestamp are kept in the order they were scheduled
+    gba_scheduler_node_t **link = &gba_scheduler_queue;
+
+    while(*link && (*link)->timestamp <= timestamp) {
+        link = &(*link)->next;
+    }
+
+    node->next = *link;
+    *link = node;
+
+    gba_scheduler_updateNextEventTimestamp();
+}
+
+void gba_scheduler_cancel(gba_scheduler_event_t event) {
+    gba_scheduler_node_t *node = &gba_scheduler_nodes[event];
+
+    if(node->scheduled) {
+        gba_scheduler_unlink(node);
+        node->scheduled = false;
+        gba_scheduler_updateNextEventTimestamp();
+    }
+}
+
+bool gba_scheduler_isScheduled(gba_scheduler_event_t event) {
+    return gba_scheduler_nodes[event].scheduled;
+}
+
+void gba_scheduler_processEvents() {
+    while(gba_scheduler_queue && gba_scheduler_queue->timestamp <= gba_scheduler_cycleCounter) {
+        gba_scheduler_node_t *node = gba_scheduler_queue;
+
+        gba_scheduler_queue = node->next;
+        node->next = NULL;
+        node->scheduled = false;
+        gba_scheduler_updateNextEventTimestamp();
+
+        // The callback receives the timestamp the event was due at, so that
+        // periodic events can be rescheduled without drifting when the
+        // queue is processed late.
+        node->callback(node->timestamp);
+    }
+}
+
+static inline void gba_scheduler_unlink(gba_scheduler_node_t *node) {
+    gba_scheduler_node_t **link = &gba_scheduler_queue;
+
+    while(*link != node) {
+        link = &(*link)->next;
+    }
+
+    *link = node->next;
+    node->next = NULL;
+}
+
+static inline void gba_scheduler_updateNextEventTimestamp() {
+    if(gba_scheduler_queue) {
+        gba_scheduler_nextEventTimestamp = gba_scheduler_queue->timestamp;
+    } else {
+        gba_scheduler_nextEventTimestamp = UINT64_MAX;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __CORE_SCHEDULER_H__
+#define __CORE_SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    GBA_SCHEDULER_EVENT_PPU_HBLANK,
+    GBA_SCHEDULER_EVENT_PPU_HDRAW,
+    GBA_SCHEDULER_EVENT_TIMER0,
+    GBA_SCHEDULER_EVENT_TIMER1,
+    GBA_SCHEDULER_EVENT_TIMER2,
+    GBA_SCHEDULER_EVENT_TIMER3,
+    GBA_SCHEDULER_EVENT_DMA,
+    GBA_SCHEDULER_EVENT_STOP, // Scheduled by tools stopping the CPU at a given cycle
+    GBA_SCHEDULER_EVENT_COUNT
+} gba_scheduler_event_t;
+
+typedef void gba_scheduler_callback_t(uint64_t timestamp);
+
+// The current emulated time, in CPU cycles, and the timestamp of the
+// earliest pending event. They are read in the CPU loop on every
+// instruction, so they are exposed directly instead of through getters.
+extern uint64_t gba_scheduler_cycleCounter;
+extern uint64_t gba_scheduler_nextEventTimestamp;
+
+extern void gba_scheduler_reset();
+extern void gba_scheduler_setCallback(gba_scheduler_event_t event, gba_scheduler_callback_t *callback);
+extern void gba_scheduler_schedule(gba_scheduler_event_t event, uint64_t timestamp);
+extern void gba_scheduler_cancel(gba_scheduler_event_t event);
+extern bool gba_scheduler_isScheduled(gba_scheduler_event_t event);
+extern void gba_scheduler_processEvents();
+
+#endif
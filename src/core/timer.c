@@ -5,6 +5,7 @@
 #include "platform.h"
 #include "core/gba.h"
 #include "core/io.h"
+#include "core/scheduler.h"
 
 struct gba_timer_channel_s;
 
@@ -12,25 +13,38 @@ typedef struct gba_timer_channel_s {
     struct gba_timer_channel_s *nextChannel;
     uint16_t irqFlag;
     int index;
+    gba_scheduler_event_t event;
     uint16_t reloadValue;
-    uint32_t prescaler;
+    unsigned int prescalerShift;
     bool countUp;
     bool irq;
     bool operate;
     uint16_t counter;
+    uint64_t counterTimestamp;
 } gba_timer_channel_t;
 
 gba_timer_channel_t gba_timer_channels[4];
-uint_least32_t gba_timer_cycleCounter;
 
 void gba_timer_reset();
-void gba_timer_cycle();
 static inline void gba_timer_channel_init(gba_timer_channel_t *channel, gba_timer_channel_t *nextChannel, int index);
-static inline void gba_timer_channel_cycle(gba_timer_channel_t *channel, uint_least32_t cycleCounter);
+static inline bool gba_timer_channel_isRunning(gba_timer_channel_t *channel);
+static inline void gba_timer_channel_sync(gba_timer_channel_t *channel);
+static inline void gba_timer_channel_schedule(gba_timer_channel_t *channel);
+static inline void gba_timer_channel_overflow(gba_timer_channel_t *channel);
 static inline void gba_timer_channel_increment(gba_timer_channel_t *channel);
 static inline void gba_timer_channel_lastOverflowed(gba_timer_channel_t *channel);
+static inline void gba_timer_onOverflowEvent(int index, uint64_t timestamp);
+void gba_timer_onOverflowEvent0(uint64_t timestamp);
+void gba_timer_onOverflowEvent1(uint64_t timestamp);
+void gba_timer_onOverflowEvent2(uint64_t timestamp);
+void gba_timer_onOverflowEvent3(uint64_t timestamp);
+static inline uint16_t gba_timer_readCallback_channel_counter(int index);
 static inline void gba_timer_writeCallback_channel_reload(int index, uint16_t value);
 static inline void gba_timer_writeCallback_channel_control(int index, uint16_t value);
+uint16_t gba_timer_readCallback_channel0_counter(uint32_t address);
+uint16_t gba_timer_readCallback_channel1_counter(uint32_t address);
+uint16_t gba_timer_readCallback_channel2_counter(uint32_t address);
+uint16_t gba_timer_readCallback_channel3_counter(uint32_t address);
 void gba_timer_writeCallback_channel0_reload(uint32_t address, uint16_t value);
 void gba_timer_writeCallback_channel0_control(uint32_t address, uint16_t value);
 void gba_timer_writeCallback_channel1_reload(uint32_t address, uint16_t value);
@@ -45,73 +59,162 @@ void gba_timer_reset() {
     gba_timer_channel_init(&gba_timer_channels[2], &gba_timer_channels[3], 2);
     gba_timer_channel_init(&gba_timer_channels[1], &gba_timer_channels[2], 1);
     gba_timer_channel_init(&gba_timer_channels[0], &gba_timer_channels[1], 0);
-}
-
-void gba_timer_cycle() {
-    for(int i = 0; i < 4; i++) {
-        gba_timer_channel_cycle(&gba_timer_channels[i], gba_timer_cycleCounter);
-    }
 
-    gba_timer_cycleCounter++;
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER0, gba_timer_onOverflowEvent0);
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER1, gba_timer_onOverflowEvent1);
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER2, gba_timer_onOverflowEvent2);
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER3, gba_timer_onOverflowEvent3);
 }
 
 static inline void gba_timer_channel_init(gba_timer_channel_t *channel, gba_timer_channel_t *nextChannel, int index) {
     channel->nextChannel = nextChannel;
     channel->irqFlag = 1 << (index + 3);
     channel->index = index;
+    channel->event = GBA_SCHEDULER_EVENT_TIMER0 + index;
+    channel->reloadValue = 0;
+    channel->prescalerShift = 0;
+    channel->countUp = false;
+    channel->irq = false;
+    channel->operate = false;
+    channel->counter = 0;
+    channel->counterTimestamp = 0;
+}
+
+// Only the channels that count CPU cycles have a scheduled overflow. Count-up
+// channels are incremented by the overflow of the previous channel.
+static inline bool gba_timer_channel_isRunning(gba_timer_channel_t *channel) {
+    return channel->operate && !channel->countUp;
+}
+
+static inline void gba_timer_channel_sync(gba_timer_channel_t *channel) {
+    if(gba_timer_channel_isRunning(channel)) {
+        uint64_t ticks = (gba_scheduler_cycleCounter - channel->counterTimestamp) >> channel->prescalerShift;
+
+        channel->counter += ticks;
+        channel->counterTimestamp += ticks << channel->prescalerShift;
+    }
 }
 
-static inline void gba_timer_channel_cycle(gba_timer_channel_t *channel, uint_least32_t cycleCounter) {
-    if(channel->operate && !channel->countUp) {
-        if((cycleCounter & channel->prescaler) == 0) {
-            gba_timer_channel_increment(channel);
-        }
+static inline void gba_timer_channel_schedule(gba_timer_channel_t *channel) {
+    if(gba_timer_channel_isRunning(channel)) {
+        uint64_t ticksToOverflow = 0x10000 - channel->counter;
+
+        gba_scheduler_schedule(channel->event, channel->counterTimestamp + (ticksToOverflow << channel->prescalerShift));
+    } else {
+        gba_scheduler_cancel(channel->event);
     }
 }
 
+static inline void gba_timer_channel_overflow(gba_timer_channel_t *channel) {
+    if(channel->irq) {
+        gba_setInterruptFlag(channel->irqFlag);
+    }
+
+    if(channel->nextChannel) {
+        gba_timer_channel_lastOverflowed(channel->nextChannel);
+    }
+
+    channel->counter = channel->reloadValue;
+}
+
 static inline void gba_timer_channel_increment(gba_timer_channel_t *channel) {
     channel->counter++;
-    
-    if(channel->counter == 0) {
-        if(channel->irq) {
-            gba_setInterruptFlag(channel->irqFlag);
-        }
 
-        if(channel->nextChannel) {
-            gba_timer_channel_lastOverflowed(channel->nextChannel);
-        }
-
-        channel->counter = channel->reloadValue;
+    if(channel->counter == 0) {
+        gba_timer_channel_overflow(channel);
     }
 }
 
 static inline void gba_timer_channel_lastOverflowed(gba_timer_channel_t *channel) {
-    if(channel->countUp) {
+    if(channel->operate && channel->countUp) {
         gba_timer_channel_increment(channel);
     }
 }
 
+static inline void gba_timer_onOverflowEvent(int index, uint64_t timestamp) {
+    gba_timer_channel_t *channel = &gba_timer_channels[index];
+
+    gba_timer_channel_overflow(channel);
+    channel->counterTimestamp = timestamp;
+    gba_timer_channel_schedule(channel);
+}
+
+void gba_timer_onOverflowEvent0(uint64_t timestamp) {
+    gba_timer_onOverflowEvent(0, timestamp);
+}
+
+void gba_timer_onOverflowEvent1(uint64_t timestamp) {
+    gba_timer_onOverflowEvent(1, timestamp);
+}
+
+void gba_timer_onOverflowEvent2(uint64_t timestamp) {
+    gba_timer_onOverflowEvent(2, timestamp);
+}
+
+void gba_timer_onOverflowEvent3(uint64_t timestamp) {
+    gba_timer_onOverflowEvent(3, timestamp);
+}
+
+static inline uint16_t gba_timer_readCallback_channel_counter(int index) {
+    gba_timer_channel_sync(&gba_timer_channels[index]);
+
+    return gba_timer_channels[index].counter;
+}
+
 static inline void gba_timer_writeCallback_channel_reload(int index, uint16_t value) {
     gba_timer_channels[index].reloadValue = value;
 }
 
 static inline void gba_timer_writeCallback_channel_control(int index, uint16_t value) {
+    gba_timer_channel_t *channel = &gba_timer_channels[index];
+    bool wasOperating = channel->operate;
+
+    gba_timer_channel_sync(channel);
+
     switch(value & 0x0003) {
-        case 0: gba_timer_channels[index].prescaler = 0; break;
-        case 1: gba_timer_channels[index].prescaler = 63; break;
-        case 2: gba_timer_channels[index].prescaler = 255; break;
-        case 3: gba_timer_channels[index].prescaler = 1023; break;
+        case 0: channel->prescalerShift = 0; break;
+        case 1: channel->prescalerShift = 6; break;
+        case 2: channel->prescalerShift = 8; break;
+        case 3: channel->prescalerShift = 10; break;
     }
 
     if(index == 0) {
-        gba_timer_channels->countUp = false;
+        channel->countUp = false;
         gba_io_getRegister(0x04000102)->value &= 0xfffb;
     } else {
-        gba_timer_channels->countUp = (value & (1 << 2)) != 0;
+        channel->countUp = (value & (1 << 2)) != 0;
+    }
+
+    channel->irq = (value & (1 << 6)) != 0;
+    channel->operate = (value & (1 << 7)) != 0;
+
+    if(channel->operate && !wasOperating) {
+        channel->counter = channel->reloadValue;
     }
 
-    gba_timer_channels[index].irq = (value & (1 << 6)) != 0;
-    gba_timer_channels[index].operate = (value & (1 << 7)) != 0;
+    channel->counterTimestamp = gba_scheduler_cycleCounter;
+
+    gba_timer_channel_schedule(channel);
+}
+
+uint16_t gba_timer_readCallback_channel0_counter(uint32_t address) {
+    UNUSED(address);
+    return gba_timer_readCallback_channel_counter(0);
+}
+
+uint16_t gba_timer_readCallback_channel1_counter(uint32_t address) {
+    UNUSED(address);
+    return gba_timer_readCallback_channel_counter(1);
+}
+
+uint16_t gba_timer_readCallback_channel2_counter(uint32_t address) {
+    UNUSED(address);
+    return gba_timer_readCallback_channel_counter(2);
+}
+
+uint16_t gba_timer_readCallback_channel3_counter(uint32_t address) {
+    UNUSED(address);
+    return gba_timer_readCallback_channel_counter(3);
 }
 
 void gba_timer_writeCallback_channel0_reload(uint32_t address, uint16_t value) {
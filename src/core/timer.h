@@ -4,7 +4,10 @@
 #include <stdint.h>
 
 extern void gba_timer_reset();
-extern void gba_timer_cycle();
+extern uint16_t gba_timer_readCallback_channel0_counter(uint32_t address);
+extern uint16_t gba_timer_readCallback_channel1_counter(uint32_t address);
+extern uint16_t gba_timer_readCallback_channel2_counter(uint32_t address);
+extern uint16_t gba_timer_readCallback_channel3_counter(uint32_t address);
 extern void gba_timer_writeCallback_channel0_reload(uint32_t address, uint16_t value);
 extern void gba_timer_writeCallback_channel0_control(uint32_t address, uint16_t value);
 extern void gba_timer_writeCallback_channel1_reload(uint32_t address, uint16_t value);
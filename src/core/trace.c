@@ -0,0 +1,222 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/trace.h"
+
+// A record holding every register, which is the longest a record can be.
+#define GBA_TRACE_KEYFRAME_LENGTH (11 + 15 * 4)
+
+// Keyframes are written often enough for the buffer to hold this many, so
+// that dropping the records up to the next one loses little of it.
+#define GBA_TRACE_KEYFRAMES_PER_BUFFER 8
+
+bool gba_trace_active;
+bool gba_trace_enabled;
+uint8_t *gba_trace_buffer;
+size_t gba_trace_size;
+
+// The records are kept between the tail and the head. Once the buffer has
+// wrapped around, the oldest ones lie between the tail and the end.
+size_t gba_trace_head;
+size_t gba_trace_tail;
+size_t gba_trace_end;
+bool gba_trace_wrapped;
+
+uint32_t gba_trace_addressStart;
+uint32_t gba_trace_addressEnd = UINT32_MAX;
+uint32_t gba_trace_firstFrame;
+uint32_t gba_trace_lastFrame = UINT32_MAX;
+uint32_t gba_trace_frame;
+
+// Register values as of the last record, which the next one is compared to.
+// Once they are no longer known, the next record is a keyframe.
+uint32_t gba_trace_registers[15];
+bool gba_trace_registersKnown;
+size_t gba_trace_keyframeDistance; // Bytes recorded since the last keyframe
+
+void gba_trace_start(void *buffer, size_t size);
+void gba_trace_stop();
+void gba_trace_setAddressRange(uint32_t start, uint32_t end);
+void gba_trace_setFrameWindow(uint32_t first, uint32_t last);
+void gba_trace_onFrame();
+void gba_trace_record(uint32_t address, uint32_t opcode, bool thumb, uint32_t cpsr, const uint32_t *registers);
+void gba_trace_getData(const void **first, size_t *firstSize, const void **second, size_t *secondSize);
+static inline void gba_trace_update();
+static inline uint8_t *gba_trace_reserve(size_t length);
+static inline uint8_t *gba_trace_write32(uint8_t *pointer, uint32_t value);
+static inline bool gba_trace_isKeyframe(const uint8_t *record);
+
+// Records into the given buffer, dropping the oldest records when it is
+// full. Frames are counted from here for the frame window.
+void gba_trace_start(void *buffer, size_t size) {
+    gba_trace_buffer = buffer;
+    gba_trace_size = size;
+    gba_trace_head = 0;
+    gba_trace_tail = 0;
+    gba_trace_end = 0;
+    gba_trace_wrapped = false;
+    gba_trace_frame = 0;
+    gba_trace_registersKnown = false;
+    gba_trace_keyframeDistance = 0;
+    gba_trace_enabled = true;
+    gba_trace_update();
+}
+
+void gba_trace_stop() {
+    gba_trace_enabled = false;
+    gba_trace_update();
+}
+
+// Only instructions at addresses from start up to, but excluding, end are
+// recorded.
+void gba_trace_setAddressRange(uint32_t start, uint32_t end) {
+    gba_trace_addressStart = start;
+    gba_trace_addressEnd = end;
+}
+
+// Only frames first to last, counted from the start of the trace, are
+// recorded.
+void gba_trace_setFrameWindow(uint32_t first, uint32_t last) {
+    gba_trace_firstFrame = first;
+    gba_trace_lastFrame = last;
+    gba_trace_update();
+}
+
+void gba_trace_onFrame() {
+    if(gba_trace_enabled) {
+        gba_trace_frame++;
+        gba_trace_update();
+    }
+}
+
+void gba_trace_record(uint32_t address, uint32_t opcode, bool thumb, uint32_t cpsr, const uint32_t *registers) {
+    if(address < gba_trace_addressStart || address >= gba_trace_addressEnd) {
+        return;
+    }
+
+    // Room is made for a keyframe, as dropping records may require one.
+    uint8_t *pointer = gba_trace_reserve(GBA_TRACE_KEYFRAME_LENGTH);
+
+    if(!pointer) {
+        return;
+    }
+
+    if(gba_trace_keyframeDistance >= gba_trace_size / GBA_TRACE_KEYFRAMES_PER_BUFFER) {
+        gba_trace_registersKnown = false;
+    }
+
+    uint16_t mask = 0;
+    size_t length = thumb ? 9 : 11;
+
+    for(int i = 0; i < 15; i++) {
+        if(!gba_trace_registersKnown || registers[i] != gba_trace_registers[i]) {
+            gba_trace_registers[i] = registers[i];
+            mask |= 1 << i;
+            length += 4;
+        }
+    }
+
+    gba_trace_keyframeDistance = gba_trace_registersKnown ? gba_trace_keyframeDistance + length : 0;
+    gba_trace_registersKnown = true;
+    gba_trace_head += length;
+
+    *pointer++ = (thumb ? GBA_TRACE_HEADER_THUMB : 0)
+        | ((cpsr & (1 << 7)) ? GBA_TRACE_HEADER_I : 0)
+        | (cpsr >> 24 & 0xf0);
+    *pointer++ = mask;
+    *pointer++ = mask >> 8;
+    pointer = gba_trace_write32(pointer, address);
+
+    if(thumb) {
+        *pointer++ = opcode;
+        *pointer++ = opcode >> 8;
+    } else {
+        pointer = gba_trace_write32(pointer, opcode);
+    }
+
+    for(int i = 0; i < 15; i++) {
+        if(mask & (1 << i)) {
+            pointer = gba_trace_write32(pointer, registers[i]);
+        }
+    }
+}
+
+// Returns the records from the oldest to the newest, which may be split in
+// two parts of the buffer.
+void gba_trace_getData(const void **first, size_t *firstSize, const void **second, size_t *secondSize) {
+    if(gba_trace_wrapped) {
+        *first = gba_trace_buffer + gba_trace_tail;
+        *firstSize = gba_trace_end - gba_trace_tail;
+        *second = gba_trace_buffer;
+        *secondSize = gba_trace_head;
+    } else {
+        *first = gba_trace_buffer + gba_trace_tail;
+        *firstSize = gba_trace_head - gba_trace_tail;
+        *second = NULL;
+        *secondSize = 0;
+    }
+}
+
+static inline void gba_trace_update() {
+    gba_trace_active = gba_trace_enabled
+        && gba_trace_frame >= gba_trace_firstFrame
+        && gba_trace_frame <= gba_trace_lastFrame;
+}
+
+// Makes room for a record of up to the given length at the head, dropping
+// the oldest records it would overwrite. The records after them are also
+// dropped up to the next keyframe, so that the oldest record left always
+// holds every register. The head is moved by the caller once the record
+// is written.
+static inline uint8_t *gba_trace_reserve(size_t length) {
+    bool dropped = false;
+
+    if(length > gba_trace_size) {
+        return NULL;
+    }
+
+    if(gba_trace_head + length > gba_trace_size) {
+        gba_trace_end = gba_trace_head;
+        gba_trace_head = 0;
+        gba_trace_wrapped = true;
+    }
+
+    while(
+        gba_trace_wrapped
+        && (gba_trace_tail < gba_trace_head + length || (dropped && !gba_trace_isKeyframe(gba_trace_buffer + gba_trace_tail)))
+    ) {
+        gba_trace_tail += gba_trace_getRecordLength(gba_trace_buffer + gba_trace_tail);
+        dropped = true;
+
+        if(gba_trace_tail >= gba_trace_end) {
+            gba_trace_tail = 0;
+            gba_trace_wrapped = false;
+        }
+    }
+
+    while(dropped && gba_trace_tail != gba_trace_head && !gba_trace_isKeyframe(gba_trace_buffer + gba_trace_tail)) {
+        gba_trace_tail += gba_trace_getRecordLength(gba_trace_buffer + gba_trace_tail);
+    }
+
+    // Every record was dropped, so the next one starts from scratch.
+    if(dropped && gba_trace_tail == gba_trace_head) {
+        gba_trace_registersKnown = false;
+    }
+
+    return gba_trace_buffer + gba_trace_head;
+}
+
+static inline uint8_t *gba_trace_write32(uint8_t *pointer, uint32_t value) {
+    pointer[0] = value;
+    pointer[1] = value >> 8;
+    pointer[2] = value >> 16;
+    pointer[3] = value >> 24;
+
+    return pointer + 4;
+}
+
+// Records with every register are keyframes, whatever the previous ones.
+static inline bool gba_trace_isKeyframe(const uint8_t *record) {
+    return (record[1] | (record[2] << 8)) == 0x7fff;
+}
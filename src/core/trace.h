@@ -0,0 +1,48 @@
+#ifndef __CORE_TRACE_H__
+#define __CORE_TRACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Every record starts with a header byte followed by the mask of the
+// registers R0 to R14 that the instruction changed, the address and the
+// opcode of the instruction, then the new value of each changed register.
+// Multi-byte fields are little-endian and unaligned. Keyframes, records
+// with every register in the mask, are written regularly and the oldest
+// record kept is always one, so that the full state can be rebuilt.
+#define GBA_TRACE_HEADER_THUMB (1 << 0)
+#define GBA_TRACE_HEADER_I (1 << 1)
+#define GBA_TRACE_HEADER_V (1 << 4)
+#define GBA_TRACE_HEADER_C (1 << 5)
+#define GBA_TRACE_HEADER_Z (1 << 6)
+#define GBA_TRACE_HEADER_N (1 << 7)
+
+// Saved traces start with this signature.
+#define GBA_TRACE_SIGNATURE "GBATRACE"
+
+// Whether instructions are being recorded, in which case the CPU runs them
+// through the interpreter whatever the selected backend.
+extern bool gba_trace_active;
+
+extern void gba_trace_start(void *buffer, size_t size);
+extern void gba_trace_stop();
+extern void gba_trace_setAddressRange(uint32_t start, uint32_t end);
+extern void gba_trace_setFrameWindow(uint32_t first, uint32_t last);
+extern void gba_trace_onFrame();
+extern void gba_trace_record(uint32_t address, uint32_t opcode, bool thumb, uint32_t cpsr, const uint32_t *registers);
+extern void gba_trace_getData(const void **first, size_t *firstSize, const void **second, size_t *secondSize);
+
+static inline size_t gba_trace_getRecordLength(const uint8_t *record) {
+    uint16_t mask = record[1] | (record[2] << 8);
+    size_t length = 7 + ((record[0] & GBA_TRACE_HEADER_THUMB) ? 2 : 4);
+
+    while(mask) {
+        length += 4;
+        mask &= mask - 1;
+    }
+
+    return length;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/coverage.h"
+
+int main(int argc, const char **argv);
+void printRegion(const uint8_t *bitmap, const char *name, size_t offset, size_t size);
+
+int main(int argc, const char **argv) {
+    if(argc < 3) {
+        fprintf(stderr, "Usage: %s <output file name> <coverage file name>...\n", argv[0]);
+        fprintf(stderr, "The coverage files are merged into the output file, which may be one of them.\n");
+        return EXIT_FAILURE;
+    }
+
+    uint8_t *bitmap = calloc(GBA_COVERAGE_SIZE, 1);
+
+    if(bitmap == NULL) {
+        fprintf(stderr, "Failed to allocate the coverage bitmap.\n");
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 2; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+
+        if(file == NULL) {
+            fprintf(stderr, "Failed to open %s.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        bool valid = gba_coverage_read(file, bitmap);
+
+        fclose(file);
+
+        if(!valid) {
+            fprintf(stderr, "%s is not a coverage file.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *file = fopen(argv[1], "wb");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    bool written = gba_coverage_write(file, bitmap);
+
+    if(fclose(file) || !written) {
+        fprintf(stderr, "Failed to write the output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    printRegion(bitmap, "BIOS", GBA_COVERAGE_OFFSET_BIOS, GBA_COVERAGE_OFFSET_EWRAM - GBA_COVERAGE_OFFSET_BIOS);
+    printRegion(bitmap, "EWRAM", GBA_COVERAGE_OFFSET_EWRAM, GBA_COVERAGE_OFFSET_IWRAM - GBA_COVERAGE_OFFSET_EWRAM);
+    printRegion(bitmap, "IWRAM", GBA_COVERAGE_OFFSET_IWRAM, GBA_COVERAGE_OFFSET_ROM - GBA_COVERAGE_OFFSET_IWRAM);
+    printRegion(bitmap, "ROM", GBA_COVERAGE_OFFSET_ROM, GBA_COVERAGE_SIZE - GBA_COVERAGE_OFFSET_ROM);
+
+    free(bitmap);
+
+    return EXIT_SUCCESS;
+}
+
+// Prints the number of bytes of code executed in the region.
+void printRegion(const uint8_t *bitmap, const char *name, size_t offset, size_t size) {
+    printf("%-6s %10zu bytes\n", name, gba_coverage_count(bitmap, offset, size) * 2);
+}
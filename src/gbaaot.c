@@ -0,0 +1,666 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "core/cpu.h"
+#include "core/disasm.h"
+
+#define ROM_ADDRESS 0x08000000
+#define ROM_MAX_SIZE 0x02000000
+
+typedef struct {
+    uint32_t address;
+    bool thumb;
+    int length;
+} block_t;
+
+uint8_t *rom;
+uint32_t romSize;
+
+// Bit 0 is set when an ARM block starts at the halfword, bit 1 for Thumb.
+uint8_t *blockStarts;
+uint32_t *worklist; // Addresses of the blocks to read, bit 0 set for Thumb
+size_t worklistCount;
+size_t worklistCapacity;
+block_t *blocks;
+size_t blockCount;
+size_t blockCapacity;
+
+int main(int argc, const char **argv);
+int addEntry(uint32_t address, bool thumb);
+int readBlock(block_t *block);
+int readBlockThumb(block_t *block);
+int readBlockArm(block_t *block);
+void writeBlock(FILE *file, const block_t *block);
+bool writeThumb(FILE *file, uint16_t opcode);
+void writeAddSub(FILE *file, int rd, const char *left, const char *right, bool sub);
+void writeLogical(FILE *file, int rd, const char *value);
+uint32_t read16(uint32_t address);
+uint32_t read32(uint32_t address);
+int compareBlocks(const void *left, const void *right);
+
+int main(int argc, const char **argv) {
+    if(argc < 3) {
+        fprintf(stderr, "Usage: %s <rom file name> <output file name> [<entry>...]\n", argv[0]);
+        fprintf(stderr, "The code reachable from the start of the ROM and from the given hexadecimal\n");
+        fprintf(stderr, "entry addresses is compiled to C. Odd entry addresses are Thumb code.\n");
+        return EXIT_FAILURE;
+    }
+
+    long fileSize = 0;
+
+    rom = readFile(argv[1], &fileSize, false);
+
+    if(rom == NULL) {
+        fprintf(stderr, "Failed to read the ROM file.\n");
+        return EXIT_FAILURE;
+    }
+
+    romSize = fileSize > ROM_MAX_SIZE ? ROM_MAX_SIZE : fileSize;
+    blockStarts = calloc(romSize / 2 + 1, 1);
+
+    if(blockStarts == NULL) {
+        fprintf(stderr, "Failed to allocate the block table.\n");
+        return EXIT_FAILURE;
+    }
+
+    if(addEntry(ROM_ADDRESS, false)) {
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 3; i < argc; i++) {
+        char *last;
+        uint32_t address = strtoul(argv[i], &last, 16);
+
+        if(*last != '\0' || addEntry(address & 0xfffffffe, address & 1)) {
+            fprintf(stderr, "Invalid entry address %s.\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    gba_cpu_init();
+
+    while(worklistCount) {
+        uint32_t entry = worklist[--worklistCount];
+
+        if(blockCount == blockCapacity) {
+            blockCapacity = blockCapacity ? blockCapacity * 2 : 1024;
+            blocks = realloc(blocks, blockCapacity * sizeof(block_t));
+
+            if(blocks == NULL) {
+                fprintf(stderr, "Failed to allocate the block list.\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        blocks[blockCount] = (block_t){entry & 0xfffffffe, entry & 1, 0};
+
+        if(readBlock(&blocks[blockCount])) {
+            return EXIT_FAILURE;
+        }
+
+        blockCount++;
+    }
+
+    qsort(blocks, blockCount, sizeof(block_t), compareBlocks);
+
+    FILE *file = fopen(argv[2], "w");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(file, "// Generated by gbaaot, do not edit.\n\n");
+    fprintf(file, "#include <stdbool.h>\n#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(file, "#include \"core/cpu.h\"\n#include \"core/scheduler.h\"\n");
+
+    for(size_t i = 0; i < blockCount; i++) {
+        writeBlock(file, &blocks[i]);
+    }
+
+    fprintf(file, "\nconst gba_cpu_aotBlock_t gba_aot_blocks[] = {\n");
+
+    for(size_t i = 0; i < blockCount; i++) {
+        uint32_t offset = blocks[i].address - ROM_ADDRESS;
+        uint32_t hash = gba_cpu_hashAotBlock(rom + offset, blocks[i].length * (blocks[i].thumb ? 2 : 4));
+        char mode = blocks[i].thumb ? 't' : 'a';
+
+        fprintf(file, "    {0x%08x, %s, %d, 0x%08x, gba_aot_%c%08x},\n", blocks[i].address, blocks[i].thumb ? "true" : "false", blocks[i].length, hash, mode, blocks[i].address);
+    }
+
+    fprintf(file, "};\n\nconst size_t gba_aot_blockCount = %zu;\n", blockCount);
+
+    if(fclose(file)) {
+        fprintf(stderr, "Failed to write the output file.\n");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "Compiled %zu blocks.\n", blockCount);
+
+    free(blocks);
+    free(worklist);
+    free(blockStarts);
+    free(rom);
+
+    return EXIT_SUCCESS;
+}
+
+// Addresses outside of the ROM are ignored.
+int addEntry(uint32_t address, bool thumb) {
+    uint32_t offset = address - ROM_ADDRESS;
+    uint8_t bit = thumb ? 2 : 1;
+
+    if(address < ROM_ADDRESS || offset >= romSize || (address & (thumb ? 1 : 3))) {
+        return 0;
+    }
+
+    if(blockStarts[offset / 2] & bit) {
+        return 0;
+    }
+
+    blockStarts[offset / 2] |= bit;
+
+    if(worklistCount == worklistCapacity) {
+        worklistCapacity = worklistCapacity ? worklistCapacity * 2 : 1024;
+        worklist = realloc(worklist, worklistCapacity * sizeof(uint32_t));
+
+        if(worklist == NULL) {
+            fprintf(stderr, "Failed to allocate the worklist.\n");
+            return 1;
+        }
+    }
+
+    worklist[worklistCount++] = address | thumb;
+
+    return 0;
+}
+
+// Blocks end where the cached backend ends them, as compiled blocks are only
+// used in place of a cached block of the same length. The blocks that code
+// may run next are added to the worklist: branch targets, return addresses,
+// and the targets of BX when the register holds a literal.
+int readBlock(block_t *block) {
+    return block->thumb ? readBlockThumb(block) : readBlockArm(block);
+}
+
+int readBlockThumb(block_t *block) {
+    uint32_t constants[16];
+    uint16_t known = 0;
+    uint32_t address = block->address;
+    bool end = false;
+    int result = 0;
+
+    while(!end && result == 0) {
+        if(address + 2 > ROM_ADDRESS + romSize) {
+            break;
+        }
+
+        uint16_t opcode = read16(address);
+        uint32_t target;
+
+        block->length++;
+
+        switch(gba_cpu_getFormatThumb(opcode)) {
+            case GBA_CPU_FORMAT_UNDEFINED:
+                end = true;
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_SWI:
+                end = true;
+                result = addEntry(address + 2, true);
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_HIREGISTER:
+                if((opcode & 0x0300) == 0x0300) {
+                    int rs = (opcode >> 3) & 0xf;
+
+                    end = true;
+
+                    if(known & (1 << rs)) {
+                        result = addEntry(constants[rs] & 0xfffffffe, constants[rs] & 1);
+                    }
+
+                    // mov lr, pc
+                    if(result == 0 && block->length >= 2 && read16(address - 2) == 0x46fe) {
+                        result = addEntry(address + 2, true);
+                    }
+                }
+
+                known &= ~(1 << ((opcode & 0x7) | ((opcode >> 4) & 0x8)));
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_PCLOAD:
+                target = ((address + 4) & 0xfffffffc) + ((opcode & 0xff) << 2);
+
+                if(target - ROM_ADDRESS + 4 <= romSize) {
+                    constants[(opcode >> 8) & 0x7] = read32(target);
+                    known |= 1 << ((opcode >> 8) & 0x7);
+                }
+
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_LOADADDRESS:
+                known &= ~(1 << ((opcode >> 8) & 0x7));
+
+                if(!(opcode & (1 << 11))) {
+                    constants[(opcode >> 8) & 0x7] = ((address + 4) & 0xfffffffc) + ((opcode & 0xff) << 2);
+                    known |= 1 << ((opcode >> 8) & 0x7);
+                }
+
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_CONDITIONALBRANCH:
+                target = address + 4 + (int8_t)opcode * 2;
+                result = addEntry(target, true);
+
+                if((opcode & 0x0f00) < 0x0e00 && target == block->address) {
+                    end = true;
+                    result |= addEntry(address + 2, true);
+                }
+
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_BRANCH:
+                target = address + 4 + ((int32_t)((uint32_t)opcode << 21) >> 20);
+                end = true;
+                result = addEntry(target, true);
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_LONGBRANCH:
+                if(!(opcode & (1 << 11))) {
+                    break;
+                }
+
+                end = true;
+
+                if(block->length >= 2 && (read16(address - 2) & 0xf800) == 0xf000) {
+                    target = address + 2 + ((int32_t)(read16(address - 2) << 21) >> 9) + ((opcode & 0x7ff) << 1);
+                    result = addEntry(target, true);
+                }
+
+                result |= addEntry(address + 2, true);
+                break;
+
+            case GBA_CPU_FORMAT_THUMB_PUSHPOP:
+                end = (opcode & 0x0900) == 0x0900;
+                break;
+
+            default:
+                // Any register the instruction may write.
+                known &= ~((1 << (opcode & 0x7)) | (1 << ((opcode >> 8) & 0x7)));
+                break;
+        }
+
+        address += 2;
+
+        if(!end && block->length == GBA_CPU_BLOCK_MAX_LENGTH) {
+            end = true;
+            result |= addEntry(address, true);
+        }
+    }
+
+    return result;
+}
+
+int readBlockArm(block_t *block) {
+    uint32_t constants[16];
+    uint16_t known = 0;
+    uint32_t address = block->address;
+    bool end = false;
+    int result = 0;
+
+    while(!end && result == 0) {
+        if(address + 4 > ROM_ADDRESS + romSize) {
+            break;
+        }
+
+        uint32_t opcode = read32(address);
+        bool always = (opcode >> 28) == 0xe;
+        int rd = (opcode >> 12) & 0xf;
+        uint32_t target;
+
+        block->length++;
+
+        switch(gba_cpu_getFormatArm(opcode)) {
+            case GBA_CPU_FORMAT_UNDEFINED:
+                end = true;
+                break;
+
+            case GBA_CPU_FORMAT_ARM_SWI:
+            case GBA_CPU_FORMAT_ARM_PSRTRANSFER:
+                end = true;
+                result = addEntry(address + 4, false);
+                break;
+
+            case GBA_CPU_FORMAT_ARM_B:
+                target = address + 8 + ((int32_t)(opcode << 8) >> 6);
+
+                if((opcode >> 28) != 0xf) {
+                    result = addEntry(target, false);
+                }
+
+                if(always) {
+                    end = true;
+                } else if(!(opcode & (1 << 24)) && (opcode >> 28) != 0xf && target == block->address) {
+                    end = true;
+                }
+
+                if(end || (opcode & (1 << 24))) {
+                    result |= addEntry(address + 4, false);
+                }
+
+                break;
+
+            case GBA_CPU_FORMAT_ARM_BX:
+                if(known & (1 << (opcode & 0xf))) {
+                    result = addEntry(constants[opcode & 0xf] & 0xfffffffe, constants[opcode & 0xf] & 1);
+                }
+
+                // mov lr, pc
+                if(block->length >= 2 && read32(address - 4) == 0xe1a0e00f) {
+                    result |= addEntry(address + 4, false);
+                }
+
+                end = always;
+                break;
+
+            case GBA_CPU_FORMAT_ARM_SINGLEDATATRANSFER:
+                known &= ~(1 << rd);
+
+                // ldr rd, [pc, #offset]
+                if((opcode & 0x0f7f0000) == 0x051f0000) {
+                    target = address + 8 + ((opcode & (1 << 23)) ? (opcode & 0xfff) : -(opcode & 0xfff));
+
+                    if(target - ROM_ADDRESS + 4 <= romSize) {
+                        constants[rd] = read32(target);
+                        known |= 1 << rd;
+                    }
+                }
+
+                break;
+
+            case GBA_CPU_FORMAT_ARM_DATAPROCESSING:
+                known &= ~(1 << rd);
+
+                // add rd, pc, #immediate
+                if((opcode & 0x0fff0000) == 0x028f0000) {
+                    uint32_t immediate = opcode & 0xff;
+                    int rotation = (opcode >> 7) & 0x1e;
+
+                    constants[rd] = address + 8 + (rotation ? (immediate >> rotation) | (immediate << (32 - rotation)) : immediate);
+                    known |= 1 << rd;
+                }
+
+                break;
+
+            default:
+                known &= ~(1 << rd);
+                break;
+        }
+
+        address += 4;
+
+        if(!end && block->length == GBA_CPU_BLOCK_MAX_LENGTH) {
+            end = true;
+            result |= addEntry(address, false);
+        }
+    }
+
+    return result;
+}
+
+// Each instruction runs the way the cached backend runs it, through the JIT
+// helpers unless it is one of the Thumb instructions on registers written
+// directly in C.
+void writeBlock(FILE *file, const block_t *block) {
+    uint32_t size = block->thumb ? 2 : 4;
+    bool cyclesUsed = false;
+    char text[GBA_DISASM_BUFFER_SIZE];
+
+    fprintf(file, "\nstatic void gba_aot_%c%08x(uint32_t cycles) {\n", block->thumb ? 't' : 'a', block->address);
+
+    for(int i = 0; i < block->length; i++) {
+        uint32_t address = block->address + i * size;
+        bool last = i == block->length - 1;
+        uint32_t opcode;
+
+        if(block->thumb) {
+            opcode = read16(address);
+
+            // Only the first half of a BL pair is disassembled as the pair.
+            gba_disasm_thumb(address, opcode | (address + 4 <= ROM_ADDRESS + romSize ? read16(address + 2) << 16 : 0), text);
+            fprintf(file, "%s    // %08x %04x %s\n", i ? "\n" : "", address, opcode, text);
+
+            if(writeThumb(file, opcode)) {
+                cyclesUsed = true;
+                fprintf(file, "\n    gba_scheduler_cycleCounter += cycles;\n");
+                fprintf(file, "    gba_cpu_r[15] += 2;\n");
+
+                if(!last) {
+                    fprintf(file, "\n    if(gba_scheduler_cycleCounter >= gba_scheduler_nextEventTimestamp) {\n        return;\n    }\n");
+                }
+
+                continue;
+            }
+        } else {
+            opcode = read32(address);
+            gba_disasm_arm(address, opcode, text);
+            fprintf(file, "%s    // %08x %08x %s\n", i ? "\n" : "", address, opcode, text);
+        }
+
+        if(last) {
+            fprintf(file, "    gba_cpu_jitInterpret%s(0x%0*x);\n", block->thumb ? "Thumb" : "Arm", block->thumb ? 4 : 8, opcode);
+        } else {
+            fprintf(file, "    if(!gba_cpu_jitInterpret%s(0x%0*x)) {\n        return;\n    }\n", block->thumb ? "Thumb" : "Arm", block->thumb ? 4 : 8, opcode);
+        }
+    }
+
+    if(!cyclesUsed) {
+        fprintf(file, "\n    (void)cycles;\n");
+    }
+
+    fprintf(file, "}\n");
+}
+
+// Writes the instruction in C when it only computes on registers other than
+// r15 and on the flags, which the flag variables hold while compiled code
+// runs. Returns false for the other instructions.
+bool writeThumb(FILE *file, uint16_t opcode) {
+    char left[16];
+    char right[16];
+    char value[64];
+    int rd = opcode & 0x7;
+    int rs = (opcode >> 3) & 0x7;
+
+    switch(gba_cpu_getFormatThumb(opcode)) {
+        case GBA_CPU_FORMAT_THUMB_MOVESHIFTED: {
+            int shift = (opcode >> 6) & 0x1f;
+
+            fprintf(file, "    {\n        uint32_t value = gba_cpu_r[%d];\n\n", rs);
+
+            switch((opcode >> 11) & 0x3) {
+                case 0:
+                    if(shift) {
+                        fprintf(file, "        gba_cpu_flagC = (value >> %d) != 0;\n", 32 - shift);
+                        snprintf(value, sizeof(value), "value << %d", shift);
+                    } else {
+                        snprintf(value, sizeof(value), "value");
+                    }
+
+                    break;
+
+                case 1:
+                    if(shift) {
+                        fprintf(file, "        gba_cpu_flagC = (value >> %d) & 1;\n", shift - 1);
+                        snprintf(value, sizeof(value), "value >> %d", shift);
+                    } else {
+                        fprintf(file, "        gba_cpu_flagC = value >> 31;\n");
+                        snprintf(value, sizeof(value), "0");
+                    }
+
+                    break;
+
+                default:
+                    fprintf(file, "        gba_cpu_flagC = (value >> %d) & 1;\n", shift ? shift - 1 : 31);
+                    snprintf(value, sizeof(value), "(uint32_t)((int32_t)value >> %d)", shift ? shift : 31);
+                    break;
+            }
+
+            writeLogical(file, rd, value);
+            fprintf(file, "    }\n");
+            return true;
+        }
+
+        case GBA_CPU_FORMAT_THUMB_ADDSUB:
+            snprintf(left, sizeof(left), "gba_cpu_r[%d]", rs);
+
+            if(opcode & (1 << 10)) {
+                snprintf(right, sizeof(right), "%d", (opcode >> 6) & 0x7);
+            } else {
+                snprintf(right, sizeof(right), "gba_cpu_r[%d]", (opcode >> 6) & 0x7);
+            }
+
+            writeAddSub(file, rd, left, right, opcode & (1 << 9));
+            return true;
+
+        case GBA_CPU_FORMAT_THUMB_IMMEDIATE:
+            rd = (opcode >> 8) & 0x7;
+            snprintf(left, sizeof(left), "gba_cpu_r[%d]", rd);
+            snprintf(right, sizeof(right), "%d", opcode & 0xff);
+
+            switch((opcode >> 11) & 0x3) {
+                case 0:
+                    fprintf(file, "    gba_cpu_r[%d] = %d;\n", rd, opcode & 0xff);
+                    fprintf(file, "    gba_cpu_flagN = false;\n");
+                    fprintf(file, "    gba_cpu_flagZ = %s;\n", (opcode & 0xff) ? "false" : "true");
+                    break;
+
+                case 1: writeAddSub(file, -1, left, right, true); break;
+                case 2: writeAddSub(file, rd, left, right, false); break;
+                case 3: writeAddSub(file, rd, left, right, true); break;
+            }
+
+            return true;
+
+        case GBA_CPU_FORMAT_THUMB_ALU:
+            snprintf(left, sizeof(left), "gba_cpu_r[%d]", rd);
+            snprintf(right, sizeof(right), "gba_cpu_r[%d]", rs);
+
+            switch((opcode >> 6) & 0xf) {
+                case 0x0: snprintf(value, sizeof(value), "%s & %s", left, right); break;
+                case 0x1: snprintf(value, sizeof(value), "%s ^ %s", left, right); break;
+                case 0x8: snprintf(value, sizeof(value), "%s & %s", left, right); rd = -1; break;
+                case 0x9: writeAddSub(file, rd, "0", right, true); return true;
+                case 0xa: writeAddSub(file, -1, left, right, true); return true;
+                case 0xb: writeAddSub(file, -1, left, right, false); return true;
+                case 0xc: snprintf(value, sizeof(value), "%s | %s", left, right); break;
+                case 0xe: snprintf(value, sizeof(value), "%s & ~%s", left, right); break;
+                case 0xf: snprintf(value, sizeof(value), "~%s", right); break;
+                default: return false;
+            }
+
+            fprintf(file, "    {\n");
+            writeLogical(file, rd, value);
+            fprintf(file, "    }\n");
+            return true;
+
+        case GBA_CPU_FORMAT_THUMB_HIREGISTER:
+            rd = (opcode & 0x7) | ((opcode >> 4) & 0x8);
+            rs = (opcode >> 3) & 0xf;
+            snprintf(left, sizeof(left), "gba_cpu_r[%d]", rd);
+            snprintf(right, sizeof(right), "gba_cpu_r[%d]", rs);
+
+            switch((opcode >> 8) & 0x3) {
+                case 0:
+                    if(rd == 15) {
+                        return false;
+                    }
+
+                    fprintf(file, "    gba_cpu_r[%d] += gba_cpu_r[%d];\n", rd, rs);
+                    return true;
+
+                case 1:
+                    writeAddSub(file, -1, left, right, true);
+                    return true;
+
+                case 2:
+                    if(rd == 15) {
+                        return false;
+                    }
+
+                    fprintf(file, "    gba_cpu_r[%d] = gba_cpu_r[%d];\n", rd, rs);
+                    return true;
+
+                default:
+                    return false;
+            }
+
+        default:
+            return false;
+    }
+}
+
+// The result is stored in rd unless it is negative.
+void writeAddSub(FILE *file, int rd, const char *left, const char *right, bool sub) {
+    fprintf(file, "    {\n");
+    fprintf(file, "        uint32_t left = %s;\n", left);
+    fprintf(file, "        uint32_t right = %s;\n", right);
+    fprintf(file, "        uint32_t result = left %c right;\n\n", sub ? '-' : '+');
+
+    if(rd >= 0) {
+        fprintf(file, "        gba_cpu_r[%d] = result;\n", rd);
+    }
+
+    fprintf(file, "        gba_cpu_flagN = result >> 31;\n");
+    fprintf(file, "        gba_cpu_flagZ = result == 0;\n");
+
+    if(sub) {
+        fprintf(file, "        gba_cpu_flagC = left >= right;\n");
+        fprintf(file, "        gba_cpu_flagV = ((left ^ right) & (left ^ result)) >> 31;\n");
+    } else {
+        fprintf(file, "        gba_cpu_flagC = result < left;\n");
+        fprintf(file, "        gba_cpu_flagV = (~(left ^ right) & (left ^ result)) >> 31;\n");
+    }
+
+    fprintf(file, "    }\n");
+}
+
+// Sets N and Z from the value, stored in rd unless it is negative.
+void writeLogical(FILE *file, int rd, const char *value) {
+    fprintf(file, "        uint32_t result = %s;\n\n", value);
+
+    if(rd >= 0) {
+        fprintf(file, "        gba_cpu_r[%d] = result;\n", rd);
+    }
+
+    fprintf(file, "        gba_cpu_flagN = result >> 31;\n");
+    fprintf(file, "        gba_cpu_flagZ = result == 0;\n");
+}
+
+uint32_t read16(uint32_t address) {
+    const uint8_t *pointer = rom + address - ROM_ADDRESS;
+
+    return pointer[0] | (pointer[1] << 8);
+}
+
+uint32_t read32(uint32_t address) {
+    const uint8_t *pointer = rom + address - ROM_ADDRESS;
+
+    return pointer[0] | (pointer[1] << 8) | (pointer[2] << 16) | ((uint32_t)pointer[3] << 24);
+}
+
+int compareBlocks(const void *left, const void *right) {
+    const block_t *leftBlock = left;
+    const block_t *rightBlock = right;
+
+    if(leftBlock->address != rightBlock->address) {
+        return leftBlock->address > rightBlock->address ? 1 : -1;
+    }
+
+    return leftBlock->thumb - rightBlock->thumb;
+}
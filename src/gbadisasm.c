@@ -0,0 +1,111 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/cpu.h"
+#include "core/disasm.h"
+
+#define ROM_ADDRESS 0x08000000
+
+int main(int argc, const char **argv);
+int readRange(const char *string, uint32_t *start, uint32_t *end);
+
+int main(int argc, const char **argv) {
+    const char *romPath = NULL;
+    const char *range = NULL;
+    bool thumb = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--thumb") == 0) {
+            thumb = true;
+        } else if(romPath == NULL) {
+            romPath = argv[i];
+        } else {
+            range = argv[i];
+        }
+    }
+
+    uint32_t start = ROM_ADDRESS;
+    uint32_t end = ROM_ADDRESS + 0x100;
+
+    if(romPath == NULL || (range && readRange(range, &start, &end))) {
+        fprintf(stderr, "Usage: %s <rom file name> [<start>-<end>] [--thumb]\n", argv[0]);
+        fprintf(stderr, "The addresses are hexadecimal, the end is excluded.\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(romPath, "rb");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the ROM file.\n");
+        return EXIT_FAILURE;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // Padded so that an instruction at the end can be read as a word.
+    uint8_t *rom = calloc(fileSize + 4, 1);
+
+    if(rom == NULL || fread(rom, 1, fileSize, file) != (size_t)fileSize) {
+        fprintf(stderr, "Failed to read the ROM file.\n");
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    fclose(file);
+
+    if(start < ROM_ADDRESS || end > ROM_ADDRESS + (uint32_t)fileSize) {
+        fprintf(stderr, "The range is outside of the ROM.\n");
+        return EXIT_FAILURE;
+    }
+
+    gba_cpu_init();
+
+    char text[GBA_DISASM_BUFFER_SIZE];
+    uint32_t address = start & (thumb ? ~1 : ~3);
+
+    while(address < end) {
+        const uint8_t *pointer = rom + address - ROM_ADDRESS;
+        uint32_t opcode = pointer[0] | (pointer[1] << 8) | (pointer[2] << 16) | ((uint32_t)pointer[3] << 24);
+        size_t size;
+
+        if(thumb) {
+            size = gba_disasm_thumb(address, opcode, text);
+            printf("%08x %0*x %s\n", address, size == 4 ? 8 : 4, size == 4 ? (opcode >> 16) | (opcode << 16) : opcode & 0xffff, text);
+        } else {
+            size = gba_disasm_arm(address, opcode, text);
+            printf("%08x %08x %s\n", address, opcode, text);
+        }
+
+        address += size;
+    }
+
+    free(rom);
+
+    return EXIT_SUCCESS;
+}
+
+// Reads "<start>-<end>".
+int readRange(const char *string, uint32_t *start, uint32_t *end) {
+    char *separator;
+    char *last;
+
+    *start = strtoul(string, &separator, 16);
+
+    if(*separator != '-') {
+        return 1;
+    }
+
+    *end = strtoul(separator + 1, &last, 16);
+
+    if(*last != '\0' || last == separator + 1) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,21 +1,69 @@
+#define _DEFAULT_SOURCE
+
+#include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "io.h"
+#include "platform.h"
+#include "symbols.h"
+#include "core/callprof.h"
+#include "core/coverage.h"
+#include "core/cpu.h"
 #include "core/defines.h"
 #include "core/gba.h"
+#include "core/jit.h"
+#include "core/trace.h"
 #include "frontend/frontend.h"
 
+#define TRACE_BUFFER_SIZE (16 << 20)
+#define CALLPROF_BUFFER_SIZE (16 << 20)
+#define CALLPROF_DEFAULT_INTERVAL 16384
+
 const char *biosPath;
 const char *romPath;
+const char *idleLoopsPath;
+const char *tracePath;
+const char *jitCachePath;
+const char *coveragePath;
 
 const void *biosBuffer;
 const void *romBuffer;
 size_t romBufferSize;
 void *sramBuffer;
 size_t sramBufferSize;
+gba_cpu_backend_t cpuBackend = GBA_CPU_BACKEND_CACHED;
+bool skipIdleLoops;
+bool emulatePipeline = true;
+bool fuseInstructions = true;
+bool fusionReport;
+
+#ifdef GBA_CPU_PROFILE
+volatile sig_atomic_t profileRequested;
+#endif
+unsigned long predecodeLimit; // In KiB
+void *traceBuffer;
+uint32_t traceAddressStart;
+uint32_t traceAddressEnd = UINT32_MAX;
+uint32_t traceFirstFrame;
+uint32_t traceLastFrame = UINT32_MAX;
+uint8_t *coverageBitmap;
+
+#ifdef GBA_AOT
+extern const gba_cpu_aotBlock_t gba_aot_blocks[];
+extern const size_t gba_aot_blockCount;
+bool useAotBlocks = true;
+#endif
+
+#ifdef GBA_CALLPROF
+const char *callProfilePath;
+const char *callProfileSymbolsPath;
+uint32_t callProfileInterval = CALLPROF_DEFAULT_INTERVAL;
+void *callProfileBuffer;
+#endif
 
 int main(int argc, const char **argv);
 int readCommandLineArguments(int argc, const char **argv);
@@ -23,6 +71,24 @@ void printHelp();
 int checkConfiguration();
 int loadBios();
 int loadRom();
+int loadIdleLoops();
+void printPredecodeReport();
+void printFusionReport();
+int readRange(const char *string, int base, uint32_t *start, uint32_t *end);
+int startTrace();
+void saveTrace();
+int openJitCache();
+void saveJitCache();
+int startCoverage();
+void saveCoverage();
+#ifdef GBA_CALLPROF
+int startCallProfile();
+void saveCallProfile();
+#endif
+#ifdef GBA_CPU_PROFILE
+void printProfile();
+void requestProfile(int number);
+#endif
 
 int main(int argc, const char **argv) {
     if(readCommandLineArguments(argc, argv)) {
@@ -42,16 +108,79 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
+    if(loadIdleLoops()) {
+        return EXIT_FAILURE;
+    }
+
     if(frontend_init()) {
         return EXIT_FAILURE;
     }
 
+    if(!gba_cpu_setBackend(cpuBackend)) {
+        fprintf(stderr, "The JIT is not available on this host, using the cached interpreter.\n");
+    } else if(cpuBackend == GBA_CPU_BACKEND_JIT && jitCachePath && openJitCache()) {
+        return EXIT_FAILURE;
+    }
+
+    if(jitCachePath && cpuBackend != GBA_CPU_BACKEND_JIT) {
+        fprintf(stderr, "The JIT cache is only used with --jit, ignoring it.
+");
+    }
+
+    gba_cpu_setIdleLoopSkipping(skipIdleLoops);
+    gba_cpu_setPipelineEmulation(emulatePipeline);
+    gba_cpu_setFusion(fuseInstructions);
+
+#ifdef GBA_AOT
+    if(useAotBlocks) {
+        gba_cpu_setAotBlocks(gba_aot_blocks, gba_aot_blockCount);
+    }
+#endif
+
+    if(fusionReport) {
+        atexit(printFusionReport);
+    }
+
+    if(predecodeLimit) {
+        gba_cpu_setPredecodeLimit(predecodeLimit * 1024);
+        atexit(printPredecodeReport);
+    }
+
+    if(tracePath && startTrace()) {
+        return EXIT_FAILURE;
+    }
+
+    if(coveragePath && startCoverage()) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef GBA_CALLPROF
+    if(callProfilePath && startCallProfile()) {
+        return EXIT_FAILURE;
+    }
+#endif
+
+#ifdef GBA_CPU_PROFILE
+    atexit(printProfile);
+
+#ifdef SIGUSR1
+    signal(SIGUSR1, requestProfile);
+#endif
+#endif
+
     gba_init(true);
     gba_setBios(biosBuffer);
     gba_setRom(romBuffer, romBufferSize);
 
     while(true) {
         gba_frameAdvance();
+
+#ifdef GBA_CPU_PROFILE
+        if(profileRequested) {
+            profileRequested = false;
+            printProfile();
+        }
+#endif
     }
 
     frontend_close();
@@ -62,6 +191,18 @@ int main(int argc, const char **argv) {
 int readCommandLineArguments(int argc, const char **argv) {
     bool flag_bios = false;
     bool flag_rom = false;
+    bool flag_idleLoops = false;
+    bool flag_predecode = false;
+    bool flag_trace = false;
+    bool flag_tracePc = false;
+    bool flag_traceFrames = false;
+    bool flag_jitCache = false;
+    bool flag_coverage = false;
+#ifdef GBA_CALLPROF
+    bool flag_callProfile = false;
+    bool flag_callProfileInterval = false;
+    bool flag_callProfileSymbols = false;
+#endif
     
     for(int i = 1; i < argc; i++) {
         if(flag_bios) {
@@ -80,10 +221,89 @@ int readCommandLineArguments(int argc, const char **argv) {
                 romPath = argv[i];
                 flag_rom = false;
             }
+        } else if(flag_idleLoops) {
+            idleLoopsPath = argv[i];
+            skipIdleLoops = true;
+            flag_idleLoops = false;
+        } else if(flag_predecode) {
+            predecodeLimit = strtoul(argv[i], NULL, 10);
+            flag_predecode = false;
+        } else if(flag_trace) {
+            tracePath = argv[i];
+            flag_trace = false;
+        } else if(flag_tracePc) {
+            if(readRange(argv[i], 16, &traceAddressStart, &traceAddressEnd)) {
+                fprintf(stderr, "Invalid address range '%s'.\n", argv[i]);
+                return 1;
+            }
+
+            flag_tracePc = false;
+        } else if(flag_traceFrames) {
+            if(readRange(argv[i], 10, &traceFirstFrame, &traceLastFrame)) {
+                fprintf(stderr, "Invalid frame range '%s'.\n", argv[i]);
+                return 1;
+            }
+
+            flag_traceFrames = false;
+        } else if(flag_jitCache) {
+            jitCachePath = argv[i];
+            flag_jitCache = false;
+        } else if(flag_coverage) {
+            coveragePath = argv[i];
+            flag_coverage = false;
+#ifdef GBA_CALLPROF
+        } else if(flag_callProfile) {
+            callProfilePath = argv[i];
+            flag_callProfile = false;
+        } else if(flag_callProfileInterval) {
+            callProfileInterval = strtoul(argv[i], NULL, 10);
+            flag_callProfileInterval = false;
+        } else if(flag_callProfileSymbols) {
+            callProfileSymbolsPath = argv[i];
+            flag_callProfileSymbols = false;
+#endif
         } else if(strcmp(argv[i], "--bios") == 0) {
             flag_bios = true;
         } else if(strcmp(argv[i], "--rom") == 0) {
             flag_rom = true;
+        } else if(strcmp(argv[i], "--interpreter") == 0) {
+            cpuBackend = GBA_CPU_BACKEND_INTERPRETER;
+        } else if(strcmp(argv[i], "--jit") == 0) {
+            cpuBackend = GBA_CPU_BACKEND_JIT;
+        } else if(strcmp(argv[i], "--jit-cache") == 0) {
+            flag_jitCache = true;
+        } else if(strcmp(argv[i], "--no-pipeline") == 0) {
+            emulatePipeline = false;
+        } else if(strcmp(argv[i], "--no-fusion") == 0) {
+            fuseInstructions = false;
+#ifdef GBA_AOT
+        } else if(strcmp(argv[i], "--no-aot") == 0) {
+            useAotBlocks = false;
+#endif
+        } else if(strcmp(argv[i], "--fusion-report") == 0) {
+            fusionReport = true;
+        } else if(strcmp(argv[i], "--skip-idle-loops") == 0) {
+            skipIdleLoops = true;
+        } else if(strcmp(argv[i], "--idle-loops") == 0) {
+            flag_idleLoops = true;
+        } else if(strcmp(argv[i], "--predecode") == 0) {
+            flag_predecode = true;
+        } else if(strcmp(argv[i], "--trace") == 0) {
+            flag_trace = true;
+        } else if(strcmp(argv[i], "--trace-pc") == 0) {
+            flag_tracePc = true;
+        } else if(strcmp(argv[i], "--trace-frames") == 0) {
+            flag_traceFrames = true;
+        } else if(strcmp(argv[i], "--coverage") == 0) {
+            flag_coverage = true;
+#ifdef GBA_CALLPROF
+        } else if(strcmp(argv[i], "--callprof") == 0) {
+            flag_callProfile = true;
+        } else if(strcmp(argv[i], "--callprof-interval") == 0) {
+            flag_callProfileInterval = true;
+        } else if(strcmp(argv[i], "--callprof-symbols") == 0) {
+            flag_callProfileSymbols = true;
+#endif
         } else if(strcmp(argv[i], "--help") == 0) {
             return 1;
         } else {
@@ -99,16 +319,37 @@ void printHelp() {
     printf("======\n");
     printf("\n");
     printf("Required command-line options:\n");
-    printf("  --bios <bios file name>\n");
     printf("  --rom <rom file name>\n");
     printf("\n");
     printf("Optional command-line options:");
+    printf("  --bios <bios file name> (the BIOS calls are emulated without it)\n");
     printf("  --help\n");
+    printf("  --interpreter\n");
+    printf("  --jit\n");
+    printf("  --jit-cache <directory> (keeps the translated ROM code between runs)\n");
+    printf("  --no-pipeline (the interpreter decodes each instruction when executing it)\n");
+    printf("  --no-fusion (the cached backend executes common Thumb pairs one by one)\n");
+#ifdef GBA_AOT
+    printf("  --no-aot (ignores the ROM code compiled into this build)\n");
+#endif
+    printf("  --fusion-report (counts the fused pairs executed)\n");
+    printf("  --skip-idle-loops\n");
+    printf("  --idle-loops <idle loop list file name>\n");
+    printf("  --predecode <memory limit in KiB> (decodes the ROM code once)\n");
+    printf("  --trace <trace file name> (records the last executed instructions)\n");
+    printf("  --trace-pc <start>-<end> (hexadecimal, the end is excluded)\n");
+    printf("  --trace-frames <first>-<last>\n");
+    printf("  --coverage <coverage file name> (marks the executed code, merged with the file)\n");
+#ifdef GBA_CALLPROF
+    printf("  --callprof <folded stack file name> (samples the call stack of the game)\n");
+    printf("  --callprof-interval <cycles between samples>\n");
+    printf("  --callprof-symbols <linker map or ELF file name>\n");
+#endif
 }
 
 int checkConfiguration() {
-    if(biosPath == NULL) {
-        fprintf(stderr, "No BIOS file path specified.\n");
+    if(romPath == NULL) {
+        fprintf(stderr, "No ROM file path specified.\n");
         return 1;
     }
 
@@ -118,6 +359,10 @@ int checkConfiguration() {
 int loadBios() {
     long fileSize = GBA_BIOS_FILE_SIZE;
 
+    if(biosPath == NULL) {
+        return 0;
+    }
+
     biosBuffer = readFile(biosPath, &fileSize, true);
 
     if(biosBuffer) {
@@ -147,3 +392,225 @@ int loadRom() {
 
     return 0;
 }
+
+// Each line of the idle loop list holds a game code and the address of one of
+// the idle loops of that game.
+int loadIdleLoops() {
+    if(idleLoopsPath == NULL || romBufferSize < 0xb0) {
+        return 0;
+    }
+
+    FILE *file = fopen(idleLoopsPath, "r");
+
+    if(!file) {
+        fprintf(stderr, "Failed to read idle loop list file.\n");
+        return 1;
+    }
+
+    char gameCode[5];
+    unsigned long address;
+
+    while(fscanf(file, "%4s %lx", gameCode, &address) == 2) {
+        if(memcmp(gameCode, (const uint8_t *)romBuffer + 0xac, 4) == 0 && !gba_cpu_addIdleLoop(address)) {
+            fprintf(stderr, "Too many idle loops for this game.\n");
+        }
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+void printPredecodeReport() {
+    printf("Predecoded %d pages of ROM code.\n", gba_cpu_getPredecodedPageCount());
+}
+
+void printFusionReport() {
+    printf("Fused BL halves: %llu\n", (unsigned long long)gba_cpu_fusionCounts[GBA_CPU_FUSION_BL]);
+    printf("Fused CMP and branches: %llu\n", (unsigned long long)gba_cpu_fusionCounts[GBA_CPU_FUSION_CMP_B]);
+    printf("Fused literal loads and BX: %llu\n", (unsigned long long)gba_cpu_fusionCounts[GBA_CPU_FUSION_LDR_BX]);
+}
+
+// Reads "<start>-<end>".
+int readRange(const char *string, int base, uint32_t *start, uint32_t *end) {
+    char *separator;
+    char *last;
+
+    *start = strtoul(string, &separator, base);
+
+    if(*separator != '-') {
+        return 1;
+    }
+
+    *end = strtoul(separator + 1, &last, base);
+
+    if(*last != '\0' || last == separator + 1) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int startTrace() {
+    traceBuffer = malloc(TRACE_BUFFER_SIZE);
+
+    if(traceBuffer == NULL) {
+        fprintf(stderr, "Failed to allocate the trace buffer.\n");
+        return 1;
+    }
+
+    gba_trace_setAddressRange(traceAddressStart, traceAddressEnd);
+    gba_trace_setFrameWindow(traceFirstFrame, traceLastFrame);
+    gba_trace_start(traceBuffer, TRACE_BUFFER_SIZE);
+    atexit(saveTrace);
+
+    return 0;
+}
+
+void saveTrace() {
+    const void *first;
+    const void *second;
+    size_t firstSize;
+    size_t secondSize;
+
+    gba_trace_stop();
+    gba_trace_getData(&first, &firstSize, &second, &secondSize);
+
+    FILE *file = fopen(tracePath, "wb");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the trace file.\n");
+        return;
+    }
+
+    fwrite(GBA_TRACE_SIGNATURE, 1, strlen(GBA_TRACE_SIGNATURE), file);
+    fwrite(first, 1, firstSize, file);
+    fwrite(second, 1, secondSize, file);
+    fclose(file);
+}
+
+// The bitmap of the previous runs is kept, so that the file covers them all.
+int startCoverage() {
+    coverageBitmap = calloc(GBA_COVERAGE_SIZE, 1);
+
+    if(coverageBitmap == NULL) {
+        fprintf(stderr, "Failed to allocate the coverage bitmap.\n");
+        return 1;
+    }
+
+    FILE *file = fopen(coveragePath, "rb");
+
+    if(file) {
+        bool valid = gba_coverage_read(file, coverageBitmap);
+
+        fclose(file);
+
+        if(!valid) {
+            fprintf(stderr, "The coverage file is not valid.\n");
+            return 1;
+        }
+    }
+
+    gba_coverage_start(coverageBitmap);
+    atexit(saveCoverage);
+
+    return 0;
+}
+
+void saveCoverage() {
+    gba_coverage_stop();
+
+    FILE *file = fopen(coveragePath, "wb");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the coverage file.\n");
+        return;
+    }
+
+    if(!gba_coverage_write(file, coverageBitmap)) {
+        fprintf(stderr, "Failed to write the coverage file.\n");
+    }
+
+    fclose(file);
+}
+
+// The cache file is named after the ROM, hashed with FNV-1a, and the build
+// of the emulator, as it is only valid for both.
+int openJitCache() {
+    const uint8_t *bytes = romBuffer;
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for(size_t i = 0; i < romBufferSize; i++) {
+        hash = (hash ^ bytes[i]) * 0x00000100000001b3;
+    }
+
+    int size = snprintf(NULL, 0, "%s/%016llx-%08x.jit", jitCachePath, (unsigned long long)hash, gba_jit_getBuildId());
+    char *fileName = malloc(size + 1);
+
+    if(fileName == NULL) {
+        fprintf(stderr, "Failed to allocate the JIT cache file name.\n");
+        return 1;
+    }
+
+    snprintf(fileName, size + 1, "%s/%016llx-%08x.jit", jitCachePath, (unsigned long long)hash, gba_jit_getBuildId());
+    gba_jit_openCache(fileName, hash);
+    free(fileName);
+    atexit(saveJitCache);
+
+    return 0;
+}
+
+void saveJitCache() {
+    if(!gba_jit_closeCache()) {
+        fprintf(stderr, "Failed to save the JIT cache.\n");
+    }
+}
+
+#ifdef GBA_CALLPROF
+int startCallProfile() {
+    if(callProfileSymbolsPath && loadSymbols(callProfileSymbolsPath)) {
+        fprintf(stderr, "Failed to read the symbol file.\n");
+        return 1;
+    }
+
+    callProfileBuffer = malloc(CALLPROF_BUFFER_SIZE);
+
+    if(callProfileBuffer == NULL) {
+        fprintf(stderr, "Failed to allocate the call tree.\n");
+        return 1;
+    }
+
+    gba_callprof_start(callProfileBuffer, CALLPROF_BUFFER_SIZE, callProfileInterval);
+    atexit(saveCallProfile);
+
+    return 0;
+}
+
+// The folded stacks can be read by flamegraph.pl and most profile viewers.
+void saveCallProfile() {
+    gba_callprof_stop();
+
+    FILE *file = fopen(callProfilePath, "w");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the call profile file.\n");
+        return;
+    }
+
+    gba_callprof_write(file, callProfileSymbolsPath ? formatSymbol : NULL);
+    fclose(file);
+}
+#endif
+
+#ifdef GBA_CPU_PROFILE
+void printProfile() {
+    gba_cpu_printProfile(stderr);
+}
+
+// The report is printed between two frames rather than from the handler.
+void requestProfile(int number) {
+    UNUSED(number);
+
+    profileRequested = true;
+}
+#endif
@@ -0,0 +1,405 @@
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "platform.h"
+#include "core/bus.h"
+#include "core/cpu.h"
+#include "core/defines.h"
+#include "core/disasm.h"
+#include "core/gba.h"
+#include "core/scheduler.h"
+
+#ifdef GBAEMU_OS_UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define CYCLES_PER_FRAME 280896
+#define SYNC_ROUNDS 64
+
+// Commands sent to the instances, besides a cycle to run up to.
+#define COMMAND_SLICE 0
+#define COMMAND_QUIT UINT64_MAX
+
+typedef struct {
+    const char *name;
+    gba_cpu_backend_t backend;
+    bool pipeline;
+} backend_t;
+
+typedef struct {
+    uint64_t cycle;
+    gba_cpu_state_t state;
+    uint32_t writeHash;
+    uint32_t opcode; // At the address of the next instruction
+} report_t;
+
+typedef struct {
+    const backend_t *backend;
+    int commands;
+    int reports;
+    report_t report;
+} instance_t;
+
+static const backend_t backends[] = {
+    {"interpreter", GBA_CPU_BACKEND_INTERPRETER, true},
+    {"no-pipeline", GBA_CPU_BACKEND_INTERPRETER, false},
+    {"cached", GBA_CPU_BACKEND_CACHED, true},
+    {"jit", GBA_CPU_BACKEND_JIT, true}
+};
+
+static const char *const registerNames[16] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc"
+};
+
+const char *biosPath;
+const char *romPath;
+const void *biosBuffer;
+const void *romBuffer;
+size_t romBufferSize;
+unsigned long frames = 60;
+bool instructionSteps;
+const backend_t *selectedBackends[2];
+
+int main(int argc, const char **argv);
+int readCommandLineArguments(int argc, const char **argv);
+void printHelp();
+int loadFiles();
+#ifdef GBAEMU_OS_UNIX
+int startInstance(instance_t *instance);
+void runInstance(const backend_t *backend, int commands, int reports);
+void onStopEvent(uint64_t timestamp);
+int sendCommand(instance_t *instance, uint64_t command);
+bool compareReports(const report_t *a, const report_t *b);
+void printDivergence(instance_t *instances, const report_t *last);
+void disassemble(const report_t *report, char *text);
+#endif
+
+int main(int argc, const char **argv) {
+    if(readCommandLineArguments(argc, argv)) {
+        printHelp();
+        return EXIT_FAILURE;
+    }
+
+    if(loadFiles()) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef GBAEMU_OS_UNIX
+    instance_t instances[2];
+
+    // The core keeps its state in globals, so each instance runs in its own
+    // process.
+    for(int i = 0; i < 2; i++) {
+        instances[i].backend = selectedBackends[i];
+
+        if(startInstance(&instances[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    gba_cpu_init();
+
+    report_t last = instances[0].report;
+    uint64_t limit = (uint64_t)frames * CYCLES_PER_FRAME;
+    bool diverged = false;
+
+    while(!diverged && last.cycle < limit) {
+        if(instructionSteps) {
+            if(sendCommand(&instances[0], last.cycle + 1) || sendCommand(&instances[1], last.cycle + 1)) {
+                return EXIT_FAILURE;
+            }
+        } else if(sendCommand(&instances[0], COMMAND_SLICE) || sendCommand(&instances[1], instances[0].report.cycle)) {
+            return EXIT_FAILURE;
+        }
+
+        // A backend running whole blocks may stop later than the other one,
+        // which then catches up.
+        for(int round = 0; round < SYNC_ROUNDS && instances[0].report.cycle != instances[1].report.cycle; round++) {
+            int late = instances[0].report.cycle < instances[1].report.cycle ? 0 : 1;
+
+            if(sendCommand(&instances[late], instances[1 - late].report.cycle)) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        if(compareReports(&instances[0].report, &instances[1].report)) {
+            last = instances[0].report;
+        } else {
+            printDivergence(instances, &last);
+            diverged = true;
+        }
+    }
+
+    for(int i = 0; i < 2; i++) {
+        sendCommand(&instances[i], COMMAND_QUIT);
+        wait(NULL);
+    }
+
+    if(!diverged) {
+        printf("No divergence in %lu frames.\n", frames);
+    }
+
+    return diverged ? EXIT_FAILURE : EXIT_SUCCESS;
+#else
+    fprintf(stderr, "The lockstep harness is only available on UNIX systems.\n");
+    return EXIT_FAILURE;
+#endif
+}
+
+int readCommandLineArguments(int argc, const char **argv) {
+    bool flag_bios = false;
+    bool flag_rom = false;
+    bool flag_frames = false;
+    int backendCount = 0;
+
+    for(int i = 1; i < argc; i++) {
+        if(flag_bios) {
+            biosPath = argv[i];
+            flag_bios = false;
+        } else if(flag_rom) {
+            romPath = argv[i];
+            flag_rom = false;
+        } else if(flag_frames) {
+            frames = strtoul(argv[i], NULL, 10);
+            flag_frames = false;
+        } else if(strcmp(argv[i], "--bios") == 0) {
+            flag_bios = true;
+        } else if(strcmp(argv[i], "--rom") == 0) {
+            flag_rom = true;
+        } else if(strcmp(argv[i], "--frames") == 0) {
+            flag_frames = true;
+        } else if(strcmp(argv[i], "--instructions") == 0) {
+            instructionSteps = true;
+        } else if(strcmp(argv[i], "--help") == 0) {
+            return 1;
+        } else {
+            const backend_t *backend = NULL;
+
+            for(size_t j = 0; j < sizeof(backends) / sizeof(backends[0]); j++) {
+                if(strcmp(argv[i], backends[j].name) == 0) {
+                    backend = &backends[j];
+                }
+            }
+
+            if(backend == NULL || backendCount == 2) {
+                fprintf(stderr, "Invalid argument '%s'\n", argv[i]);
+                return 1;
+            }
+
+            selectedBackends[backendCount++] = backend;
+        }
+    }
+
+    if(romPath == NULL || backendCount != 2) {
+        return 1;
+    }
+
+    return 0;
+}
+
+void printHelp() {
+    printf("lockstep\n");
+    printf("========\n");
+    printf("\n");
+    printf("Runs a ROM with two backends and stops at the first difference in\n");
+    printf("the registers or in the memory writes.\n");
+    printf("\n");
+    printf("Usage: lockstep --rom <rom file name> <backend> <backend>\n");
+    printf("\n");
+    printf("Backends: interpreter, no-pipeline, cached, jit\n");
+    printf("\n");
+    printf("Optional command-line options:\n");
+    printf("  --bios <bios file name> (the BIOS calls are emulated without it)\n");
+    printf("  --frames <frame count> (60 by default)\n");
+    printf("  --instructions (compares after every instruction instead of every event)\n");
+}
+
+int loadFiles() {
+    if(biosPath) {
+        long fileSize = GBA_BIOS_FILE_SIZE;
+
+        biosBuffer = readFile(biosPath, &fileSize, true);
+
+        if(!biosBuffer || fileSize != GBA_BIOS_FILE_SIZE) {
+            fprintf(stderr, "Failed to read BIOS file.\n");
+            return 1;
+        }
+    }
+
+    long fileSize = GBA_MAX_ROM_FILE_SIZE;
+
+    romBuffer = readFile(romPath, &fileSize, true);
+
+    if(!romBuffer) {
+        fprintf(stderr, "Failed to read ROM file.\n");
+        return 1;
+    }
+
+    romBufferSize = fileSize;
+
+    return 0;
+}
+
+#ifdef GBAEMU_OS_UNIX
+int startInstance(instance_t *instance) {
+    int commands[2];
+    int reports[2];
+
+    if(pipe(commands) || pipe(reports)) {
+        fprintf(stderr, "Failed to create the pipes.\n");
+        return 1;
+    }
+
+    pid_t pid = fork();
+
+    if(pid < 0) {
+        fprintf(stderr, "Failed to start an instance.\n");
+        return 1;
+    }
+
+    if(pid == 0) {
+        close(commands[1]);
+        close(reports[0]);
+        runInstance(instance->backend, commands[0], reports[1]);
+        exit(EXIT_SUCCESS);
+    }
+
+    close(commands[0]);
+    close(reports[1]);
+    instance->commands = commands[1];
+    instance->reports = reports[0];
+
+    // The instance reports its initial state.
+    if(read(instance->reports, &instance->report, sizeof(report_t)) != sizeof(report_t)) {
+        fprintf(stderr, "The %s instance did not start.\n", instance->backend->name);
+        return 1;
+    }
+
+    return 0;
+}
+
+void runInstance(const backend_t *backend, int commands, int reports) {
+    uint64_t command = COMMAND_SLICE;
+
+    if(!gba_cpu_setBackend(backend->backend)) {
+        fprintf(stderr, "The %s backend is not available on this host.\n", backend->name);
+        return;
+    }
+
+    gba_cpu_setPipelineEmulation(backend->pipeline);
+    gba_init(true);
+    gba_setBios(biosBuffer);
+    gba_setRom(romBuffer, romBufferSize);
+    gba_bus_writeHashing = true;
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_STOP, onStopEvent);
+
+    do {
+        if(command == COMMAND_SLICE) {
+            gba_cpu_run();
+            gba_scheduler_processEvents();
+        } else if(gba_scheduler_cycleCounter < command) {
+            gba_scheduler_schedule(GBA_SCHEDULER_EVENT_STOP, command);
+
+            while(gba_scheduler_cycleCounter < command) {
+                gba_cpu_run();
+                gba_scheduler_processEvents();
+            }
+
+            gba_scheduler_cancel(GBA_SCHEDULER_EVENT_STOP);
+        }
+
+        report_t report;
+
+        report.cycle = gba_scheduler_cycleCounter;
+        report.writeHash = gba_bus_writeHash;
+        gba_cpu_getState(&report.state);
+
+        if(report.state.cpsr & (1 << 5)) {
+            report.opcode = gba_bus_peek16(report.state.r[15]) | (gba_bus_peek16(report.state.r[15] + 2) << 16);
+        } else {
+            report.opcode = gba_bus_peek32(report.state.r[15]);
+        }
+
+        if(write(reports, &report, sizeof(report)) != sizeof(report)) {
+            return;
+        }
+    } while(read(commands, &command, sizeof(command)) == sizeof(command) && command != COMMAND_QUIT);
+}
+
+// The event only makes the CPU return.
+void onStopEvent(uint64_t timestamp) {
+    UNUSED(timestamp);
+}
+
+int sendCommand(instance_t *instance, uint64_t command) {
+    if(write(instance->commands, &command, sizeof(command)) != sizeof(command)) {
+        fprintf(stderr, "The %s instance stopped.\n", instance->backend->name);
+        return 1;
+    }
+
+    if(command == COMMAND_QUIT) {
+        return 0;
+    }
+
+    if(read(instance->reports, &instance->report, sizeof(report_t)) != sizeof(report_t)) {
+        fprintf(stderr, "The %s instance stopped.\n", instance->backend->name);
+        return 1;
+    }
+
+    return 0;
+}
+
+bool compareReports(const report_t *a, const report_t *b) {
+    return a->cycle == b->cycle
+        && a->writeHash == b->writeHash
+        && a->state.cpsr == b->state.cpsr
+        && a->state.spsr == b->state.spsr
+        && memcmp(a->state.r, b->state.r, sizeof(a->state.r)) == 0;
+}
+
+void printDivergence(instance_t *instances, const report_t *last) {
+    char text[2][GBA_DISASM_BUFFER_SIZE];
+    const report_t *a = &instances[0].report;
+    const report_t *b = &instances[1].report;
+
+    disassemble(last, text[0]);
+    printf("Divergence between cycles %llu and %llu.\n", (unsigned long long)last->cycle, (unsigned long long)a->cycle);
+    printf("Last common instruction: %08x %s\n", last->state.r[15], text[0]);
+
+    if(!instructionSteps) {
+        printf("Other instructions may have run since, use --instructions to find the first one.\n");
+    }
+
+    printf("\n%-10s %-40s %s\n", "", instances[0].backend->name, instances[1].backend->name);
+    printf("%-10s %-40llu %llu%s\n", "cycle", (unsigned long long)a->cycle, (unsigned long long)b->cycle, a->cycle != b->cycle ? " *" : "");
+
+    for(int i = 0; i < 16; i++) {
+        printf("%-10s %08x%32s %08x%s\n", registerNames[i], a->state.r[i], "", b->state.r[i], a->state.r[i] != b->state.r[i] ? " *" : "");
+    }
+
+    printf("%-10s %08x%32s %08x%s\n", "cpsr", a->state.cpsr, "", b->state.cpsr, a->state.cpsr != b->state.cpsr ? " *" : "");
+    printf("%-10s %08x%32s %08x%s\n", "spsr", a->state.spsr, "", b->state.spsr, a->state.spsr != b->state.spsr ? " *" : "");
+    printf("%-10s %08x%32s %08x%s\n", "writes", a->writeHash, "", b->writeHash, a->writeHash != b->writeHash ? " *" : "");
+
+    disassemble(a, text[0]);
+    disassemble(b, text[1]);
+    printf("%-10s %-40s %s\n", "next", text[0], text[1]);
+}
+
+void disassemble(const report_t *report, char *text) {
+    if(report->state.cpsr & (1 << 5)) {
+        gba_disasm_thumb(report->state.r[15], report->opcode, text);
+    } else {
+        gba_disasm_arm(report->state.r[15], report->opcode, text);
+    }
+}
+#endif
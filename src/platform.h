@@ -33,8 +33,10 @@
 
 #ifdef _MSC_VER
 #define PACKED_STRUCT(__declaration__) __pragma(pack(push, 1)) struct {__declaration__} __pragma(pack(pop))
+#define ALWAYS_INLINE __forceinline
 #elif defined(__GNUC__)
 #define PACKED_STRUCT(__declaration__) struct {__declaration__} __attribute__((packed))
+#define ALWAYS_INLINE inline __attribute__((always_inline))
 #else
 #error Unsupported build environment.
 #endif
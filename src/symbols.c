@@ -0,0 +1,240 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+
+#define SYMBOL_NAME_SIZE 64
+
+// Functions further than this from the previous symbol are printed as
+// addresses.
+#define SYMBOL_MAX_OFFSET 0x10000
+
+typedef struct {
+    uint32_t address;
+    char name[SYMBOL_NAME_SIZE];
+} symbol_t;
+
+symbol_t *symbols;
+size_t symbolCount;
+size_t symbolCapacity;
+
+int loadSymbols(const char *fileName);
+void freeSymbols();
+void formatSymbol(uint32_t address, char *buffer, size_t size);
+static inline int loadElfSymbols(const uint8_t *buffer, size_t size);
+static inline int loadMapSymbols(const char *buffer, size_t size);
+static inline int readMapLine(const char *line);
+static inline int addSymbol(uint32_t address, const char *name, size_t length);
+static inline uint32_t readElf16(const uint8_t *pointer);
+static inline uint32_t readElf32(const uint8_t *pointer);
+static int compareSymbols(const void *left, const void *right);
+
+// Reads the functions of an ELF file, or the symbols of a linker map file.
+int loadSymbols(const char *fileName) {
+    long fileSize = 0;
+    uint8_t *buffer = readFile(fileName, &fileSize, false);
+    int result;
+
+    if(!buffer) {
+        return 1;
+    }
+
+    if(fileSize >= 4 && memcmp(buffer, "\x7f" "ELF", 4) == 0) {
+        result = loadElfSymbols(buffer, fileSize);
+    } else {
+        result = loadMapSymbols((const char *)buffer, fileSize);
+    }
+
+    free(buffer);
+
+    if(result == 0) {
+        qsort(symbols, symbolCount, sizeof(symbol_t), compareSymbols);
+    }
+
+    return result;
+}
+
+void freeSymbols() {
+    free(symbols);
+    symbols = NULL;
+    symbolCount = 0;
+    symbolCapacity = 0;
+}
+
+// Names the address after the closest symbol at or before it.
+void formatSymbol(uint32_t address, char *buffer, size_t size) {
+    size_t low = 0;
+    size_t high = symbolCount;
+
+    while(low < high) {
+        size_t middle = (low + high) / 2;
+
+        if(symbols[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if(low == 0 || address - symbols[low - 1].address >= SYMBOL_MAX_OFFSET) {
+        snprintf(buffer, size, "0x%08x", address);
+    } else if(address == symbols[low - 1].address) {
+        snprintf(buffer, size, "%s", symbols[low - 1].name);
+    } else {
+        snprintf(buffer, size, "%s+0x%x", symbols[low - 1].name, address - symbols[low - 1].address);
+    }
+}
+
+// Only 32-bit little-endian files are supported, as built for the GBA.
+static inline int loadElfSymbols(const uint8_t *buffer, size_t size) {
+    if(size < 0x34 || buffer[4] != 1 || buffer[5] != 1) {
+        fprintf(stderr, "Only 32-bit little-endian ELF files are supported.\n");
+        return 1;
+    }
+
+    uint32_t sectionOffset = readElf32(buffer + 0x20);
+    uint32_t sectionSize = readElf16(buffer + 0x2e);
+    uint32_t sectionCount = readElf16(buffer + 0x30);
+
+    if(sectionSize < 0x28 || sectionOffset > size || sectionCount > (size - sectionOffset) / sectionSize) {
+        fprintf(stderr, "The ELF file is truncated.\n");
+        return 1;
+    }
+
+    for(uint32_t i = 0; i < sectionCount; i++) {
+        const uint8_t *section = buffer + sectionOffset + i * sectionSize;
+
+        // SHT_SYMTAB
+        if(readElf32(section + 4) != 2) {
+            continue;
+        }
+
+        uint32_t offset = readElf32(section + 16);
+        uint32_t tableSize = readElf32(section + 20);
+        uint32_t link = readElf32(section + 24);
+
+        if(link >= sectionCount || offset > size || tableSize > size - offset) {
+            continue;
+        }
+
+        const uint8_t *strings = buffer + sectionOffset + link * sectionSize;
+        uint32_t stringOffset = readElf32(strings + 16);
+        uint32_t stringSize = readElf32(strings + 20);
+
+        if(stringOffset > size || stringSize > size - stringOffset) {
+            continue;
+        }
+
+        for(uint32_t j = 0; j + 16 <= tableSize; j += 16) {
+            const uint8_t *symbol = buffer + offset + j;
+            uint32_t name = readElf32(symbol);
+            int type = symbol[12] & 0x0f;
+
+            // Functions, and the labels of assembly code, except the mapping
+            // symbols ($a, $t and $d) and the undefined symbols.
+            if((type != 2 && type != 0) || readElf16(symbol + 14) == 0 || name >= stringSize) {
+                continue;
+            }
+
+            const char *string = (const char *)buffer + stringOffset + name;
+            const char *end = memchr(string, '\0', stringSize - name);
+
+            if(end == NULL || end == string || string[0] == '$') {
+                continue;
+            }
+
+            if(addSymbol(readElf32(symbol + 4) & 0xfffffffe, string, end - string)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static inline int loadMapSymbols(const char *buffer, size_t size) {
+    char line[256];
+    size_t length = 0;
+
+    for(size_t i = 0; i <= size; i++) {
+        if(i == size || buffer[i] == '\n') {
+            line[length] = '\0';
+            length = 0;
+
+            if(readMapLine(line)) {
+                return 1;
+            }
+        } else if(length < sizeof(line) - 1) {
+            line[length++] = buffer[i];
+        }
+    }
+
+    return 0;
+}
+
+// The symbols are the lines holding only an address and a name, as in the
+// maps written by GNU ld ("0x08000120    main") or in .sym files.
+static inline int readMapLine(const char *line) {
+    char address[32];
+    char name[SYMBOL_NAME_SIZE];
+    char extra;
+    char *last;
+
+    if(sscanf(line, "%31s %63s %c", address, name, &extra) != 2) {
+        return 0;
+    }
+
+    uint32_t value = strtoul(address, &last, 16);
+
+    if(*last != '\0' || !(isalpha((unsigned char)name[0]) || name[0] == '_' || name[0] == '.')) {
+        return 0;
+    }
+
+    return addSymbol(value & 0xfffffffe, name, strlen(name));
+}
+
+static inline int addSymbol(uint32_t address, const char *name, size_t length) {
+    if(symbolCount == symbolCapacity) {
+        size_t capacity = symbolCapacity ? symbolCapacity * 2 : 1024;
+        symbol_t *buffer = realloc(symbols, capacity * sizeof(symbol_t));
+
+        if(!buffer) {
+            fprintf(stderr, "Failed to allocate the symbol table.\n");
+            return 1;
+        }
+
+        symbols = buffer;
+        symbolCapacity = capacity;
+    }
+
+    if(length >= SYMBOL_NAME_SIZE) {
+        length = SYMBOL_NAME_SIZE - 1;
+    }
+
+    symbols[symbolCount].address = address;
+    memcpy(symbols[symbolCount].name, name, length);
+    symbols[symbolCount].name[length] = '\0';
+    symbolCount++;
+
+    return 0;
+}
+
+static inline uint32_t readElf16(const uint8_t *pointer) {
+    return pointer[0] | (pointer[1] << 8);
+}
+
+static inline uint32_t readElf32(const uint8_t *pointer) {
+    return pointer[0] | (pointer[1] << 8) | (pointer[2] << 16) | ((uint32_t)pointer[3] << 24);
+}
+
+static int compareSymbols(const void *left, const void *right) {
+    uint32_t leftAddress = ((const symbol_t *)left)->address;
+    uint32_t rightAddress = ((const symbol_t *)right)->address;
+
+    return (leftAddress > rightAddress) - (leftAddress < rightAddress);
+}
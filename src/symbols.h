@@ -0,0 +1,11 @@
+#ifndef __SYMBOLS_H__
+#define __SYMBOLS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+int loadSymbols(const char *fileName);
+void freeSymbols();
+void formatSymbol(uint32_t address, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,114 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/cpu.h"
+#include "core/disasm.h"
+#include "core/trace.h"
+
+int main(int argc, const char **argv);
+uint32_t read32(const uint8_t *pointer);
+void printRecord(const uint8_t *record);
+
+int main(int argc, const char **argv) {
+    if(argc != 2) {
+        fprintf(stderr, "Usage: %s <trace file name>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+
+    if(file == NULL) {
+        fprintf(stderr, "Failed to open the trace file.\n");
+        return EXIT_FAILURE;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *buffer = malloc(fileSize);
+
+    if(buffer == NULL || fread(buffer, 1, fileSize, file) != (size_t)fileSize) {
+        fprintf(stderr, "Failed to read the trace file.\n");
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    fclose(file);
+
+    size_t signatureSize = strlen(GBA_TRACE_SIGNATURE);
+
+    if((size_t)fileSize < signatureSize || memcmp(buffer, GBA_TRACE_SIGNATURE, signatureSize)) {
+        fprintf(stderr, "This is not a trace file.\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t offset = signatureSize;
+
+    gba_cpu_init();
+
+    while(offset + 3 <= (size_t)fileSize) {
+        size_t length = gba_trace_getRecordLength(buffer + offset);
+
+        if(offset + length > (size_t)fileSize) {
+            fprintf(stderr, "The last record is truncated.\n");
+            break;
+        }
+
+        printRecord(buffer + offset);
+        offset += length;
+    }
+
+    free(buffer);
+
+    return EXIT_SUCCESS;
+}
+
+uint32_t read32(const uint8_t *pointer) {
+    return pointer[0] | (pointer[1] << 8) | (pointer[2] << 16) | ((uint32_t)pointer[3] << 24);
+}
+
+// Only the registers that changed since the previous record are printed.
+void printRecord(const uint8_t *record) {
+    uint8_t header = record[0];
+    uint16_t mask = record[1] | (record[2] << 8);
+    uint32_t address = read32(record + 3);
+    const uint8_t *pointer = record + 7;
+    char text[GBA_DISASM_BUFFER_SIZE];
+
+    if(header & GBA_TRACE_HEADER_THUMB) {
+        uint16_t opcode = pointer[0] | (pointer[1] << 8);
+
+        gba_disasm_thumb(address, opcode, text);
+        printf("%08x     %04x ", address, opcode);
+        pointer += 2;
+    } else {
+        uint32_t opcode = read32(pointer);
+
+        gba_disasm_arm(address, opcode, text);
+        printf("%08x %08x ", address, opcode);
+        pointer += 4;
+    }
+
+    printf(
+        "%c%c%c%c%c%c",
+        (header & GBA_TRACE_HEADER_N) ? 'N' : '-',
+        (header & GBA_TRACE_HEADER_Z) ? 'Z' : '-',
+        (header & GBA_TRACE_HEADER_C) ? 'C' : '-',
+        (header & GBA_TRACE_HEADER_V) ? 'V' : '-',
+        (header & GBA_TRACE_HEADER_I) ? 'I' : '-',
+        (header & GBA_TRACE_HEADER_THUMB) ? 'T' : '-'
+    );
+
+    for(int i = 0; i < 15; i++) {
+        if(mask & (1 << i)) {
+            printf(" r%d=%08x", i, read32(pointer));
+            pointer += 4;
+        }
+    }
+
+    printf(" ; %s\n", text);
+}
@@ -2,7 +2,13 @@
 #include <stdlib.h>
 
 #include "libtest.h"
+#include "test_callprof.h"
+#include "test_coverage.h"
+#include "test_cpu.h"
+#include "test_disasm.h"
 #include "test_dummy.h"
+#include "test_hle.h"
+#include "test_scheduler.h"
 
 #include "platform.h"
 
@@ -13,6 +19,36 @@ int main(int argc, const char **argv) {
     libtest_start();
 
     test_dummy();
+    test_callprof_folded();
+    test_coverage_merge();
+    test_cpu_backendsAgree();
+    test_cpu_stateAgrees();
+    test_cpu_pipelineFree();
+    test_cpu_trace();
+    test_cpu_traceKeyframes();
+    test_cpu_blockTransfer();
+    test_cpu_selfModifyingCode();
+    test_cpu_jitAgrees();
+    test_cpu_jitCache();
+    test_cpu_aot();
+#ifdef GBA_AOT_TEST_ROM
+    test_cpu_aotRom();
+#endif
+    test_cpu_coverage();
+    test_cpu_flags();
+    test_cpu_thumb();
+    test_cpu_fusion();
+    test_cpu_waitStates();
+    test_cpu_predecode();
+    test_cpu_idleLoop();
+    test_cpu_halt();
+    test_cpu_irqMidBlock();
+    test_cpu_keypadWakeup();
+    test_disasm_formats();
+    test_hle_div();
+    test_hle_lz77UnComp();
+    test_scheduler_order();
+    test_scheduler_rescheduleAndCancel();
     
     libtest_finish();
 
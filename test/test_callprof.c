@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libtest.h"
+#include "core/callprof.h"
+#include "core/scheduler.h"
+
+/* Description: The call path is sampled at every interval and written as
+ * folded stacks, returns matching the address after a call.
+ */
+void test_callprof_folded() {
+    BEGIN_TEST_CASE;
+
+    static uint64_t buffer[1024];
+    char text[256];
+
+    gba_scheduler_cycleCounter = 0;
+    gba_callprof_start(buffer, sizeof(buffer), 100);
+
+    gba_scheduler_cycleCounter = 250;
+    gba_callprof_call(0x08000100, 0x08000010);
+    gba_scheduler_cycleCounter = 520;
+    gba_callprof_call(0x08000200, 0x08000104);
+    gba_scheduler_cycleCounter = 700;
+    gba_callprof_return(0x08000104);
+    gba_callprof_return(0x12345678);
+
+    ASSERT(gba_callprof_getDepth() == 1, "A jump was taken for a return.");
+
+    gba_scheduler_cycleCounter = 800;
+    gba_callprof_return(0x08000011);
+    gba_scheduler_cycleCounter = 1000;
+    gba_callprof_stop();
+
+    ASSERT(gba_callprof_getDepth() == 0, "The return to Thumb code was missed.");
+
+    FILE *file = tmpfile();
+
+    ASSERT(file != NULL, "The temporary file could not be created.");
+
+    gba_callprof_write(file, NULL);
+    rewind(file);
+    size_t size = fread(text, 1, sizeof(text) - 1, file);
+    text[size] = '\0';
+    fclose(file);
+
+    ASSERT(strcmp(text, "[root] 4\n0x08000100 4\n0x08000100;0x08000200 2\n") == 0, "The folded stacks are wrong.");
+
+    END_TEST_CASE;
+}
@@ -0,0 +1,6 @@
+#ifndef __TEST_CALLPROF__
+#define __TEST_CALLPROF__
+
+extern void test_callprof_folded();
+
+#endif
@@ -0,0 +1,46 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libtest.h"
+#include "core/coverage.h"
+
+/* Description: Marked ranges set one bit per halfword, mirrors included,
+ * and a saved bitmap is merged into the bits already set.
+ */
+void test_coverage_merge() {
+    BEGIN_TEST_CASE;
+
+    static uint8_t first[GBA_COVERAGE_SIZE];
+    static uint8_t second[GBA_COVERAGE_SIZE];
+
+    gba_coverage_start(first);
+    gba_coverage_mark(0x08000002, 0x08000016);
+    gba_coverage_mark(0x03007ffc, 0x03008004);
+    gba_coverage_mark(0x04000000, 0x04000010);
+    gba_coverage_stop();
+
+    ASSERT(!gba_coverage_isCovered(first, 0x08000000), "A halfword before the range was marked.");
+    ASSERT(gba_coverage_isCovered(first, 0x0a000002) && gba_coverage_isCovered(first, 0x08000014), "The range was not marked.");
+    ASSERT(!gba_coverage_isCovered(first, 0x08000016), "A halfword after the range was marked.");
+    ASSERT(gba_coverage_count(first, 0, GBA_COVERAGE_SIZE) == 12, "The range was not clipped to its region.");
+
+    gba_coverage_start(second);
+    gba_coverage_mark(0x02000000, 0x02000004);
+    gba_coverage_mark(0x08000000, 0x08000004);
+    gba_coverage_stop();
+
+    FILE *file = tmpfile();
+
+    ASSERT(file != NULL, "The temporary file could not be created.");
+    ASSERT(gba_coverage_write(file, first), "The bitmap was not written.");
+    rewind(file);
+    ASSERT(gba_coverage_read(file, second), "The bitmap was not read.");
+    fclose(file);
+
+    ASSERT(gba_coverage_isCovered(second, 0x02040002) && gba_coverage_isCovered(second, 0x08000000), "The bits already set were lost.");
+    ASSERT(gba_coverage_count(second, GBA_COVERAGE_OFFSET_ROM, GBA_COVERAGE_SIZE - GBA_COVERAGE_OFFSET_ROM) == 11, "The ROM bits were not merged.");
+    ASSERT(gba_coverage_count(second, 0, GBA_COVERAGE_SIZE) == 15, "The bitmaps were not merged.");
+
+    END_TEST_CASE;
+}
@@ -0,0 +1,6 @@
+#ifndef __TEST_COVERAGE__
+#define __TEST_COVERAGE__
+
+extern void test_coverage_merge();
+
+#endif
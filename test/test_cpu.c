@@ -0,0 +1,977 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libtest.h"
+#include "core/bus.h"
+#include "core/coverage.h"
+#include "core/cpu.h"
+#include "core/defines.h"
+#include "core/gba.h"
+#include "core/jit.h"
+#include "core/keypad.h"
+#include "core/scheduler.h"
+#include "core/trace.h"
+
+static uint32_t test_cpu_bios[GBA_BIOS_FILE_SIZE / 4];
+static uint32_t test_cpu_rom[1024];
+
+// Boots a ROM that jumps to a counting loop in EWRAM. The loop stores its
+// counter at 0x02000100 on every iteration.
+static void test_cpu_boot(gba_cpu_backend_t backend) {
+    test_cpu_rom[0] = 0xe3a0e402; // mov lr, #0x02000000
+    test_cpu_rom[1] = 0xe12fff1e; // bx lr
+
+    gba_cpu_setBackend(backend);
+    gba_init(true);
+    gba_setBios(test_cpu_bios);
+    gba_setRom(test_cpu_rom, sizeof(test_cpu_rom));
+
+    gba_bus_write32(0x02000000, 0xe2800001); // add r0, r0, #1
+    gba_bus_write32(0x02000004, 0xe58e0100); // str r0, [lr, #0x100]
+    gba_bus_write32(0x02000008, 0xeafffffc); // b 0x02000000
+}
+
+static void test_cpu_runEvents(int count) {
+    for(int i = 0; i < count; i++) {
+        gba_cpu_run();
+        gba_scheduler_processEvents();
+    }
+}
+
+/* Description: The interpreter and the cached backend execute the same
+ * number of instructions in the same number of cycles.
+ */
+void test_cpu_backendsAgree() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+    test_cpu_runEvents(16);
+    uint32_t interpreterCount = gba_bus_read32(0x02000100);
+    uint64_t interpreterCycles = gba_scheduler_cycleCounter;
+
+    test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+    test_cpu_runEvents(16);
+    uint32_t cachedCount = gba_bus_read32(0x02000100);
+    uint64_t cachedCycles = gba_scheduler_cycleCounter;
+
+    ASSERT(interpreterCount != 0, "The test program did not run.");
+    ASSERT(interpreterCount == cachedCount, "The backends executed a different number of instructions.");
+    ASSERT(interpreterCycles == cachedCycles, "The backends stopped at different cycles.");
+
+    END_TEST_CASE;
+}
+
+/* Description: The backends stopped at the same cycle report the same
+ * architectural state and the same memory writes, whatever their pipeline
+ * state.
+ */
+void test_cpu_stateAgrees() {
+    BEGIN_TEST_CASE;
+
+    gba_cpu_state_t states[2];
+    uint32_t hashes[2];
+
+    for(int i = 0; i < 2; i++) {
+        test_cpu_boot(i ? GBA_CPU_BACKEND_CACHED : GBA_CPU_BACKEND_INTERPRETER);
+        gba_bus_writeHashing = true;
+        gba_bus_writeHash = 0;
+        test_cpu_runEvents(16);
+        gba_bus_writeHashing = false;
+        gba_cpu_getState(&states[i]);
+        hashes[i] = gba_bus_writeHash;
+    }
+
+    ASSERT(hashes[0] != 0, "The writes were not hashed.");
+    ASSERT(hashes[0] == hashes[1], "The backends wrote different values.");
+    ASSERT(states[0].r[15] >= 0x02000000 && states[0].r[15] < 0x0200000c, "The address of the next instruction is outside of the loop.");
+    ASSERT(memcmp(&states[0], &states[1], sizeof(gba_cpu_state_t)) == 0, "The backends reported different states.");
+
+    END_TEST_CASE;
+}
+
+/* Description: The interpreter behaves the same without emulating the
+ * pipeline stages.
+ */
+void test_cpu_pipelineFree() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+    test_cpu_runEvents(16);
+    uint32_t pipelineCount = gba_bus_read32(0x02000100);
+    uint64_t pipelineCycles = gba_scheduler_cycleCounter;
+
+    gba_cpu_setPipelineEmulation(false);
+    test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+    test_cpu_runEvents(16);
+
+    ASSERT(gba_bus_read32(0x02000100) == pipelineCount, "A different number of instructions was executed.");
+    ASSERT(gba_scheduler_cycleCounter == pipelineCycles, "The interpreter stopped at a different cycle.");
+
+    gba_cpu_setPipelineEmulation(true);
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+/* Description: Tracing runs the instructions in the address range through
+ * the interpreter, recording the changed registers, and keeps the newest
+ * records once the buffer is full.
+ */
+void test_cpu_trace() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+    test_cpu_runEvents(16);
+    uint64_t interpreterCycles = gba_scheduler_cycleCounter;
+
+    static uint8_t buffer[256];
+    const void *first;
+    const void *second;
+    size_t firstSize;
+    size_t secondSize;
+
+    test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+    gba_trace_setAddressRange(0x02000000, 0x02000004);
+    gba_trace_start(buffer, sizeof(buffer));
+    test_cpu_runEvents(16);
+    gba_trace_stop();
+    gba_trace_setAddressRange(0, UINT32_MAX);
+    gba_trace_getData(&first, &firstSize, &second, &secondSize);
+
+    ASSERT(gba_scheduler_cycleCounter == interpreterCycles, "Tracing changed the timing.");
+    ASSERT(firstSize + secondSize > sizeof(buffer) / 4, "The buffer was not filled.");
+
+    // Every record is the add instruction, which only changes r0, unless it
+    // is a keyframe holding every register.
+    uint32_t r0 = 0;
+
+    for(int part = 0; part < 2; part++) {
+        const uint8_t *record = part ? second : first;
+        size_t size = part ? secondSize : firstSize;
+
+        for(size_t offset = 0; offset < size; offset += gba_trace_getRecordLength(record + offset)) {
+            uint16_t mask = record[offset + 1] | (record[offset + 2] << 8);
+            uint32_t address = record[offset + 3] | (record[offset + 4] << 8) | (record[offset + 5] << 16) | (record[offset + 6] << 24);
+            uint32_t value = record[offset + 11] | (record[offset + 12] << 8) | (record[offset + 13] << 16) | (record[offset + 14] << 24);
+
+            ASSERT(address == 0x02000000, "An instruction outside of the range was recorded.");
+            ASSERT(mask == 0x0001 || mask == 0x7fff, "The changed registers were not recorded.");
+            ASSERT(r0 == 0 || value == r0 + 1, "The records are out of order.");
+
+            r0 = value;
+        }
+    }
+
+    ASSERT(r0 == gba_bus_read32(0x02000100) || r0 == gba_bus_read32(0x02000100) + 1, "The newest records were not kept.");
+
+    END_TEST_CASE;
+}
+
+/* Description: Once the trace buffer wraps around, the oldest record kept
+ * is a keyframe holding every register, from which the registers can be
+ * rebuilt up to the newest record.
+ */
+void test_cpu_traceKeyframes() {
+    BEGIN_TEST_CASE;
+
+    static uint8_t buffer[1024];
+    const void *first;
+    const void *second;
+    size_t firstSize;
+    size_t secondSize;
+    uint32_t registers[15] = {0};
+
+    test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+    gba_trace_start(buffer, sizeof(buffer));
+    test_cpu_runEvents(16);
+    gba_trace_stop();
+    gba_trace_getData(&first, &firstSize, &second, &secondSize);
+
+    const uint8_t *oldest = first;
+    uint32_t oldestR0 = oldest[11] | (oldest[12] << 8) | (oldest[13] << 16) | (oldest[14] << 24);
+
+    ASSERT(firstSize != 0, "Nothing was recorded.");
+    ASSERT(oldestR0 > 1, "The buffer did not wrap around.");
+    ASSERT((oldest[1] | (oldest[2] << 8)) == 0x7fff, "The oldest record is not a keyframe.");
+
+    for(int part = 0; part < 2; part++) {
+        const uint8_t *record = part ? second : first;
+        size_t size = part ? secondSize : firstSize;
+
+        for(size_t offset = 0; offset < size; offset += gba_trace_getRecordLength(record + offset)) {
+            uint16_t mask = record[offset + 1] | (record[offset + 2] << 8);
+            const uint8_t *value = record + offset + ((record[offset] & GBA_TRACE_HEADER_THUMB) ? 9 : 11);
+
+            for(int i = 0; i < 15; i++) {
+                if(mask & (1 << i)) {
+                    registers[i] = value[0] | (value[1] << 8) | (value[2] << 16) | (value[3] << 24);
+                    value += 4;
+                }
+            }
+        }
+    }
+
+    ASSERT(memcmp(registers, gba_cpu_r, sizeof(registers)) == 0, "The registers could not be rebuilt from the trace.");
+
+    END_TEST_CASE;
+}
+
+/* Description: The JIT, when available, executes the same number of
+ * instructions in the same number of cycles as the interpreter.
+ */
+void test_cpu_jitAgrees() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+    test_cpu_runEvents(16);
+    uint32_t interpreterCount = gba_bus_read32(0x02000100);
+    uint64_t interpreterCycles = gba_scheduler_cycleCounter;
+
+    if(gba_cpu_setBackend(GBA_CPU_BACKEND_JIT)) {
+        test_cpu_boot(GBA_CPU_BACKEND_JIT);
+        test_cpu_runEvents(16);
+
+        ASSERT(gba_bus_read32(0x02000100) == interpreterCount, "The JIT executed a different number of instructions.");
+        ASSERT(gba_scheduler_cycleCounter == interpreterCycles, "The JIT stopped at a different cycle.");
+
+        test_cpu_runEvents(4);
+        gba_bus_write32(0x02000000, 0xe3a00055); // mov r0, #0x55
+        test_cpu_runEvents(1);
+
+        ASSERT(gba_bus_read32(0x02000100) == 0x55, "The JIT executed overwritten code.");
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+/* Description: The JIT cache saves the blocks translated from ROM, and a
+ * later run using it finds them instead of translating them again, while
+ * executing the same instructions. A cache saved for another ROM or by
+ * another build is not loaded.
+ */
+void test_cpu_jitCache() {
+    BEGIN_TEST_CASE;
+
+    static const char fileName[] = "test_cpu_jitCache.jit";
+    bool loaded[2];
+    uint64_t hits[2];
+    uint32_t counts[2];
+    uint64_t cycles[2];
+
+    if(gba_cpu_setBackend(GBA_CPU_BACKEND_JIT)) {
+        remove(fileName);
+
+        for(int i = 0; i < 2; i++) {
+            test_cpu_boot(GBA_CPU_BACKEND_JIT);
+
+            test_cpu_rom[0] = 0xe3a01402; // mov r1, #0x02000000
+            test_cpu_rom[1] = 0xe2800001; // add r0, r0, #1
+            test_cpu_rom[2] = 0xe5810100; // str r0, [r1, #0x100]
+            test_cpu_rom[3] = 0xeafffffc; // b 0x08000004
+
+            loaded[i] = gba_jit_openCache(fileName, 0x0123456789abcdef);
+            hits[i] = gba_jit_cacheHits;
+            test_cpu_runEvents(16);
+            hits[i] = gba_jit_cacheHits - hits[i];
+            counts[i] = gba_bus_read32(0x02000100);
+            cycles[i] = gba_scheduler_cycleCounter;
+
+            ASSERT(gba_jit_closeCache(), "The cache was not saved.");
+        }
+
+        ASSERT(!loaded[0] && loaded[1], "The saved cache was not loaded.");
+        ASSERT(hits[0] == 0 && hits[1] != 0, "The loaded blocks were not used.");
+        ASSERT(counts[0] != 0 && counts[0] == counts[1], "The loaded blocks executed a different number of instructions.");
+        ASSERT(cycles[0] == cycles[1], "The loaded blocks stopped at a different cycle.");
+
+        // The build ID follows the signature in the header.
+        FILE *file = fopen(fileName, "r+b");
+        uint32_t buildId = gba_jit_getBuildId() ^ 1;
+
+        if(file) {
+            fseek(file, 8, SEEK_SET);
+            fwrite(&buildId, sizeof(buildId), 1, file);
+            fclose(file);
+        }
+
+        ASSERT(file != NULL, "The saved cache could not be modified.");
+        ASSERT(!gba_jit_openCache(fileName, 0x0123456789abcdef), "The cache of another build was loaded.");
+
+        gba_jit_closeCache();
+
+        ASSERT(!gba_jit_openCache(fileName, 0xfedcba9876543210), "The cache of another ROM was loaded.");
+
+        gba_jit_closeCache();
+        remove(fileName);
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+static int test_cpu_aotCalls;
+
+static void test_cpu_aotBlock(uint32_t cycles) {
+    (void)cycles;
+
+    test_cpu_aotCalls++;
+
+    if(gba_cpu_jitInterpretArm(0xe2800001) && gba_cpu_jitInterpretArm(0xe5810100)) {
+        gba_cpu_jitInterpretArm(0xeafffffc);
+    }
+}
+
+/* Description: A block compiled ahead of time replaces the cached block at
+ * the same address when the opcodes match its hash, while executing the
+ * same instructions, and is ignored otherwise.
+ */
+void test_cpu_aot() {
+    BEGIN_TEST_CASE;
+
+    gba_cpu_aotBlock_t blocks[] = {
+        {0x08000004, false, 3, 0, test_cpu_aotBlock}
+    };
+
+    int calls[3];
+    uint32_t counts[3];
+    uint64_t cycles[3];
+
+    for(int i = 0; i < 3; i++) {
+        test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+
+        test_cpu_rom[0] = 0xe3a01402; // mov r1, #0x02000000
+        test_cpu_rom[1] = 0xe2800001; // add r0, r0, #1
+        test_cpu_rom[2] = 0xe5810100; // str r0, [r1, #0x100]
+        test_cpu_rom[3] = 0xeafffffc; // b 0x08000004
+
+        blocks[0].hash = gba_cpu_hashAotBlock((const uint8_t *)&test_cpu_rom[1], 12) + (i == 2);
+        gba_cpu_setAotBlocks(blocks, i ? 1 : 0);
+        test_cpu_aotCalls = 0;
+        test_cpu_runEvents(16);
+        calls[i] = test_cpu_aotCalls;
+        counts[i] = gba_bus_read32(0x02000100);
+        cycles[i] = gba_scheduler_cycleCounter;
+    }
+
+    gba_cpu_setAotBlocks(NULL, 0);
+
+    ASSERT(calls[0] == 0 && calls[1] != 0, "The compiled block was not used.");
+    ASSERT(calls[2] == 0, "The compiled block was used with a different hash.");
+    ASSERT(counts[0] != 0 && counts[0] == counts[1], "The compiled block executed a different number of instructions.");
+    ASSERT(cycles[0] == cycles[1], "The compiled block stopped at a different cycle.");
+
+    END_TEST_CASE;
+}
+
+#ifdef GBA_AOT_TEST_ROM
+extern const gba_cpu_aotBlock_t gba_aot_blocks[];
+extern const size_t gba_aot_blockCount;
+
+/* Description: The blocks gbaaot compiled from the test ROM leave the CPU
+ * state, the cycle counter and the memory as the cached backend does.
+ */
+void test_cpu_aotRom() {
+    BEGIN_TEST_CASE;
+
+    static uint8_t rom[4096];
+    gba_cpu_state_t states[2];
+    uint64_t cycles[2];
+    uint32_t memory[2][64];
+    uint64_t hits;
+
+    FILE *file = fopen(GBA_AOT_TEST_ROM, "rb");
+    size_t size = 0;
+
+    if(file != NULL) {
+        size = fread(rom, 1, sizeof(rom), file);
+        fclose(file);
+    }
+
+    ASSERT(size != 0, "The test ROM could not be read.");
+
+    for(int i = 0; i < 2; i++) {
+        gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+        gba_init(true);
+        gba_setBios(test_cpu_bios);
+        gba_setRom(rom, sizeof(rom));
+        gba_cpu_setAotBlocks(i ? gba_aot_blocks : NULL, i ? gba_aot_blockCount : 0);
+        test_cpu_runEvents(64);
+
+        gba_cpu_getState(&states[i]);
+        cycles[i] = gba_scheduler_cycleCounter;
+
+        for(int j = 0; j < 64; j++) {
+            memory[i][j] = gba_bus_read32(0x02000000 + j * 4);
+        }
+    }
+
+    hits = gba_cpu_aotHits;
+    gba_cpu_setAotBlocks(NULL, 0);
+
+    ASSERT(memory[0][0] != 0, "The test ROM did not run.");
+    ASSERT(hits != 0, "The compiled blocks were not used.");
+    ASSERT(memcmp(&states[0], &states[1], sizeof(gba_cpu_state_t)) == 0, "The compiled blocks left a different CPU state.");
+    ASSERT(cycles[0] == cycles[1], "The compiled blocks stopped at a different cycle.");
+    ASSERT(memcmp(memory[0], memory[1], sizeof(memory[0])) == 0, "The compiled blocks left different memory contents.");
+
+    END_TEST_CASE;
+}
+#endif
+
+/* Description: The backends mark the same executed instructions in the
+ * coverage bitmap, leaving out the ones a taken branch skipped, even in
+ * the middle of a cached block.
+ */
+void test_cpu_coverage() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe2800001, // add r0, r0, #1
+        0xe3500000, // cmp r0, #0
+        0x1a000001, // bne 0x02000014
+        0xe2822001, // add r2, r2, #1
+        0xe2822001, // add r2, r2, #1
+        0xe58e0100, // str r0, [lr, #0x100]
+        0xeafffff8  // b 0x02000000
+    };
+
+    static uint8_t bitmaps[3][GBA_COVERAGE_SIZE];
+
+    gba_cpu_backend_t backends[] = {
+        GBA_CPU_BACKEND_INTERPRETER,
+        GBA_CPU_BACKEND_CACHED,
+        GBA_CPU_BACKEND_JIT
+    };
+
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if(!gba_cpu_setBackend(backends[i])) {
+            memcpy(bitmaps[i], bitmaps[1], GBA_COVERAGE_SIZE);
+            continue;
+        }
+
+        test_cpu_boot(backends[i]);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        memset(bitmaps[i], 0, GBA_COVERAGE_SIZE);
+        gba_coverage_start(bitmaps[i]);
+        test_cpu_runEvents(4);
+        gba_coverage_stop();
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    ASSERT(gba_coverage_isCovered(bitmaps[1], 0x08000000) && gba_coverage_isCovered(bitmaps[1], 0x08000006), "The ROM code was not marked.");
+    ASSERT(gba_coverage_isCovered(bitmaps[1], 0x0200000a) && gba_coverage_isCovered(bitmaps[1], 0x02000018), "The loop was not marked.");
+    ASSERT(!gba_coverage_isCovered(bitmaps[1], 0x0200000c) && !gba_coverage_isCovered(bitmaps[1], 0x02000012), "The skipped instructions were marked.");
+    ASSERT(gba_coverage_count(bitmaps[1], 0, GBA_COVERAGE_SIZE) == 14, "Other halfwords were marked.");
+    ASSERT(memcmp(bitmaps[0], bitmaps[1], GBA_COVERAGE_SIZE) == 0, "The interpreter marked other instructions.");
+    ASSERT(memcmp(bitmaps[2], bitmaps[1], GBA_COVERAGE_SIZE) == 0, "The JIT backend marked other instructions.");
+
+    END_TEST_CASE;
+}
+
+/* Description: Block transfers within RAM are copied directly, taking the
+ * same cycles and giving the same results as one access per register, and
+ * the other transfers still go through the bus.
+ */
+void test_cpu_blockTransfer() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe3a01001, // mov r1, #1
+        0xe3a02002, // mov r2, #2
+        0xe3a03003, // mov r3, #3
+        0xe92d000e, // push {r1-r3}
+        0xe8bd0070, // pop {r4-r6}
+        0xe3a07406, // mov r7, #0x06000000
+        0xe8a7000e, // stmia r7!, {r1-r3}
+        0xe9370700, // ldmdb r7!, {r8-r10}
+        0xeafffffe  // b .
+    };
+
+    gba_cpu_state_t states[2];
+
+    // Hashing the writes makes stores take the per-register path.
+    for(int i = 0; i < 2; i++) {
+        test_cpu_boot(GBA_CPU_BACKEND_INTERPRETER);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        gba_bus_writeHashing = i == 1;
+        test_cpu_runEvents(2);
+        gba_bus_writeHashing = false;
+        gba_cpu_getState(&states[i]);
+    }
+
+    ASSERT(states[0].r[4] == 1 && states[0].r[5] == 2 && states[0].r[6] == 3, "The registers were not popped.");
+    ASSERT(states[0].r[8] == 1 && states[0].r[9] == 2 && states[0].r[10] == 3, "The registers were not loaded from VRAM.");
+    ASSERT(states[0].r[7] == 0x06000000 && states[0].r[13] == 0x03007f00, "The base registers were not written back.");
+    ASSERT(memcmp(&states[0], &states[1], sizeof(gba_cpu_state_t)) == 0, "The direct copy gave different results.");
+
+    uint64_t cycles = gba_scheduler_cycleCounter;
+
+    for(int i = 0; i < 4; i++) {
+        gba_bus_read32(0x02000000 + i * 4);
+        gba_bus_sequential = true;
+    }
+
+    gba_bus_sequential = false;
+    cycles = gba_scheduler_cycleCounter - cycles;
+    uint64_t burstCycles = gba_scheduler_cycleCounter;
+
+    ASSERT(gba_bus_getBurst32(0x02000000, 4, false) != NULL, "The burst in EWRAM was not copied directly.");
+    ASSERT(gba_scheduler_cycleCounter - burstCycles == cycles, "The burst took different cycles.");
+    ASSERT(gba_bus_getBurst32(0x03007ff8, 4, true) == NULL, "The burst crossing the end of IWRAM was copied directly.");
+    ASSERT(gba_bus_getBurst32(0x06000000, 4, true) == NULL, "The burst in VRAM was copied directly.");
+
+    END_TEST_CASE;
+}
+
+/* Description: Overwriting cached code in EWRAM invalidates the block.
+ */
+void test_cpu_selfModifyingCode() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+    test_cpu_runEvents(4);
+
+    gba_bus_write32(0x02000000, 0xe3a00055); // mov r0, #0x55
+    test_cpu_runEvents(1);
+
+    ASSERT(gba_bus_read32(0x02000100) == 0x55, "The overwritten code was still executed.");
+
+    END_TEST_CASE;
+}
+
+/* Description: The condition flags are evaluated correctly when they are
+ * read after being set by additions and subtractions.
+ */
+void test_cpu_flags() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe3a00000, // mov r0, #0
+        0xe2501001, // subs r1, r0, #1
+        0xe2a02000, // adc r2, r0, #0
+        0x43a03001, // movmi r3, #1
+        0xe2914001, // adds r4, r1, #1
+        0xe2a05000, // adc r5, r0, #0
+        0x03a06001, // moveq r6, #1
+        0xe10f7000, // mrs r7, cpsr
+        0xeafffffe  // b .
+    };
+
+    gba_cpu_backend_t backends[] = {
+        GBA_CPU_BACKEND_INTERPRETER,
+        GBA_CPU_BACKEND_CACHED,
+        GBA_CPU_BACKEND_JIT
+    };
+
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if(!gba_cpu_setBackend(backends[i])) {
+            continue;
+        }
+
+        test_cpu_boot(backends[i]);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        test_cpu_runEvents(4);
+
+        ASSERT(gba_cpu_r[2] == 0, "The subtraction did not clear the carry flag.");
+        ASSERT(gba_cpu_r[3] == 1, "The subtraction did not set the negative flag.");
+        ASSERT(gba_cpu_r[5] == 1, "The addition did not set the carry flag.");
+        ASSERT(gba_cpu_r[6] == 1, "The addition did not set the zero flag.");
+        ASSERT((gba_cpu_r[7] & 0xf0000000) == 0x60000000, "The CPSR holds the wrong flags.");
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+/* Description: Thumb instructions get the right operands from their
+ * decoded records, including signed offsets and high registers.
+ */
+void test_cpu_thumb() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe28f0001, // add r0, pc, #1
+        0xe12fff10, // bx r0
+        0x2200210a, // movs r1, #10; movs r2, #0
+        0x39011852, // adds r2, r2, r1; subs r1, #1
+        0xf000d1fc, // bne 0x0200000c; bl 0x02000026
+        0xb082f808,
+        0xb002ac01, // sub sp, #8; add r4, sp, #4; add sp, #8
+        0x25014690, // mov r8, r2; movs r5, #1
+        0x4e024445, // add r5, r8; ldr r6, [pc, #8]
+        0x2307e7fe, // b .; movs r3, #7
+        0x46c04770, // bx lr; nop
+        0x12345678
+    };
+
+    gba_cpu_backend_t backends[] = {
+        GBA_CPU_BACKEND_INTERPRETER,
+        GBA_CPU_BACKEND_CACHED,
+        GBA_CPU_BACKEND_JIT
+    };
+
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if(!gba_cpu_setBackend(backends[i])) {
+            continue;
+        }
+
+        test_cpu_boot(backends[i]);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        test_cpu_runEvents(4);
+
+        ASSERT(gba_cpu_r[2] == 55, "The loop did not run ten times.");
+        ASSERT(gba_cpu_r[3] == 7, "The subroutine was not called.");
+        ASSERT(gba_cpu_r[4] == 0x03007efc, "The stack pointer offsets are wrong.");
+        ASSERT(gba_cpu_r[5] == 56 && gba_cpu_r[13] == 0x03007f00, "The high register was not added.");
+        ASSERT(gba_cpu_r[6] == 0x12345678, "The literal was not loaded.");
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+/* Description: Fusing Thumb instruction pairs in the cached backend gives
+ * the same state in the same number of cycles.
+ */
+void test_cpu_fusion() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe28f0001, // add r0, pc, #1
+        0xe12fff10, // bx r0
+        0x31012100, // movs r1, #0; adds r1, #1
+        0xd1fc290a, // cmp r1, #10; bne 0x0200000a
+        0xf802f000, // bl 0x02000018
+        0x47004802, // ldr r0, [pc, #8]; bx r0
+        0x47702307, // movs r3, #7; bx lr
+        0xe7fe2409, // movs r4, #9; b .
+        0x0200001d
+    };
+
+    gba_cpu_state_t states[2];
+    uint64_t cycles[2];
+    uint64_t fusionCounts[GBA_CPU_FUSION_COUNT];
+
+    for(int i = 0; i < 2; i++) {
+        gba_cpu_setFusion(i == 1);
+        test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        test_cpu_runEvents(4);
+        gba_cpu_getState(&states[i]);
+        cycles[i] = gba_scheduler_cycleCounter;
+    }
+
+    memcpy(fusionCounts, gba_cpu_fusionCounts, sizeof(fusionCounts));
+
+    ASSERT(states[0].r[1] == 10 && states[0].r[3] == 7 && states[0].r[4] == 9, "The program did not run.");
+    ASSERT(memcmp(&states[0], &states[1], sizeof(gba_cpu_state_t)) == 0, "The fused pairs gave different results.");
+    ASSERT(cycles[0] == cycles[1], "The fused pairs took different cycles.");
+    ASSERT(fusionCounts[GBA_CPU_FUSION_BL] == 1, "The BL pair was not fused.");
+    ASSERT(fusionCounts[GBA_CPU_FUSION_CMP_B] == 10, "The CMP and branch pair was not fused.");
+    ASSERT(fusionCounts[GBA_CPU_FUSION_LDR_BX] == 1, "The literal load and BX pair was not fused.");
+
+    END_TEST_CASE;
+}
+
+/* Description: Reading from the ROM takes the number of wait states set in
+ * WAITCNT.
+ */
+void test_cpu_waitStates() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+
+    uint64_t cycles = gba_scheduler_cycleCounter;
+    gba_bus_read16(0x08000000);
+
+    ASSERT(gba_scheduler_cycleCounter - cycles == 5, "The default ROM wait states were not applied.");
+
+    gba_bus_write16(0x04000204, 0x0024); // 3 wait states for WS0 and WS1
+    cycles = gba_scheduler_cycleCounter;
+    gba_bus_read16(0x08000000);
+    gba_bus_read16(0x0a000000);
+
+    ASSERT(gba_scheduler_cycleCounter - cycles == 8, "The ROM wait states were not updated.");
+
+    END_TEST_CASE;
+}
+
+/* Description: Code executed from ROM is predecoded one page at a time, and
+ * runs the same way as when it is decoded block by block.
+ */
+void test_cpu_predecode() {
+    BEGIN_TEST_CASE;
+
+    uint32_t counts[2];
+
+    for(int i = 0; i < 2; i++) {
+        gba_cpu_setPredecodeLimit(i * 65536);
+        test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+
+        test_cpu_rom[0] = 0xe3a01402; // mov r1, #0x02000000
+        test_cpu_rom[1] = 0xe2800001; // add r0, r0, #1
+        test_cpu_rom[2] = 0xe5810100; // str r0, [r1, #0x100]
+        test_cpu_rom[3] = 0xeafffffc; // b 0x08000004
+
+        test_cpu_runEvents(16);
+        counts[i] = gba_bus_read32(0x02000100);
+    }
+
+    ASSERT(gba_cpu_getPredecodedPageCount() == 1, "The ROM page was not predecoded.");
+    ASSERT(counts[0] != 0 && counts[0] == counts[1], "The predecoded code ran differently.");
+
+    gba_cpu_setPredecodeLimit(0);
+
+    END_TEST_CASE;
+}
+
+/* Description: A loop polling memory is skipped until the next event, and
+ * left once the polled value changes.
+ */
+void test_cpu_idleLoop() {
+    BEGIN_TEST_CASE;
+
+    test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+    gba_cpu_setIdleLoopSkipping(true);
+
+    gba_bus_write32(0x02000000, 0xe59e0100); // ldr r0, [lr, #0x100]
+    gba_bus_write32(0x02000004, 0xe3500000); // cmp r0, #0
+    gba_bus_write32(0x02000008, 0x0afffffc); // beq 0x02000000
+    gba_bus_write32(0x0200000c, 0xeafffffe); // b .
+    gba_bus_write32(0x02000100, 0);
+
+    test_cpu_runEvents(16);
+
+    ASSERT(gba_cpu_idleSkippedCycles != 0, "The idle loop was not skipped.");
+
+    gba_bus_write32(0x02000100, 1);
+    test_cpu_runEvents(2);
+
+    ASSERT(gba_cpu_r[15] == 0x02000014, "The idle loop was not left.");
+
+    gba_cpu_setIdleLoopSkipping(false);
+
+    END_TEST_CASE;
+}
+
+/* Description: Writing to HALTCNT, with a byte write or with a halfword
+ * write to POSTFLG, stops the CPU until an enabled interrupt is requested,
+ * even with IME cleared.
+ */
+void test_cpu_halt() {
+    BEGIN_TEST_CASE;
+
+    static uint32_t program[] = {
+        0xe3a01301, // mov r1, #0x04000000
+        0xe2811c02, // add r1, r1, #0x200
+        0xe2814c01, // add r4, r1, #0x100
+        0xe3a00001, // mov r0, #1
+        0xe1c100b0, // strh r0, [r1]
+        0xe3a02301, // mov r2, #0x04000000
+        0xe3a00008, // mov r0, #8
+        0xe1c200b4, // strh r0, [r2, #4]
+        0xe3a00000, // mov r0, #0
+        0xe5c40001, // strb r0, [r4, #1]
+        0xe2833001, // add r3, r3, #1
+        0xeafffffe  // b .
+    };
+
+    static const uint32_t haltInstructions[] = {
+        0xe5c40001, // strb r0, [r4, #1]
+        0xe1c400b0  // strh r0, [r4]
+    };
+
+    gba_cpu_backend_t backends[] = {
+        GBA_CPU_BACKEND_INTERPRETER,
+        GBA_CPU_BACKEND_CACHED,
+        GBA_CPU_BACKEND_JIT
+    };
+
+    for(size_t k = 0; k < sizeof(haltInstructions) / sizeof(haltInstructions[0]); k++) {
+        program[9] = haltInstructions[k];
+
+        for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+            if(!gba_cpu_setBackend(backends[i])) {
+                continue;
+            }
+
+            test_cpu_boot(backends[i]);
+
+            for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+                gba_bus_write32(0x02000000 + j * 4, program[j]);
+            }
+
+            // VBlank starts at cycle 197120.
+            while(gba_scheduler_cycleCounter < 190000) {
+                test_cpu_runEvents(1);
+            }
+
+            ASSERT(gba_cpu_r[3] == 0, "The CPU did not halt.");
+
+            while(gba_scheduler_cycleCounter < 200000) {
+                test_cpu_runEvents(1);
+            }
+
+            ASSERT(gba_cpu_r[3] == 1, "The CPU was not woken up by the interrupt.");
+        }
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+/* Description: An interrupt made pending by a store to IME in the middle
+ * of a block is taken right after the store in every backend, as in the
+ * interpreter.
+ */
+void test_cpu_irqMidBlock() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe3a01301, // mov r1, #0x04000000
+        0xe2811c02, // add r1, r1, #0x200
+        0xe3a02001, // mov r2, #1
+        0xe1c120b8  // strh r2, [r1, #8]
+    };
+
+    gba_cpu_backend_t backends[] = {
+        GBA_CPU_BACKEND_INTERPRETER,
+        GBA_CPU_BACKEND_CACHED,
+        GBA_CPU_BACKEND_JIT
+    };
+
+    gba_cpu_state_t state;
+
+    // The IRQ vector loops, keeping the registers as they were on entry.
+    test_cpu_bios[0x18 / 4] = 0xeafffffe; // b .
+
+    for(size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if(!gba_cpu_setBackend(backends[i])) {
+            continue;
+        }
+
+        test_cpu_boot(backends[i]);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        for(uint32_t j = 0; j < 20; j++) {
+            gba_bus_write32(0x02000010 + j * 4, 0xe2800001); // add r0, r0, #1
+        }
+
+        gba_bus_write32(0x02000060, 0xeafffffe); // b .
+        gba_bus_write16(0x04000200, 0x3fff);
+        gba_setInterruptFlag(1);
+        test_cpu_runEvents(4);
+        gba_cpu_getState(&state);
+
+        ASSERT((state.cpsr & 0x1f) == 0x12, "The interrupt was not taken.");
+        ASSERT(gba_cpu_r[0] == 0, "Instructions ran after the store to IME.");
+    }
+
+    test_cpu_bios[0x18 / 4] = 0;
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+
+    END_TEST_CASE;
+}
+
+/* Description: Pressing a key selected in KEYCNT wakes the CPU up from the
+ * halt state, and from the stop state, which VBlank does not wake it up
+ * from.
+ */
+void test_cpu_keypadWakeup() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe3a01301, // mov r1, #0x04000000
+        0xe2811c02, // add r1, r1, #0x200
+        0xe3a00a01, // mov r0, #0x1000
+        0xe2800001, // add r0, r0, #1
+        0xe1c100b0, // strh r0, [r1]
+        0xe3a02301, // mov r2, #0x04000000
+        0xe3a00008, // mov r0, #8
+        0xe1c200b4, // strh r0, [r2, #4]
+        0xe3a00901, // mov r0, #0x4000
+        0xe2800001, // add r0, r0, #1
+        0xe2822c01, // add r2, r2, #0x100
+        0xe1c203b2, // strh r0, [r2, #0x32]
+        0xe3a00000, // mov r0, #0 (#0x80 to stop)
+        0xe5c10101, // strb r0, [r1, #0x101]
+        0xe2833001, // add r3, r3, #1
+        0xeafffffe  // b .
+    };
+
+    bool released[10] = {false};
+    bool pressed[10] = {true};
+
+    for(int i = 0; i < 2; i++) {
+        bool stop = i == 1;
+
+        test_cpu_boot(GBA_CPU_BACKEND_CACHED);
+        gba_keypad_update(released);
+
+        for(size_t j = 0; j < sizeof(program) / sizeof(program[0]); j++) {
+            gba_bus_write32(0x02000000 + j * 4, program[j]);
+        }
+
+        if(stop) {
+            gba_bus_write32(0x02000030, 0xe3a00080); // mov r0, #0x80
+        } else {
+            gba_bus_write32(0x02000000 + 3 * 4, 0xe1a00000); // nop, only the keypad interrupt
+        }
+
+        // VBlank starts at cycle 197120.
+        while(gba_scheduler_cycleCounter < 200000) {
+            test_cpu_runEvents(1);
+        }
+
+        if(stop) {
+            ASSERT(gba_cpu_r[3] == 0, "The CPU was woken up from the stop state by VBlank.");
+        }
+
+        while(gba_scheduler_cycleCounter < 210000) {
+            test_cpu_runEvents(1);
+        }
+
+        ASSERT(gba_cpu_r[3] == 0, "The CPU was woken up without a key press.");
+
+        gba_keypad_update(pressed);
+        test_cpu_runEvents(2);
+
+        ASSERT(gba_cpu_r[3] == 1, "The CPU was not woken up by the key press.");
+        ASSERT(gba_bus_read16(0x04000202) & (1 << 12), "The keypad interrupt was not requested.");
+    }
+
+    END_TEST_CASE;
+}
@@ -0,0 +1,28 @@
+#ifndef __TEST_CPU__
+#define __TEST_CPU__
+
+extern void test_cpu_backendsAgree();
+extern void test_cpu_stateAgrees();
+extern void test_cpu_pipelineFree();
+extern void test_cpu_trace();
+extern void test_cpu_traceKeyframes();
+extern void test_cpu_blockTransfer();
+extern void test_cpu_selfModifyingCode();
+extern void test_cpu_jitAgrees();
+extern void test_cpu_jitCache();
+extern void test_cpu_aot();
+#ifdef GBA_AOT_TEST_ROM
+extern void test_cpu_aotRom();
+#endif
+extern void test_cpu_coverage();
+extern void test_cpu_flags();
+extern void test_cpu_thumb();
+extern void test_cpu_fusion();
+extern void test_cpu_waitStates();
+extern void test_cpu_predecode();
+extern void test_cpu_idleLoop();
+extern void test_cpu_halt();
+extern void test_cpu_irqMidBlock();
+extern void test_cpu_keypadWakeup();
+
+#endif
@@ -0,0 +1,41 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libtest.h"
+#include "core/cpu.h"
+#include "core/disasm.h"
+
+/* Description: Instructions of each set are classified by the decode tables
+ * and formatted with their operands.
+ */
+void test_disasm_formats() {
+    BEGIN_TEST_CASE;
+
+    char text[GBA_DISASM_BUFFER_SIZE];
+
+    gba_cpu_init();
+
+    gba_disasm_arm(0x08000000, 0xe0911102, text); // adds r1, r1, r2, lsl #2
+    ASSERT(strcmp(text, "adds r1, r1, r2, lsl #2") == 0, "A data processing instruction was not disassembled.");
+
+    gba_disasm_arm(0x08000000, 0x1a000002, text); // bne 0x08000010
+    ASSERT(strcmp(text, "bne 0x8000010") == 0, "A branch was not disassembled.");
+
+    gba_disasm_arm(0x08000000, 0xe92d4030, text); // stmdb sp!, {r4, r5, lr}
+    ASSERT(strcmp(text, "stmdb sp!, {r4, r5, lr}") == 0, "A block data transfer was not disassembled.");
+
+    gba_disasm_arm(0x08000000, 0xe1d300b2, text); // ldrh r0, [r3, #2]
+    ASSERT(strcmp(text, "ldrh r0, [r3, #0x2]") == 0, "A halfword data transfer was not disassembled.");
+
+    gba_disasm_arm(0x08000000, 0xee000000, text);
+    ASSERT(strcmp(text, "undefined") == 0, "A coprocessor instruction was not reported as undefined.");
+
+    gba_disasm_thumb(0x08000000, 0xb5f0, text); // push {r4-r7, lr}
+    ASSERT(strcmp(text, "push {r4-r7, lr}") == 0, "A push was not disassembled.");
+
+    ASSERT(gba_disasm_thumb(0x08000000, 0xf800f000, text) == 4, "Both halves of a BL were not disassembled together.");
+    ASSERT(strcmp(text, "bl 0x8000004") == 0, "A BL was not disassembled.");
+
+    END_TEST_CASE;
+}
@@ -0,0 +1,6 @@
+#ifndef __TEST_DISASM__
+#define __TEST_DISASM__
+
+extern void test_disasm_formats();
+
+#endif
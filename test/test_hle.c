@@ -0,0 +1,85 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libtest.h"
+#include "core/bus.h"
+#include "core/cpu.h"
+#include "core/gba.h"
+#include "core/scheduler.h"
+
+static uint32_t test_hle_rom[1024];
+
+// Boots the given program from the ROM without a BIOS image.
+static void test_hle_boot(const uint32_t *program, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        test_hle_rom[i] = program[i];
+    }
+
+    gba_cpu_setBackend(GBA_CPU_BACKEND_CACHED);
+    gba_init(true);
+    gba_setBios(NULL);
+    gba_setRom(test_hle_rom, sizeof(test_hle_rom));
+}
+
+static void test_hle_run() {
+    for(int i = 0; i < 4; i++) {
+        gba_cpu_run();
+        gba_scheduler_processEvents();
+    }
+}
+
+/* Description: The Div SWI returns the quotient, the remainder and the
+ * absolute value of the quotient.
+ */
+void test_hle_div() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe3a00064, // mov r0, #100
+        0xe3e01006, // mvn r1, #6
+        0xef060000, // swi 0x06
+        0xeafffffe  // b .
+    };
+
+    test_hle_boot(program, sizeof(program) / sizeof(program[0]));
+    test_hle_run();
+
+    ASSERT(gba_cpu_r[0] == (uint32_t)-14, "The quotient is wrong.");
+    ASSERT(gba_cpu_r[1] == 2, "The remainder is wrong.");
+    ASSERT(gba_cpu_r[3] == 14, "The absolute quotient is wrong.");
+
+    END_TEST_CASE;
+}
+
+/* Description: The LZ77UnCompWram SWI expands both literals and references
+ * to previous output.
+ */
+void test_hle_lz77UnComp() {
+    BEGIN_TEST_CASE;
+
+    static const uint32_t program[] = {
+        0xe3a00402, // mov r0, #0x02000000
+        0xe2801c01, // add r1, r0, #0x100
+        0xef110000, // swi 0x11
+        0xeafffffe  // b .
+    };
+
+    static const uint8_t data[] = {
+        0x10, 0x08, 0x00, 0x00, // 8 bytes
+        0x20, 0x41, 0x42,       // 'A', 'B'
+        0x30, 0x01              // 6 bytes from 2 bytes back
+    };
+
+    test_hle_boot(program, sizeof(program) / sizeof(program[0]));
+
+    for(size_t i = 0; i < sizeof(data); i++) {
+        gba_bus_write8(0x02000000 + i, data[i]);
+    }
+
+    test_hle_run();
+
+    ASSERT(gba_bus_read32(0x02000100) == 0x42414241, "The literals were not copied.");
+    ASSERT(gba_bus_read32(0x02000104) == 0x42414241, "The reference was not expanded.");
+
+    END_TEST_CASE;
+}
@@ -0,0 +1,7 @@
+#ifndef __TEST_HLE__
+#define __TEST_HLE__
+
+extern void test_hle_div();
+extern void test_hle_lz77UnComp();
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libtest.h"
+#include "core/scheduler.h"
+
+static int test_scheduler_callCount;
+static gba_scheduler_event_t test_scheduler_calls[8];
+static uint64_t test_scheduler_timestamps[8];
+
+static void test_scheduler_record(gba_scheduler_event_t event, uint64_t timestamp) {
+    if(test_scheduler_callCount < 8) {
+        test_scheduler_calls[test_scheduler_callCount] = event;
+        test_scheduler_timestamps[test_scheduler_callCount] = timestamp;
+    }
+
+    test_scheduler_callCount++;
+}
+
+static void test_scheduler_onTimer0(uint64_t timestamp) {
+    test_scheduler_record(GBA_SCHEDULER_EVENT_TIMER0, timestamp);
+}
+
+static void test_scheduler_onTimer1(uint64_t timestamp) {
+    test_scheduler_record(GBA_SCHEDULER_EVENT_TIMER1, timestamp);
+}
+
+static void test_scheduler_onTimer2(uint64_t timestamp) {
+    test_scheduler_record(GBA_SCHEDULER_EVENT_TIMER2, timestamp);
+}
+
+static void test_scheduler_init() {
+    test_scheduler_callCount = 0;
+    gba_scheduler_reset();
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER0, test_scheduler_onTimer0);
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER1, test_scheduler_onTimer1);
+    gba_scheduler_setCallback(GBA_SCHEDULER_EVENT_TIMER2, test_scheduler_onTimer2);
+}
+
+/* Description: Events are dispatched in timestamp order, and only once due.
+ */
+void test_scheduler_order() {
+    BEGIN_TEST_CASE;
+
+    test_scheduler_init();
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER0, 300);
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER1, 100);
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER2, 200);
+
+    ASSERT(gba_scheduler_nextEventTimestamp == 100, "The next event timestamp is not the earliest one.");
+
+    gba_scheduler_cycleCounter = 99;
+    gba_scheduler_processEvents();
+    ASSERT(test_scheduler_callCount == 0, "An event was dispatched before being due.");
+
+    gba_scheduler_cycleCounter = 250;
+    gba_scheduler_processEvents();
+    ASSERT(test_scheduler_callCount == 2, "The due events were not all dispatched.");
+    ASSERT(test_scheduler_calls[0] == GBA_SCHEDULER_EVENT_TIMER1, "Events were dispatched out of order.");
+    ASSERT(test_scheduler_calls[1] == GBA_SCHEDULER_EVENT_TIMER2, "Events were dispatched out of order.");
+    ASSERT(test_scheduler_timestamps[1] == 200, "The callback did not receive the due timestamp.");
+    ASSERT(gba_scheduler_nextEventTimestamp == 300, "The next event timestamp was not updated.");
+
+    END_TEST_CASE;
+}
+
+/* Description: Rescheduling moves an event and cancelling removes it.
+ */
+void test_scheduler_rescheduleAndCancel() {
+    BEGIN_TEST_CASE;
+
+    test_scheduler_init();
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER0, 100);
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER1, 100);
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER2, 50);
+    gba_scheduler_schedule(GBA_SCHEDULER_EVENT_TIMER2, 150);
+    gba_scheduler_cancel(GBA_SCHEDULER_EVENT_TIMER0);
+
+    ASSERT(!gba_scheduler_isScheduled(GBA_SCHEDULER_EVENT_TIMER0), "A cancelled event is still scheduled.");
+    ASSERT(gba_scheduler_nextEventTimestamp == 100, "The next event timestamp is wrong after cancelling.");
+
+    gba_scheduler_cycleCounter = 1000;
+    gba_scheduler_processEvents();
+    ASSERT(test_scheduler_callCount == 2, "A cancelled or moved event was dispatched twice.");
+    ASSERT(test_scheduler_calls[0] == GBA_SCHEDULER_EVENT_TIMER1, "Events were dispatched out of order.");
+    ASSERT(test_scheduler_timestamps[1] == 150, "A rescheduled event kept its old timestamp.");
+    ASSERT(gba_scheduler_nextEventTimestamp == UINT64_MAX, "The queue is not empty.");
+
+    END_TEST_CASE;
+}
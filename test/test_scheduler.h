@@ -0,0 +1,7 @@
+#ifndef __TEST_SCHEDULER__
+#define __TEST_SCHEDULER__
+
+extern void test_scheduler_order();
+extern void test_scheduler_rescheduleAndCancel();
+
+#endif
@@ -0,0 +1,54 @@
+; Test ROM for gbaaot. A Thumb loop mixing the register-only instructions
+; that gbaaot writes in C with ones it leaves to the interpreter, storing
+; its registers to EWRAM on every iteration. make test-aot checks that the
+; compiled blocks run it like the cached backend.
+
+format binary as 'gba'
+org 0x08000000
+
+code32
+
+start:
+    mov r4, #0x02000000
+    mov r3, #0x41000000
+    orr r3, r3, #0x00c60000
+    orr r3, r3, #0x00004e00
+    orr r3, r3, #0x0000006d
+    add r0, pc, #1
+    bx r0
+
+code16
+
+main:
+    mov r0, #1
+    mov r1, #0
+    mov r6, #0
+    mov r7, #0
+
+loop:
+    mul r0, r3
+    add r0, #0x39
+    lsl r2, r0, #3
+    adc r7, r1
+    eor r2, r0
+    sub r5, r2, r0
+    mvn r5, r5
+    asr r2, r2, #5
+    orr r5, r2
+    lsr r2, r0, #1
+    bcc skip
+    add r6, #1
+    cmp r6, r7
+    bic r5, r6
+
+skip:
+    add r6, r6, #2
+    mov r8, r6
+    add r8, r0
+    mov r2, r8
+    str r0, [r4, #0]
+    str r2, [r4, #4]
+    str r5, [r4, #8]
+    str r6, [r4, #12]
+    str r7, [r4, #16]
+    b loop